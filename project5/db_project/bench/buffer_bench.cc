@@ -0,0 +1,131 @@
+/**
+ * @addtogroup Benchmark
+ * @{
+ */
+#include <db.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+
+/// @brief Benchmark table file path.
+static const char* BENCH_TABLE_PATH = "bench_buffer.db";
+
+/// @brief Number of records inserted before measuring.
+static constexpr int NUM_KEYS = 20000;
+/// @brief Total number of lookups for each thread count.
+static constexpr int NUM_LOOKUPS = 320000;
+/// @brief Maximum number of worker threads.
+static constexpr int MAX_THREADS = 32;
+
+/// @brief Minimum record value size.
+static constexpr int MIN_VAL_SIZE = 50;
+
+/**
+ * @brief Lookup worker argument.
+ */
+struct LookupArgs {
+    /// @brief table id.
+    tableid_t table_id;
+    /// @brief random seed of this worker.
+    unsigned int seed;
+    /// @brief number of lookups to do.
+    int lookup_count;
+    /// @brief number of failed lookups.
+    int failed;
+};
+
+/**
+ * @brief Look up random keys.
+ *
+ * @param arg   <code>LookupArgs*</code>.
+ * @return <code>nullptr</code>.
+ */
+void* lookup_worker(void* arg) {
+    LookupArgs* args = reinterpret_cast<LookupArgs*>(arg);
+    std::mt19937 gen(args->seed);
+    std::uniform_int_distribution<recordkey_t> key_dis(1, NUM_KEYS);
+
+    char value[MAX_VALUE_SIZE];
+    valsize_t value_size;
+    for (int i = 0; i < args->lookup_count; i++) {
+        if (db_find(args->table_id, key_dis(gen), value, &value_size) != 0) {
+            args->failed++;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief   Buffer manager scaling benchmark.
+ * @details Fills a table, then runs a fixed number of random point lookups
+ * with 1 to 32 threads and prints the throughput of each run.
+ *
+ * usage: <code>buffer_bench [num_shards] [num_buf] [policy]</code>
+ */
+int main(int argc, char** argv) {
+    int num_shards = argc > 1 ? atoi(argv[1]) : DEFAULT_BUFFER_SHARDS;
+    int num_buf = argc > 2 ? atoi(argv[2]) : DEFAULT_BUFFER_SIZE;
+    ReplacementPolicyType policy =
+        argc > 3 ? static_cast<ReplacementPolicyType>(atoi(argv[3]))
+                 : DEFAULT_REPLACEMENT_POLICY;
+
+    unlink(BENCH_TABLE_PATH);
+    if (init_db(num_buf, num_shards, policy) != 0) {
+        std::cerr << "init_db failed" << std::endl;
+        return 1;
+    }
+
+    tableid_t table_id = open_table(const_cast<char*>(BENCH_TABLE_PATH));
+    if (table_id < 0) {
+        std::cerr << "open_table failed" << std::endl;
+        return 1;
+    }
+
+    std::mt19937 gen(1);
+    std::uniform_int_distribution<int> len_dis(MIN_VAL_SIZE, MAX_VALUE_SIZE);
+    char value[MAX_VALUE_SIZE];
+    memset(value, 'v', MAX_VALUE_SIZE);
+    for (int key = 1; key <= NUM_KEYS; key++) {
+        db_insert(table_id, key, value, len_dis(gen));
+    }
+
+    std::cout << "shards=" << num_shards << " buffer=" << num_buf
+              << " policy=" << policy << "\n";
+    std::cout << "threads\tops/sec\n";
+
+    pthread_t threads[MAX_THREADS];
+    LookupArgs args[MAX_THREADS];
+    for (int thread_count = 1; thread_count <= MAX_THREADS; thread_count *= 2) {
+        auto start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < thread_count; i++) {
+            args[i] = {table_id, static_cast<unsigned int>(i + 1),
+                       NUM_LOOKUPS / thread_count, 0};
+            pthread_create(&threads[i], nullptr, lookup_worker, &args[i]);
+        }
+
+        int failed = 0;
+        for (int i = 0; i < thread_count; i++) {
+            pthread_join(threads[i], nullptr);
+            failed += args[i].failed;
+        }
+
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        std::cout << thread_count << "\t"
+                  << static_cast<long>(NUM_LOOKUPS / elapsed.count());
+        if (failed) std::cout << "\t(" << failed << " failed)";
+        std::cout << std::endl;
+    }
+
+    shutdown_db();
+    unlink(BENCH_TABLE_PATH);
+    return 0;
+}
+/** @}*/
@@ -0,0 +1,181 @@
+/**
+ * @addtogroup Benchmark
+ * @{
+ */
+#include <buffer.h>
+#include <db.h>
+#include <fcntl.h>
+#include <file.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+/// @brief Benchmark table file path.
+static const char* BENCH_TABLE_PATH = "bench_direct_io.db";
+
+/// @brief Default memory budget(in pages).
+static constexpr int DEFAULT_BUDGET_PAGES = 2048;
+/// @brief Default number of pages of the table file.
+static constexpr int DEFAULT_TABLE_PAGES = 16384;
+/// @brief Default number of measured page reads.
+static constexpr int DEFAULT_NUM_READS = 200000;
+
+/**
+ * @brief Benchmark configuration.
+ */
+struct BenchConfig {
+    /// @brief configuration name.
+    const char* name;
+    /// @brief <code>true</code> to open the table with O_DIRECT.
+    bool direct_io;
+    /// @brief number of buffer frames.
+    int num_buf;
+};
+
+/**
+ * @brief Count the table file pages in the kernel page cache.
+ *
+ * @param table_pages   number of pages of the table file.
+ * @return number of resident pages.
+ */
+static long count_cached_pages(int table_pages) {
+    int fd = open(BENCH_TABLE_PATH, O_RDONLY);
+    size_t length = static_cast<size_t>(table_pages) * PAGE_SIZE;
+    void* mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return -1;
+    }
+
+    std::vector<unsigned char> residency(table_pages);
+    long cached_pages = 0;
+    if (mincore(mapped, length, residency.data()) == 0) {
+        for (unsigned char resident : residency) {
+            cached_pages += resident & 1;
+        }
+    }
+    munmap(mapped, length);
+    return cached_pages;
+}
+
+/**
+ * @brief Drop the table file from the kernel page cache.
+ */
+static void drop_cached_pages() {
+    int fd = open(BENCH_TABLE_PATH, O_RDONLY);
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+/**
+ * @brief Read skewed random pages through the buffer.
+ *
+ * @param table_id      table id.
+ * @param table_pages   number of pages of the table file.
+ * @param num_reads     number of page reads.
+ * @param seed          random seed.
+ * @param[out] latencies    read latencies in microseconds, if not null.
+ * @return number of reads which hit the buffer.
+ */
+static long read_pages(tableid_t table_id, int table_pages, int num_reads,
+                       unsigned int seed, std::vector<double>* latencies) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> dis(0, 1);
+    fullpage_t page;
+    long hits = 0;
+
+    for (int i = 0; i < num_reads; i++) {
+        // Cubing a uniform value makes low pages hot.
+        double u = dis(gen);
+        pagenum_t pagenum = 1 + static_cast<pagenum_t>(u * u * u *
+                                                        (table_pages - 1));
+        PageLocation page_location = std::make_pair(table_id, pagenum);
+        hits += buffer_helper::get_shard(page_location).index.count(
+            page_location);
+
+        auto start = std::chrono::steady_clock::now();
+        buffered_read_page(table_id, pagenum, &page, 0, false);
+        std::chrono::duration<double, std::micro> elapsed =
+            std::chrono::steady_clock::now() - start;
+        if (latencies != nullptr) {
+            latencies->push_back(elapsed.count());
+        }
+    }
+    return hits;
+}
+
+/**
+ * @brief   O_DIRECT cache efficiency benchmark.
+ * @details Reads skewed random pages of a table which does not fit in the
+ * memory budget, with a cold kernel page cache. The buffered configurations
+ * also fill the page cache, so the pages resident in it are reported as
+ * memory in use. <code>buffered/2</code> gives half of the budget to the
+ * buffer pool, as if the page cache was capped at the other half.
+ *
+ * usage: <code>direct_io_bench [budget_pages] [table_pages] [num_reads]</code>
+ */
+int main(int argc, char** argv) {
+    int budget_pages = argc > 1 ? atoi(argv[1]) : DEFAULT_BUDGET_PAGES;
+    int table_pages = argc > 2 ? atoi(argv[2]) : DEFAULT_TABLE_PAGES;
+    int num_reads = argc > 3 ? atoi(argv[3]) : DEFAULT_NUM_READS;
+
+    unlink(BENCH_TABLE_PATH);
+    if (init_db(budget_pages) != 0) {
+        std::cerr << "init_db failed" << std::endl;
+        return 1;
+    }
+    tableid_t table_id = open_table(const_cast<char*>(BENCH_TABLE_PATH));
+    file_helper::extend_capacity(table_id, table_pages);
+    shutdown_db();
+
+    BenchConfig configs[] = {{"buffered", false, budget_pages},
+                             {"buffered/2", false, budget_pages / 2},
+                             {"direct", true, budget_pages}};
+
+    std::cout << "budget=" << budget_pages << " table=" << table_pages
+              << " reads=" << num_reads << "\n";
+    std::cout << "mode\tpool\tcached\tmemory\thit%\tavg_us\tp99_us\n";
+    for (const BenchConfig& config : configs) {
+        drop_cached_pages();
+        if (init_db(config.num_buf) != 0) {
+            std::cerr << "init_db failed" << std::endl;
+            return 1;
+        }
+        table_id = open_table(const_cast<char*>(BENCH_TABLE_PATH),
+                              PREAD_BACKEND, config.direct_io);
+        if (config.direct_io && !file_is_direct_io(table_id)) {
+            std::cerr << "O_DIRECT is not supported" << std::endl;
+        }
+
+        // Warm up the buffer, then measure.
+        read_pages(table_id, table_pages, num_reads / 4, 1, nullptr);
+        std::vector<double> latencies;
+        latencies.reserve(num_reads);
+        long hits = read_pages(table_id, table_pages, num_reads, 2, &latencies);
+        shutdown_db();
+
+        double total = 0;
+        for (double latency : latencies) total += latency;
+        std::sort(latencies.begin(), latencies.end());
+        long cached_pages = count_cached_pages(table_pages);
+
+        std::cout << std::fixed << std::setprecision(2) << config.name << "\t"
+                  << config.num_buf << "\t" << cached_pages << "\t"
+                  << config.num_buf + cached_pages << "\t"
+                  << 100.0 * hits / num_reads << "\t" << total / num_reads
+                  << "\t" << latencies[latencies.size() * 99 / 100]
+                  << std::endl;
+    }
+
+    unlink(BENCH_TABLE_PATH);
+    return 0;
+}
+/** @}*/
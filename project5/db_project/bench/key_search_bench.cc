@@ -0,0 +1,211 @@
+/**
+ * @addtogroup Benchmark
+ * @{
+ */
+#include <key_search.h>
+#include <page.h>
+#include <types.h>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+/// @brief Number of searched pages, which are larger than the L2 cache
+/// together.
+static constexpr int NUM_PAGES = 1024;
+/// @brief Number of lookups for each fill factor and search.
+static constexpr int NUM_LOOKUPS = 4000000;
+/// @brief Maximum key gap between two adjacent keys of a page.
+static constexpr recordkey_t MAX_KEY_GAP = 64;
+/// @brief Search which is not a kernel, the loop the tree used before.
+static constexpr int LINEAR_SEARCH = -1;
+
+/// @brief Sum of the search results, so the searches are not optimized out.
+static volatile long checksum;
+
+/**
+ * @brief Searched key.
+ */
+struct Lookup {
+    /// @brief searched page.
+    int page;
+    /// @brief search key.
+    recordkey_t key;
+};
+
+/**
+ * @brief Fill the keys of the pages and make random lookups within them.
+ *
+ * @param keys          keys of the pages, <code>count</code> for each page.
+ * @param count         number of keys in a page.
+ * @param[out] lookups  lookups, half of them are the stored keys.
+ */
+static void make_keys(std::vector<recordkey_t>& keys, int count,
+                      std::vector<Lookup>& lookups) {
+    std::mt19937 gen(count);
+    std::uniform_int_distribution<recordkey_t> gap_dis(1, MAX_KEY_GAP);
+    std::uniform_int_distribution<int> page_dis(0, NUM_PAGES - 1);
+    std::uniform_int_distribution<int> idx_dis(0, count - 1);
+
+    keys.resize(static_cast<size_t>(NUM_PAGES) * count);
+    for (int page = 0; page < NUM_PAGES; page++) {
+        recordkey_t key = 0;
+        for (int i = 0; i < count; i++) {
+            key += gap_dis(gen);
+            keys[page * count + i] = key;
+        }
+    }
+
+    lookups.resize(NUM_LOOKUPS);
+    for (int i = 0; i < NUM_LOOKUPS; i++) {
+        int page = page_dis(gen);
+        recordkey_t key = keys[page * count + idx_dis(gen)];
+        lookups[i] = {page, i % 2 ? key : key - 1};
+    }
+}
+
+/**
+ * @brief Search the internal pages.
+ *
+ * @param pages     internal pages.
+ * @param lookups   lookups.
+ * @param kernel    search kernel, or <code>LINEAR_SEARCH</code>.
+ * @return lookups per second.
+ */
+static long run_branch_lookups(const std::vector<internalpage_t>& pages,
+                               const std::vector<Lookup>& lookups,
+                               int kernel) {
+    long sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const Lookup& lookup : lookups) {
+        const internalpage_t& page = pages[lookup.page];
+        int i = 0;
+        if (kernel == LINEAR_SEARCH) {
+            uint32_t idx;
+            for (idx = 0; idx < page.page_header.key_num; idx++) {
+                if (lookup.key < page.page_branches[idx].key) break;
+            }
+            i = static_cast<int>(idx);
+        } else {
+            i = key_search_helper::upper_bound_branches(
+                static_cast<KeySearchKernel>(kernel), page.page_branches,
+                page.page_header.key_num, lookup.key);
+        }
+        sum += i - 1;
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    checksum = checksum + sum;
+    return static_cast<long>(lookups.size() / elapsed.count());
+}
+
+/**
+ * @brief Search the leaf pages.
+ *
+ * @param pages         leaf pages.
+ * @param lookups       lookups.
+ * @param use_binary    <code>true</code> to use the binary search.
+ * @return lookups per second.
+ */
+static long run_slot_lookups(std::vector<leafpage_t>& pages,
+                             const std::vector<Lookup>& lookups,
+                             bool use_binary) {
+    long sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const Lookup& lookup : lookups) {
+        leafpage_t* page = &pages[lookup.page];
+        int key_idx = -1;
+        if (use_binary) {
+            key_idx = page_helper::get_record_idx(page, lookup.key);
+        } else {
+            PageSlot* leaf_slot = page_helper::get_page_slot(page);
+            for (uint32_t i = 0; i < page->page_header.key_num; i++) {
+                if (leaf_slot[i].key == lookup.key) {
+                    key_idx = static_cast<int>(i);
+                    break;
+                }
+            }
+        }
+        sum += key_idx;
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    checksum = checksum + sum;
+    return static_cast<long>(lookups.size() / elapsed.count());
+}
+
+/**
+ * @brief   Page key search micro-benchmark.
+ * @details Compares the key search kernels with the linear scans they
+ * replace, in random lookups over 1024 pages. Internal pages are filled from
+ * the half of the 248 branches, as a split leaves them, to full. Leaf pages
+ * are filled with the number of the slots which fit 100 and 8 byte values,
+ * at half and full. The kernels the CPU does not support are skipped.
+ *
+ * usage: <code>key_search_bench</code>
+ */
+int main() {
+    const int branch_counts[] = {MAX_PAGE_BRANCHES / 2,
+                                 MAX_PAGE_BRANCHES * 2 / 3,
+                                 MAX_PAGE_BRANCHES * 5 / 6, MAX_PAGE_BRANCHES};
+    const int slot_space = PAGE_SIZE - PAGE_HEADER_SIZE;
+    const int slot_counts[] = {
+        slot_space / (100 + static_cast<int>(sizeof(PageSlot))) / 2,
+        slot_space / (100 + static_cast<int>(sizeof(PageSlot))),
+        slot_space / (8 + static_cast<int>(sizeof(PageSlot))) / 2,
+        slot_space / (8 + static_cast<int>(sizeof(PageSlot)))};
+    KeySearchKernel supported = key_search_helper::get_supported_kernel();
+    std::vector<recordkey_t> keys;
+    std::vector<Lookup> lookups;
+
+    std::vector<internalpage_t> internal_pages(NUM_PAGES);
+    std::cout << "internal page lookups/sec\n";
+    std::cout << "keys\tlinear\tbranchless\tsse4.2\tavx2\n";
+    for (int count : branch_counts) {
+        make_keys(keys, count, lookups);
+        for (int page = 0; page < NUM_PAGES; page++) {
+            internal_pages[page].page_header.key_num = count;
+            for (int i = 0; i < count; i++) {
+                internal_pages[page].page_branches[i].key =
+                    keys[page * count + i];
+                internal_pages[page].page_branches[i].page_idx = i;
+            }
+        }
+
+        std::cout << count;
+        for (int kernel = LINEAR_SEARCH; kernel <= AVX2_SEARCH; kernel++) {
+            std::cout << "\t";
+            if (kernel > supported) {
+                std::cout << "-";
+            } else {
+                std::cout << run_branch_lookups(internal_pages, lookups,
+                                                kernel);
+            }
+        }
+        std::cout << std::endl;
+    }
+
+    std::vector<leafpage_t> leaf_pages(NUM_PAGES);
+    std::cout << "leaf page lookups/sec\n";
+    std::cout << "keys\tlinear\tbranchless\n";
+    for (int count : slot_counts) {
+        make_keys(keys, count, lookups);
+        for (int page = 0; page < NUM_PAGES; page++) {
+            PageSlot* leaf_slot =
+                page_helper::get_page_slot(&leaf_pages[page]);
+            leaf_pages[page].page_header.key_num = count;
+            for (int i = 0; i < count; i++) {
+                leaf_slot[i].key = keys[page * count + i];
+            }
+        }
+
+        std::cout << count << "\t"
+                  << run_slot_lookups(leaf_pages, lookups, false) << "\t"
+                  << run_slot_lookups(leaf_pages, lookups, true)
+                  << std::endl;
+    }
+
+    return 0;
+}
+/** @}*/
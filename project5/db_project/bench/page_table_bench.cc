@@ -0,0 +1,166 @@
+/**
+ * @addtogroup Benchmark
+ * @{
+ */
+#include <page_table.h>
+#include <pthread.h>
+#include <types.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+
+/// @brief Number of stored pages.
+static constexpr int NUM_PAGES = 1024;
+/// @brief Number of tables the pages are spread over.
+static constexpr int NUM_TABLES = 4;
+/// @brief Total number of lookups for each thread count.
+static constexpr int NUM_LOOKUPS = 8000000;
+/// @brief Number of replaced pages of the update benchmark.
+static constexpr int NUM_UPDATES = 2000000;
+/// @brief Maximum number of worker threads.
+static constexpr int MAX_THREADS = 16;
+
+/// @brief Map which was used as the page index.
+static std::unordered_map<PageLocation, int> locked_map;
+/// @brief Mutex which protects the map, like the shard mutex did.
+static pthread_mutex_t map_mutex = PTHREAD_MUTEX_INITIALIZER;
+/// @brief Lock-free page table.
+static PageTable page_table;
+
+/**
+ * @brief Lookup worker argument.
+ */
+struct LookupArgs {
+    /// @brief <code>true</code> to look up the page table.
+    bool use_page_table;
+    /// @brief random seed of this worker.
+    unsigned int seed;
+    /// @brief number of lookups to do.
+    int lookup_count;
+    /// @brief sum of found frame indexes, so lookups are not optimized out.
+    long checksum;
+};
+
+/**
+ * @brief Get the location of the i-th stored page.
+ *
+ * @param i     page index.
+ * @param round number of times the page has been replaced.
+ * @return page location.
+ */
+static PageLocation page_location_of(int i, int round = 0) {
+    return std::make_pair(
+        i % NUM_TABLES,
+        static_cast<pagenum_t>(i * 7 + 1) + round * NUM_PAGES * 7);
+}
+
+/**
+ * @brief Look up random stored pages.
+ *
+ * @param arg   <code>LookupArgs*</code>.
+ * @return <code>nullptr</code>.
+ */
+void* lookup_worker(void* arg) {
+    LookupArgs* args = reinterpret_cast<LookupArgs*>(arg);
+    std::mt19937 gen(args->seed);
+    std::uniform_int_distribution<int> page_dis(0, NUM_PAGES - 1);
+
+    for (int i = 0; i < args->lookup_count; i++) {
+        PageLocation page_location = page_location_of(page_dis(gen));
+        if (args->use_page_table) {
+            args->checksum += page_table.find(page_location);
+        } else {
+            pthread_mutex_lock(&map_mutex);
+            const auto& found = locked_map.find(page_location);
+            args->checksum += found != locked_map.end() ? found->second : -1;
+            pthread_mutex_unlock(&map_mutex);
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Run lookups with the given number of threads.
+ *
+ * @param use_page_table    <code>true</code> to look up the page table.
+ * @param thread_count      number of threads.
+ * @return lookups per second.
+ */
+static long run_lookups(bool use_page_table, int thread_count) {
+    pthread_t threads[MAX_THREADS];
+    LookupArgs args[MAX_THREADS];
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < thread_count; i++) {
+        args[i] = {use_page_table, static_cast<unsigned int>(i + 1),
+                   NUM_LOOKUPS / thread_count, 0};
+        pthread_create(&threads[i], nullptr, lookup_worker, &args[i]);
+    }
+    for (int i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], nullptr);
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return static_cast<long>(NUM_LOOKUPS / elapsed.count());
+}
+
+/**
+ * @brief Replace pages like evictions do, one erase and one insert each.
+ *
+ * @param use_page_table    <code>true</code> to update the page table.
+ * @return replacements per second.
+ */
+static long run_updates(bool use_page_table) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < NUM_UPDATES; i++) {
+        int round = i / NUM_PAGES;
+        PageLocation victim = page_location_of(i % NUM_PAGES, round);
+        PageLocation loaded = page_location_of(i % NUM_PAGES, round + 1);
+
+        pthread_mutex_lock(&map_mutex);
+        if (use_page_table) {
+            page_table.erase(victim);
+            page_table.insert(loaded, i % NUM_PAGES);
+        } else {
+            locked_map.erase(victim);
+            locked_map[loaded] = i % NUM_PAGES;
+        }
+        pthread_mutex_unlock(&map_mutex);
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return static_cast<long>(NUM_UPDATES / elapsed.count());
+}
+
+/**
+ * @brief   Page index micro-benchmark.
+ * @details Compares <code>PageTable</code> with the mutex protected
+ * <code>std::unordered_map</code> it replaces, in random lookups with 1 to 16
+ * threads and in single-threaded page replacements.
+ *
+ * usage: <code>page_table_bench</code>
+ */
+int main() {
+    page_table.init(NUM_PAGES);
+    for (int i = 0; i < NUM_PAGES; i++) {
+        locked_map[page_location_of(i)] = i;
+        page_table.insert(page_location_of(i), i);
+    }
+
+    std::cout << "lookups/sec\n";
+    std::cout << "threads\tunordered_map\tPageTable\n";
+    for (int thread_count = 1; thread_count <= MAX_THREADS; thread_count *= 2) {
+        std::cout << thread_count << "\t" << run_lookups(false, thread_count)
+                  << "\t" << run_lookups(true, thread_count) << std::endl;
+    }
+
+    std::cout << "replacements/sec\n";
+    std::cout << "unordered_map\tPageTable\n";
+    long map_updates = run_updates(false);
+    std::cout << map_updates << "\t" << run_updates(true) << std::endl;
+    return 0;
+}
+/** @}*/
@@ -4,34 +4,253 @@
  */
 #pragma once
 
+#include <file.h>
 #include <page.h>
+#include <page_table.h>
+#include <policy.h>
 #include <pthread.h>
 #include <types.h>
 
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 typedef struct BufferBlock {
-    /// @brief buffered page.
-    fullpage_t page;
+    /// @brief buffered page. <code>nullptr</code> while the frame is not a
+    /// part of the buffer pool.
+    fullpage_t* page;
     /// @brief page location.
     PageLocation page_location;
 
-    /// @brief page latch.
-    pthread_cond_t latch;
-    trxid_t pin_owner;
-    /// @brief how many threads are using(or waiting) this buffer block.
+    /// @brief page latch. Readers share it, and writers hold it exclusively.
+    pthread_rwlock_t latch;
+    /// @brief how many pins of <code>buffered_read_page()</code> are not
+    /// written or released yet.
     int pin_count;
+    /// @brief how many <code>PageGuard</code>s are holding this buffer block.
+    /// <code>-1</code> while the frame is claimed to load another page.
+    std::atomic<int> guard_count;
+    /// @brief <code>true</code> while the page is read into the frame without
+    /// the shard mutex. The frame is indexed, but claimed.
+    bool is_loading;
+    /// @brief page version, which is odd while the page is exclusively latched
+    /// or loaded. Optimistic readers validate it instead of latching.
+    std::atomic<uint64_t> version;
 
     /// @brief <code>true</code> if this buffer has been modified,
     /// <code>false</code> otherwise.
     bool is_dirty;
-
-    /// @brief revious buffer block index of Recently-Used linked list.
-    /// <code>-1</code> if this buffer is the first item.
-    int prev_block_idx;
-    /// @brief next buffer block index of Recently-Used linked list.
-    /// <code>-1</code> if this buffer is the last item.
-    int next_block_idx;
+    /// @brief <code>true</code> if this buffer has been loaded by read-ahead
+    /// and not accessed yet.
+    bool is_prefetched;
 } BufferBlock;
 
+/**
+ * @class   TableShare
+ * @brief   Quota and frame usage of a table in a shard.
+ */
+typedef struct TableShare {
+    /// @brief number of frames which hold pages of the table.
+    int frame_count;
+    /// @brief shard share of the reserved frames.
+    int min_frames;
+    /// @brief shard share of the maximum frames. <code>0</code> if unlimited.
+    int max_frames;
+    /// @brief eviction priority class.
+    BufferPriority priority;
+} TableShare;
+
+/**
+ * @class   BufferShard
+ * @brief   Independently latched partition of the buffer pool.
+ * @details Every page location is mapped into exactly one shard, which owns
+ * its frames, page index and replacement policy. Frames are allocated in
+ * chunks which never move.
+ */
+typedef struct BufferShard {
+    /// @brief chunks of <code>FRAME_CHUNK_SIZE</code> buffer blocks(frames)
+    /// owned by this shard.
+    BufferBlock* chunks[MAX_FRAME_CHUNKS];
+    /// @brief pages of each frame chunk, which are mapped together.
+    fullpage_t* page_chunks[MAX_FRAME_CHUNKS];
+    /// @brief number of allocated frames. Frames beyond <code>size</code> are
+    /// retired, or being retired while the shard shrinks.
+    int frame_count;
+    /// @brief number of frames in this shard.
+    int size;
+
+    /// @brief replacement policy which tracks every non-empty frame.
+    ReplacementPolicy* policy;
+    /// @brief indexes of frames which have never been loaded.
+    std::deque<int> free_frames;
+    /// @brief evicted pages which are being written back, or stored into the
+    /// victim cache. They are not loaded until it is done.
+    std::vector<PageLocation> evicting_pages;
+    /// @brief pages accessed without a frame, with the number of their shared
+    /// holders, or <code>-1</code> if held exclusively. They are not loaded
+    /// until every holder is done.
+    std::unordered_map<PageLocation, int> fallback_pages;
+
+    /// @brief page location to frame index map. Lookups do not need the
+    /// shard mutex, but updates do.
+    PageTable index;
+
+    /// @brief number of dirty frames.
+    int dirty_count;
+    /// @brief number of pages written by the buffer cleaner.
+    uint64_t cleaner_writes;
+    /// @brief number of dirty victims written on eviction.
+    uint64_t eviction_writes;
+    /// @brief number of pages written by flushes.
+    uint64_t flush_writes;
+
+    /// @brief number of pages loaded by read-ahead.
+    uint64_t prefetched_pages;
+    /// @brief number of prefetched pages accessed before eviction.
+    uint64_t prefetch_used;
+    /// @brief number of prefetched pages evicted without access.
+    uint64_t prefetch_wasted;
+
+    /// @brief quota and frame usage of each table which has a quota or
+    /// frames in this shard.
+    std::unordered_map<tableid_t, TableShare> table_shares;
+    /// @brief <code>true</code> if any table has a quota, so that eviction
+    /// has to honor them.
+    bool has_quotas;
+
+    /// @brief shard mutex which protects every field above, except lookups of
+    /// <code>index</code>.
+    pthread_mutex_t mutex;
+    /// @brief signaled when a frame is loaded, an evicted page is written
+    /// back, or a frame is released while a thread waits for one.
+    pthread_cond_t frame_cond;
+    /// @brief number of threads waiting for a frame to be released. Read
+    /// without the shard mutex by unpins.
+    std::atomic<int> frame_waiters;
+} BufferShard;
+
+/**
+ * @class   FrameLoad
+ * @brief   Frame claimed to load a page.
+ */
+typedef struct FrameLoad {
+    /// @brief page to load.
+    PageLocation page_location;
+    /// @brief claimed frame index.
+    int frame_idx;
+    /// @brief page evicted from the frame.
+    PageLocation evicted_location;
+    /// @brief <code>true</code> if the evicted page is dirty.
+    bool is_dirty;
+    /// @brief <code>true</code> if the evicted page is in
+    /// <code>evicting_pages</code> until it is written back.
+    bool writes_back;
+} FrameLoad;
+
+/**
+ * @class   DirtyPageStats
+ * @brief   Dirty page statistics of the whole buffer pool.
+ */
+typedef struct DirtyPageStats {
+    /// @brief number of dirty frames.
+    int dirty_pages;
+    /// @brief number of pages written by the buffer cleaner.
+    uint64_t cleaner_writes;
+    /// @brief number of dirty victims written on eviction.
+    uint64_t eviction_writes;
+    /// @brief number of pages written by flushes.
+    uint64_t flush_writes;
+} DirtyPageStats;
+
+/**
+ * @class   ReadAheadStats
+ * @brief   Read-ahead statistics of the whole buffer pool.
+ */
+typedef struct ReadAheadStats {
+    /// @brief number of pages loaded by read-ahead.
+    uint64_t prefetched_pages;
+    /// @brief number of prefetched pages accessed before eviction.
+    uint64_t used_pages;
+    /// @brief number of prefetched pages evicted without access.
+    uint64_t wasted_pages;
+} ReadAheadStats;
+
+/**
+ * @class   WarmUpManifestHeader
+ * @brief   Header of a warm-up manifest file.
+ * @details Followed by <code>page_count</code> page numbers, hottest first.
+ * A manifest of a modified or replaced table file is ignored.
+ */
+typedef struct WarmUpManifestHeader {
+    /// @brief magic number of the manifest format.
+    uint64_t magic;
+    /// @brief inode number of the table file.
+    uint64_t inode;
+    /// @brief size(in bytes) of the table file.
+    uint64_t file_size;
+    /// @brief last modification time(in nanoseconds) of the table file.
+    uint64_t modified_ns;
+    /// @brief number of page numbers which follow.
+    uint64_t page_count;
+} WarmUpManifestHeader;
+
+/**
+ * @class   WarmUpRequest
+ * @brief   Pending warm-up of a table.
+ */
+typedef struct WarmUpRequest {
+    /// @brief table id.
+    tableid_t table_id;
+    /// @brief pages to load, hottest first.
+    std::vector<pagenum_t> pagenums;
+} WarmUpRequest;
+
+/**
+ * @class   WarmUpStats
+ * @brief   Warm-up statistics since the buffer is initialized.
+ */
+typedef struct WarmUpStats {
+    /// @brief number of pages loaded by the warm-up.
+    uint64_t warmed_pages;
+    /// @brief number of manifest pages which were already buffered, or did
+    /// not fit in the free frames.
+    uint64_t skipped_pages;
+    /// @brief number of tables which are not warmed up yet.
+    int pending_tables;
+} WarmUpStats;
+
+/**
+ * @class   ReadAheadRequest
+ * @brief   Pending read-ahead of a leaf sibling chain.
+ */
+typedef struct ReadAheadRequest {
+    /// @brief table id.
+    tableid_t table_id;
+    /// @brief first leaf page to read.
+    pagenum_t pagenum;
+    /// @brief number of leaf pages to read.
+    int count;
+} ReadAheadRequest;
+
+/**
+ * @class   SequentialState
+ * @brief   Sequential leaf walk detector of a table.
+ */
+typedef struct SequentialState {
+    /// @brief right sibling of the last accessed leaf.
+    pagenum_t expected_leaf;
+    /// @brief number of consecutive sibling leaf accesses.
+    int streak;
+} SequentialState;
+
+/**
+ * @brief Page access mode of <code>PageGuard</code>.
+ */
+enum LatchMode { SHARED_LATCH = 0, EXCLUSIVE_LATCH = 1 };
+
 /**
  * @brief   BufferManager helper
  * @details This namespace includes some helper functions which are used by
@@ -39,6 +258,24 @@ typedef struct BufferBlock {
  * frequently used part of it so I wrapped these functions.
  */
 namespace buffer_helper {
+/**
+ * @brief   Get a frame of the shard.
+ *
+ * @param shard     buffer shard.
+ * @param frame_idx frame index.
+ * @return frame.
+ */
+inline BufferBlock* get_frame(BufferShard& shard, int frame_idx) {
+    return shard.chunks[frame_idx / FRAME_CHUNK_SIZE] +
+           frame_idx % FRAME_CHUNK_SIZE;
+}
+/**
+ * @brief   Get the shard which is responsible for the given page.
+ *
+ * @param page_location page location.
+ * @return  buffer shard.
+ */
+BufferShard& get_shard(const PageLocation& page_location);
 /**
  * @brief   Load a page into buffer.
  * @details Return a buffer block if exists. If not, automatically evict a
@@ -56,8 +293,9 @@ BufferBlock* load_buffer(tableid_t table_id, pagenum_t pagenum, page_t* page,
                          trxid_t trx_id = 0, bool pin = true);
 /**
  * @brief   Apply a page into buffer.
- * @details Apply page content into buffer block if exists. If not, return
- * <code>false</code> to notify fallback direct I/O method should be used.
+ * @details Apply page content into buffer block under the exclusive latch if
+ * exists. If not, the page is written to the file as an exclusive fallback,
+ * and <code>false</code> is returned.
  *
  * @param table_id      table id.
  * @param pagenum       page number.
@@ -75,45 +313,799 @@ bool apply_buffer(tableid_t table_id, pagenum_t pagenum, const page_t* page);
  */
 void release_buffer(tableid_t table_id, pagenum_t pagenum);
 /**
- * @brief Check if there buffer slot is full.
+ * @brief Evict a buffer with the lowest priority in the shard.
+ * @details Empty frames are used first, then clean pages among the coldest
+ * <code>CLEAN_VICTIM_WINDOW</code> frames, within the table quotas. Caller
+ * should hold the shard mutex.
  *
- * @return true if there are no room
+ * @param shard         buffer shard.
+ * @param table_id      table id of the page to load.
+ * @return evicted buffer slot index if success, <code><0</code> otherwise.
  */
-bool is_full();
+int evict(BufferShard& shard, tableid_t table_id);
 /**
- * @brief Evict a buffer with the lowest priority.
- * @details <code>load_buffer()</code> will determine using of fallback method
- * with return value of <code>evict()</code>.
+ * @brief Search a victim which honors the table quotas of the shard.
+ * @details Caller should hold the shard mutex.
  *
- * @return evicted buffer slot index if success, <code><0</code> otherwise.
+ * @param shard         buffer shard.
+ * @param table_id      table id of the page to load.
+ * @param at_max        <code>true</code> if the table is at its maximum.
+ * @return claimed frame index if found, <code>-1</code> otherwise.
+ */
+int find_quota_victim(BufferShard& shard, tableid_t table_id, bool at_max);
+/**
+ * @brief Get the quota and frame usage of a table in the shard.
+ * @details A table without quota and frames gets an unlimited share. Caller
+ * should hold the shard mutex.
+ *
+ * @param shard     buffer shard.
+ * @param table_id  table id.
+ * @return table share.
+ */
+TableShare& get_table_share(BufferShard& shard, tableid_t table_id);
+/**
+ * @brief Check the fields of a quota, regardless of the reservations.
+ *
+ * @param quota buffer quota.
+ * @return <code>true</code> if valid.
+ */
+bool is_valid_quota(const BufferQuota& quota);
+/**
+ * @brief Get the shard share of a frame count.
+ *
+ * @param frames    frame count of the whole buffer pool.
+ * @param shard_idx shard index.
+ * @return frames of the shard.
+ */
+int get_shard_share(int frames, int shard_idx);
+/**
+ * @brief Load a page into an evicted frame of the shard.
+ * @details Caller should hold the shard mutex, which is released during the
+ * I/O. Meanwhile, lookups of either page wait for the frame.
+ *
+ * @param shard         buffer shard.
+ * @param page_location page location.
+ * @param hint          kind of the access which loads the page.
+ * @return loaded frame index if success, <code><0</code> if there are no
+ * evictable frames.
+ */
+int load_frame(BufferShard& shard, const PageLocation& page_location,
+               AccessHint hint = NORMAL_ACCESS);
+/**
+ * @brief   Claim an evicted frame of the shard to load a page.
+ * @details The first step of <code>load_frame()</code>. The frame is indexed
+ * and loading, but its page is not read yet. Caller should hold the shard
+ * mutex, which is kept.
+ *
+ * @param       shard           buffer shard.
+ * @param       page_location   page location.
+ * @param       hint            kind of the access which loads the page.
+ * @param[out]  load            claimed frame.
+ * @return claimed frame index if success, <code><0</code> if there are no
+ * evictable frames.
+ */
+int begin_load(BufferShard& shard, const PageLocation& page_location,
+               AccessHint hint, FrameLoad* load);
+/**
+ * @brief   Write back the page evicted from a claimed frame.
+ * @details Caller should not hold the shard mutex. Lookups of the evicted
+ * page are woken once it is written.
+ *
+ * @param shard buffer shard.
+ * @param load  claimed frame.
+ */
+void write_back_evicted(BufferShard& shard, const FrameLoad& load);
+/**
+ * @brief   Finish loading a claimed frame, whose page is read.
+ * @details Caller should hold the shard mutex. Lookups of the page are woken.
+ *
+ * @param shard     buffer shard.
+ * @param frame_idx claimed frame index.
+ */
+void end_load(BufferShard& shard, int frame_idx);
+/**
+ * @brief Check if an evicted page is being written back.
+ * @details Caller should hold the shard mutex.
+ *
+ * @param shard         buffer shard.
+ * @param page_location page location.
+ * @return <code>true</code> if the page should not be loaded yet.
+ */
+bool is_evicting(const BufferShard& shard, const PageLocation& page_location);
+/**
+ * @brief Find a buffered page, waiting for the I/O in progress of it.
+ * @details Waits while the page is loading, while it is being written back
+ * on eviction, or while it is accessed without a frame. Caller should hold the
+ * shard mutex.
+ *
+ * @param shard         buffer shard.
+ * @param page_location page location.
+ * @return frame index of the loaded page, or <code>-1</code> if the page is
+ * not buffered and can be loaded.
+ */
+int find_loaded_frame(BufferShard& shard, const PageLocation& page_location);
+/**
+ * @brief Wake up the threads waiting for a frame, after a frame is released.
+ * @details Caller should hold the shard mutex.
+ *
+ * @param shard buffer shard.
+ */
+void wake_frame_waiters(BufferShard& shard);
+/**
+ * @brief   Register the thread as a waiter for a frame of the shard.
+ * @details Called before sleeping on <code>frame_cond</code>. Caller should
+ * hold the shard mutex.
+ *
+ * @param shard buffer shard.
+ * @return <code>true</code> if the thread is blocked, and may fall back once
+ * <code>is_stalled()</code>.
+ */
+bool begin_frame_wait(BufferShard& shard);
+/**
+ * @brief   Unregister a waiter of <code>begin_frame_wait()</code>.
+ * @details Caller should hold the shard mutex.
+ *
+ * @param shard         buffer shard.
+ * @param is_blocked    return value of <code>begin_frame_wait()</code>.
+ */
+void end_frame_wait(BufferShard& shard, bool is_blocked);
+/**
+ * @brief   Count a frame, or a page accessed without a frame, the calling
+ * thread holds.
+ */
+void hold_frame();
+/**
+ * @brief   Uncount a frame of <code>hold_frame()</code>.
+ * @details Caller should not hold a shard mutex. Blocked holders are woken
+ * once the thread holds nothing, since the rest of the holders may be stalled.
+ */
+void drop_frame();
+/**
+ * @brief   Count the calling thread as blocked if it holds frames.
+ * @details Blocked holders waiting for a frame are woken, since every holder
+ * may be blocked now.
+ *
+ * @param locked_shard  shard of which mutex the caller holds, which may be
+ * released meanwhile, or <code>nullptr</code>.
+ * @return <code>true</code> if counted, and the caller should call
+ * <code>end_holder_wait()</code> once it stops waiting.
+ */
+bool begin_holder_wait(BufferShard* locked_shard);
+/**
+ * @brief   Uncount a blocked holder of <code>begin_holder_wait()</code>.
+ */
+void end_holder_wait();
+/**
+ * @brief   Check if every thread which holds frames is blocked.
+ * @details Then no frame is released until one of them accesses a page
+ * without a frame.
+ *
+ * @return <code>true</code> if stalled.
+ */
+bool is_stalled();
+/**
+ * @brief   Wake up the blocked holders waiting for a frame.
+ *
+ * @param locked_shard  shard of which mutex the caller holds, which is
+ * released meanwhile, or <code>nullptr</code>.
+ */
+void wake_blocked_holders(BufferShard* locked_shard);
+/**
+ * @brief   Claim an unguarded frame to load another page into it.
+ * @details Caller should hold the shard mutex. A claimed frame can not be
+ * pinned without the shard mutex until it is loaded.
+ *
+ * @param frame frame.
+ * @return <code>true</code> if claimed.
+ */
+bool claim_frame(BufferBlock* frame);
+/**
+ * @brief   Pin a frame found without the shard mutex.
+ * @details Fails if the frame is claimed, or if it does not hold the page
+ * anymore.
+ *
+ * @param frame         frame.
+ * @param page_location expected page location of the frame.
+ * @return <code>true</code> if pinned.
+ */
+bool try_pin_frame(BufferBlock* frame, const PageLocation& page_location);
+/**
+ * @brief   Pin a page in buffer.
+ * @details Load the page if it is not buffered. If every frame is in use and
+ * every holder is blocked, the page is accessed directly instead until
+ * <code>end_fallback()</code>.
+ *
+ * @param table_id  table id.
+ * @param pagenum   page number.
+ * @param hint      kind of the access.
+ * @param mode      access mode of the fallback.
+ * @return pinned frame, <code>nullptr</code> if the page is accessed without a
+ * frame.
+ */
+BufferBlock* pin_frame(tableid_t table_id, pagenum_t pagenum,
+                       AccessHint hint = NORMAL_ACCESS,
+                       LatchMode mode = SHARED_LATCH);
+/**
+ * @brief   Finish an access without a frame, begun by <code>pin_frame()</code>.
+ * @details The page should be written before, if it is modified. Lookups of
+ * the page are woken once every holder is done.
+ *
+ * @param table_id  table id.
+ * @param pagenum   page number.
+ */
+void end_fallback(tableid_t table_id, pagenum_t pagenum);
+/**
+ * @brief   Acquire the latch of a pinned frame.
+ * @details Called without the shard mutex, since it may block until the
+ * other holders release the latch, as a blocked holder meanwhile. An
+ * exclusive latch makes the frame version odd.
+ *
+ * @param frame pinned frame.
+ * @param mode  latch mode.
+ */
+void latch_frame(BufferBlock* frame, LatchMode mode);
+/**
+ * @brief   Release the latch of a frame.
+ * @details Releasing an exclusive latch makes the frame version even again,
+ * so that optimistic readers of the page before it fail to validate.
+ *
+ * @param frame latched frame.
+ */
+void unlatch_frame(BufferBlock* frame);
+/**
+ * @brief   Start an optimistic read of a buffered page.
+ * @details Neither the page is pinned nor latched, so the page may change or
+ * be replaced at any time. Every value read from it should be validated with
+ * <code>validate_optimistic_read()</code> before it is used.
+ *
+ * @param      table_id table id.
+ * @param      pagenum  page number.
+ * @param[out] frame    frame of the page.
+ * @param[out] version  frame version to validate.
+ * @return page, <code>nullptr</code> if it is not buffered, or is modified or
+ * loaded now.
+ */
+const fullpage_t* begin_optimistic_read(tableid_t table_id, pagenum_t pagenum,
+                                        BufferBlock** frame,
+                                        uint64_t* version);
+/**
+ * @brief   Validate an optimistic read.
+ *
+ * @param frame     frame of <code>begin_optimistic_read()</code>.
+ * @param version   frame version of <code>begin_optimistic_read()</code>.
+ * @return <code>true</code> if the page has not been modified or replaced
+ * since the read began.
+ */
+bool validate_optimistic_read(const BufferBlock* frame, uint64_t version);
+/**
+ * @brief   Unpin a frame pinned by <code>pin_frame()</code>.
+ *
+ * @param frame     pinned frame.
+ * @param is_dirty  <code>true</code> if the page has been modified.
+ */
+void unpin_frame(BufferBlock* frame, bool is_dirty);
+/**
+ * @brief   Record an access to a buffered frame.
+ * @details Notify the replacement policy, and count the first access to a
+ * prefetched page. Caller should hold the shard mutex.
+ *
+ * @param shard     buffer shard.
+ * @param frame_idx frame index.
+ * @param hint      kind of the access.
+ */
+void touch_frame(BufferShard& shard, int frame_idx, AccessHint hint);
+/**
+ * @brief   Get the warm-up manifest path of a table.
+ *
+ * @param table_id  table id.
+ * @return manifest path.
+ */
+std::string get_warm_up_manifest_path(tableid_t table_id);
+/**
+ * @brief   Identify the current table file in a manifest header.
+ *
+ * @param       table_id    table id.
+ * @param[out]  header      manifest header to fill, except the page count.
+ * @return <code>true</code> if success.
+ */
+bool stat_warm_up_table(tableid_t table_id, WarmUpManifestHeader* header);
+/**
+ * @brief   Write the warm-up manifest of every table with buffered pages.
+ * @details Pages are ordered by recency. Each shard is visited from its
+ * hottest frame, and the shards are interleaved rank by rank. Called by
+ * <code>shutdown_buffer()</code> after the dirty pages are written.
+ */
+void write_warm_up_manifests();
+/**
+ * @brief   Read and remove the warm-up manifest of a table.
+ *
+ * @param       table_id    table id.
+ * @param[out]  pagenums    manifest pages, hottest first.
+ * @return <code>true</code> if the manifest matches the table file.
+ */
+bool read_warm_up_manifest(tableid_t table_id,
+                           std::vector<pagenum_t>* pagenums);
+/**
+ * @brief   Queue the warm-up of a newly opened table.
+ * @details The hottest pages which fit in the buffer are loaded by the warmer
+ * thread, which is started if it is not running.
+ *
+ * @param table_id  table id.
+ */
+void queue_warm_up(tableid_t table_id);
+/**
+ * @brief   Claim a free frame to load a manifest page.
+ * @details The page is skipped if it is buffered, if the shard has no free
+ * frame, or if the table is at its maximum frames.
+ *
+ * @param       table_id    table id.
+ * @param       pagenum     page number.
+ * @param       wait        <code>false</code> to give up if the shard mutex
+ *                          is busy.
+ * @param[out]  load        claimed frame.
+ * @return <code>1</code> if claimed, <code>0</code> if skipped,
+ * <code>-1</code> if the shard is busy.
+ */
+int warm_up_frame(tableid_t table_id, pagenum_t pagenum, bool wait,
+                  FrameLoad* load);
+/**
+ * @brief   Load the frames claimed for the pages of a table.
+ * @details Pages in the victim cache are copied from it, and the others are
+ * read by a single <code>file_read_pages()</code>.
+ *
+ * @param table_id  table id.
+ * @param loads     claimed frames.
+ */
+void load_warm_up_frames(tableid_t table_id,
+                         const std::vector<FrameLoad>& loads);
+/**
+ * @brief   Warm up a table.
+ * @details Pages are loaded in page order. The frames of each run of
+ * consecutive pages are claimed first, and the run is read at once. Pages of
+ * a busy shard are retried after the others.
+ *
+ * @param request   warm-up request.
+ */
+void warm_up_table(const WarmUpRequest& request);
+/**
+ * @brief   Main function of the warmer thread.
+ * @details Serves the warm-up requests and exits when there are none.
+ *
+ * @param arg   not used.
+ * @return <code>nullptr</code>.
+ */
+void* warmer_main(void* arg);
+/**
+ * @brief   Pin a page for read-ahead.
+ * @details Same as <code>pin_frame()</code>, but the access is not recorded.
+ * If the page is newly loaded, it is marked as prefetched.
+ *
+ * @param       table_id    table id.
+ * @param       pagenum     page number.
+ * @param[out]  is_loaded   <code>true</code> if the page is newly loaded.
+ * @return pinned frame, <code>nullptr</code> if every frame of the shard is in
+ * use.
  */
-int evict();
+BufferBlock* prefetch_frame(tableid_t table_id, pagenum_t pagenum,
+                            bool* is_loaded);
 /**
- * @brief Move a buffer to head of Recently-Used list.
+ * @brief   Read a leaf sibling chain into the buffer.
+ * @details Follows the right sibling links from <code>pagenum</code> and
+ * loads at most <code>count</code> leaf pages. The rest of the chain is hinted
+ * with <code>file_advise_pages()</code>.
  *
- * @param buffer_idx    index of buffer which will be detached.
+ * @param table_id  table id.
+ * @param pagenum   first leaf page number.
+ * @param count     maximum number of leaf pages.
+ * @return number of newly loaded pages.
  */
-void move_to_head(int buffer_idx);
+int read_ahead(tableid_t table_id, pagenum_t pagenum, int count);
+/**
+ * @brief   Record a leaf access of a sibling chain walk.
+ * @details If the leaf is the right sibling of the previously accessed leaf
+ * for <code>READ_AHEAD_TRIGGER</code> times in a row, read-ahead of the
+ * following leaves is requested to the prefetcher thread.
+ *
+ * @param table_id      table id.
+ * @param leaf_idx      accessed leaf page number.
+ * @param next_leaf_idx right sibling of the accessed leaf.
+ */
+void record_leaf_access(tableid_t table_id, pagenum_t leaf_idx,
+                        pagenum_t next_leaf_idx);
+/**
+ * @brief   Main loop of the prefetcher thread.
+ *
+ * @param arg   unused.
+ * @return <code>nullptr</code>.
+ */
+void* prefetcher_main(void* arg);
+/**
+ * @brief   Set the dirty bit of a frame and keep the dirty count of the shard.
+ * @details Caller should hold the shard mutex.
+ *
+ * @param shard     buffer shard.
+ * @param frame     frame of the shard.
+ * @param is_dirty  new dirty bit.
+ */
+void set_dirty(BufferShard& shard, BufferBlock* frame, bool is_dirty);
+/**
+ * @brief   Write a batch of frames.
+ * @details The pages of each table are written with a single
+ * <code>file_write_pages()</code>, which coalesces runs of consecutive pages.
+ *
+ * @param batch     (page location, frame) pairs sorted by page location.
+ */
+void write_frames(
+    const std::vector<std::pair<PageLocation, BufferBlock*>>& batch);
+/**
+ * @brief   Write the pinned dirty frames of a table.
+ * @details Frames are written in page order under the shared latch. Frames
+ * whose latch is busy are written one by one at the end, so that no latch is
+ * held while waiting for a writer. Every frame is unpinned afterwards.
+ *
+ * @param batch     (page location, frame) pairs of a table sorted by page
+ * location. Frames should be pinned, and their dirty bits cleared.
+ * @return number of written pages.
+ */
+int flush_frames(
+    const std::vector<std::pair<PageLocation, BufferBlock*>>& batch);
+/**
+ * @brief   Main function of a flusher thread.
+ *
+ * @param arg   batch of <code>flush_frames()</code>.
+ * @return <code>nullptr</code>.
+ */
+void* flusher_main(void* arg);
+/**
+ * @brief   Write the dirty pages among the coldest frames of every shard.
+ * @details Dirty pages which are not guarded are written in page order
+ * without the shard mutex. Frames whose latch is busy are skipped.
+ *
+ * @param clean_share   share of the coldest frames to clean.
+ * @return number of written pages.
+ */
+int clean_cold_frames(double clean_share);
+/**
+ * @brief   Map the pages of a frame chunk.
+ * @details Pages are aligned to <code>PAGE_SIZE</code> for
+ * <code>O_DIRECT</code>, and backed by a huge page if enabled.
+ *
+ * @return <code>FRAME_CHUNK_SIZE</code> pages. Throws
+ * <code>std::bad_alloc</code> on failure.
+ */
+fullpage_t* map_page_chunk();
+/**
+ * @brief   Add frames to the shard.
+ * @details Frames are added a chunk at a time, so that the shard mutex is
+ * released between chunks.
+ *
+ * @param shard     buffer shard.
+ * @param new_size  new number of frames.
+ */
+void grow_shard(BufferShard& shard, int new_size);
+/**
+ * @brief   Retire the frames of the shard beyond the new size.
+ * @details Dirty excess frames are written back, and each clean one is
+ * evicted as soon as it is not in use. Lookups keep running meanwhile.
+ *
+ * @param shard     buffer shard.
+ * @param new_size  new number of frames.
+ */
+void shrink_shard(BufferShard& shard, int new_size);
+/**
+ * @brief   Pin the dirty frames of a table in the shard to flush them.
+ * @details The frames are marked clean, and should be written by
+ * <code>flush_frames()</code>. Caller should hold the shard mutex.
+ *
+ * @param       shard       buffer shard.
+ * @param       table_id    table id.
+ * @param[out]  batch       pinned frames with their page locations.
+ * @return number of the pinned frames.
+ */
+int collect_dirty_frames(
+    BufferShard& shard, tableid_t table_id,
+    std::vector<std::pair<PageLocation, BufferBlock*>>* batch);
+/**
+ * @brief   Write back the dirty frames of a table.
+ * @details The frames of the other tables are not written. Frames claimed for
+ * eviction are written by the eviction itself.
+ *
+ * @param table_id  table id.
+ * @return number of the written frames.
+ */
+int flush_table_frames(tableid_t table_id);
+/**
+ * @brief   Drop the frames of a table from the shard.
+ * @details Dirty frames are written back, and each clean frame is freed as
+ * soon as it is not in use, without a copy in the victim cache.
+ *
+ * @param shard     buffer shard.
+ * @param table_id  table id.
+ */
+void drop_table_frames(BufferShard& shard, tableid_t table_id);
+/**
+ * @brief   Discard the frames of free pages of a table from the shard.
+ * @details Each frame is freed as soon as it is not in use, and dirty ones
+ * are not written back, so that no write of the pages is in flight once it
+ * returns.
+ *
+ * @param shard         buffer shard.
+ * @param table_id      table id.
+ * @param is_discarded  <code>true</code> for the pages to discard.
+ */
+void discard_page_frames(BufferShard& shard, tableid_t table_id,
+                         const std::function<bool(pagenum_t)>& is_discarded);
+/**
+ * @brief   Drop the read-ahead and warm-up requests of a table.
+ * @details The request being served for the table is waited for.
+ *
+ * @param table_id  table id.
+ */
+void cancel_background_requests(tableid_t table_id);
+/**
+ * @brief   Main loop of the buffer cleaner thread.
+ *
+ * @param arg   unused.
+ * @return <code>nullptr</code>.
+ */
+void* cleaner_main(void* arg);
+/**
+ * @brief   Write the free space fields of a header page through the buffer.
+ * @details Used to persist the free space of a table, so that the buffered
+ * header page is not overwritten by a stale copy.
+ *
+ * @param table_id              table id.
+ * @param free_page_idx         first free page index.
+ * @param unformatted_page_idx  first unformatted page index.
+ * @param page_num              total count of the reserved pages.
+ * @param holes                 punched runs of free pages.
+ */
+void write_space_header(tableid_t table_id, pagenum_t free_page_idx,
+                        pagenum_t unformatted_page_idx, pagenum_t page_num,
+                        const std::vector<PageRun>& holes);
 }  // namespace buffer_helper
 
+/**
+ * @class   PageGuardBase
+ * @brief   Untyped part of <code>PageGuard</code>.
+ * @details Pins the frame of a page and holds its latch for the lifetime of
+ * the guard, and gives direct access to the buffered page. If no frame can be
+ * pinned, the guard works on a private copy, which is written back on release.
+ */
+class PageGuardBase {
+   protected:
+    /// @brief table id.
+    tableid_t table_id;
+    /// @brief page number.
+    pagenum_t pagenum;
+    /// @brief access mode.
+    LatchMode mode;
+    /// @brief pinned frame, <code>nullptr</code> if a private copy is used.
+    BufferBlock* frame;
+    /// @brief guarded page. <code>nullptr</code> if released.
+    fullpage_t* page;
+    /// @brief <code>true</code> if the page has been modified.
+    bool is_dirty;
+
+   public:
+    PageGuardBase();
+    /**
+     * @brief Pin a page.
+     *
+     * @param table_id  table id.
+     * @param pagenum   page number.
+     * @param mode      access mode.
+     * @param hint      kind of the access, <code>SCAN_ACCESS</code> not to
+     * promote the page.
+     */
+    PageGuardBase(tableid_t table_id, pagenum_t pagenum,
+                  LatchMode mode = SHARED_LATCH,
+                  AccessHint hint = NORMAL_ACCESS);
+    PageGuardBase(PageGuardBase&& other) noexcept;
+    PageGuardBase& operator=(PageGuardBase&& other) noexcept;
+    PageGuardBase(const PageGuardBase&) = delete;
+    PageGuardBase& operator=(const PageGuardBase&) = delete;
+    ~PageGuardBase();
+
+    /**
+     * @brief Mark the page as modified.
+     * @details Only exclusive guards can modify the page. The frame is marked
+     * dirty when the guard is released.
+     */
+    void mark_dirty();
+    /**
+     * @brief Unlatch and unpin the page. The guard can not be used after it.
+     */
+    void release();
+    /**
+     * @brief Check whether the guard is holding a page.
+     *
+     * @return <code>true</code> if the page is not released.
+     */
+    bool is_valid() const { return page != nullptr; }
+};
+
+/**
+ * @class   PageGuard
+ * @brief   RAII handle for a pinned page.
+ * @details <code>PageType</code> is the page struct the buffered page is
+ * interpreted as. Modifications through an exclusive guard are applied to the
+ * buffer in place, and should be followed by <code>mark_dirty()</code>.
+ */
+template <typename PageType>
+class PageGuard : public PageGuardBase {
+   public:
+    PageGuard() = default;
+    /**
+     * @brief Pin a page.
+     *
+     * @param table_id  table id.
+     * @param pagenum   page number.
+     * @param mode      access mode.
+     * @param hint      kind of the access, <code>SCAN_ACCESS</code> not to
+     * promote the page.
+     */
+    PageGuard(tableid_t table_id, pagenum_t pagenum,
+              LatchMode mode = SHARED_LATCH, AccessHint hint = NORMAL_ACCESS)
+        : PageGuardBase(table_id, pagenum, mode, hint) {}
+
+    /// @brief Get the guarded page.
+    PageType* get() const { return reinterpret_cast<PageType*>(page); }
+    PageType* operator->() const { return get(); }
+    PageType& operator*() const { return *get(); }
+};
+
 /**
  * @brief   Initialize buffer manager.
+ * @details Frames are distributed as evenly as possible into
+ * <code>shard_count</code> shards. If there are more shards than frames, the
+ * shard count is clamped to the buffer size.
  *
  * @param   buffer_size     Buffer size.
+ * @param   shard_count     Number of independently latched buffer shards.
+ * @param   policy          Page replacement policy of every shard.
+ * @param   huge_pages      <code>true</code> to back frames with huge pages.
+ * @return  <code>0</code> if success, non-zero value otherwise.
+ */
+int init_buffer(int buffer_size, int shard_count = DEFAULT_BUFFER_SHARDS,
+                ReplacementPolicyType policy = DEFAULT_REPLACEMENT_POLICY,
+                bool huge_pages = false);
+
+/**
+ * @brief   Resize the buffer pool while it is in use.
+ * @details The shard count is kept. Shrinking writes back and evicts the
+ * excess frames, and is rejected if a shard would have no unreserved frame.
+ *
+ * @param   buffer_size     new buffer size. At least the number of shards.
+ * @return  <code>0</code> if success, non-zero value otherwise.
+ */
+int resize_buffer(int buffer_size);
+
+/**
+ * @brief   Write every dirty page in the buffer.
+ * @details Tables are flushed in parallel, each in page order with adjacent
+ * pages coalesced into vectored writes.
+ *
  * @return  <code>0</code> if success, non-zero value otherwise.
  */
-int init_buffer(int buffer_size);
+int flush_buffer();
+
+/**
+ * @brief   Configure the background buffer cleaner.
+ * @details The cleaner keeps the coldest <code>clean_share</code> of every
+ * shard clean. <code>init_buffer()</code> starts it with the defaults.
+ *
+ * @param clean_share   share of the coldest frames to clean. <code>0</code>
+ * stops the cleaner.
+ * @param interval_ms   interval between cleaner passes.
+ * @return <code>0</code> if success, non-zero value otherwise.
+ */
+int set_buffer_cleaner(double clean_share,
+                       int interval_ms = DEFAULT_CLEANER_INTERVAL_MS);
+
+/**
+ * @brief   Get the dirty page statistics.
+ *
+ * @return  dirty page statistics of the whole buffer pool.
+ */
+DirtyPageStats get_dirty_page_stats();
+
+/**
+ * @brief   Configure the leaf read-ahead.
+ * @details It is enabled by <code>init_buffer()</code> with
+ * <code>DEFAULT_READ_AHEAD_WINDOW</code>.
+ *
+ * @param window    number of leaf pages to read ahead of a sequential walk.
+ * <code>0</code> disables read-ahead.
+ * @return <code>0</code> if success, non-zero value otherwise.
+ */
+int set_read_ahead(int window);
+
+/**
+ * @brief   Get the read-ahead statistics.
+ *
+ * @return  read-ahead statistics of the whole buffer pool.
+ */
+ReadAheadStats get_read_ahead_stats();
+
+/**
+ * @brief   Configure the buffer warm-up.
+ * @details If enabled, the buffered pages of each table are recorded on
+ * shutdown and loaded back in the background when it is opened again.
+ *
+ * @param enabled   <code>true</code> to enable the warm-up.
+ * @return <code>0</code> if success, non-zero value otherwise.
+ */
+int set_buffer_warm_up(bool enabled);
+
+/**
+ * @brief   Get the warm-up statistics.
+ *
+ * @return  warm-up statistics of the whole buffer pool.
+ */
+WarmUpStats get_warm_up_stats();
+
+/**
+ * @brief   Set the buffer quota of a table.
+ * @details Reservations are rejected unless every shard keeps at least one
+ * unreserved frame. Pages of a table over its new maximum are replaced by
+ * its next loads.
+ *
+ * @param table_id  table id.
+ * @param quota     buffer quota.
+ * @return <code>0</code> if success, non-zero value otherwise.
+ */
+int set_table_buffer_quota(tableid_t table_id, const BufferQuota& quota);
 
 /**
  * @brief   Open existing table file or create one if not existed.
+ * @details If the table has a warm-up manifest which matches the file, its
+ * pages are loaded in the background. A quota other than
+ * <code>DEFAULT_BUFFER_QUOTA</code> is set on the table.
+ *
+ * @param   path        Table file path.
+ * @param   backend     I/O backend.
+ * @param   direct_io   <code>true</code> to bypass the kernel page cache.
+ * @param   quota       buffer quota of the table.
+ * @return          ID of the opened table file, or <code>-1</code> if the
+ * quota can not be set. A table opened by the call is closed then, and a
+ * table which was already open keeps its quota.
+ */
+tableid_t buffered_open_table_file(
+    const char* path, IOBackend backend = PREAD_BACKEND,
+    bool direct_io = false, const BufferQuota& quota = DEFAULT_BUFFER_QUOTA);
+
+/**
+ * @brief   Close a table file.
+ * @details Waits for the running operations on the table, then writes its
+ * dirty pages and drops its frames. A table opened again gets a new id.
+ *
+ * @param   table_id        table id obtained with
+ *                          <code>buffered_open_table_file()</code>.
+ * @return  <code>0</code> if success, <code>-1</code> if the table is not
+ * open.
+ */
+int buffered_close_table_file(tableid_t table_id);
+
+/**
+ * @brief   Give the free pages of a table back to the file system.
+ * @details The free pages at the end are cut, and the aligned extents of
+ * free pages in the middle are punched. Caller should hold the table
+ * exclusively.
  *
- * @param   path    Table file path.
- * @return          ID of the opened table file.
+ * @param       table_id    table id obtained with
+ *                          <code>buffered_open_table_file()</code>.
+ * @param[out]  stats       truncated and punched pages are added to it.
+ * @return  <code>0</code> if success, <code>-1</code> if the table is not
+ * open.
  */
-tableid_t buffered_open_table_file(const char* path);
+int buffered_shrink_table_file(tableid_t table_id, CompactionStats* stats);
 
 /**
  * @brief   Allocate an on-disk page from the free page list
+ * @details The page is taken from the in-memory free space, without the
+ * header page. The free page list on disk is updated by
+ * <code>flush_buffer()</code>.
  *
  * @param   table_id        table id obtained with
  *                          <code>buffered_open_table_file()</code>.
@@ -123,8 +1115,39 @@ tableid_t buffered_open_table_file(const char* path);
  */
 pagenum_t buffered_alloc_page(tableid_t table_id, trxid_t trx_id = 0);
 
+/**
+ * @brief   Allocate an on-disk page for a tree level, close to another page
+ * @details The page is placed right after <code>near_page_idx</code> if
+ * possible, and in the extent of the level of the calling thread otherwise.
+ *
+ * @param   table_id        table id obtained with
+ *                          <code>buffered_open_table_file()</code>.
+ * @param   level           tree level of the page.
+ * @param   near_page_idx   page to place the new page after, or
+ *                          <code>0</code>.
+ * @return  >0  Page index number if allocation success.
+ *          0   Zero if allocation failed.
+ */
+pagenum_t buffered_alloc_page_near(tableid_t table_id, PageLevel level,
+                                   pagenum_t near_page_idx = 0);
+
+/**
+ * @brief   Allocate the lowest free on-disk page below a page
+ * @details Only the free page list is searched, so pages cached by threads
+ * are not taken. The file never grows.
+ *
+ * @param   table_id        table id obtained with
+ *                          <code>buffered_open_table_file()</code>.
+ * @param   end             page index to allocate below.
+ * @return  >0  Page index number if allocation success.
+ *          0   Zero if there is no free page below <code>end</code>.
+ */
+pagenum_t buffered_alloc_page_below(tableid_t table_id, pagenum_t end);
+
 /**
  * @brief   Free an on-disk page to the free page list
+ * @details The page is given to the in-memory free space, and is not written
+ * until <code>flush_buffer()</code>.
  *
  * @param   table_id        table id obtained with
  *                          <code>buffered_open_table_file()</code>.
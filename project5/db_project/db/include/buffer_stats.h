@@ -0,0 +1,173 @@
+/**
+ * @addtogroup BufferManager
+ * @{
+ */
+#pragma once
+
+#include <const.h>
+#include <types.h>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+/**
+ * @brief   Buffer manager event counted by each thread.
+ */
+enum BufferEvent {
+    /// @brief page found in the buffer.
+    BUFFER_HIT = 0,
+    /// @brief page loaded from the table file.
+    BUFFER_MISS,
+    /// @brief page evicted to load another one.
+    BUFFER_EVICTION,
+    /// @brief dirty page written on eviction.
+    BUFFER_DIRTY_EVICTION,
+    /// @brief page accessed without the buffer, since no frame was released in
+    /// time.
+    BUFFER_FALLBACK,
+    /// @brief pin which waited for a busy shard mutex.
+    BUFFER_PIN_WAIT,
+    /// @brief page latch acquisition which waited for other holders.
+    BUFFER_LATCH_WAIT,
+    /// @brief time(in nanoseconds) spent waiting for page latches.
+    BUFFER_LATCH_WAIT_NS,
+    /// @brief lookup which waited for a read or a write-back of the page.
+    BUFFER_IO_WAIT,
+    /// @brief pin which waited for a frame, since every frame was in use.
+    BUFFER_FRAME_WAIT,
+    /// @brief number of events.
+    BUFFER_EVENT_COUNT
+};
+
+/**
+ * @class   BufferStats
+ * @brief   Buffer manager statistics since the buffer is initialized.
+ */
+typedef struct BufferStats {
+    /// @brief number of page accesses which hit the buffer.
+    uint64_t hits;
+    /// @brief number of page accesses which loaded the page.
+    uint64_t misses;
+    /// @brief number of evicted pages.
+    uint64_t evictions;
+    /// @brief number of evicted pages which were written back.
+    uint64_t dirty_evictions;
+    /// @brief number of page accesses which bypassed the buffer, since no
+    /// frame of the shard was released in time.
+    uint64_t fallbacks;
+    /// @brief number of pins which waited for a busy shard mutex.
+    uint64_t pin_waits;
+    /// @brief number of page latch acquisitions which waited.
+    uint64_t latch_waits;
+    /// @brief total time(in nanoseconds) spent waiting for page latches.
+    uint64_t latch_wait_ns;
+    /// @brief number of lookups which waited for I/O of the page.
+    uint64_t io_waits;
+    /// @brief number of pins which waited for a frame to be released.
+    uint64_t frame_waits;
+    /// @brief number of hits of each table, indexed by table id.
+    std::vector<uint64_t> table_hits;
+    /// @brief number of misses of each table, indexed by table id.
+    std::vector<uint64_t> table_misses;
+} BufferStats;
+
+/**
+ * @class   ThreadBufferStats
+ * @brief   Buffer manager counters of a thread.
+ * @details Only the owner thread updates its counters, so they are updated
+ * without atomic read-modify-write instructions, and read by other threads
+ * when the statistics are aggregated. The counters are registered while the
+ * thread runs, and folded into the counters of exited threads when it exits.
+ * The table counters grow with the table ids the thread accesses, under the
+ * registry mutex, so that they do not move while they are aggregated.
+ */
+class ThreadBufferStats {
+   public:
+    /// @brief event counters.
+    std::atomic<uint64_t> events[BUFFER_EVENT_COUNT];
+    /// @brief hit counters of each table, indexed by table id.
+    std::deque<std::atomic<uint64_t>> table_hits;
+    /// @brief miss counters of each table, indexed by table id.
+    std::deque<std::atomic<uint64_t>> table_misses;
+
+    ThreadBufferStats();
+    ~ThreadBufferStats();
+};
+
+/**
+ * @brief   Buffer statistics helper
+ * @details This namespace includes the per-thread counters of the buffer
+ * manager, and the functions which aggregate them.
+ */
+namespace buffer_stats_helper {
+/**
+ * @brief Get the counters of the calling thread.
+ *
+ * @return thread counters.
+ */
+ThreadBufferStats& get_thread_stats();
+/**
+ * @brief Count an event in the calling thread.
+ *
+ * @param event     event.
+ * @param amount    amount to add.
+ */
+inline void count(BufferEvent event, uint64_t amount = 1) {
+    std::atomic<uint64_t>& counter = get_thread_stats().events[event];
+    counter.store(counter.load(std::memory_order_relaxed) + amount,
+                  std::memory_order_relaxed);
+}
+/**
+ * @brief Count a hit or a miss of a table in the calling thread.
+ *
+ * @param table_id  table id.
+ * @param is_hit    <code>true</code> if the page is buffered.
+ */
+void count_access(tableid_t table_id, bool is_hit);
+/**
+ * @brief Sum the counters of every thread, including exited ones.
+ *
+ * @param[out] stats    aggregated statistics.
+ */
+void collect(BufferStats* stats);
+/**
+ * @brief Print the statistics into <code>stderr</code>.
+ *
+ * @param stats statistics.
+ */
+void print_stats(const BufferStats& stats);
+/**
+ * @brief   Main function of the statistics dump thread.
+ *
+ * @param arg   not used.
+ * @return <code>nullptr</code>.
+ */
+void* dumper_main(void* arg);
+}  // namespace buffer_stats_helper
+
+/**
+ * @brief   Get the buffer statistics.
+ * @details The counters of every thread are summed on demand.
+ *
+ * @return  statistics since the last <code>reset_buffer_stats()</code>.
+ */
+BufferStats get_buffer_stats();
+
+/**
+ * @brief   Start the statistics from zero.
+ * @details Called by <code>init_buffer()</code>.
+ */
+void reset_buffer_stats();
+
+/**
+ * @brief   Configure the periodic statistics dump.
+ * @details A background thread prints the statistics into
+ * <code>stderr</code> every interval.
+ *
+ * @param interval_ms   interval between dumps. <code>0</code> stops the dump.
+ * @return <code>0</code> if success, non-zero value otherwise.
+ */
+int set_buffer_stats_dump(int interval_ms);
+/** @}*/
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 
 /**
  * @addtogroup DiskSpaceManager
@@ -9,15 +10,20 @@
 /// @details    It means 10MiB.
 constexpr int INITIAL_TABLE_FILE_SIZE = 10 * 1024 * 1024;
 
-/// @brief      Maximum number of table instances count.
-constexpr int MAX_TABLE_INSTANCE = 32;
+/// @brief  Size of each page(in bytes).
+constexpr int PAGE_SIZE = 4096;
 
 /// @brief      Initial number of page count in newly created table file.
 /// @details    Its value is 2560.
-constexpr int INITIAL_TABLE_CAPS = INITIAL_TABLE_FILE_SIZE / MAX_TABLE_INSTANCE;
+constexpr int INITIAL_TABLE_CAPS = INITIAL_TABLE_FILE_SIZE / PAGE_SIZE;
 
-/// @brief  Size of each page(in bytes).
-constexpr int PAGE_SIZE = 4096;
+/// @brief      Number of table instance slots allocated at a time.
+constexpr int TABLE_CHUNK_SIZE = 256;
+
+/// @brief      Maximum number of table instance slot chunks.
+/// @details    Table ids are never reused, so it bounds the number of opens
+/// in a process, not the number of open tables.
+constexpr int MAX_TABLE_CHUNKS = 4096;
 
 /// @brief  Size of page header(in bytes).
 constexpr int PAGE_HEADER_SIZE = 128;
@@ -25,6 +31,38 @@ constexpr int PAGE_HEADER_SIZE = 128;
 /// @brief  Maximum number of page branches.
 constexpr int MAX_PAGE_BRANCHES = 248;
 
+/// @brief  Number of submission queue entries of each table's io_uring.
+constexpr int IO_URING_ENTRIES = 64;
+
+/// @brief  Number of free pages a thread takes from a table at a time.
+constexpr int SPACE_CACHE_BATCH = 16;
+
+/// @brief  Maximum number of free pages a thread caches for each table.
+/// @details    Freed pages are cached up to this, so that a split after a
+/// merge reuses the pages, which are likely to be buffered.
+constexpr int SPACE_CACHE_CAPACITY = 64;
+
+/// @brief  Number of consecutive pages a thread reserves for a tree level.
+/// @details    An extent is a word of the free page bitmap, so that a run of
+/// free pages is found a word at a time.
+constexpr int SPACE_EXTENT_SIZE = 64;
+
+/// @brief  Maximum number of punched runs of free pages a header page holds.
+/// @details    A run is punched an extent at a time, and adjacent runs are
+/// merged, so it bounds the punched free space only if it is fragmented.
+constexpr int MAX_HEADER_HOLES = 240;
+
+/// @brief  Magic number of the header pages with the free space fields.
+constexpr uint32_t HEADER_MAGIC = 0x44425350;
+
+/// @brief  Format version of the free space fields of the header page.
+constexpr uint32_t HEADER_VERSION = 1;
+
+/// @brief  Number of tree pages a compaction moves at a time.
+/// @details    The table is held exclusively for a batch only, so that the
+/// other operations go on between the batches.
+constexpr int COMPACTION_BATCH_MOVES = 64;
+
 /** @}*/
 
 /**
@@ -35,6 +73,64 @@ constexpr int MAX_PAGE_BRANCHES = 248;
 /// @brief      Initial number of buffer pages when initializing db.
 constexpr int DEFAULT_BUFFER_SIZE = 1024;
 
+/// @brief      Maximum share of the frames in the protected list of the LRU
+/// policy.
+/// @details    The rest is the probation list, where loaded pages wait for
+/// their second access.
+constexpr double LRU_PROTECTED_SHARE = 0.625;
+
+/// @brief      Default number of buffer shards when initializing db.
+constexpr int DEFAULT_BUFFER_SHARDS = 16;
+
+/// @brief      Size(in bytes) of a huge page which can back buffer frames.
+constexpr int HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+/// @brief      Number of frames allocated together when a shard grows.
+/// @details    A power of 2, so that a frame is found with shifts. Pages of a
+/// chunk fill a huge page.
+constexpr int FRAME_CHUNK_SIZE = HUGE_PAGE_SIZE / PAGE_SIZE;
+
+/// @brief      Maximum number of frame chunks of a shard.
+/// @details    It bounds a shard to 262144 frames, or 1GiB of pages.
+constexpr int MAX_FRAME_CHUNKS = 512;
+
+/// @brief      Interval(in milliseconds) between retries to retire frames
+/// which are in use while the buffer shrinks.
+constexpr int RESIZE_RETRY_INTERVAL_MS = 1;
+
+/// @brief      Share of the coldest frames searched for a clean victim.
+/// @details    If every candidate in this window is dirty, a dirty page is
+/// written back and evicted.
+constexpr double CLEAN_VICTIM_WINDOW = 0.25;
+
+/// @brief      Default interval(in milliseconds) between buffer cleaner passes.
+constexpr int DEFAULT_CLEANER_INTERVAL_MS = 10;
+
+/// @brief      Default number of leaf pages read ahead of a sequential walk.
+constexpr int DEFAULT_READ_AHEAD_WINDOW = 8;
+
+/// @brief      Number of consecutive sibling leaf accesses which starts
+/// read-ahead.
+constexpr int READ_AHEAD_TRIGGER = 2;
+
+/// @brief      Maximum number of pending read-ahead requests.
+constexpr int MAX_READ_AHEAD_REQUESTS = 64;
+
+/// @brief      Suffix of the warm-up manifest file next to each table file.
+constexpr const char* WARM_UP_MANIFEST_SUFFIX = ".warm";
+
+/// @brief      Maximum number of consecutive pages the warm-up reads at
+/// once.
+constexpr int MAX_WARM_UP_RUN_PAGES = 64;
+
+/// @brief      Number of independently latched stripes of the victim cache.
+constexpr int VICTIM_CACHE_STRIPES = 16;
+
+/// @brief      Maximum size(in bytes) of a compressed page in the victim
+/// cache.
+/// @details    Pages which do not compress into it are not cached.
+constexpr int MAX_COMPRESSED_PAGE_SIZE = PAGE_SIZE * 3 / 4;
+
 /** @}*/
 
 /**
@@ -46,5 +142,9 @@ constexpr int DEFAULT_BUFFER_SIZE = 1024;
 constexpr int REDISTRIBUTE_THRESHOLD = 2500;
 /// @brief      Maximum size of the leaf node record size.
 constexpr int MAX_VALUE_SIZE = 112;
+/// @brief      Maximum number of restarts of an optimistic descent.
+/// @details    The descent latches pages after it, so that it finishes while
+/// the pages on its path keep changing.
+constexpr int MAX_OPTIMISTIC_RESTARTS = 8;
 
 /** @}*/
\ No newline at end of file
@@ -4,26 +4,117 @@
  */
 #pragma once
 
+#include <buffer_stats.h>
 #include <const.h>
+#include <file.h>
+#include <policy.h>
+#include <tree.h>
 #include <types.h>
+#include <victim_cache.h>
+
+#include <functional>
 
 /**
  * @brief   Initialize database management system.
  *
- * @param num_buf   Number of buffered pages.
+ * @param num_buf       Number of buffered pages.
+ * @param num_shards    Number of buffer shards.
+ * @param policy        Page replacement policy.
+ * @param huge_pages    Back buffered pages with huge pages.
+ * @returns         If success, return 0. Otherwise return non-zero value.
+ */
+int init_db(int num_buf = DEFAULT_BUFFER_SIZE,
+            int num_shards = DEFAULT_BUFFER_SHARDS,
+            ReplacementPolicyType policy = DEFAULT_REPLACEMENT_POLICY,
+            bool huge_pages = false);
+
+/**
+ * @brief   Resize the buffer pool without restarting the database.
+ * @details Transactions can run meanwhile. Shrinking writes back the excess
+ * pages, and waits until pages in use are released.
+ *
+ * @param num_buf   New number of buffered pages. At least the number of
+ * buffer shards.
+ * @returns         If success, return 0. Otherwise return non-zero value.
+ */
+int db_resize_buffer(int num_buf);
+
+/**
+ * @brief   Write every modified page in the buffer to the table files.
+ * @details Can be called periodically as a checkpoint while transactions run.
+ * Table files are written in parallel, each in page order with adjacent
+ * pages coalesced.
+ *
+ * @returns         If success, return 0. Otherwise return non-zero value.
+ */
+int db_flush();
+
+/**
+ * @brief   Get the buffer manager statistics.
+ * @details Hits, misses, evictions, fallbacks and waits are counted by each
+ * thread, and summed when they are requested.
+ *
+ * @returns         statistics since <code>init_db()</code>.
+ */
+BufferStats db_get_buffer_stats();
+
+/**
+ * @brief   Print the buffer manager statistics periodically.
+ * @details The statistics are printed into <code>stderr</code> until
+ * <code>shutdown_db()</code>.
+ *
+ * @param interval_ms   interval between dumps. <code>0</code> stops them.
+ * @returns         If success, return 0. Otherwise return non-zero value.
+ */
+int db_set_buffer_stats_dump(int interval_ms);
+
+/**
+ * @brief   Configure the compressed victim cache.
+ * @details Clean pages evicted from the buffer are kept compressed within the
+ * budget, and loaded back from it instead of the table file. It is disabled
+ * by <code>shutdown_db()</code>.
+ *
+ * @param budget_bytes  memory budget(in bytes). <code>0</code> disables it.
  * @returns         If success, return 0. Otherwise return non-zero value.
  */
-int init_db(int num_buf = DEFAULT_BUFFER_SIZE);
+int db_set_victim_cache(size_t budget_bytes);
+
+/**
+ * @brief   Get the victim cache statistics.
+ *
+ * @returns         statistics since the victim cache is enabled.
+ */
+VictimCacheStats db_get_victim_cache_stats();
 
 /**
  * @brief   Open existing data file using ‘pathname’ or create one if not
  * existed.
  *
  * @param pathname  Table file path.
+ * @param backend   I/O backend. io_uring falls back to pread if the kernel
+ * does not support it.
+ * @param direct_io Open with <code>O_DIRECT</code>, so that pages are not
+ * cached twice by the buffer pool and the kernel page cache.
+ * @param quota     Buffer frames reserved for and allowed to the table, and
+ * the priority of its pages on eviction. Reopening the table with a quota
+ * other than <code>DEFAULT_BUFFER_QUOTA</code> replaces its quota.
  * @returns         unique table id which represents the own table in this
  * database. return negative value otherwise.
  */
-tableid_t open_table(char* pathname);
+tableid_t open_table(char* pathname, IOBackend backend = PREAD_BACKEND,
+                     bool direct_io = false,
+                     const BufferQuota& quota = DEFAULT_BUFFER_QUOTA);
+
+/**
+ * @brief   Close a table, writing its dirty pages and free space.
+ * @details The table should not be used by other threads or running
+ * transactions. A table opened again gets a new table id, so that an id of a
+ * closed table never refers to another table.
+ *
+ * @param table_id  table id obtained with <code>open_table()</code>.
+ * @returns         0 if success. negative value otherwise.
+ */
+int close_table(tableid_t table_id);
 
 /**
  * @brief   Insert input (key, value) record with its size to data file at the
@@ -70,6 +161,59 @@ int db_find(tableid_t table_id, recordkey_t key, char* ret_val,
 int db_find(tableid_t table_id, recordkey_t key, char* ret_val,
             valsize_t* value_size, trxid_t trx_id);
 
+/**
+ * @brief   Visit the records in a key range in key order.
+ * @details Sequential leaf accesses of a scan are read ahead by the buffer
+ * manager. By default the leaves are accessed with <code>SCAN_ACCESS</code>,
+ * so that a large scan does not evict the hot pages from the buffer.
+ *
+ * @param table_id  table id obtained with <code>open_table()</code>.
+ * @param begin_key smallest record key.
+ * @param end_key   largest record key.
+ * @param visitor   called with each record key, value and value size. The
+ * value is valid only during the call. Returning <code>false</code> stops the
+ * scan.
+ * @param hint      kind of the leaf accesses. <code>NORMAL_ACCESS</code> lets
+ * the scanned leaves be promoted like point reads.
+ * @returns         number of visited records. negative value otherwise.
+ */
+int db_scan(
+    tableid_t table_id, recordkey_t begin_key, recordkey_t end_key,
+    const std::function<bool(recordkey_t, const char*, valsize_t)>& visitor,
+    AccessHint hint = SCAN_ACCESS);
+
+/**
+ * @brief   Measure how far the leaves of a table are from key order on disk.
+ * @details The sequential ratio
+ * <code>sequential_links / (leaf_count - 1)</code> is close to 1 if a range
+ * scan reads the file sequentially.
+ *
+ * @param       table_id        table id obtained with
+ * <code>open_table()</code>.
+ * @param[out]  fragmentation   fragmentation of the leaves.
+ * @returns                     0 if success. negative value otherwise.
+ */
+int db_get_leaf_fragmentation(tableid_t table_id,
+                              LeafFragmentation* fragmentation);
+
+/**
+ * @brief   Compact a table file exclusively, and give its free pages back.
+ * @details The highest tree pages are moved to the lowest free pages, and
+ * their parent, children and sibling links are rewritten. Then the free
+ * pages at the end of the file are truncated, and the aligned extents of free
+ * pages left in the middle are punched with
+ * <code>FALLOC_FL_PUNCH_HOLE</code>. The pages are moved in batches, and the
+ * table is held exclusively for a batch at a time, so the other operations
+ * go on between them. It fails if any record lock of the table is held.
+ *
+ * @param       table_id    table id obtained with <code>open_table()</code>.
+ * @param       max_moves   maximum number of pages to move, negative for no
+ * limit. <code>0</code> only releases the free pages.
+ * @param[out]  stats       compaction result.
+ * @returns                 0 if success. negative value otherwise.
+ */
+int db_compact_table(tableid_t table_id, int max_moves, CompactionStats* stats);
+
 /**
  * @brief Find the matching record and modify its value if found.
  *
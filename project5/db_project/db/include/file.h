@@ -6,7 +6,21 @@
 
 #include <const.h>
 #include <page.h>
+#include <space.h>
 #include <types.h>
+#include <uring.h>
+
+#include <atomic>
+
+/**
+ * @brief   I/O backend of a table file.
+ */
+enum IOBackend {
+    /// @brief blocking <code>pread64</code>/<code>pwrite64</code>.
+    PREAD_BACKEND = 0,
+    /// @brief io_uring with batched submission.
+    IO_URING_BACKEND = 1
+};
 
 /**
  * @class   TableInstance
@@ -17,8 +31,50 @@ typedef struct TableInstance {
     char* file_path;
     /// @brief table file descriptor.
     int file_descriptor;
+    /// @brief I/O backend in use.
+    IOBackend backend;
+    /// @brief <code>true</code> if the file is opened with
+    /// <code>O_DIRECT</code>, bypassing the kernel page cache.
+    bool direct_io;
+    /// @brief io_uring instance, <code>nullptr</code> for pread backend.
+    IoUring* ring;
+    /// @brief in-memory free space, loaded when the file is opened.
+    TableSpace* space;
+    /// @brief gate of the table operations, which take it shared. Compaction
+    /// and close take it exclusive.
+    pthread_rwlock_t table_gate;
+    /// @brief number of threads which entered the table, and may touch the
+    /// instance. It is freed on close after they leave.
+    std::atomic<int> user_count;
+    /// @brief <code>true</code> once the table is being closed, so that new
+    /// threads leave without entering.
+    std::atomic<bool> is_closing;
 } TableInstance;
 
+/**
+ * @class   PageIO
+ * @brief   A page read or write of a batch.
+ */
+typedef struct PageIO {
+    /// @brief page index.
+    pagenum_t pagenum;
+    /// @brief page data. Read into it, or written from it.
+    page_t* page;
+    /// @brief <code>true</code> if the page is written.
+    bool is_write;
+} PageIO;
+
+/**
+ * @class   PageBuffer
+ * @brief   A page of a vectored read or write.
+ */
+typedef struct PageBuffer {
+    /// @brief page index.
+    pagenum_t pagenum;
+    /// @brief page data. Read into it, or written from it.
+    page_t* page;
+} PageBuffer;
+
 /**
  * @brief   Filemanager helper
  * @details This namespace includes some helper functions which are used by
@@ -29,16 +85,70 @@ namespace file_helper {
 /**
  * @brief   Get table instance
  * @details Get the reference of the table instance ojbect corresponds with the
- * given table id.
+ * given table id. The table should be open.
  *
  * @param   table_id    Target table id
  */
 TableInstance& get_table_instance(tableid_t table_id);
+/**
+ * @brief   Find the instance of a table, which may be closed.
+ * @details Instances are looked up without locks, so the caller should make
+ * sure that the table is not closed meanwhile.
+ *
+ * @param   table_id    table id.
+ * @return  table instance, or <code>nullptr</code> if the table is not open.
+ */
+TableInstance* find_table_instance(tableid_t table_id);
+/**
+ * @brief   Get the upper bound of the table ids issued so far.
+ * @details Ids of closed tables are not reused, so some ids below it may be
+ * closed.
+ *
+ * @return  one more than the largest table id.
+ */
+tableid_t get_table_id_limit();
+/**
+ * @brief   Enter an open table and hold its gate.
+ * @details The instance stays valid until <code>leave_table()</code>, even if
+ * the table is closed meanwhile.
+ *
+ * @param   table_id        table id.
+ * @param   is_exclusive    <code>true</code> to hold the gate exclusive.
+ * @return  table instance, or <code>nullptr</code> if the table is not open or
+ * is being closed.
+ */
+TableInstance* enter_table(tableid_t table_id, bool is_exclusive);
+/**
+ * @brief   Release the gate of a table, and leave it.
+ *
+ * @param   instance    instance from <code>enter_table()</code>.
+ */
+void leave_table(TableInstance* instance);
+/**
+ * @brief   Enter a table exclusive to close it.
+ * @details Threads which enter the table from now on leave without entering,
+ * and the running ones are waited for.
+ *
+ * @param   table_id    table id.
+ * @return  table instance, or <code>nullptr</code> if the table is not open or
+ * is being closed.
+ */
+TableInstance* begin_close(tableid_t table_id);
+/**
+ * @brief   Persist the free space of a table and close its file.
+ * @details The table is unpublished, and the instance is freed after every
+ * thread which found it leaves.
+ *
+ * @param   table_id    table id.
+ * @param   instance    instance from <code>begin_close()</code>.
+ */
+void end_close(tableid_t table_id, TableInstance* instance);
 /**
  * @brief   Automatically check and size-up a page file.
  * @details If <code>newsize > page_num</code>, reserve pages so that total page
- *          num is equivalent to newsize. If <code>newsize = 0</code> and header
- * page's free_page_idx is 0, double the reserved page count.
+ *          num is equivalent to newsize. If <code>newsize = 0</code> and the
+ * table has no free page, double the reserved page count. The free page list
+ * on disk is updated when the space is persisted.
  *
  * @param   table_id    Target table id.
  * @param   newsize     extended size. default is 0, which means doubling the
@@ -53,18 +163,68 @@ void extend_capacity(tableid_t table_id, pagenum_t newsize = 0);
  * @param   header_page Header page.
  */
 void flush_header(tableid_t table_id, headerpage_t* header_page);
+
+/**
+ * @brief   Read or write pages with vectored I/O.
+ * @details The pages are sorted by page index, and each run of consecutive
+ * pages is transferred by a single <code>preadv</code> or
+ * <code>pwritev</code>, up to <code>IOV_MAX</code> pages each.
+ *
+ * @param   table_id    Target table id.
+ * @param   pages       pages, in any order. Each page appears once.
+ * @param   count       number of pages.
+ * @param   is_write    <code>true</code> to write the pages.
+ */
+void transfer_pages(tableid_t table_id, const PageBuffer* pages, int count,
+                    bool is_write);
 };  // namespace file_helper
 
 /**
  * @brief   Open existing table file or create one if not existed.
+ * @details Open tables are looked up by their real path, so a table which is
+ * already open keeps its id. A table opened again after it is closed gets a
+ * new id, since ids are never reused. If io_uring is requested but not supported by the kernel, the
+ * table falls back to the pread backend. Likewise, if the file system does
+ * not support <code>O_DIRECT</code>, the file is opened through the page
+ * cache. The backend and mode of a table which is already open are not
+ * changed.
  *
- * @param   path    Table file path.
+ * @param   path        Table file path.
+ * @param   backend     I/O backend.
+ * @param   direct_io   <code>true</code> to bypass the kernel page cache, so
+ * that pages are cached only in the buffer pool.
+ * @param[out] is_opened    set to <code>true</code> if the table is opened by
+ * this call, <code>false</code> if it was already open. May be
+ * <code>nullptr</code>.
  * @return          ID of the opened table file.
  */
-tableid_t file_open_table_file(const char* path);
+tableid_t file_open_table_file(const char* path,
+                               IOBackend backend = PREAD_BACKEND,
+                               bool direct_io = false,
+                               bool* is_opened = nullptr);
+
+/**
+ * @brief   Get the I/O backend of a table file.
+ *
+ * @param   table_id        table id obtained with
+ *                          <code>file_open_table_file()</code>.
+ * @return  I/O backend in use.
+ */
+IOBackend file_get_backend(tableid_t table_id);
+
+/**
+ * @brief   Check whether a table file bypasses the kernel page cache.
+ *
+ * @param   table_id        table id obtained with
+ *                          <code>file_open_table_file()</code>.
+ * @return  <code>true</code> if the file is opened with <code>O_DIRECT</code>.
+ */
+bool file_is_direct_io(tableid_t table_id);
 
 /**
  * @brief   Allocate an on-disk page from the free page list
+ * @details The free space is persisted right away, without the caches of
+ * threads.
  *
  * @param   table_id        table id obtained with
  *                          <code>file_open_table_file()</code>.
@@ -75,6 +235,8 @@ pagenum_t file_alloc_page(tableid_t table_id);
 
 /**
  * @brief   Free an on-disk page to the free page list
+ * @details The free space is persisted right away, without the caches of
+ * threads.
  *
  * @param   table_id        table id obtained with
  *                          <code>file_open_table_file()</code>.
@@ -102,8 +264,77 @@ void file_read_page(tableid_t table_id, pagenum_t pagenum, page_t* dest);
  */
 void file_write_page(tableid_t table_id, pagenum_t pagenum, const page_t* src);
 
+/**
+ * @brief   Read on-disk pages into in-memory pages.
+ * @details Consecutive pages are scattered by a single <code>preadv</code>,
+ * whatever the backend of the table is, so that a run of pages costs one
+ * system call.
+ *
+ * @param   table_id        table id obtained with
+ *                          <code>file_open_table_file()</code>.
+ * @param   pages           page indexes and the page data to read into.
+ * @param   count           number of pages.
+ */
+void file_read_pages(tableid_t table_id, const PageBuffer* pages, int count);
+
+/**
+ * @brief   Write in-memory pages to on-disk pages.
+ * @details Consecutive pages are gathered by a single <code>pwritev</code>,
+ * whatever the backend of the table is, so that a run of pages costs one
+ * system call.
+ *
+ * @param   table_id        table id obtained with
+ *                          <code>file_open_table_file()</code>.
+ * @param   pages           page indexes and the page data to write.
+ * @param   count           number of pages.
+ */
+void file_write_pages(tableid_t table_id, const PageBuffer* pages, int count);
+
+/**
+ * @brief   Read and write a batch of on-disk pages.
+ * @details With io_uring backend, the whole batch is submitted at once and
+ * the caller sleeps until the last completion arrives. With pread backend,
+ * pages are transferred one by one. Pages should be aligned to
+ * <code>PAGE_SIZE</code>, which every page struct is.
+ *
+ * @param   table_id        table id obtained with
+ *                          <code>file_open_table_file()</code>.
+ * @param   requests        page reads and writes.
+ * @param   count           number of requests.
+ */
+void file_submit_pages(tableid_t table_id, PageIO* requests, int count);
+
+/**
+ * @brief   Hint that on-disk pages will be read soon.
+ * @details Issues <code>posix_fadvise(POSIX_FADV_WILLNEED)</code> for
+ * <code>count</code> pages from <code>pagenum</code>, so that the kernel can
+ * read them asynchronously. Ignored for <code>O_DIRECT</code> files, which
+ * do not go through the page cache.
+ *
+ * @param   table_id        table id obtained with
+ *                          <code>file_open_table_file()</code>.
+ * @param   pagenum         first page index.
+ * @param   count           number of pages.
+ */
+void file_advise_pages(tableid_t table_id, pagenum_t pagenum, int count);
+
+/**
+ * @brief   Close a table file.
+ * @details The caches of the threads are drained and the free space is
+ * persisted before the file is closed. It waits for the operations which
+ * entered the table. Caller should make sure that none of its pages is
+ * buffered.
+ *
+ * @param   table_id        table id obtained with
+ *                          <code>file_open_table_file()</code>.
+ * @return  <code>0</code> if success, <code>-1</code> if the table is not
+ * open.
+ */
+int file_close_table_file(tableid_t table_id);
+
 /**
  * @brief   Stop referencing the table files
+ * @details The free space of each table is persisted before it is closed.
  */
 void file_close_table_files();
 /** @}*/
\ No newline at end of file
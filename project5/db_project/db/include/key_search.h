@@ -0,0 +1,84 @@
+/**
+ * @addtogroup DiskSpaceManager
+ * @{
+ */
+#pragma once
+#include <page.h>
+#include <types.h>
+
+/// @brief Number of branches the SIMD kernels compare at once, after the
+/// binary search narrows the range down to it.
+constexpr int KEY_SEARCH_BLOCK = 8;
+
+/**
+ * @brief Implementation of the internal page search.
+ */
+enum KeySearchKernel {
+    /// @brief branchless binary search.
+    SCALAR_SEARCH = 0,
+    /// @brief binary search, then SSE4.2 comparisons of two keys at once.
+    SSE42_SEARCH = 1,
+    /// @brief binary search, then AVX2 comparisons of four keys at once.
+    AVX2_SEARCH = 2
+};
+
+/**
+ * @brief   Key search helper
+ * @details Search kernels for the sorted keys of the pages. They do not
+ * branch on the compared keys, so the searches are not slowed down by
+ * mispredictions, and they never read outside the given range even if the
+ * keys are not sorted, which happens in optimistic reads of a page under
+ * modification.
+ */
+namespace key_search_helper {
+/**
+ * @brief Count the branches of which key is not greater than the given key.
+ * @details Same as the index of the upper bound. The child page to follow is
+ * the one of the branch before it, or the leftmost child if it is
+ * <code>0</code>. It uses the fastest kernel the CPU supports.
+ *
+ * @param branches  sorted branches.
+ * @param count     number of branches.
+ * @param key       search key.
+ * @return number of branches of which key is not greater than
+ * <code>key</code>.
+ */
+int upper_bound_branches(const PageBranch* branches, int count,
+                         recordkey_t key);
+/**
+ * @brief Count the branches of which key is not greater than the given key,
+ * with the given kernel.
+ * @details The kernel should be supported by the CPU, see
+ * <code>get_supported_kernel()</code>.
+ *
+ * @param kernel    search kernel.
+ * @param branches  sorted branches.
+ * @param count     number of branches.
+ * @param key       search key.
+ * @return number of branches of which key is not greater than
+ * <code>key</code>.
+ */
+int upper_bound_branches(KeySearchKernel kernel, const PageBranch* branches,
+                         int count, recordkey_t key);
+/**
+ * @brief Get the fastest kernel the CPU supports.
+ * @details It is checked once, and the same kernel is returned after that.
+ *
+ * @return search kernel.
+ */
+KeySearchKernel get_supported_kernel();
+/**
+ * @brief Find the first slot of which key is not less than the given key.
+ * @details Slots are packed into 12 bytes, so the keys are not aligned for
+ * the SIMD comparisons and it is always a branchless binary search.
+ *
+ * @param slots     sorted slots.
+ * @param count     number of slots.
+ * @param key       search key.
+ * @return index of the lower bound, <code>count</code> if every key is less
+ * than <code>key</code>.
+ */
+int lower_bound_slots(const PageSlot* slots, int count, recordkey_t key);
+}  // namespace key_search_helper
+
+/** @}*/
@@ -159,5 +159,13 @@ Lock* lock_acquire(int table_id, pagenum_t page_id, int key_idx,
  */
 int lock_release(Lock* lock_obj);
 
+/**
+ * @brief Determine if any lock is held or waited on a table.
+ *
+ * @param table_id  table id.
+ * @return <code>true</code> if found, <code>false</code> otherwise.
+ */
+bool lock_is_table_locked(int table_id);
+
 typedef struct Lock lock_t;
 /** @}*/
\ No newline at end of file
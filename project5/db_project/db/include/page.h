@@ -12,7 +12,9 @@
  * @class   Page
  * @brief   struct for abstract page.
  * @details Actually this struct is empty for equalizing the size of all
- *          inherited pages.
+ *          inherited pages. Every complete page is aligned to its size, so
+ *          that it can be transferred with <code>O_DIRECT</code>. Partial
+ *          bases are not, which would pad them to the page size.
  */
 struct Page {};
 
@@ -20,32 +22,56 @@ struct Page {};
  * @class   FullPage
  * @brief   struct for any page.
  */
-struct FullPage : public Page {
+struct alignas(PAGE_SIZE) FullPage : public Page {
     /// @brief Reserved area for page.
     uint8_t reserved[PAGE_SIZE];
 };
 
+/**
+ * @class   PageRun
+ * @brief   Run of consecutive pages.
+ */
+struct PageRun {
+    /// @brief The first page index.
+    pagenum_t first;
+    /// @brief The end of the run, exclusive.
+    pagenum_t end;
+};
+
 /**
  * @class   HeaderPage
  * @brief   struct for the header page.
  */
-struct HeaderPage : public Page {
+struct alignas(PAGE_SIZE) HeaderPage : public Page {
     /// @brief The first free page index.
     pagenum_t free_page_idx;
     /// @brief Total count of the page reserved.
     uint64_t page_num;
     /// @brief The root page index.
     pagenum_t root_page_idx;
+    /// @brief <code>HEADER_MAGIC</code> if the fields below are written.
+    /// Older files may leave anything in their reserved area.
+    uint32_t magic;
+    /// @brief Format version of the fields below.
+    uint32_t version;
+    /// @brief The first page of the unformatted free pages, which run to the
+    /// end of the file without links. <code>0</code> if there is none.
+    pagenum_t unformatted_page_idx;
+    /// @brief Number of the punched runs.
+    uint64_t hole_count;
+    /// @brief Runs of free pages punched out of the file. They are not
+    /// linked, and lie below the free page list.
+    PageRun holes[MAX_HEADER_HOLES];
 
     /// @brief Reserved area for next project.
-    uint8_t reserved[PAGE_SIZE - 24];
+    uint8_t reserved[PAGE_SIZE - 48 - MAX_HEADER_HOLES * sizeof(PageRun)];
 };
 
 /**
  * @class   FreePage
  * @brief   struct for the free page.
  */
-struct FreePage : public Page {
+struct alignas(PAGE_SIZE) FreePage : public Page {
     /// @brief Index of the very next free page.
     pagenum_t next_free_idx;
 
@@ -118,7 +144,7 @@ struct AllocatedPage : public Page {
  * @brief   struct for any allocated page.
  * @details You should use this struct for read & write allocated page.
  */
-struct AllocatedFullPage : public AllocatedPage {
+struct alignas(PAGE_SIZE) AllocatedFullPage : public AllocatedPage {
     /// @brief Reserved area for normal allocated page.
     uint8_t reserved[PAGE_SIZE - PAGE_HEADER_SIZE];
 };
@@ -127,7 +153,7 @@ struct AllocatedFullPage : public AllocatedPage {
  * @class   InternalPage
  * @brief   struct for allocated internal page.
  */
-struct InternalPage : public AllocatedPage {
+struct alignas(PAGE_SIZE) InternalPage : public AllocatedPage {
     /// @brief Page branches.
     PageBranch page_branches[MAX_PAGE_BRANCHES];
 };
@@ -136,7 +162,7 @@ struct InternalPage : public AllocatedPage {
  * @class   LeafPage
  * @brief   struct for allocated leaf page.
  */
-struct LeafPage : public AllocatedPage {
+struct alignas(PAGE_SIZE) LeafPage : public AllocatedPage {
     /// @brief Reserved area for normal allocated page.
     uint8_t reserved[PAGE_SIZE - PAGE_HEADER_SIZE];
 } __attribute__((packed));
@@ -163,7 +189,8 @@ PageSlot* get_page_slot(LeafPage* page);
 /**
  * @brief Get the record index.
  * @details Search record key from the leaf page slot and return its index.
- * 
+ * The slots are sorted by key, so it is a binary search.
+ *
  * @param page  leaf page.
  * @param key   record key
  * @return record index if found, <code>-1</code> otherwise.
@@ -295,6 +322,17 @@ bool remove_internal_key(InternalPage* page, recordkey_t key);
  * @returns             leftmost child page index.
  */
 pagenum_t* get_leftmost_child_idx(InternalPage* page);
+/**
+ * @brief Get the index of the branch to follow for the given key.
+ * @details It is the last branch of which key is not greater than
+ * <code>key</code>.
+ *
+ * @param page          internal page.
+ * @param key           search key.
+ * @returns             branch index, <code>-1</code> if the leftmost child
+ * should be followed.
+ */
+int get_branch_idx(InternalPage* page, recordkey_t key);
 }  // namespace page_helper
 
 typedef Page page_t;
@@ -0,0 +1,149 @@
+/**
+ * @addtogroup BufferManager
+ * @{
+ */
+#pragma once
+
+#include <types.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @class   PageTable
+ * @brief   Open addressing hash table from page location to frame index.
+ * @details Slots are preallocated and probed linearly, so neither lookups nor
+ * updates allocate memory. Updates should be serialized by the caller, while
+ * <code>find()</code> can run concurrently with them without any lock. A
+ * concurrent lookup may miss a page which is being moved by an update, or
+ * return the old frame of a page which is being replaced, so lock-free callers
+ * should validate the frame and retry under the lock on a miss. Growing the
+ * table publishes a rehashed copy of the slots, and the old slots are kept
+ * until the table is initialized again, so that lookups which are still
+ * probing them stay valid.
+ */
+class PageTable {
+   private:
+    /**
+     * @brief Hash table slot. Four slots share a cache line.
+     */
+    struct alignas(16) Slot {
+        /// @brief packed page location, <code>EMPTY_KEY</code> if empty.
+        std::atomic<uint64_t> key;
+        /// @brief frame index.
+        std::atomic<int> value;
+    };
+
+    /**
+     * @brief Slot array and its mask, which are published together.
+     */
+    struct Slots {
+        /// @brief slots.
+        Slot* slots;
+        /// @brief number of slots minus one. The number of slots is a power
+        /// of 2.
+        size_t mask;
+    };
+
+    /// @brief key of an empty slot.
+    static constexpr uint64_t EMPTY_KEY = ~static_cast<uint64_t>(0);
+    /// @brief number of bits of a packed page number.
+    static constexpr int PAGENUM_BITS = 48;
+
+    /// @brief current slots.
+    std::atomic<Slots*> table;
+    /// @brief slots replaced by <code>reserve()</code>.
+    std::vector<Slots*> retired;
+    /// @brief number of stored pages.
+    size_t stored_count;
+
+    /**
+     * @brief Pack a page location into a key.
+     *
+     * @param page_location page location.
+     * @return packed key.
+     */
+    static uint64_t pack(const PageLocation& page_location);
+    /**
+     * @brief Get the home slot of a key.
+     *
+     * @param key   packed key.
+     * @param mask  slot mask.
+     * @return slot index.
+     */
+    static size_t home(uint64_t key, size_t mask);
+    /**
+     * @brief Allocate empty slots.
+     *
+     * @param capacity  maximum number of stored pages.
+     * @return allocated slots.
+     */
+    static Slots* make_slots(int capacity);
+    /**
+     * @brief Free the current and retired slots.
+     */
+    void free_slots();
+
+   public:
+    PageTable();
+    ~PageTable();
+    PageTable(const PageTable&) = delete;
+    PageTable& operator=(const PageTable&) = delete;
+
+    /**
+     * @brief Allocate the slots. Every stored page is dropped.
+     *
+     * @param capacity  maximum number of stored pages.
+     */
+    void init(int capacity);
+    /**
+     * @brief Make room for more pages without dropping stored pages.
+     * @details Serialized with the other updates, but lookups can run
+     * concurrently. Does nothing if the table is already large enough.
+     *
+     * @param capacity  maximum number of stored pages.
+     */
+    void reserve(int capacity);
+    /**
+     * @brief Find the frame of a page.
+     * @details Lock-free. See the class description for the result of a
+     * lookup which races with an update.
+     *
+     * @param page_location page location.
+     * @return frame index if found, <code>-1</code> otherwise.
+     */
+    int find(const PageLocation& page_location) const;
+    /**
+     * @brief Count a page.
+     *
+     * @param page_location page location.
+     * @return <code>1</code> if found, <code>0</code> otherwise.
+     */
+    size_t count(const PageLocation& page_location) const {
+        return find(page_location) >= 0;
+    }
+    /**
+     * @brief Store the frame of a page which is not stored.
+     *
+     * @param page_location page location.
+     * @param frame_idx     frame index.
+     */
+    void insert(const PageLocation& page_location, int frame_idx);
+    /**
+     * @brief Remove a page.
+     * @details Following slots of the probe sequence are shifted back instead
+     * of leaving a tombstone, so the table never fills up with deleted slots.
+     *
+     * @param page_location page location.
+     */
+    void erase(const PageLocation& page_location);
+    /**
+     * @brief Get the number of stored pages.
+     *
+     * @return number of stored pages.
+     */
+    size_t size() const { return stored_count; }
+};
+/** @}*/
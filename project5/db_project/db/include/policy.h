@@ -0,0 +1,398 @@
+/**
+ * @addtogroup BufferManager
+ * @{
+ */
+#pragma once
+
+#include <types.h>
+
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Page replacement policy type.
+ */
+enum ReplacementPolicyType {
+    LRU_POLICY = 0,
+    CLOCK_POLICY = 1,
+    LRU_K_POLICY = 2,
+    TWO_Q_POLICY = 3
+};
+
+/// @brief Default page replacement policy.
+constexpr ReplacementPolicyType DEFAULT_REPLACEMENT_POLICY = CLOCK_POLICY;
+
+/**
+ * @brief Kind of a page access, which decides how the policy ranks the page.
+ */
+enum AccessHint {
+    /// @brief ordinary access. A page loaded by it is on probation until it
+    /// is accessed again.
+    NORMAL_ACCESS = 0,
+    /// @brief access of a scan which should not promote the page. A page
+    /// loaded by it is evicted before the other pages.
+    SCAN_ACCESS = 1
+};
+
+/**
+ * @brief Eviction priority of the pages of a table.
+ */
+enum BufferPriority {
+    /// @brief pages evicted before the other classes.
+    LOW_PRIORITY = 0,
+    NORMAL_PRIORITY = 1,
+    /// @brief pages evicted only if there are no other candidates.
+    HIGH_PRIORITY = 2
+};
+
+/**
+ * @class BufferQuota
+ * @brief Frame reservation and priority of a table.
+ * @details The frames are split into the shards the same way as the buffer
+ * pool.
+ */
+typedef struct BufferQuota {
+    /// @brief number of frames the table keeps even if other tables need
+    /// them.
+    int min_frames;
+    /// @brief maximum number of frames of the table. <code>0</code> if
+    /// unlimited.
+    int max_frames;
+    /// @brief eviction priority class.
+    BufferPriority priority;
+} BufferQuota;
+
+/// @brief Quota of a table which is not configured.
+constexpr BufferQuota DEFAULT_BUFFER_QUOTA = {0, 0, NORMAL_PRIORITY};
+
+/// @brief Get the page location of a frame by its index.
+typedef std::function<const PageLocation&(int)> PageLocator;
+
+/**
+ * @class   ReplacementPolicy
+ * @brief   Page replacement policy of a buffer shard.
+ * @details Every policy tracks the frames which hold a page. A frame enters the
+ * policy with <code>on_load()</code>, and leaves it with
+ * <code>on_evict()</code>. Empty frames are not tracked by policies. All the
+ * methods are called with the shard mutex held.
+ *
+ * Policies are scan resistant: a newly loaded page is not protected until its
+ * second access, so that pages touched once by a scan are evicted before the
+ * hot pages. Scans may also flag their accesses with <code>SCAN_ACCESS</code>,
+ * which never promotes a page.
+ */
+class ReplacementPolicy {
+   protected:
+    /// @brief page locations of the shard frames.
+    PageLocator page_location_of;
+    /// @brief number of frames.
+    int size;
+
+   public:
+    ReplacementPolicy(const PageLocator& page_location_of, int size)
+        : page_location_of(page_location_of), size(size) {}
+    virtual ~ReplacementPolicy() {}
+
+    /**
+     * @brief Change the number of frames.
+     * @details When the shard shrinks, frames beyond the new size should not
+     * be tracked anymore.
+     *
+     * @param new_size  new number of frames.
+     */
+    virtual void resize(int new_size) { size = new_size; }
+    /**
+     * @brief Track a frame which is newly loaded.
+     *
+     * @param frame_idx frame index.
+     * @param hint      kind of the access which loads the frame.
+     */
+    virtual void on_load(int frame_idx, AccessHint hint = NORMAL_ACCESS) = 0;
+    /**
+     * @brief Record an access to a tracked frame.
+     * @details Scan accesses are ignored.
+     *
+     * @param frame_idx frame index.
+     * @param hint      kind of the access.
+     */
+    virtual void on_hit(int frame_idx, AccessHint hint = NORMAL_ACCESS) = 0;
+    /**
+     * @brief Stop tracking a frame.
+     * @details Called before the frame's page location is overwritten, so
+     * policies can still look at the evicted page.
+     *
+     * @param frame_idx frame index.
+     */
+    virtual void on_evict(int frame_idx) = 0;
+    /**
+     * @brief Choose a victim frame.
+     * @details Visits tracked frames from the coldest one, and returns the
+     * first frame which satisfies <code>evictable</code>. At most
+     * <code>scan_limit</code> candidates are visited.
+     *
+     * @param evictable     victim condition.
+     * @param scan_limit    maximum number of visited candidates.
+     * @return victim frame index if found, <code>-1</code> otherwise.
+     */
+    virtual int victim(const std::function<bool(int)>& evictable,
+                       int scan_limit) = 0;
+    /**
+     * @brief Visit the coldest frames.
+     * @details Frames are visited from the coldest one, roughly in the order
+     * <code>victim()</code> would choose them, but no policy state is changed.
+     *
+     * @param visitor       called with each visited frame index.
+     * @param visit_limit   maximum number of visited frames.
+     */
+    virtual void visit_coldest(const std::function<void(int)>& visitor,
+                               int visit_limit) = 0;
+};
+
+/**
+ * @class   FrameList
+ * @brief   Intrusive doubly linked list of frame indexes.
+ * @details Each frame can be linked into at most one list sharing the same
+ * link arrays.
+ */
+struct FrameList {
+    /// @brief head(most recent) frame index. <code>-1</code> if empty.
+    int head = -1;
+    /// @brief tail(least recent) frame index. <code>-1</code> if empty.
+    int tail = -1;
+    /// @brief number of linked frames.
+    int size = 0;
+};
+
+namespace policy_helper {
+/**
+ * @brief Push a frame into the head of the list.
+ *
+ * @param list      frame list.
+ * @param prev      previous links.
+ * @param next      next links.
+ * @param frame_idx frame index.
+ */
+void push_head(FrameList& list, std::vector<int>& prev, std::vector<int>& next,
+               int frame_idx);
+/**
+ * @brief Push a frame into the tail of the list.
+ *
+ * @param list      frame list.
+ * @param prev      previous links.
+ * @param next      next links.
+ * @param frame_idx frame index.
+ */
+void push_tail(FrameList& list, std::vector<int>& prev, std::vector<int>& next,
+               int frame_idx);
+/**
+ * @brief Unlink a frame from the list.
+ *
+ * @param list      frame list.
+ * @param prev      previous links.
+ * @param next      next links.
+ * @param frame_idx frame index.
+ */
+void unlink(FrameList& list, std::vector<int>& prev, std::vector<int>& next,
+            int frame_idx);
+/**
+ * @brief Find a victim from the tail of the list.
+ *
+ * @param list          frame list.
+ * @param prev          previous links.
+ * @param evictable     victim condition.
+ * @param scan_limit    maximum number of visited candidates.
+ * @return victim frame index if found, <code>-1</code> otherwise.
+ */
+int find_from_tail(const FrameList& list, const std::vector<int>& prev,
+                   const std::function<bool(int)>& evictable, int scan_limit);
+/**
+ * @brief Visit frames from the tail of the list.
+ *
+ * @param list          frame list.
+ * @param prev          previous links.
+ * @param visitor       called with each visited frame index.
+ * @param visit_limit   maximum number of visited frames.
+ * @return number of visited frames.
+ */
+int visit_from_tail(const FrameList& list, const std::vector<int>& prev,
+                    const std::function<void(int)>& visitor, int visit_limit);
+}  // namespace policy_helper
+
+/**
+ * @class   LRUPolicy
+ * @brief   Least-Recently-Used policy with midpoint insertion.
+ * @details The Recently-Used list is split into the probation list and the
+ * protected list. A loaded frame enters the head of the probation list, which
+ * is the midpoint of the whole list, and moves to the head of the protected
+ * list on a hit. If the protected list exceeds
+ * <code>LRU_PROTECTED_SHARE</code> of the frames, its tail is demoted to the
+ * head of the probation list. Victims are taken from the probation list
+ * first.
+ */
+class LRUPolicy : public ReplacementPolicy {
+   private:
+    /// @brief probation list.
+    FrameList probation;
+    /// @brief protected list.
+    FrameList protected_list;
+    /// @brief previous frame index of the lists.
+    std::vector<int> prev;
+    /// @brief next frame index of the lists.
+    std::vector<int> next;
+    /// @brief <code>true</code> if the frame is in the protected list.
+    std::vector<bool> is_protected;
+    /// @brief maximum size of the protected list.
+    int protected_limit;
+
+   public:
+    LRUPolicy(const PageLocator& page_location_of, int size);
+    void resize(int new_size) override;
+    void on_load(int frame_idx, AccessHint hint) override;
+    void on_hit(int frame_idx, AccessHint hint) override;
+    void on_evict(int frame_idx) override;
+    int victim(const std::function<bool(int)>& evictable,
+               int scan_limit) override;
+    void visit_coldest(const std::function<void(int)>& visitor,
+                       int visit_limit) override;
+};
+
+/**
+ * @class   ClockPolicy
+ * @brief   CLOCK(second chance) policy.
+ * @details A hit only sets the reference bit of the frame. The clock hand
+ * clears reference bits while it looks for a victim. A loaded frame starts
+ * without the reference bit, so it gets a second chance only if it is hit.
+ * Frames loaded by scans are kept out of the clock in a FIFO probation list,
+ * which is searched for a victim first, until they are hit.
+ */
+class ClockPolicy : public ReplacementPolicy {
+   private:
+    /// @brief reference bit of each frame.
+    std::vector<bool> referenced;
+    /// @brief <code>true</code> if the frame is tracked.
+    std::vector<bool> tracked;
+    /// @brief clock hand.
+    int hand;
+    /// @brief probation list of frames loaded by scans.
+    FrameList probation;
+    /// @brief previous frame index of the probation list.
+    std::vector<int> prev;
+    /// @brief next frame index of the probation list.
+    std::vector<int> next;
+    /// @brief <code>true</code> if the frame is in the probation list.
+    std::vector<bool> on_probation;
+
+   public:
+    ClockPolicy(const PageLocator& page_location_of, int size);
+    void resize(int new_size) override;
+    void on_load(int frame_idx, AccessHint hint) override;
+    void on_hit(int frame_idx, AccessHint hint) override;
+    void on_evict(int frame_idx) override;
+    int victim(const std::function<bool(int)>& evictable,
+               int scan_limit) override;
+    void visit_coldest(const std::function<void(int)>& visitor,
+                       int visit_limit) override;
+};
+
+/**
+ * @class   LRUKPolicy
+ * @brief   LRU-K policy.
+ * @details Evicts the frame whose K-th most recent access is the oldest.
+ * Frames with less than K accesses are evicted first, in LRU order. Frames
+ * loaded by scans are regarded as accessed before any other frame.
+ */
+class LRUKPolicy : public ReplacementPolicy {
+   private:
+    /// @brief K.
+    int k;
+    /// @brief logical access clock.
+    uint64_t now;
+    /// @brief last K access times of each frame, most recent first.
+    std::vector<std::vector<uint64_t>> history;
+    /// @brief <code>true</code> if the frame is tracked.
+    std::vector<bool> tracked;
+    /// @brief victim candidates, reused to avoid allocation on eviction.
+    std::vector<std::pair<std::pair<uint64_t, uint64_t>, int>> candidates;
+
+    /**
+     * @brief Sort the coldest candidates to the front.
+     *
+     * @param count maximum number of sorted candidates.
+     * @return number of sorted candidates.
+     */
+    int sort_candidates(int count);
+
+   public:
+    LRUKPolicy(const PageLocator& page_location_of, int size, int k = 2);
+    void resize(int new_size) override;
+    void on_load(int frame_idx, AccessHint hint) override;
+    void on_hit(int frame_idx, AccessHint hint) override;
+    void on_evict(int frame_idx) override;
+    int victim(const std::function<bool(int)>& evictable,
+               int scan_limit) override;
+    void visit_coldest(const std::function<void(int)>& visitor,
+                       int visit_limit) override;
+};
+
+/**
+ * @class   TwoQueuePolicy
+ * @brief   2Q policy.
+ * @details Newly loaded pages enter the FIFO <code>A1in</code> queue, and are
+ * remembered in the ghost <code>A1out</code> queue when evicted from it. Only
+ * pages which are loaded again while remembered enter the LRU
+ * <code>Am</code> queue. Pages loaded by scans enter the tail of
+ * <code>A1in</code>, and are not remembered unless they are hit.
+ */
+class TwoQueuePolicy : public ReplacementPolicy {
+   private:
+    /// @brief <code>A1in</code> FIFO queue.
+    FrameList a1in;
+    /// @brief <code>Am</code> LRU queue.
+    FrameList am;
+    /// @brief previous frame index of queues.
+    std::vector<int> prev;
+    /// @brief next frame index of queues.
+    std::vector<int> next;
+    /// @brief <code>true</code> if the frame is in <code>Am</code>.
+    std::vector<bool> in_am;
+    /// @brief <code>true</code> if the frame is loaded by a scan and not hit
+    /// yet.
+    std::vector<bool> scanned;
+
+    /// @brief ghost <code>A1out</code> queue, most recent first.
+    std::list<PageLocation> a1out;
+    /// @brief ghost queue index.
+    std::unordered_map<PageLocation, std::list<PageLocation>::iterator>
+        a1out_index;
+
+    /// @brief target size of <code>A1in</code>.
+    int kin;
+    /// @brief maximum size of <code>A1out</code>.
+    int kout;
+
+   public:
+    TwoQueuePolicy(const PageLocator& page_location_of, int size);
+    void resize(int new_size) override;
+    void on_load(int frame_idx, AccessHint hint) override;
+    void on_hit(int frame_idx, AccessHint hint) override;
+    void on_evict(int frame_idx) override;
+    int victim(const std::function<bool(int)>& evictable,
+               int scan_limit) override;
+    void visit_coldest(const std::function<void(int)>& visitor,
+                       int visit_limit) override;
+};
+
+/**
+ * @brief Create a replacement policy.
+ *
+ * @param type                policy type.
+ * @param page_location_of    page locations of the shard frames.
+ * @param size                number of frames.
+ * @return created policy, <code>nullptr</code> if type is invalid.
+ */
+ReplacementPolicy* make_replacement_policy(ReplacementPolicyType type,
+                                           const PageLocator& page_location_of,
+                                           int size);
+/** @}*/
@@ -0,0 +1,432 @@
+/**
+ * @addtogroup DiskSpaceManager
+ * @{
+ */
+#pragma once
+
+#include <const.h>
+#include <page.h>
+#include <pthread.h>
+#include <types.h>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief   Level of the tree a page is allocated for.
+ */
+enum PageLevel {
+    /// @brief leaf page.
+    LEAF_LEVEL = 0,
+    /// @brief internal page.
+    INTERNAL_LEVEL = 1,
+    /// @brief number of levels.
+    PAGE_LEVEL_COUNT
+};
+
+/**
+ * @class   SpaceExtent
+ * @brief   Run of consecutive pages reserved for a tree level.
+ */
+typedef struct SpaceExtent {
+    /// @brief next page to allocate.
+    pagenum_t next;
+    /// @brief end of the run, exclusive.
+    pagenum_t end;
+} SpaceExtent;
+
+/**
+ * @brief   Function which writes a page of a table.
+ * @details <code>file_write_page()</code> and
+ * <code>buffered_write_page()</code>.
+ */
+typedef void (*SpacePageWriter)(tableid_t table_id, pagenum_t pagenum,
+                                const page_t* src);
+/**
+ * @brief   Function which writes the free space fields of a header page.
+ */
+typedef void (*SpaceHeaderWriter)(tableid_t table_id, pagenum_t free_page_idx,
+                                  pagenum_t unformatted_page_idx,
+                                  pagenum_t page_num,
+                                  const std::vector<PageRun>& holes);
+
+/**
+ * @class   CompactionStats
+ * @brief   Result of a table compaction.
+ */
+typedef struct CompactionStats {
+    /// @brief number of tree pages moved toward the front of the file.
+    uint64_t moved_pages;
+    /// @brief number of pages cut from the end of the file.
+    uint64_t truncated_pages;
+    /// @brief number of free pages punched out of the file.
+    uint64_t punched_pages;
+} CompactionStats;
+
+/**
+ * @class   TableSpace
+ * @brief   In-memory free space of a table file.
+ * @details The free pages are kept in the order of the on-disk free page
+ * list, so that it is still LIFO. The list on disk is updated lazily, and
+ * only the pages pushed since the last persist are linked again, since the
+ * links of the pages below them are not changed by pushes and pops. Pages
+ * reserved by growing the file are never formatted: they are allocated from
+ * the unformatted tail of the file, lowest first, once the list is empty.
+ *
+ * A page can be taken from the middle of the list for an extent. It is left
+ * in place as a tombstone, which pops skip, until the list is compacted by a
+ * persist.
+ *
+ * Free pages punched out of the file lie at the bottom of the list. They are
+ * recorded as runs in the header page instead of being linked, since a
+ * punched page reads as zeros.
+ */
+typedef struct TableSpace {
+    /// @brief total count of the reserved pages.
+    pagenum_t page_num;
+    /// @brief first page of the unformatted tail, or <code>page_num</code>
+    /// if there is none.
+    pagenum_t unformatted_page_idx;
+    /// @brief free pages, the first free page last.
+    std::vector<pagenum_t> free_pages;
+    /// @brief one bit per page, set if the page is in
+    /// <code>free_pages</code> and not a tombstone.
+    std::vector<uint64_t> free_bits;
+    /// @brief one bit per page, set if the page is in
+    /// <code>free_pages</code>, including tombstones.
+    std::vector<uint64_t> listed_bits;
+    /// @brief number of tombstones in <code>free_pages</code>.
+    size_t tombstone_count;
+    /// @brief bitmap word to search a free extent from.
+    size_t extent_search_idx;
+    /// @brief number of free pages from the bottom, whose links on disk are
+    /// up to date.
+    size_t persisted_count;
+    /// @brief number of free pages from the bottom, which are punched and
+    /// not linked. Bounded by <code>persisted_count</code> on a persist.
+    size_t hole_count;
+    /// @brief <code>true</code> if the header page on disk is out of date.
+    bool is_dirty;
+
+    /// @brief mutex which protects every field above.
+    pthread_mutex_t mutex;
+    /// @brief serializes persists, so that header pages are written in
+    /// order.
+    pthread_mutex_t persist_mutex;
+} TableSpace;
+
+/**
+ * @class   ThreadSpaceCache
+ * @brief   Free pages cached by a thread.
+ * @details A thread allocates and frees pages of its cache without the table
+ * space mutex. The owner thread takes the cache mutex uncontended, unless the
+ * caches are drained by a persist meanwhile. The caches are registered while
+ * the thread runs, and given back to the tables when it exits. Each thread
+ * also reserves an extent of each tree level, so that the pages a thread
+ * allocates for a level are physically consecutive.
+ */
+class ThreadSpaceCache {
+   public:
+    /// @brief cached free pages of each table, the most recently freed last.
+    std::vector<std::vector<pagenum_t>> pages;
+    /// @brief extents of each table and level.
+    std::vector<std::array<SpaceExtent, PAGE_LEVEL_COUNT>> extents;
+    /// @brief mutex which protects the pages.
+    pthread_mutex_t mutex;
+
+    ThreadSpaceCache();
+    ~ThreadSpaceCache();
+};
+
+/**
+ * @brief   Space manager helper
+ * @details This namespace includes the in-memory free space of table files,
+ * which replaces header page round trips on every allocation.
+ */
+namespace space_helper {
+/**
+ * @brief Get the free space of a table.
+ *
+ * @param table_id  table id.
+ * @return table space.
+ */
+TableSpace& get_space(tableid_t table_id);
+/**
+ * @brief   Load the free space of a table file.
+ * @details Walks the on-disk free page list once, and puts the punched runs
+ * below it. A list which loops or points out of the file is cut there, and
+ * runs which do not fit in the file are ignored.
+ *
+ * @param table_fd      table file descriptor.
+ * @param header_page   header page of the file.
+ * @return table space.
+ */
+TableSpace* load_space(int table_fd, const headerpage_t& header_page);
+/**
+ * @brief Free a table space.
+ *
+ * @param space table space.
+ */
+void destroy_space(TableSpace* space);
+/**
+ * @brief Get the cache of the calling thread.
+ *
+ * @return thread cache.
+ */
+ThreadSpaceCache& get_thread_cache();
+/**
+ * @brief   Reserve pages so that the table has <code>newsize</code> pages.
+ * @details The file is extended with <code>fallocate</code>, or by writing
+ * its last page if the file system does not support it. The new pages join
+ * the unformatted tail, so growing costs a single call whatever the size is.
+ * Caller should hold the space mutex.
+ *
+ * @param table_id  table id.
+ * @param space     table space.
+ * @param newsize   new page count, larger than the current one.
+ */
+void grow_space(tableid_t table_id, TableSpace& space, pagenum_t newsize);
+/**
+ * @brief   Pop a free page, growing the file twice if there is none.
+ * @details The free page list is popped first, and the unformatted tail
+ * next. Caller should hold the space mutex.
+ *
+ * @param table_id  table id.
+ * @param space     table space.
+ * @return page index.
+ */
+pagenum_t pop_free_page(tableid_t table_id, TableSpace& space);
+/**
+ * @brief   Check if a page is in the free page list.
+ * @details Caller should hold the space mutex.
+ *
+ * @param space     table space.
+ * @param pagenum   page index.
+ * @return <code>true</code> if free.
+ */
+bool is_listed_free(const TableSpace& space, pagenum_t pagenum);
+/**
+ * @brief   Take a page out of the middle of the free page list.
+ * @details The page is left as a tombstone. Caller should hold the space
+ * mutex.
+ *
+ * @param space     table space.
+ * @param pagenum   free page index.
+ */
+void take_listed_page(TableSpace& space, pagenum_t pagenum);
+/**
+ * @brief   Remove the tombstones of the free page list.
+ * @details The links of the pages above the first tombstone are written again
+ * by the next persist. Caller should hold the space mutex.
+ *
+ * @param space     table space.
+ */
+void compact_free_pages(TableSpace& space);
+/**
+ * @brief   Find the lowest free page of the list below a page.
+ * @details Caller should hold the space mutex.
+ *
+ * @param space     table space.
+ * @param end       page index to search below.
+ * @return free page index, or <code>0</code> if there is none.
+ */
+pagenum_t find_free_page_below(const TableSpace& space, pagenum_t end);
+/**
+ * @brief   Get the end of the pages in use.
+ * @details Pages cached by threads count as in use, so drain them first.
+ * Caller should hold the space mutex.
+ *
+ * @param space     table space.
+ * @return one past the highest page which is not free.
+ */
+pagenum_t get_used_page_end(const TableSpace& space);
+/**
+ * @brief   Cut the free pages at the end of a table.
+ * @details The free pages from <code>newsize</code> are dropped from the list
+ * and from the unformatted tail. The file is not truncated until
+ * <code>release_file_pages()</code>. Caller should hold the space mutex.
+ *
+ * @param space     table space.
+ * @param newsize   new page count, not below <code>get_used_page_end()</code>.
+ */
+void shrink_space(TableSpace& space, pagenum_t newsize);
+/**
+ * @brief   Punch the aligned extents of the free page list.
+ * @details Extents of free pages which are not punched yet are moved to the
+ * bottom of the list along with the older holes, and the pages above them are
+ * linked again by the next persist. Punching stops once the holes would take
+ * more than <code>MAX_HEADER_HOLES</code> runs. The file is not punched until
+ * <code>release_file_pages()</code>. Caller should hold the space mutex.
+ *
+ * @param space     table space.
+ * @return the newly punched runs.
+ */
+std::vector<PageRun> punch_free_pages(TableSpace& space);
+/**
+ * @brief   Give pages back to the file system.
+ * @details The file is truncated to <code>newsize</code> pages, and the runs
+ * are punched with <code>FALLOC_FL_PUNCH_HOLE</code>. A file system which can
+ * not punch holes keeps the pages, which are still free. Call it only after
+ * the header page which records them is written.
+ *
+ * @param table_id  table id.
+ * @param newsize   new page count.
+ * @param holes     runs to punch.
+ */
+void release_file_pages(tableid_t table_id, pagenum_t newsize,
+                        const std::vector<PageRun>& holes);
+/**
+ * @brief   Reserve an extent of <code>SPACE_EXTENT_SIZE</code> pages.
+ * @details An aligned run of free pages in the list is taken first, and the
+ * unformatted tail next. The file is grown only if there is no free page at
+ * all. Caller should hold the space mutex.
+ *
+ * @param       table_id    table id.
+ * @param       space       table space.
+ * @param[out]  extent      reserved extent.
+ * @return <code>true</code> if reserved, <code>false</code> if only scattered
+ * free pages are left.
+ */
+bool reserve_extent(tableid_t table_id, TableSpace& space,
+                    SpaceExtent* extent);
+/**
+ * @brief   Give the unused pages of an extent back.
+ * @details The pages go back to the unformatted tail if the extent ends at
+ * it, and to the free page list otherwise. Caller should hold the space
+ * mutex.
+ *
+ * @param space     table space.
+ * @param extent    extent, which is emptied.
+ */
+void release_extent(TableSpace& space, SpaceExtent* extent);
+/**
+ * @brief   Take free pages into the cache of a thread.
+ * @details Up to <code>SPACE_CACHE_BATCH</code> pages are taken from the top
+ * of the free page list as they are, or from the unformatted tail, so that
+ * the cache pops them in the order <code>pop_free_page()</code> would.
+ * Caller should hold the space mutex.
+ *
+ * @param       table_id    table id.
+ * @param       space       table space.
+ * @param[out]  pages       empty cache of the table.
+ */
+void refill_cache(tableid_t table_id, TableSpace& space,
+                  std::vector<pagenum_t>& pages);
+/**
+ * @brief   Push a free page.
+ * @details Caller should hold the space mutex.
+ *
+ * @param space     table space.
+ * @param pagenum   page index.
+ */
+void push_free_page(TableSpace& space, pagenum_t pagenum);
+/**
+ * @brief   Give the pages cached by every thread back to a table.
+ * @details Pages are pushed in the order they were freed, so the order of
+ * allocations is still LIFO. Extents are kept at a checkpoint, so that they
+ * stay consecutive, and given back when the table is closed.
+ *
+ * @param table_id      table id.
+ * @param with_extents  <code>true</code> to give back the extents too.
+ */
+void drain_caches(tableid_t table_id, bool with_extents = false);
+/**
+ * @brief Write the header page of a table file directly.
+ *
+ * @param table_id              table id.
+ * @param free_page_idx         first free page index.
+ * @param unformatted_page_idx  first unformatted page index.
+ * @param page_num              total count of the reserved pages.
+ * @param holes                 punched runs of free pages.
+ */
+void write_file_header(tableid_t table_id, pagenum_t free_page_idx,
+                       pagenum_t unformatted_page_idx, pagenum_t page_num,
+                       const std::vector<PageRun>& holes);
+/**
+ * @brief Set the free space fields of a header page.
+ *
+ * @param[out]  header_page             header page.
+ * @param       free_page_idx           first free page index.
+ * @param       unformatted_page_idx    first unformatted page index.
+ * @param       page_num                total count of the reserved pages.
+ * @param       holes                   punched runs of free pages.
+ */
+void set_header_fields(headerpage_t* header_page, pagenum_t free_page_idx,
+                       pagenum_t unformatted_page_idx, pagenum_t page_num,
+                       const std::vector<PageRun>& holes);
+}  // namespace space_helper
+
+/**
+ * @brief   Allocate a page from the free space of a table.
+ * @details The page is popped from the cache of the calling thread, which is
+ * refilled with <code>SPACE_CACHE_BATCH</code> pages at a time. Neither the
+ * header page nor the allocated page is accessed.
+ *
+ * @param table_id  table id.
+ * @return page index.
+ */
+pagenum_t space_alloc_page(tableid_t table_id);
+
+/**
+ * @brief   Allocate a page for a tree level, close to another page.
+ * @details The page right after <code>near_page_idx</code> is taken if it is
+ * free, so that a page split from it follows it on disk. Otherwise, the page
+ * is taken from the extent of the level of the calling thread, which is
+ * refilled with <code>SPACE_EXTENT_SIZE</code> consecutive pages. Scattered
+ * free pages are used only if no extent is left, instead of growing the
+ * file.
+ *
+ * @param table_id      table id.
+ * @param level         tree level of the page.
+ * @param near_page_idx page to place the new page after, or <code>0</code>.
+ * @return page index.
+ */
+pagenum_t space_alloc_page_near(tableid_t table_id, PageLevel level,
+                                pagenum_t near_page_idx);
+
+/**
+ * @brief   Allocate the lowest free page of a table below a page.
+ * @details The page is taken out of the free page list as a tombstone. Pages
+ * cached by threads are not taken, and the file never grows.
+ *
+ * @param table_id  table id.
+ * @param end       page index to allocate below.
+ * @return page index, or <code>0</code> if there is no free page below
+ * <code>end</code>.
+ */
+pagenum_t space_alloc_page_below(tableid_t table_id, pagenum_t end);
+
+/**
+ * @brief   Free a page into the free space of a table.
+ * @details The page is pushed into the cache of the calling thread. A cache
+ * over <code>SPACE_CACHE_CAPACITY</code> pages gives its older half back to
+ * the table. The page itself is not written until the space is persisted.
+ *
+ * @param table_id  table id.
+ * @param pagenum   page index.
+ */
+void space_free_page(tableid_t table_id, pagenum_t pagenum);
+
+/**
+ * @brief   Get the total count of the reserved pages of a table.
+ *
+ * @param table_id  table id.
+ * @return page count.
+ */
+pagenum_t space_get_page_count(tableid_t table_id);
+
+/**
+ * @brief   Write the free space of a table into the table file.
+ * @details The free pages pushed since the last persist are linked with
+ * <code>write_page</code>, and the header page is updated with
+ * <code>write_header</code> if needed. Pages cached by threads are not
+ * written; drain them first to persist them as free.
+ *
+ * @param table_id      table id.
+ * @param write_page    page writer.
+ * @param write_header  header page writer.
+ */
+void persist_table_space(tableid_t table_id, SpacePageWriter write_page,
+                         SpaceHeaderWriter write_header);
+/** @}*/
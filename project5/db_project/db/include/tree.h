@@ -4,24 +4,64 @@
  */
 #pragma once
 
+#include <policy.h>
+#include <space.h>
 #include <types.h>
 
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+/**
+ * @class   LeafFragmentation
+ * @brief   Physical order of the leaf pages of a tree.
+ * @details A range scan reads the leaves in key order, so it reads the file
+ * sequentially only if each leaf is followed by its right sibling on disk.
+ */
+typedef struct LeafFragmentation {
+    /// @brief number of leaf pages.
+    uint64_t leaf_count;
+    /// @brief number of leaves whose right sibling is the next page.
+    uint64_t sequential_links;
+    /// @brief number of leaves whose right sibling is after them.
+    uint64_t forward_links;
+    /// @brief sum of the distances(in pages) between the siblings.
+    uint64_t total_distance;
+} LeafFragmentation;
+
+/**
+ * @class   TreePageLinks
+ * @brief   Pages which point to a tree page.
+ */
+typedef struct TreePageLinks {
+    /// @brief parent page index, or <code>0</code> for the root.
+    pagenum_t parent_page_idx;
+    /// @brief left sibling index of a leaf, or <code>0</code>.
+    pagenum_t left_page_idx;
+} TreePageLinks;
+
 /**
  * @brief Allocate and make a leaf page.
  *
  * @param table_id          table id.
  * @param parent_page_idx   parent page index.
+ * @param near_page_idx     page to place the new page after, or
+ *                          <code>0</code>.
  * @returns                 created page index.
  */
-pagenum_t make_leaf(tableid_t table_id, pagenum_t parent_page_idx = 0);
+pagenum_t make_leaf(tableid_t table_id, pagenum_t parent_page_idx = 0,
+                    pagenum_t near_page_idx = 0);
 /**
  * @brief Allocate and make an internal page.
  *
  * @param table_id          table id.
  * @param parent_page_idx   parent page index.
+ * @param near_page_idx     page to place the new page after, or
+ *                          <code>0</code>.
  * @returns                 created page index.
  */
-pagenum_t make_node(tableid_t table_id, pagenum_t parent_page_idx = 0);
+pagenum_t make_node(tableid_t table_id, pagenum_t parent_page_idx = 0,
+                    pagenum_t near_page_idx = 0);
 
 /**
  * @brief Create a new tree.
@@ -36,8 +76,26 @@ pagenum_t make_node(tableid_t table_id, pagenum_t parent_page_idx = 0);
 pagenum_t create_tree(tableid_t table_id, recordkey_t key, const char* value,
                       valsize_t value_size);
 
+/**
+ * @brief Descend the tree without latches.
+ * @details Pages are read from their frames without pins or latches. Each page
+ * is validated with its frame version after its child is found, and again
+ * after the version of the child is read, so that a page modified meanwhile
+ * restarts the descent. It stops at the first page which is not buffered.
+ *
+ * @param table_id          table id.
+ * @param key               key to query with.
+ * @param[out] page_idx     leaf page index, or <code>0</code> if the tree is
+ * empty, when the leaf is found. Otherwise, the page to continue the descent
+ * from with latches, or <code>0</code> to descend from the root.
+ * @returns                 <code>true</code> if the leaf is found.
+ */
+bool find_leaf_optimistic(tableid_t table_id, recordkey_t key,
+                          pagenum_t* page_idx);
 /**
  * @brief Find a leaf node which contains given key.
+ * @details The descent is optimistic first, and latches shared pages from
+ * where the optimistic one stopped.
  *
  * @param table_id          table id.
  * @param key               key to query with.
@@ -62,6 +120,79 @@ pagenum_t find_leaf(tableid_t table_id, recordkey_t key, trxid_t trx_id = 0);
  */
 bool find_by_key(tableid_t table_id, recordkey_t key, char* value = nullptr,
                  valsize_t* value_size = nullptr, trxid_t trx_id = 0);
+/**
+ * @brief Visit records in a key range in key order.
+ * @details Walks the leaf sibling chain from the leaf which contains
+ * <code>begin_key</code>. Every leaf access is reported to the buffer manager,
+ * so that following leaves can be read ahead. The value pointer given to the
+ * visitor is valid only during the call.
+ *
+ * @param table_id          table id.
+ * @param begin_key         smallest key of the range.
+ * @param end_key           largest key of the range.
+ * @param visitor           called with each record key, value and value size.
+ * Returning <code>false</code> stops the scan.
+ * @param hint              kind of the leaf accesses.
+ * @returns                 number of visited records.
+ */
+int find_range(
+    tableid_t table_id, recordkey_t begin_key, recordkey_t end_key,
+    const std::function<bool(recordkey_t, const char*, valsize_t)>& visitor,
+    AccessHint hint = SCAN_ACCESS);
+
+/**
+ * @brief Measure the physical order of the leaves.
+ * @details The leaves are walked from the leftmost one with shared latches.
+ *
+ * @param table_id          table id.
+ * @returns                 fragmentation of the leaves.
+ */
+LeafFragmentation get_leaf_fragmentation(tableid_t table_id);
+
+/**
+ * @brief Map each page of the tree to the pages which point to it.
+ * @details The tree is walked level by level with shared latches, so that the
+ * leaves are visited in key order.
+ *
+ * @param table_id          table id.
+ * @returns                 links of every tree page.
+ */
+std::unordered_map<pagenum_t, TreePageLinks> map_tree_links(
+    tableid_t table_id);
+/**
+ * @brief Move a tree page to a free page.
+ * @details The parent, the page and the new page are latched in this order,
+ * like a descent. The page is copied, and the pointer of the parent or the
+ * root of the header page is switched to the copy. Then the children get the
+ * new parent, or the left sibling of a leaf gets the new link. The old page
+ * is freed, and left as it is for the readers which reached it. Nothing is
+ * modified if the parent or the left sibling does not point to the page.
+ *
+ * @param table_id          table id.
+ * @param page_idx          tree page index.
+ * @param new_page_idx      allocated page index.
+ * @param links             links of every tree page, which are updated.
+ * @returns                 <code>0</code> if success, <code>-1</code> if the
+ * links are stale.
+ */
+int relocate_page(tableid_t table_id, pagenum_t page_idx,
+                  pagenum_t new_page_idx,
+                  std::unordered_map<pagenum_t, TreePageLinks>& links);
+/**
+ * @brief Move the tree pages toward the front of the file.
+ * @details The tree pages beyond the size the tree would fill, up to
+ * <code>max_moves</code> of the highest ones, are moved to the lowest free
+ * pages in page order, so that sequential leaves stay sequential.
+ *
+ * @param table_id          table id.
+ * @param max_moves         maximum number of pages to move, negative for no
+ * limit.
+ * @param[out] stats        compaction result, which is added to.
+ * @returns                 <code>0</code> if success, <code>-1</code>
+ * otherwise.
+ */
+int move_tree_pages(tableid_t table_id, int max_moves,
+                    CompactionStats* stats);
 
 /**
  * @brief Insert a <code>(key, right_page_idx)</code> tuple in parent page.
@@ -0,0 +1,160 @@
+/**
+ * @addtogroup DiskSpaceManager
+ * @{
+ */
+#pragma once
+
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class   IoUringBatch
+ * @brief   Completion state of a batch of submitted requests.
+ * @details The submitter waits on <code>cond</code> until every request of
+ * the batch is completed by the reaper thread.
+ */
+typedef struct IoUringBatch {
+    /// @brief number of requests which are not completed yet.
+    int pending;
+    /// @brief number of requests which did not transfer the whole buffer.
+    int failed;
+    /// @brief protects <code>pending</code> and <code>failed</code>.
+    pthread_mutex_t mutex;
+    /// @brief signaled when <code>pending</code> becomes 0.
+    pthread_cond_t cond;
+} IoUringBatch;
+
+/**
+ * @class   IoUringRequest
+ * @brief   A read or write request.
+ */
+typedef struct IoUringRequest {
+    /// @brief byte offset in the file.
+    uint64_t offset;
+    /// @brief data buffer.
+    void* buffer;
+    /// @brief number of bytes to transfer.
+    size_t length;
+    /// @brief <code>true</code> if the buffer is written to the file.
+    bool is_write;
+    /// @brief io vector, which should live until the request is completed.
+    iovec io_vector;
+    /// @brief batch which the request belongs to.
+    IoUringBatch* batch;
+} IoUringRequest;
+
+/**
+ * @class   IoUring
+ * @brief   io_uring instance built on the raw system calls.
+ * @details Submissions are serialized with a mutex, and a reaper thread waits
+ * for completions and wakes up the submitters of completed batches. Reads and
+ * writes use <code>IORING_OP_READV</code>/<code>IORING_OP_WRITEV</code>, which
+ * are available since the first io_uring kernel.
+ */
+class IoUring {
+   private:
+    /// @brief io_uring file descriptor.
+    int ring_fd;
+
+    /// @brief mapped submission queue ring.
+    void* sq_ring;
+    /// @brief size of the mapped submission queue ring.
+    size_t sq_ring_size;
+    /// @brief mapped completion queue ring. Same as <code>sq_ring</code> if
+    /// the kernel maps both rings at once.
+    void* cq_ring;
+    /// @brief size of the mapped completion queue ring.
+    size_t cq_ring_size;
+    /// @brief mapped submission queue entries.
+    io_uring_sqe* sqes;
+    /// @brief size of the mapped submission queue entries.
+    size_t sqes_size;
+
+    /// @brief submission queue head, advanced by the kernel.
+    unsigned* sq_head;
+    /// @brief submission queue tail.
+    unsigned* sq_tail;
+    /// @brief submission queue index mask.
+    unsigned sq_mask;
+    /// @brief submission queue index array.
+    unsigned* sq_array;
+    /// @brief number of submission queue entries.
+    unsigned sq_entries;
+
+    /// @brief completion queue head.
+    unsigned* cq_head;
+    /// @brief completion queue tail, advanced by the kernel.
+    unsigned* cq_tail;
+    /// @brief completion queue index mask.
+    unsigned cq_mask;
+    /// @brief number of completion queue entries.
+    unsigned cq_entries;
+    /// @brief completion queue entries.
+    io_uring_cqe* cqes;
+
+    /// @brief number of submitted requests which are not reaped yet. It is
+    /// kept under <code>cq_entries</code> so that completions never overflow.
+    unsigned inflight;
+    /// @brief signaled when reaped requests make room for new ones.
+    pthread_cond_t inflight_cond;
+    /// @brief number of entries which are queued but not submitted yet.
+    unsigned queued;
+
+    /// @brief serializes submissions.
+    pthread_mutex_t submit_mutex;
+    /// @brief completion reaper thread.
+    pthread_t reaper_thread;
+
+    /**
+     * @brief Main loop of the reaper thread.
+     *
+     * @param arg   <code>IoUring*</code>.
+     * @return <code>nullptr</code>.
+     */
+    static void* reaper_main(void* arg);
+    /**
+     * @brief Get a free submission queue entry. Caller should hold the submit
+     * mutex.
+     * @details Queued entries are submitted first if the submission queue is
+     * full, and it waits for completions if too many requests are in flight.
+     *
+     * @return submission queue entry.
+     */
+    io_uring_sqe* get_sqe();
+    /**
+     * @brief Submit every queued entry. Caller should hold the submit mutex.
+     */
+    void flush_sqes();
+
+   public:
+    IoUring();
+    ~IoUring();
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    /**
+     * @brief Set up the ring and start the reaper thread.
+     *
+     * @param entries   number of submission queue entries.
+     * @return <code>0</code> if success, <code>-1</code> if io_uring is not
+     * available.
+     */
+    int init(unsigned entries);
+    /**
+     * @brief Submit a batch of requests and wait for all of them.
+     * @details Requests are submitted with as few system calls as the
+     * submission queue allows.
+     *
+     * @param fd        file descriptor.
+     * @param requests  requests.
+     * @param count     number of requests.
+     * @return <code>0</code> if every request transferred the whole buffer,
+     * <code>-1</code> otherwise.
+     */
+    int submit_and_wait(int fd, IoUringRequest* requests, int count);
+};
+/** @}*/
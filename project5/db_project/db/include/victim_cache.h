@@ -0,0 +1,187 @@
+/**
+ * @addtogroup BufferManager
+ * @{
+ */
+#pragma once
+
+#include <const.h>
+#include <page.h>
+#include <pthread.h>
+#include <types.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class   VictimCacheEntry
+ * @brief   Compressed copy of an evicted page.
+ */
+typedef struct VictimCacheEntry {
+    /// @brief page location.
+    PageLocation page_location;
+    /// @brief compressed page.
+    std::vector<uint8_t> data;
+} VictimCacheEntry;
+
+/**
+ * @class   VictimCacheStripe
+ * @brief   Independently latched partition of the victim cache.
+ * @details Every page location is mapped into exactly one stripe, which
+ * evicts its least recently stored entries to stay within its budget.
+ */
+typedef struct VictimCacheStripe {
+    /// @brief entries, most recently stored first.
+    std::list<VictimCacheEntry> entries;
+    /// @brief page location to entry map.
+    std::unordered_map<PageLocation, std::list<VictimCacheEntry>::iterator>
+        index;
+    /// @brief memory(in bytes) used by the entries.
+    size_t used_bytes;
+    /// @brief memory budget(in bytes) of this stripe. <code>0</code> while
+    /// the cache is disabled.
+    size_t budget_bytes;
+
+    /// @brief number of loads which found the page.
+    uint64_t hits;
+    /// @brief number of loads which did not find the page.
+    uint64_t misses;
+    /// @brief number of stored pages.
+    uint64_t stored_pages;
+    /// @brief number of pages which did not compress well enough.
+    uint64_t rejected_pages;
+    /// @brief number of entries evicted to stay within the budget.
+    uint64_t evicted_pages;
+
+    /// @brief stripe mutex which protects every field above.
+    pthread_mutex_t mutex;
+} VictimCacheStripe;
+
+/**
+ * @class   VictimCacheStats
+ * @brief   Statistics of the victim cache.
+ */
+typedef struct VictimCacheStats {
+    /// @brief number of buffer misses which found the page.
+    uint64_t hits;
+    /// @brief number of buffer misses which read the table file.
+    uint64_t misses;
+    /// @brief number of stored pages.
+    uint64_t stored_pages;
+    /// @brief number of pages which did not compress well enough.
+    uint64_t rejected_pages;
+    /// @brief number of entries evicted to stay within the budget.
+    uint64_t evicted_pages;
+    /// @brief number of cached pages.
+    uint64_t cached_pages;
+    /// @brief memory(in bytes) used by the cached pages.
+    uint64_t used_bytes;
+} VictimCacheStats;
+
+/**
+ * @brief   Victim cache helper
+ * @details This namespace includes the page codec and the operations of the
+ * compressed second-tier cache, which keeps pages evicted from the buffer
+ * pool. An entry is a clean copy of the page in the table file, and it is
+ * taken out of the cache when the page is loaded back, so that a page is never
+ * both buffered and cached.
+ */
+namespace victim_cache_helper {
+/**
+ * @brief   Compress a block.
+ * @details LZ77 with a single-probe hash table. A sequence is a token of the
+ * literal and match lengths, the literals, a 2-byte offset and the extra
+ * length bytes. The last sequence has no match.
+ *
+ * @param      src      source block.
+ * @param      size     size of the source block.
+ * @param[out] dst      compressed block.
+ * @param      capacity capacity of <code>dst</code>.
+ * @return compressed size, or <code>-1</code> if it does not fit in
+ * <code>capacity</code>.
+ */
+int compress(const uint8_t* src, int size, uint8_t* dst, int capacity);
+/**
+ * @brief   Decompress a block of <code>compress()</code>.
+ *
+ * @param      src      compressed block.
+ * @param      size     size of the compressed block.
+ * @param[out] dst      decompressed block.
+ * @param      capacity capacity of <code>dst</code>.
+ * @return decompressed size, or <code>-1</code> if the block is corrupted.
+ */
+int decompress(const uint8_t* src, int size, uint8_t* dst, int capacity);
+/**
+ * @brief Check if the victim cache is enabled.
+ *
+ * @return <code>true</code> if enabled.
+ */
+bool is_enabled();
+/**
+ * @brief Get the stripe of a page location.
+ *
+ * @param page_location page location.
+ * @return victim cache stripe.
+ */
+VictimCacheStripe& get_stripe(const PageLocation& page_location);
+/**
+ * @brief   Store an evicted page.
+ * @details The page should be clean. It is rejected if it does not compress
+ * into <code>MAX_COMPRESSED_PAGE_SIZE</code>.
+ *
+ * @param page_location page location.
+ * @param page          page content.
+ */
+void store_page(const PageLocation& page_location, const page_t* page);
+/**
+ * @brief   Take a page out of the cache.
+ *
+ * @param      page_location    page location.
+ * @param[out] dest             page content.
+ * @return <code>true</code> if the page was cached.
+ */
+bool take_page(const PageLocation& page_location, page_t* dest);
+/**
+ * @brief   Drop a page, since the table file is written without the buffer.
+ *
+ * @param page_location page location.
+ */
+void drop_page(const PageLocation& page_location);
+/**
+ * @brief   Drop every page of a table, since the table is closed.
+ *
+ * @param table_id  table id.
+ */
+void drop_table(tableid_t table_id);
+/**
+ * @brief   Evict the least recently stored entries of a stripe over its
+ * budget.
+ * @details Caller should hold the stripe mutex.
+ *
+ * @param stripe    victim cache stripe.
+ */
+void trim_stripe(VictimCacheStripe& stripe);
+}  // namespace victim_cache_helper
+
+/**
+ * @brief   Configure the compressed victim cache.
+ * @details Clean pages evicted from the buffer pool are compressed into the
+ * cache, and a buffer miss takes the page from it before reading the table
+ * file. It is disabled until configured, and
+ * <code>shutdown_buffer()</code> disables it.
+ *
+ * @param budget_bytes  memory budget(in bytes). <code>0</code> disables the
+ * cache and drops every entry.
+ * @return <code>0</code> if success, non-zero value otherwise.
+ */
+int set_victim_cache(size_t budget_bytes);
+
+/**
+ * @brief   Get the victim cache statistics.
+ *
+ * @return  statistics since the cache is enabled.
+ */
+VictimCacheStats get_victim_cache_stats();
+/** @}*/
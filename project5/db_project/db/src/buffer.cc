@@ -3,282 +3,2187 @@
  * @{
  */
 #include <buffer.h>
+#include <buffer_stats.h>
 #include <errors.h>
 #include <file.h>
+#include <fcntl.h>
 #include <pthread.h>
-
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <victim_cache.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
 #include <cstring>
-#include <iostream>
+#include <deque>
 #include <new>
 #include <unordered_map>
 #include <utility>
 
-/// @brief buffer slot.
-BufferBlock* buffer_slot = nullptr;
-/// @brief head index of Recently-Used list.
-int buffer_head_idx = -1;
-/// @brief tail index of Recently-Used list.
-int buffer_tail_idx = -1;
-/// @brief size of buffer block.
+/// @brief buffer shards.
+BufferShard* buffer_shards = nullptr;
+/// @brief number of buffer shards.
+int buffer_shard_count = 0;
+/// @brief total size of buffer block.
 int buffer_size = 0;
-
-std::unordered_map<PageLocation, int> buffer_index;
-
-pthread_mutex_t* buffer_manager_mutex;
+/// @brief <code>true</code> if frames are backed by huge pages.
+bool buffer_huge_pages = false;
+/// @brief serializes resizes of the buffer pool.
+pthread_mutex_t resize_mutex = PTHREAD_MUTEX_INITIALIZER;
+/// @brief number of frames the calling thread holds with guards or pins,
+/// including the pages it accesses without frames.
+thread_local int held_frames = 0;
+/// @brief number of threads which hold frames.
+std::atomic<int> frame_holders(0);
+/// @brief number of threads which hold frames, and wait for a frame, a latch,
+/// a record lock or a page accessed without a frame. If every holder waits, no
+/// frame is released until one of them falls back.
+std::atomic<int> blocked_holders(0);
+/// @brief number of threads which hold frames, and wait for a frame.
+std::atomic<int> frame_waiting_holders(0);
+/// @brief page location of a frame which holds no page.
+static const PageLocation EMPTY_PAGE_LOCATION = std::make_pair(-1, 0);
+
+/// @brief buffer cleaner thread.
+pthread_t cleaner_thread;
+/// @brief <code>true</code> if the buffer cleaner thread is running.
+bool cleaner_running = false;
+/// @brief share of the coldest frames the cleaner keeps clean.
+double cleaner_share = 0;
+/// @brief interval(in milliseconds) between cleaner passes.
+int cleaner_interval_ms = DEFAULT_CLEANER_INTERVAL_MS;
+/// @brief mutex which protects the cleaner configuration.
+pthread_mutex_t cleaner_mutex = PTHREAD_MUTEX_INITIALIZER;
+/// @brief wakes the cleaner up before its interval.
+pthread_cond_t cleaner_cond = PTHREAD_COND_INITIALIZER;
+
+/// @brief prefetcher thread.
+pthread_t prefetcher_thread;
+/// @brief <code>true</code> if the prefetcher thread is running.
+bool prefetcher_running = false;
+/// @brief number of leaf pages to read ahead.
+int read_ahead_window = 0;
+/// @brief pending read-ahead requests.
+std::deque<ReadAheadRequest> read_ahead_requests;
+/// @brief sequential walk detector of each table.
+std::unordered_map<tableid_t, SequentialState> sequential_states;
+/// @brief table of the request being read ahead, <code>-1</code> if none.
+tableid_t read_ahead_table_id = -1;
+/// @brief mutex which protects the read-ahead state.
+pthread_mutex_t prefetcher_mutex = PTHREAD_MUTEX_INITIALIZER;
+/// @brief wakes the prefetcher up when a request is queued.
+pthread_cond_t prefetcher_cond = PTHREAD_COND_INITIALIZER;
+
+/// @brief magic number of warm-up manifests.
+static constexpr uint64_t WARM_UP_MANIFEST_MAGIC = 0x3170556d72615744ULL;
+/// @brief warmer thread.
+pthread_t warmer_thread;
+/// @brief <code>true</code> if the warmer thread is running.
+bool warmer_running = false;
+/// @brief <code>true</code> if the warmer thread has exited but is not
+/// joined yet.
+bool warmer_joinable = false;
+/// @brief <code>true</code> if the buffer warm-up is enabled.
+bool warm_up_enabled = false;
+/// @brief pending warm-up requests.
+std::deque<WarmUpRequest> warm_up_requests;
+/// @brief warm-up statistics.
+WarmUpStats warm_up_stats = {0, 0, 0};
+/// @brief table being warmed up, <code>-1</code> if none.
+tableid_t warming_table_id = -1;
+/// @brief mutex which protects the warm-up state.
+pthread_mutex_t warmer_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 namespace buffer_helper {
+BufferShard& get_shard(const PageLocation& page_location) {
+    return buffer_shards[std::hash<PageLocation>()(page_location) %
+                         buffer_shard_count];
+}
+
 BufferBlock* load_buffer(tableid_t table_id, pagenum_t pagenum, page_t* page,
-                         trxid_t trx_id, bool pin) {
-    pthread_mutex_lock(buffer_manager_mutex);
+                         [[maybe_unused]] trxid_t trx_id, bool pin) {
     auto page_location = std::make_pair(table_id, pagenum);
-    const auto& existing_buffer = buffer_index.find(page_location);
-    if (existing_buffer != buffer_index.end()) {
-        int buffer_page_idx = existing_buffer->second;
-        BufferBlock* buffer_page = buffer_slot + buffer_page_idx;
-
-        if (pin && buffer_page->pin_count > 0) {
-            buffer_page->pin_count++;
-            if(buffer_page->pin_owner == trx_id) {
-                std::cout << "wow" << std::endl;
+    BufferShard& shard = get_shard(page_location);
+
+    BufferBlock* frame = pin_frame(table_id, pagenum);
+    if (frame == nullptr) {
+        // direct I/O fallback
+        buffer_stats_helper::count(BUFFER_FALLBACK);
+        if (page != nullptr) {
+            file_read_page(table_id, pagenum, page);
+        }
+        end_fallback(table_id, pagenum);
+        return nullptr;
+    }
+
+    if (page != nullptr) {
+        latch_frame(frame, SHARED_LATCH);
+        memcpy(page, frame->page, PAGE_SIZE);
+        unlatch_frame(frame);
+    }
+
+    pthread_mutex_lock(&shard.mutex);
+    if (pin) {
+        frame->pin_count++;
+        hold_frame();
+    }
+    frame->guard_count--;
+    wake_frame_waiters(shard);
+    pthread_mutex_unlock(&shard.mutex);
+    return frame;
+}
+
+bool apply_buffer(tableid_t table_id, pagenum_t pagenum, const page_t* page) {
+    auto page_location = std::make_pair(table_id, pagenum);
+    BufferShard& shard = get_shard(page_location);
+
+    pthread_mutex_lock(&shard.mutex);
+    int frame_idx = find_loaded_frame(shard, page_location);
+    if (frame_idx < 0) {
+        // direct I/O fallback, which is not loaded until it is written.
+        shard.fallback_pages.emplace(page_location, -1);
+        pthread_mutex_unlock(&shard.mutex);
+
+        victim_cache_helper::drop_page(page_location);
+        file_write_page(table_id, pagenum, page);
+        end_fallback(table_id, pagenum);
+        return false;
+    }
+
+    BufferBlock* frame = get_frame(shard, frame_idx);
+    frame->guard_count++;
+    pthread_mutex_unlock(&shard.mutex);
+
+    latch_frame(frame, EXCLUSIVE_LATCH);
+    memcpy(frame->page, page, PAGE_SIZE);
+    unlatch_frame(frame);
+
+    pthread_mutex_lock(&shard.mutex);
+    set_dirty(shard, frame, true);
+    bool is_unpinned = frame->pin_count > 0;
+    if (is_unpinned) {
+        frame->pin_count--;
+    }
+    frame->guard_count--;
+    wake_frame_waiters(shard);
+    pthread_mutex_unlock(&shard.mutex);
+
+    if (is_unpinned) {
+        drop_frame();
+    }
+    return true;
+}
+
+void release_buffer(tableid_t table_id, pagenum_t pagenum) {
+    auto page_location = std::make_pair(table_id, pagenum);
+    BufferShard& shard = get_shard(page_location);
+
+    pthread_mutex_lock(&shard.mutex);
+    int frame_idx = shard.index.find(page_location);
+    bool is_unpinned = false;
+    if (frame_idx >= 0) {
+        BufferBlock* frame = get_frame(shard, frame_idx);
+        if (frame->pin_count > 0) {
+            frame->pin_count--;
+            is_unpinned = true;
+            wake_frame_waiters(shard);
+        }
+    }
+    pthread_mutex_unlock(&shard.mutex);
+
+    if (is_unpinned) {
+        drop_frame();
+    }
+}
+
+int evict(BufferShard& shard, tableid_t table_id) {
+    const TableShare& share = get_table_share(shard, table_id);
+    bool at_max = share.max_frames > 0 && share.frame_count >= share.max_frames;
+    if (!at_max && !shard.free_frames.empty()) {
+        int free_idx = shard.free_frames.back();
+        shard.free_frames.pop_back();
+        get_frame(shard, free_idx)->guard_count.store(-1, std::memory_order_relaxed);
+        return free_idx;
+    }
+
+    // Victims are claimed as the last condition, since a claimed frame is
+    // returned by the policy right away. Frames beyond the size are being
+    // retired by a shrink.
+    auto is_unpinned = [&shard](int frame_idx) {
+        BufferBlock* frame = get_frame(shard, frame_idx);
+        return frame_idx < shard.size && frame->pin_count <= 0 &&
+               claim_frame(frame);
+    };
+    auto is_clean = [&shard](int frame_idx) {
+        BufferBlock* frame = get_frame(shard, frame_idx);
+        return frame_idx < shard.size && frame->pin_count <= 0 &&
+               !frame->is_dirty && claim_frame(frame);
+    };
+
+    int evicted_idx;
+    if (shard.has_quotas) {
+        evicted_idx = find_quota_victim(shard, table_id, at_max);
+    } else {
+        int clean_window =
+            std::max(1, static_cast<int>(shard.size * CLEAN_VICTIM_WINDOW));
+        evicted_idx = shard.policy->victim(is_clean, clean_window);
+        if (evicted_idx == -1) {
+            evicted_idx = shard.policy->victim(is_unpinned, shard.size);
+        }
+    }
+
+    // All the buffers are using
+    if (evicted_idx == -1) {
+        return -1;
+    }
+
+    BufferBlock* buffer_evict = get_frame(shard, evicted_idx);
+    buffer_stats_helper::count(BUFFER_EVICTION);
+    shard.policy->on_evict(evicted_idx);
+    if (buffer_evict->is_prefetched) {
+        buffer_evict->is_prefetched = false;
+        shard.prefetch_wasted++;
+    }
+    shard.index.erase(buffer_evict->page_location);
+    get_table_share(shard, buffer_evict->page_location.first).frame_count--;
+    return evicted_idx;
+}
+
+int find_quota_victim(BufferShard& shard, tableid_t table_id, bool at_max) {
+    // A table at its maximum only replaces its own pages, and the other
+    // tables keep their reservations.
+    auto is_allowed = [&shard, table_id, at_max](int frame_idx,
+                                                 int priority) {
+        tableid_t owner_id = get_frame(shard, frame_idx)->page_location.first;
+        if (at_max || owner_id == table_id) {
+            return owner_id == table_id;
+        }
+        const TableShare& owner = get_table_share(shard, owner_id);
+        return owner.frame_count > owner.min_frames &&
+               owner.priority <= priority;
+    };
+
+    int clean_window =
+        std::max(1, static_cast<int>(shard.size * CLEAN_VICTIM_WINDOW));
+    for (int priority = LOW_PRIORITY; priority <= HIGH_PRIORITY; priority++) {
+        // Victims are claimed as the last condition.
+        int evicted_idx = shard.policy->victim(
+            [&shard, &is_allowed, priority](int frame_idx) {
+                BufferBlock* frame = get_frame(shard, frame_idx);
+                return frame_idx < shard.size && frame->pin_count <= 0 &&
+                       !frame->is_dirty && is_allowed(frame_idx, priority) &&
+                       claim_frame(frame);
+            },
+            clean_window);
+        if (evicted_idx == -1) {
+            evicted_idx = shard.policy->victim(
+                [&shard, &is_allowed, priority](int frame_idx) {
+                    BufferBlock* frame = get_frame(shard, frame_idx);
+                    return frame_idx < shard.size && frame->pin_count <= 0 &&
+                           is_allowed(frame_idx, priority) &&
+                           claim_frame(frame);
+                },
+                shard.size);
+        }
+        if (evicted_idx != -1) {
+            return evicted_idx;
+        }
+    }
+    return -1;
+}
+
+TableShare& get_table_share(BufferShard& shard, tableid_t table_id) {
+    auto share = shard.table_shares.find(table_id);
+    if (share == shard.table_shares.end()) {
+        share = shard.table_shares
+                    .emplace(table_id, TableShare{0, 0, 0, NORMAL_PRIORITY})
+                    .first;
+    }
+    return share->second;
+}
+
+bool is_valid_quota(const BufferQuota& quota) {
+    return quota.min_frames >= 0 && quota.max_frames >= 0 &&
+           (quota.max_frames == 0 || quota.max_frames >= quota.min_frames) &&
+           quota.priority >= LOW_PRIORITY && quota.priority <= HIGH_PRIORITY;
+}
+
+int get_shard_share(int frames, int shard_idx) {
+    return frames / buffer_shard_count +
+           (shard_idx < frames % buffer_shard_count);
+}
+
+bool is_evicting(const BufferShard& shard, const PageLocation& page_location) {
+    return std::find(shard.evicting_pages.begin(), shard.evicting_pages.end(),
+                     page_location) != shard.evicting_pages.end();
+}
+
+int find_loaded_frame(BufferShard& shard, const PageLocation& page_location) {
+    bool is_counted = false;
+    bool is_blocked = false;
+    for (;;) {
+        int frame_idx = shard.index.find(page_location);
+        bool is_fallback = frame_idx < 0 &&
+                           shard.fallback_pages.count(page_location) > 0;
+        bool is_busy = frame_idx >= 0
+                           ? get_frame(shard, frame_idx)->is_loading
+                           : is_evicting(shard, page_location) || is_fallback;
+        if (!is_busy) {
+            if (is_blocked) {
+                end_holder_wait();
             }
-            pthread_cond_wait(&buffer_page->latch, buffer_manager_mutex);
-            //pthread_mutex_lock(&buffer_page->mutex);
-            buffer_page->pin_owner = trx_id;
+            return frame_idx;
         }
 
-        move_to_head(buffer_page_idx);
+        if (!is_counted) {
+            buffer_stats_helper::count(BUFFER_IO_WAIT);
+            is_counted = true;
+        }
+        // The fallback may be held by a thread waiting for a frame, which
+        // this thread holds. The shard mutex may be released, so the page is
+        // looked up again.
+        if (is_fallback && !is_blocked) {
+            is_blocked = begin_holder_wait(&shard);
+            if (is_blocked) continue;
+        }
+        pthread_cond_wait(&shard.frame_cond, &shard.mutex);
+    }
+}
 
-        if (page != nullptr) {
-            memcpy(page, &(buffer_page->page), PAGE_SIZE);
+void wake_frame_waiters(BufferShard& shard) {
+    if (shard.frame_waiters.load() > 0) {
+        pthread_cond_broadcast(&shard.frame_cond);
+    }
+}
+
+bool begin_frame_wait(BufferShard& shard) {
+    // Announced before the caller retries, so that an unpin without the
+    // shard mutex is either seen by the retry or wakes this thread up.
+    shard.frame_waiters++;
+    buffer_stats_helper::count(BUFFER_FRAME_WAIT);
+    if (held_frames == 0) {
+        return false;
+    }
+    frame_waiting_holders++;
+    return begin_holder_wait(&shard);
+}
+
+void end_frame_wait(BufferShard& shard, bool is_blocked) {
+    shard.frame_waiters--;
+    if (is_blocked) {
+        frame_waiting_holders--;
+        end_holder_wait();
+    }
+}
+
+void hold_frame() {
+    if (held_frames++ == 0) {
+        frame_holders++;
+    }
+}
+
+void drop_frame() {
+    if (--held_frames == 0) {
+        frame_holders--;
+        wake_blocked_holders(nullptr);
+    }
+}
+
+bool begin_holder_wait(BufferShard* locked_shard) {
+    if (held_frames == 0) {
+        return false;
+    }
+    blocked_holders++;
+    wake_blocked_holders(locked_shard);
+    return true;
+}
+
+void end_holder_wait() { blocked_holders--; }
+
+bool is_stalled() {
+    return blocked_holders.load() >= frame_holders.load();
+}
+
+void wake_blocked_holders(BufferShard* locked_shard) {
+    // Sequentially consistent with the announcement of the waiters, so that
+    // a waiter either sees the change of the holders or is woken up.
+    if (frame_waiting_holders.load() == 0) {
+        return;
+    }
+
+    // Shard mutexes are not nested.
+    if (locked_shard != nullptr) {
+        pthread_mutex_unlock(&locked_shard->mutex);
+    }
+    for (int i = 0; i < buffer_shard_count; i++) {
+        BufferShard& shard = buffer_shards[i];
+        if (shard.frame_waiters.load() > 0) {
+            pthread_mutex_lock(&shard.mutex);
+            pthread_cond_broadcast(&shard.frame_cond);
+            pthread_mutex_unlock(&shard.mutex);
         }
+    }
+    if (locked_shard != nullptr) {
+        pthread_mutex_lock(&locked_shard->mutex);
+    }
+}
+
+int load_frame(BufferShard& shard, const PageLocation& page_location,
+               AccessHint hint) {
+    FrameLoad load;
+    int frame_idx = begin_load(shard, page_location, hint, &load);
+    if (frame_idx < 0) {
+        return frame_idx;
+    }
+    pthread_mutex_unlock(&shard.mutex);
+
+    // The claimed frame is not accessed by other threads, so its old page
+    // is written and the new one is read without the shard mutex.
+    write_back_evicted(shard, load);
+    BufferBlock* frame = get_frame(shard, frame_idx);
+    if (!victim_cache_helper::take_page(page_location, frame->page)) {
+        file_read_page(page_location.first, page_location.second,
+                       frame->page);
+    }
+
+    pthread_mutex_lock(&shard.mutex);
+    end_load(shard, frame_idx);
+    return frame_idx;
+}
+
+int begin_load(BufferShard& shard, const PageLocation& page_location,
+               AccessHint hint, FrameLoad* load) {
+    int frame_idx = evict(shard, page_location.first);
+    if (frame_idx < 0) {
+        return frame_idx;
+    }
+
+    BufferBlock* frame = get_frame(shard, frame_idx);
+    PageLocation evicted_location = frame->page_location;
+    bool is_dirty = frame->is_dirty;
+    // Lookups of the evicted page wait until its write-back is done, and the
+    // victim cache has its copy.
+    bool writes_back =
+        evicted_location != EMPTY_PAGE_LOCATION &&
+        (is_dirty || victim_cache_helper::is_enabled());
+    if (writes_back) {
+        shard.evicting_pages.push_back(evicted_location);
+    }
+    if (is_dirty) {
+        set_dirty(shard, frame, false);
+        shard.eviction_writes++;
+        buffer_stats_helper::count(BUFFER_DIRTY_EVICTION);
+        // The cleaner is falling behind.
+        pthread_cond_signal(&cleaner_cond);
+    }
 
-        pthread_mutex_unlock(buffer_manager_mutex);
-        return buffer_slot + buffer_page_idx;
+    // Lookups of the loaded page wait until it is read, and optimistic
+    // readers of the evicted page fail to validate.
+    frame->version.fetch_add(1);
+    shard.index.insert(page_location, frame_idx);
+    get_table_share(shard, page_location.first).frame_count++;
+    frame->page_location = page_location;
+    frame->is_loading = true;
+    shard.policy->on_load(frame_idx, hint);
+
+    *load = {page_location, frame_idx, evicted_location, is_dirty,
+             writes_back};
+    return frame_idx;
+}
+
+void write_back_evicted(BufferShard& shard, const FrameLoad& load) {
+    if (!load.writes_back) {
+        return;
+    }
+
+    BufferBlock* frame = get_frame(shard, load.frame_idx);
+    if (load.is_dirty) {
+        file_write_page(load.evicted_location.first,
+                        load.evicted_location.second, frame->page);
     }
+    victim_cache_helper::store_page(load.evicted_location, frame->page);
+
+    pthread_mutex_lock(&shard.mutex);
+    shard.evicting_pages.erase(std::find(shard.evicting_pages.begin(),
+                                         shard.evicting_pages.end(),
+                                         load.evicted_location));
+    pthread_cond_broadcast(&shard.frame_cond);
+    pthread_mutex_unlock(&shard.mutex);
+}
+
+void end_load(BufferShard& shard, int frame_idx) {
+    BufferBlock* frame = get_frame(shard, frame_idx);
+    frame->version.fetch_add(1, std::memory_order_release);
+    frame->is_loading = false;
+    frame->guard_count.store(0, std::memory_order_release);
+    pthread_cond_broadcast(&shard.frame_cond);
+}
 
-    int evicted_idx = evict();
-    if (evicted_idx >= 0) {
-        // add
-        BufferBlock* buffer_page = buffer_slot + evicted_idx;
+bool claim_frame(BufferBlock* frame) {
+    int unguarded = 0;
+    return frame->guard_count.compare_exchange_strong(
+        unguarded, -1, std::memory_order_acquire);
+}
 
-        if (pin) {
-            // buffer_page->someone_waiting++;
-            // pthread_mutex_unlock(buffer_manager_mutex);
-            // pthread_mutex_lock(&buffer_page->mutex);
-            // pthread_mutex_lock(buffer_manager_mutex);
-            // buffer_page->someone_waiting--;
-            buffer_page->pin_count++;
-            buffer_page->pin_owner = trx_id;
+bool try_pin_frame(BufferBlock* frame, const PageLocation& page_location) {
+    int guard_count = frame->guard_count.load(std::memory_order_relaxed);
+    do {
+        if (guard_count < 0) return false;
+    } while (!frame->guard_count.compare_exchange_weak(
+        guard_count, guard_count + 1, std::memory_order_acquire));
+
+    // The frame may have been reused after the lookup. A thread which
+    // waits for a frame may have seen the pin, so it is woken up like an
+    // unpin.
+    if (frame->page_location != page_location) {
+        frame->guard_count.fetch_sub(1);
+        BufferShard& shard = get_shard(page_location);
+        if (shard.frame_waiters.load() > 0) {
+            pthread_mutex_lock(&shard.mutex);
+            pthread_cond_broadcast(&shard.frame_cond);
+            pthread_mutex_unlock(&shard.mutex);
         }
+        return false;
+    }
+    return true;
+}
+
+BufferBlock* pin_frame(tableid_t table_id, pagenum_t pagenum,
+                       AccessHint hint, LatchMode mode) {
+    auto page_location = std::make_pair(table_id, pagenum);
+    BufferShard& shard = get_shard(page_location);
+
+    int frame_idx = shard.index.find(page_location);
+    if (frame_idx >= 0 && try_pin_frame(get_frame(shard, frame_idx),
+                                        page_location)) {
+        BufferBlock* frame = get_frame(shard, frame_idx);
+        // The hit is dropped if the shard is busy, unless it consumes a
+        // prefetched page. Scan hits are only recorded for prefetched pages.
+        bool is_prefetched =
+            __atomic_load_n(&frame->is_prefetched, __ATOMIC_RELAXED);
+        if ((hint != SCAN_ACCESS &&
+             pthread_mutex_trylock(&shard.mutex) == 0) ||
+            (is_prefetched && pthread_mutex_lock(&shard.mutex) == 0)) {
+            touch_frame(shard, frame_idx, hint);
+            pthread_mutex_unlock(&shard.mutex);
+        }
+        buffer_stats_helper::count_access(table_id, true);
+        return frame;
+    }
+
+    if (pthread_mutex_trylock(&shard.mutex) != 0) {
+        buffer_stats_helper::count(BUFFER_PIN_WAIT);
+        pthread_mutex_lock(&shard.mutex);
+    }
+    auto fallback = shard.fallback_pages.find(page_location);
+    if (mode == SHARED_LATCH && held_frames > 0 &&
+        fallback != shard.fallback_pages.end() && fallback->second > 0) {
+        fallback->second++;
+        buffer_stats_helper::count_access(table_id, false);
+        pthread_mutex_unlock(&shard.mutex);
+        return nullptr;
+    }
 
-        move_to_head(evicted_idx);
+    bool is_waiting = false;
+    bool is_blocked = false;
+    for (;;) {
+        frame_idx = find_loaded_frame(shard, page_location);
+        if (frame_idx >= 0) {
+            buffer_stats_helper::count_access(table_id, true);
+            touch_frame(shard, frame_idx, hint);
+            break;
+        }
 
-        buffer_index[page_location] = evicted_idx;
+        frame_idx = load_frame(shard, page_location, hint);
+        if (frame_idx >= 0) {
+            buffer_stats_helper::count_access(table_id, false);
+            break;
+        }
+        // Every frame is in use. The page may be loaded by another thread
+        // meanwhile, so it is looked up again.
+        if (!is_waiting) {
+            is_waiting = true;
+            is_blocked = begin_frame_wait(shard);
+            continue;
+        }
+        // No frame is released if every thread which holds one waits.
+        if (is_blocked && is_stalled()) {
+            buffer_stats_helper::count_access(table_id, false);
+            break;
+        }
+        pthread_cond_wait(&shard.frame_cond, &shard.mutex);
+    }
+    if (is_waiting) {
+        end_frame_wait(shard, is_blocked);
+    }
 
-        buffer_page->is_dirty = false;
+    BufferBlock* frame = nullptr;
+    if (frame_idx >= 0) {
+        frame = get_frame(shard, frame_idx);
+        frame->guard_count++;
+    } else {
+        // The page is neither buffered nor written back now, and it is not
+        // loaded until the fallback ends.
+        shard.fallback_pages.emplace(page_location,
+                                     mode == EXCLUSIVE_LATCH ? -1 : 1);
+    }
+    pthread_mutex_unlock(&shard.mutex);
+    return frame;
+}
 
-        buffer_page->page_location = page_location;
+void end_fallback(tableid_t table_id, pagenum_t pagenum) {
+    auto page_location = std::make_pair(table_id, pagenum);
+    BufferShard& shard = get_shard(page_location);
+
+    pthread_mutex_lock(&shard.mutex);
+    auto fallback = shard.fallback_pages.find(page_location);
+    if (fallback->second > 1) {
+        fallback->second--;
+    } else {
+        shard.fallback_pages.erase(fallback);
+    }
+    pthread_cond_broadcast(&shard.frame_cond);
+    pthread_mutex_unlock(&shard.mutex);
+}
 
-        file_read_page(table_id, pagenum, &(buffer_page->page));
-        if (page != nullptr) {
-            memcpy(page, &(buffer_page->page), PAGE_SIZE);
+void latch_frame(BufferBlock* frame, LatchMode mode) {
+    // Only waits are timed, so uncontended latches cost no clock reads.
+    if (mode == EXCLUSIVE_LATCH) {
+        if (pthread_rwlock_trywrlock(&frame->latch) == 0) {
+            frame->version.fetch_add(1);
+            return;
         }
+    } else {
+        if (pthread_rwlock_tryrdlock(&frame->latch) == 0) return;
+    }
 
-        pthread_mutex_unlock(buffer_manager_mutex);
-        return buffer_page;
+    timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bool is_blocked = begin_holder_wait(nullptr);
+    if (mode == EXCLUSIVE_LATCH) {
+        pthread_rwlock_wrlock(&frame->latch);
+        frame->version.fetch_add(1);
+    } else {
+        pthread_rwlock_rdlock(&frame->latch);
+    }
+    if (is_blocked) {
+        end_holder_wait();
     }
+    clock_gettime(CLOCK_MONOTONIC, &end);
 
-    // direct I/O fallback
-    if (page != nullptr) {
-        file_read_page(table_id, pagenum, page);
+    buffer_stats_helper::count(BUFFER_LATCH_WAIT);
+    buffer_stats_helper::count(
+        BUFFER_LATCH_WAIT_NS, (end.tv_sec - start.tv_sec) * 1000000000LL +
+                                  (end.tv_nsec - start.tv_nsec));
+}
+
+void unlatch_frame(BufferBlock* frame) {
+    // Shared holders never see an odd version, since the writer excludes
+    // them.
+    if (frame->version.load(std::memory_order_relaxed) & 1) {
+        frame->version.fetch_add(1, std::memory_order_release);
     }
-    pthread_mutex_unlock(buffer_manager_mutex);
-    return nullptr;
+    pthread_rwlock_unlock(&frame->latch);
 }
 
-bool apply_buffer(tableid_t table_id, pagenum_t pagenum, const page_t* page) {
-    pthread_mutex_lock(buffer_manager_mutex);
+__attribute__((no_sanitize("thread")))
+const fullpage_t* begin_optimistic_read(tableid_t table_id, pagenum_t pagenum,
+                                        BufferBlock** frame,
+                                        uint64_t* version) {
     auto page_location = std::make_pair(table_id, pagenum);
-    const auto& existing_buffer = buffer_index.find(page_location);
-    if (existing_buffer != buffer_index.end()) {
-        int buffer_page_idx = existing_buffer->second;
-        BufferBlock* buffer_page = buffer_slot + buffer_page_idx;
+    BufferShard& shard = get_shard(page_location);
 
-        move_to_head(buffer_page_idx);
+    int frame_idx = shard.index.find(page_location);
+    if (frame_idx < 0) {
+        return nullptr;
+    }
+    *frame = get_frame(shard, frame_idx);
+    *version = (*frame)->version.load(std::memory_order_acquire);
+
+    // The fields are read racily, and validated with the version.
+    fullpage_t* page = (*frame)->page;
+    if ((*version & 1) || page == nullptr ||
+        (*frame)->page_location.first != table_id ||
+        (*frame)->page_location.second != pagenum) {
+        return nullptr;
+    }
+    return page;
+}
 
-        memcpy(&(buffer_page->page), page, PAGE_SIZE);
-        buffer_page->is_dirty = true;
-        buffer_page->pin_count--;
-        buffer_page->pin_owner = -1;
+bool validate_optimistic_read(const BufferBlock* frame, uint64_t version) {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return frame->version.load(std::memory_order_relaxed) == version;
+}
 
-        pthread_cond_signal(&buffer_page->latch);
-        //pthread_mutex_unlock(&buffer_page->mutex);
-        pthread_mutex_unlock(buffer_manager_mutex);
-        return true;
+void unpin_frame(BufferBlock* frame, bool is_dirty) {
+    BufferShard& shard = get_shard(frame->page_location);
+    if (!is_dirty) {
+        // Sequentially consistent, so that a thread which is about to wait
+        // for a frame either sees the unpin or is woken up.
+        frame->guard_count.fetch_sub(1);
+        if (shard.frame_waiters.load() > 0) {
+            pthread_mutex_lock(&shard.mutex);
+            pthread_cond_broadcast(&shard.frame_cond);
+            pthread_mutex_unlock(&shard.mutex);
+        }
+        return;
     }
 
-    // direct I/O fallback
-    file_write_page(table_id, pagenum, page);
-    pthread_mutex_unlock(buffer_manager_mutex);
-    return false;
+    pthread_mutex_lock(&shard.mutex);
+    frame->guard_count--;
+    set_dirty(shard, frame, true);
+    wake_frame_waiters(shard);
+    pthread_mutex_unlock(&shard.mutex);
 }
 
-void release_buffer(tableid_t table_id, pagenum_t pagenum) {
-    pthread_mutex_lock(buffer_manager_mutex);
+void touch_frame(BufferShard& shard, int frame_idx, AccessHint hint) {
+    BufferBlock* frame = get_frame(shard, frame_idx);
+    if (frame->is_prefetched) {
+        frame->is_prefetched = false;
+        shard.prefetch_used++;
+    }
+    shard.policy->on_hit(frame_idx, hint);
+}
+
+BufferBlock* prefetch_frame(tableid_t table_id, pagenum_t pagenum,
+                            bool* is_loaded) {
     auto page_location = std::make_pair(table_id, pagenum);
-    const auto& existing_buffer = buffer_index.find(page_location);
-    if (existing_buffer != buffer_index.end()) {
-        int buffer_page_idx = existing_buffer->second;
-        BufferBlock* buffer_page = buffer_slot + buffer_page_idx;
+    BufferShard& shard = get_shard(page_location);
+
+    *is_loaded = false;
+    pthread_mutex_lock(&shard.mutex);
+    int frame_idx = find_loaded_frame(shard, page_location);
+    if (frame_idx < 0) {
+        frame_idx = load_frame(shard, page_location);
+        if (frame_idx >= 0) {
+            get_frame(shard, frame_idx)->is_prefetched = true;
+            shard.prefetched_pages++;
+            *is_loaded = true;
+        }
+    }
 
-        buffer_page->pin_count--;
-        buffer_page->pin_owner = -1;
-        pthread_cond_signal(&buffer_page->latch);
-        //pthread_mutex_unlock(&buffer_page->mutex);
+    BufferBlock* frame = nullptr;
+    if (frame_idx >= 0) {
+        frame = get_frame(shard, frame_idx);
+        frame->guard_count++;
     }
-    pthread_mutex_unlock(buffer_manager_mutex);
+    pthread_mutex_unlock(&shard.mutex);
+    return frame;
 }
 
-int evict() {
-    int evicted_idx = buffer_tail_idx;
-    BufferBlock* buffer_evict = buffer_slot + evicted_idx;
+int read_ahead(tableid_t table_id, pagenum_t pagenum, int count) {
+    int loaded_count = 0;
+    bool advised = false;
+
+    for (int i = 0; i < count && pagenum != 0; i++) {
+        if (!advised) {
+            BufferShard& shard = get_shard(std::make_pair(table_id, pagenum));
+            bool is_buffered =
+                shard.index.count(std::make_pair(table_id, pagenum)) != 0;
+
+            if (!is_buffered) {
+                file_advise_pages(table_id, pagenum, count - i);
+                advised = true;
+            }
+        }
 
-    while (evicted_idx != -1 && buffer_evict->pin_count > 0) {
-        evicted_idx = buffer_evict->prev_block_idx;
-        buffer_evict = buffer_slot + evicted_idx;
+        bool is_loaded;
+        BufferBlock* frame = prefetch_frame(table_id, pagenum, &is_loaded);
+        if (frame == nullptr) {
+            break;
+        }
+        if (is_loaded) {
+            loaded_count++;
+        }
+
+        // The chain may have been changed since the request.
+        leafpage_t* leaf_page = reinterpret_cast<leafpage_t*>(frame->page);
+        latch_frame(frame, SHARED_LATCH);
+        pagenum = leaf_page->page_header.is_leaf_page
+                      ? *page_helper::get_sibling_idx(leaf_page)
+                      : 0;
+        unlatch_frame(frame);
+        unpin_frame(frame, false);
     }
+    return loaded_count;
+}
 
-    // All the buffers are using
-    if (evicted_idx == -1) {
+void record_leaf_access(tableid_t table_id, pagenum_t leaf_idx,
+                        pagenum_t next_leaf_idx) {
+    pthread_mutex_lock(&prefetcher_mutex);
+    if (!prefetcher_running) {
+        pthread_mutex_unlock(&prefetcher_mutex);
+        return;
+    }
+
+    SequentialState& state = sequential_states[table_id];
+    state.streak = leaf_idx == state.expected_leaf ? state.streak + 1 : 1;
+    state.expected_leaf = next_leaf_idx;
+
+    // Request again when the walk has consumed half of the window.
+    int refill_distance = std::max(1, read_ahead_window / 2);
+    if (next_leaf_idx != 0 && state.streak >= READ_AHEAD_TRIGGER &&
+        (state.streak - READ_AHEAD_TRIGGER) % refill_distance == 0 &&
+        read_ahead_requests.size() < MAX_READ_AHEAD_REQUESTS) {
+        read_ahead_requests.push_back(
+            {table_id, next_leaf_idx, read_ahead_window});
+        pthread_cond_signal(&prefetcher_cond);
+    }
+    pthread_mutex_unlock(&prefetcher_mutex);
+}
+
+void* prefetcher_main([[maybe_unused]] void* arg) {
+    pthread_mutex_lock(&prefetcher_mutex);
+    while (prefetcher_running) {
+        if (read_ahead_requests.empty()) {
+            pthread_cond_wait(&prefetcher_cond, &prefetcher_mutex);
+            continue;
+        }
+
+        ReadAheadRequest request = read_ahead_requests.front();
+        read_ahead_requests.pop_front();
+        read_ahead_table_id = request.table_id;
+        pthread_mutex_unlock(&prefetcher_mutex);
+
+        read_ahead(request.table_id, request.pagenum, request.count);
+
+        pthread_mutex_lock(&prefetcher_mutex);
+        read_ahead_table_id = -1;
+    }
+    pthread_mutex_unlock(&prefetcher_mutex);
+    return nullptr;
+}
+
+std::string get_warm_up_manifest_path(tableid_t table_id) {
+    return std::string(file_helper::get_table_instance(table_id).file_path) +
+           WARM_UP_MANIFEST_SUFFIX;
+}
+
+bool stat_warm_up_table(tableid_t table_id, WarmUpManifestHeader* header) {
+    struct stat table_stat;
+    if (fstat(file_helper::get_table_instance(table_id).file_descriptor,
+              &table_stat) != 0) {
+        return false;
+    }
+
+    header->magic = WARM_UP_MANIFEST_MAGIC;
+    header->inode = table_stat.st_ino;
+    header->file_size = table_stat.st_size;
+    header->modified_ns = table_stat.st_mtim.tv_sec * 1000000000ULL +
+                          table_stat.st_mtim.tv_nsec;
+    header->page_count = 0;
+    return true;
+}
+
+void write_warm_up_manifests() {
+    // Hottest frames of each shard first.
+    std::vector<std::vector<PageLocation>> shard_pages(buffer_shard_count);
+    size_t max_rank = 0;
+    for (int shard_idx = 0; shard_idx < buffer_shard_count; shard_idx++) {
+        BufferShard& shard = buffer_shards[shard_idx];
+        std::vector<PageLocation>& pages = shard_pages[shard_idx];
+
+        pthread_mutex_lock(&shard.mutex);
+        shard.policy->visit_coldest(
+            [&shard, &pages](int frame_idx) {
+                pages.push_back(get_frame(shard, frame_idx)->page_location);
+            },
+            shard.size);
+        pthread_mutex_unlock(&shard.mutex);
+
+        std::reverse(pages.begin(), pages.end());
+        max_rank = std::max(max_rank, pages.size());
+    }
+
+    std::unordered_map<tableid_t, std::vector<pagenum_t>> table_pages;
+    for (size_t rank = 0; rank < max_rank; rank++) {
+        for (const auto& pages : shard_pages) {
+            if (rank < pages.size()) {
+                table_pages[pages[rank].first].push_back(pages[rank].second);
+            }
+        }
+    }
+
+    for (const auto& table : table_pages) {
+        WarmUpManifestHeader header;
+        if (!stat_warm_up_table(table.first, &header)) continue;
+        header.page_count = table.second.size();
+
+        // Replace the manifest at once, so a crash never leaves half of it.
+        std::string manifest_path = get_warm_up_manifest_path(table.first);
+        std::string temp_path = manifest_path + ".tmp";
+        FILE* manifest = fopen(temp_path.c_str(), "wb");
+        if (manifest == nullptr) continue;
+
+        bool written =
+            fwrite(&header, sizeof(header), 1, manifest) == 1 &&
+            fwrite(table.second.data(), sizeof(pagenum_t), table.second.size(),
+                   manifest) == table.second.size();
+        if (fclose(manifest) == 0 && written) {
+            rename(temp_path.c_str(), manifest_path.c_str());
+        } else {
+            unlink(temp_path.c_str());
+        }
+    }
+}
+
+bool read_warm_up_manifest(tableid_t table_id,
+                           std::vector<pagenum_t>* pagenums) {
+    std::string manifest_path = get_warm_up_manifest_path(table_id);
+    FILE* manifest = fopen(manifest_path.c_str(), "rb");
+    if (manifest == nullptr) {
+        return false;
+    }
+
+    // A manifest is used once, since the buffered pages change from now on.
+    WarmUpManifestHeader header, expected;
+    bool matched = fread(&header, sizeof(header), 1, manifest) == 1 &&
+                   stat_warm_up_table(table_id, &expected) &&
+                   header.magic == expected.magic &&
+                   header.inode == expected.inode &&
+                   header.file_size == expected.file_size &&
+                   header.modified_ns == expected.modified_ns;
+    if (matched) {
+        pagenums->resize(header.page_count);
+        matched = fread(pagenums->data(), sizeof(pagenum_t),
+                        header.page_count, manifest) == header.page_count;
+    }
+    fclose(manifest);
+    unlink(manifest_path.c_str());
+    return matched;
+}
+
+void queue_warm_up(tableid_t table_id) {
+    pthread_mutex_lock(&warmer_mutex);
+    bool enabled = warm_up_enabled;
+    pthread_mutex_unlock(&warmer_mutex);
+
+    WarmUpRequest request = {table_id, {}};
+    if (!enabled || !read_warm_up_manifest(table_id, &request.pagenums)) {
+        return;
+    }
+
+    // Colder pages would not fit in the buffer anyway.
+    pthread_mutex_lock(&resize_mutex);
+    size_t capacity = buffer_size;
+    pthread_mutex_unlock(&resize_mutex);
+    size_t dropped = 0;
+    if (request.pagenums.size() > capacity) {
+        dropped = request.pagenums.size() - capacity;
+        request.pagenums.resize(capacity);
+    }
+
+    pthread_mutex_lock(&warmer_mutex);
+    warm_up_stats.skipped_pages += dropped;
+    if (warm_up_enabled) {
+        warm_up_requests.push_back(std::move(request));
+        warm_up_stats.pending_tables++;
+
+        if (!warmer_running) {
+            if (warmer_joinable) {
+                pthread_join(warmer_thread, nullptr);
+                warmer_joinable = false;
+            }
+            warmer_running = pthread_create(&warmer_thread, nullptr,
+                                            warmer_main, nullptr) == 0;
+            if (!warmer_running) {
+                warm_up_requests.clear();
+                warm_up_stats.pending_tables = 0;
+            }
+        }
+    }
+    pthread_mutex_unlock(&warmer_mutex);
+}
+
+int warm_up_frame(tableid_t table_id, pagenum_t pagenum, bool wait,
+                  FrameLoad* load) {
+    auto page_location = std::make_pair(table_id, pagenum);
+    BufferShard& shard = get_shard(page_location);
+    if (shard.index.find(page_location) >= 0) {
+        return 0;
+    }
+
+    if (wait) {
+        pthread_mutex_lock(&shard.mutex);
+    } else if (pthread_mutex_trylock(&shard.mutex) != 0) {
         return -1;
     }
 
-    buffer_index.erase(buffer_evict->page_location);
+    const TableShare& share = get_table_share(shard, table_id);
+    int frame_idx = -1;
+    if (!shard.free_frames.empty() && shard.index.find(page_location) < 0 &&
+        !is_evicting(shard, page_location) &&
+        shard.fallback_pages.count(page_location) == 0 &&
+        (share.max_frames == 0 || share.frame_count < share.max_frames)) {
+        frame_idx = begin_load(shard, page_location, NORMAL_ACCESS, load);
+    }
+    pthread_mutex_unlock(&shard.mutex);
+    return frame_idx >= 0 ? 1 : 0;
+}
+
+void load_warm_up_frames(tableid_t table_id,
+                         const std::vector<FrameLoad>& loads) {
+    std::vector<PageBuffer> pages;
+    for (const FrameLoad& load : loads) {
+        BufferShard& shard = get_shard(load.page_location);
+        write_back_evicted(shard, load);
 
-    // Flush to file if dirty
-    if (buffer_evict->is_dirty) {
-        tableid_t table_id;
-        pagenum_t page_num;
-        std::tie(table_id, page_num) = buffer_evict->page_location;
-        file_write_page(table_id, page_num, &buffer_evict->page);
+        BufferBlock* frame = get_frame(shard, load.frame_idx);
+        if (!victim_cache_helper::take_page(load.page_location, frame->page)) {
+            pages.push_back({load.page_location.second, frame->page});
+        }
+    }
+    file_read_pages(table_id, pages.data(), pages.size());
+
+    for (const FrameLoad& load : loads) {
+        BufferShard& shard = get_shard(load.page_location);
+        pthread_mutex_lock(&shard.mutex);
+        end_load(shard, load.frame_idx);
+        pthread_mutex_unlock(&shard.mutex);
+    }
+}
+
+void warm_up_table(const WarmUpRequest& request) {
+    std::vector<pagenum_t> pagenums = request.pagenums;
+    std::sort(pagenums.begin(), pagenums.end());
+    pagenums.erase(std::unique(pagenums.begin(), pagenums.end()),
+                   pagenums.end());
+
+    std::vector<pagenum_t> deferred;
+    std::vector<FrameLoad> loads;
+    uint64_t warmed = 0, skipped = 0;
+    for (size_t begin = 0; begin < pagenums.size();) {
+        size_t end = begin + 1;
+        while (end < pagenums.size() &&
+               static_cast<int>(end - begin) < MAX_WARM_UP_RUN_PAGES &&
+               pagenums[end] == pagenums[end - 1] + 1) {
+            end++;
+        }
+        loads.clear();
+        for (size_t i = begin; i < end; i++) {
+            FrameLoad load;
+            int result =
+                warm_up_frame(request.table_id, pagenums[i], false, &load);
+            if (result < 0) {
+                // Foreground accesses come first.
+                deferred.push_back(pagenums[i]);
+            } else {
+                if (result > 0) loads.push_back(load);
+                warmed += result;
+                skipped += 1 - result;
+            }
+        }
+        load_warm_up_frames(request.table_id, loads);
+        begin = end;
+
+        pthread_mutex_lock(&warmer_mutex);
+        warm_up_stats.warmed_pages += warmed;
+        warm_up_stats.skipped_pages += skipped;
+        bool enabled = warm_up_enabled;
+        pthread_mutex_unlock(&warmer_mutex);
+        warmed = skipped = 0;
+        if (!enabled) return;
+    }
+
+    for (pagenum_t pagenum : deferred) {
+        FrameLoad load;
+        int result = warm_up_frame(request.table_id, pagenum, true, &load);
+        if (result > 0) load_warm_up_frames(request.table_id, {load});
+        warmed += result;
+        skipped += 1 - result;
+    }
+    pthread_mutex_lock(&warmer_mutex);
+    warm_up_stats.warmed_pages += warmed;
+    warm_up_stats.skipped_pages += skipped;
+    pthread_mutex_unlock(&warmer_mutex);
+}
+
+void* warmer_main([[maybe_unused]] void* arg) {
+    pthread_mutex_lock(&warmer_mutex);
+    while (warm_up_enabled && !warm_up_requests.empty()) {
+        WarmUpRequest request = std::move(warm_up_requests.front());
+        warm_up_requests.pop_front();
+        warming_table_id = request.table_id;
+        pthread_mutex_unlock(&warmer_mutex);
+
+        warm_up_table(request);
+
+        pthread_mutex_lock(&warmer_mutex);
+        warming_table_id = -1;
+        warm_up_stats.pending_tables--;
+    }
+    warmer_running = false;
+    warmer_joinable = true;
+    pthread_mutex_unlock(&warmer_mutex);
+    return nullptr;
+}
+
+void set_dirty(BufferShard& shard, BufferBlock* frame, bool is_dirty) {
+    if (frame->is_dirty != is_dirty) {
+        frame->is_dirty = is_dirty;
+        shard.dirty_count += is_dirty ? 1 : -1;
+    }
+}
+
+void write_frames(
+    const std::vector<std::pair<PageLocation, BufferBlock*>>& batch) {
+    std::vector<PageBuffer> pages;
+    for (size_t begin = 0; begin < batch.size();) {
+        tableid_t table_id = batch[begin].first.first;
+
+        pages.clear();
+        size_t end = begin;
+        for (; end < batch.size() && batch[end].first.first == table_id;
+             end++) {
+            pages.push_back({batch[end].first.second, batch[end].second->page});
+        }
+        file_write_pages(table_id, pages.data(), pages.size());
+        begin = end;
     }
-    return evicted_idx;
 }
 
-void move_to_head(int buffer_idx) {
-    if(buffer_idx == buffer_head_idx) return;
+int flush_frames(
+    const std::vector<std::pair<PageLocation, BufferBlock*>>& batch) {
+    std::vector<std::pair<PageLocation, BufferBlock*>> latched, busy;
+    for (const auto& dirty_page : batch) {
+        if (pthread_rwlock_tryrdlock(&dirty_page.second->latch) == 0) {
+            latched.push_back(dirty_page);
+        } else {
+            busy.push_back(dirty_page);
+        }
+    }
+
+    write_frames(latched);
+    for (const auto& dirty_page : latched) {
+        unlatch_frame(dirty_page.second);
+    }
 
-    BufferBlock* buffer_page = buffer_slot + buffer_idx;
-    BufferBlock* buffer_head = buffer_slot + buffer_head_idx;
+    for (const auto& dirty_page : busy) {
+        latch_frame(dirty_page.second, SHARED_LATCH);
+        write_frames({dirty_page});
+        unlatch_frame(dirty_page.second);
+    }
 
-    if (buffer_page->prev_block_idx != -1) {
-        BufferBlock* buffer_prev = buffer_slot + (buffer_page->prev_block_idx);
-        buffer_prev->next_block_idx = buffer_page->next_block_idx;
+    for (const auto& dirty_page : batch) {
+        BufferShard& shard = get_shard(dirty_page.first);
+        pthread_mutex_lock(&shard.mutex);
+        dirty_page.second->guard_count--;
+        shard.flush_writes++;
+        wake_frame_waiters(shard);
+        pthread_mutex_unlock(&shard.mutex);
     }
+    return batch.size();
+}
+
+void* flusher_main(void* arg) {
+    flush_frames(
+        *reinterpret_cast<std::vector<std::pair<PageLocation, BufferBlock*>>*>(
+            arg));
+    return nullptr;
+}
 
-    if (buffer_page->next_block_idx != -1) {
-        BufferBlock* buffer_next = buffer_slot + (buffer_page->next_block_idx);
-        buffer_next->prev_block_idx = buffer_page->prev_block_idx;
+int clean_cold_frames(double clean_share) {
+    std::vector<std::pair<PageLocation, BufferBlock*>> batch;
+
+    for (int shard_idx = 0; shard_idx < buffer_shard_count; shard_idx++) {
+        BufferShard& shard = buffer_shards[shard_idx];
+
+        pthread_mutex_lock(&shard.mutex);
+        int clean_window =
+            std::max(1, static_cast<int>(shard.size * clean_share));
+        if (shard.dirty_count > 0) {
+            shard.policy->visit_coldest(
+                [&shard, &batch](int frame_idx) {
+                    BufferBlock* frame = get_frame(shard, frame_idx);
+                    // Guarded pages may be in the middle of modification.
+                    if (frame->is_dirty && frame->guard_count == 0) {
+                        frame->guard_count++;
+                        set_dirty(shard, frame, false);
+                        batch.emplace_back(frame->page_location, frame);
+                    }
+                },
+                clean_window);
+        }
+        pthread_mutex_unlock(&shard.mutex);
     }
 
-    if(buffer_idx == buffer_tail_idx) {
-        buffer_tail_idx = buffer_page->prev_block_idx;
+    // Waiting for a writer while holding other latches of the batch could
+    // deadlock, so busy frames are left dirty.
+    std::vector<std::pair<PageLocation, BufferBlock*>> latched;
+    for (const auto& dirty_page : batch) {
+        BufferBlock* frame = dirty_page.second;
+        if (pthread_rwlock_tryrdlock(&frame->latch) == 0) {
+            latched.push_back(dirty_page);
+            continue;
+        }
+
+        BufferShard& shard = get_shard(dirty_page.first);
+        pthread_mutex_lock(&shard.mutex);
+        set_dirty(shard, frame, true);
+        frame->guard_count--;
+        wake_frame_waiters(shard);
+        pthread_mutex_unlock(&shard.mutex);
     }
 
-    buffer_page->prev_block_idx = -1;
-    buffer_page->next_block_idx = buffer_head_idx;
-    buffer_head->prev_block_idx = buffer_idx;
+    std::sort(latched.begin(), latched.end());
+    write_frames(latched);
+
+    for (const auto& dirty_page : latched) {
+        BufferShard& shard = get_shard(dirty_page.first);
+        unlatch_frame(dirty_page.second);
 
-    buffer_head_idx = buffer_idx;
+        pthread_mutex_lock(&shard.mutex);
+        dirty_page.second->guard_count--;
+        shard.cleaner_writes++;
+        wake_frame_waiters(shard);
+        pthread_mutex_unlock(&shard.mutex);
+    }
+    return latched.size();
+}
+
+fullpage_t* map_page_chunk() {
+    void* pages = MAP_FAILED;
+    if (buffer_huge_pages) {
+        pages = mmap(nullptr, HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+    if (pages == MAP_FAILED) {
+        pages = mmap(nullptr, HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (pages == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        // No huge page is reserved, so ask for a transparent one.
+        if (buffer_huge_pages) {
+            madvise(pages, HUGE_PAGE_SIZE, MADV_HUGEPAGE);
+        }
+    }
+    return reinterpret_cast<fullpage_t*>(pages);
+}
+
+void grow_shard(BufferShard& shard, int new_size) {
+    pthread_mutex_lock(&shard.mutex);
+    shard.index.reserve(new_size);
+    shard.policy->resize(new_size);
+    pthread_mutex_unlock(&shard.mutex);
+
+    // Only serialized resizes change the size, so the frames beyond it are
+    // prepared without the shard mutex.
+    while (shard.size < new_size) {
+        int begin = shard.size;
+        int end = std::min(new_size,
+                           (begin / FRAME_CHUNK_SIZE + 1) * FRAME_CHUNK_SIZE);
+
+        if (begin == shard.frame_count) {
+            fullpage_t* pages = map_page_chunk();
+            BufferBlock* chunk;
+            try {
+                chunk = new BufferBlock[FRAME_CHUNK_SIZE];
+            } catch (const std::bad_alloc& err) {
+                munmap(pages, HUGE_PAGE_SIZE);
+                throw;
+            }
+            for (int i = 0; i < FRAME_CHUNK_SIZE; i++) {
+                BufferBlock& frame = chunk[i];
+                frame.page = nullptr;
+                frame.page_location = EMPTY_PAGE_LOCATION;
+
+                pthread_rwlock_init(&frame.latch, nullptr);
+                frame.is_dirty = false;
+                frame.is_prefetched = false;
+                frame.is_loading = false;
+                frame.version = 0;
+                frame.pin_count = 0;
+                frame.guard_count = -1;
+            }
+            shard.chunks[begin / FRAME_CHUNK_SIZE] = chunk;
+            shard.page_chunks[begin / FRAME_CHUNK_SIZE] = pages;
+            shard.frame_count += FRAME_CHUNK_SIZE;
+        }
+        for (int frame_idx = begin; frame_idx < end; frame_idx++) {
+            get_frame(shard, frame_idx)->page =
+                shard.page_chunks[frame_idx / FRAME_CHUNK_SIZE] +
+                frame_idx % FRAME_CHUNK_SIZE;
+        }
+
+        pthread_mutex_lock(&shard.mutex);
+        for (int frame_idx = begin; frame_idx < end; frame_idx++) {
+            get_frame(shard, frame_idx)->guard_count = 0;
+            // Pop from the back, so lower frames are used first.
+            shard.free_frames.push_front(frame_idx);
+        }
+        shard.size = end;
+        wake_frame_waiters(shard);
+        pthread_mutex_unlock(&shard.mutex);
+    }
+}
+
+void shrink_shard(BufferShard& shard, int new_size) {
+    int old_size = shard.size;
+
+    pthread_mutex_lock(&shard.mutex);
+    shard.size = new_size;
+    shard.free_frames.erase(
+        std::remove_if(shard.free_frames.begin(), shard.free_frames.end(),
+                       [new_size](int frame_idx) {
+                           return frame_idx >= new_size;
+                       }),
+        shard.free_frames.end());
+    pthread_mutex_unlock(&shard.mutex);
+
+    for (;;) {
+        int busy_count = 0;
+        std::vector<BufferBlock*> dirty_frames;
+
+        pthread_mutex_lock(&shard.mutex);
+        for (int frame_idx = new_size; frame_idx < old_size; frame_idx++) {
+            BufferBlock* frame = get_frame(shard, frame_idx);
+            if (frame->page == nullptr) continue;
+            // Written back after the shard mutex is released, and retired by
+            // the next pass unless it is modified again.
+            if (frame->is_dirty && frame->guard_count == 0) {
+                frame->guard_count++;
+                set_dirty(shard, frame, false);
+                dirty_frames.push_back(frame);
+                busy_count++;
+                continue;
+            }
+            if (frame->pin_count > 0 || !claim_frame(frame)) {
+                busy_count++;
+                continue;
+            }
+
+            // Free frames are not indexed.
+            if (shard.index.find(frame->page_location) == frame_idx) {
+                shard.policy->on_evict(frame_idx);
+                if (frame->is_prefetched) {
+                    frame->is_prefetched = false;
+                    shard.prefetch_wasted++;
+                }
+                shard.index.erase(frame->page_location);
+                get_table_share(shard, frame->page_location.first)
+                    .frame_count--;
+                victim_cache_helper::store_page(frame->page_location,
+                                                frame->page);
+            }
+
+            // Claimed for good, so stale lookups never pin it, and
+            // optimistic readers fail to validate.
+            frame->version.fetch_add(1);
+            frame->page_location = EMPTY_PAGE_LOCATION;
+            // Give the memory back, unless a huge page backs it.
+            madvise(frame->page, PAGE_SIZE, MADV_DONTNEED);
+            frame->page = nullptr;
+            frame->version.fetch_add(1, std::memory_order_release);
+        }
+
+        if (busy_count == 0) {
+            shard.policy->resize(new_size);
+            pthread_mutex_unlock(&shard.mutex);
+            return;
+        }
+        pthread_mutex_unlock(&shard.mutex);
+
+        if (dirty_frames.empty()) {
+            usleep(RESIZE_RETRY_INTERVAL_MS * 1000);
+        }
+        // Write back like the cleaner.
+        for (BufferBlock* frame : dirty_frames) {
+            latch_frame(frame, SHARED_LATCH);
+            file_write_page(frame->page_location.first,
+                            frame->page_location.second, frame->page);
+            unlatch_frame(frame);
+
+            pthread_mutex_lock(&shard.mutex);
+            frame->guard_count--;
+            shard.eviction_writes++;
+            wake_frame_waiters(shard);
+            pthread_mutex_unlock(&shard.mutex);
+        }
+    }
+}
+
+int collect_dirty_frames(
+    BufferShard& shard, tableid_t table_id,
+    std::vector<std::pair<PageLocation, BufferBlock*>>* batch) {
+    int count = 0;
+    for (int frame_idx = 0; frame_idx < shard.size; frame_idx++) {
+        BufferBlock* frame = get_frame(shard, frame_idx);
+        if (frame->page_location.first == table_id && frame->is_dirty &&
+            frame->guard_count >= 0) {
+            frame->guard_count++;
+            set_dirty(shard, frame, false);
+            batch->emplace_back(frame->page_location, frame);
+            count++;
+        }
+    }
+    return count;
+}
+
+int flush_table_frames(tableid_t table_id) {
+    // Frames claimed for eviction are written by the eviction itself.
+    std::vector<std::pair<PageLocation, BufferBlock*>> batch;
+    for (int shard_idx = 0; shard_idx < buffer_shard_count; shard_idx++) {
+        BufferShard& shard = buffer_shards[shard_idx];
+        pthread_mutex_lock(&shard.mutex);
+        collect_dirty_frames(shard, table_id, &batch);
+        pthread_mutex_unlock(&shard.mutex);
+    }
+    std::sort(batch.begin(), batch.end());
+    return flush_frames(batch);
+}
+
+void drop_table_frames(BufferShard& shard, tableid_t table_id) {
+    for (;;) {
+        int busy_count = 0;
+        std::vector<std::pair<PageLocation, BufferBlock*>> batch;
+
+        pthread_mutex_lock(&shard.mutex);
+        for (const PageLocation& evicting : shard.evicting_pages) {
+            busy_count += evicting.first == table_id;
+        }
+        // Written back after the shard mutex is released, and dropped by the
+        // next pass unless they are modified again.
+        busy_count += collect_dirty_frames(shard, table_id, &batch);
+        for (int frame_idx = 0; frame_idx < shard.size; frame_idx++) {
+            BufferBlock* frame = get_frame(shard, frame_idx);
+            if (frame->page_location.first != table_id ||
+                shard.index.find(frame->page_location) != frame_idx ||
+                frame->is_dirty) {
+                continue;
+            }
+            if (frame->pin_count > 0 || !claim_frame(frame)) {
+                busy_count++;
+                continue;
+            }
+
+            shard.policy->on_evict(frame_idx);
+            if (frame->is_prefetched) {
+                frame->is_prefetched = false;
+                shard.prefetch_wasted++;
+            }
+            shard.index.erase(frame->page_location);
+
+            // Optimistic readers of the page fail to validate.
+            frame->version.fetch_add(2, std::memory_order_release);
+            frame->page_location = EMPTY_PAGE_LOCATION;
+            frame->guard_count.store(0, std::memory_order_release);
+            shard.free_frames.push_back(frame_idx);
+        }
+
+        if (busy_count == 0) {
+            shard.table_shares.erase(table_id);
+            wake_frame_waiters(shard);
+            pthread_mutex_unlock(&shard.mutex);
+            return;
+        }
+        pthread_mutex_unlock(&shard.mutex);
+
+        if (batch.empty()) {
+            usleep(RESIZE_RETRY_INTERVAL_MS * 1000);
+        }
+        std::sort(batch.begin(), batch.end());
+        flush_frames(batch);
+    }
+}
+
+void discard_page_frames(BufferShard& shard, tableid_t table_id,
+                         const std::function<bool(pagenum_t)>& is_discarded) {
+    for (;;) {
+        int busy_count = 0;
+
+        pthread_mutex_lock(&shard.mutex);
+        for (const PageLocation& evicting : shard.evicting_pages) {
+            busy_count +=
+                evicting.first == table_id && is_discarded(evicting.second);
+        }
+        for (int frame_idx = 0; frame_idx < shard.size; frame_idx++) {
+            BufferBlock* frame = get_frame(shard, frame_idx);
+            if (frame->page_location.first != table_id ||
+                shard.index.find(frame->page_location) != frame_idx ||
+                !is_discarded(frame->page_location.second)) {
+                continue;
+            }
+            if (frame->pin_count > 0 || !claim_frame(frame)) {
+                busy_count++;
+                continue;
+            }
+
+            shard.policy->on_evict(frame_idx);
+            if (frame->is_prefetched) {
+                frame->is_prefetched = false;
+                shard.prefetch_wasted++;
+            }
+            shard.index.erase(frame->page_location);
+            get_table_share(shard, table_id).frame_count--;
+            if (frame->is_dirty) {
+                set_dirty(shard, frame, false);
+            }
+
+            // Optimistic readers of the page fail to validate.
+            frame->version.fetch_add(2, std::memory_order_release);
+            frame->page_location = EMPTY_PAGE_LOCATION;
+            frame->guard_count.store(0, std::memory_order_release);
+            shard.free_frames.push_back(frame_idx);
+        }
+
+        if (busy_count == 0) {
+            wake_frame_waiters(shard);
+            pthread_mutex_unlock(&shard.mutex);
+            return;
+        }
+        pthread_mutex_unlock(&shard.mutex);
+        usleep(RESIZE_RETRY_INTERVAL_MS * 1000);
+    }
+}
+
+void cancel_background_requests(tableid_t table_id) {
+    for (;;) {
+        pthread_mutex_lock(&prefetcher_mutex);
+        read_ahead_requests.erase(
+            std::remove_if(read_ahead_requests.begin(),
+                           read_ahead_requests.end(),
+                           [table_id](const ReadAheadRequest& request) {
+                               return request.table_id == table_id;
+                           }),
+            read_ahead_requests.end());
+        sequential_states.erase(table_id);
+        bool is_reading = read_ahead_table_id == table_id;
+        pthread_mutex_unlock(&prefetcher_mutex);
+
+        pthread_mutex_lock(&warmer_mutex);
+        size_t request_count = warm_up_requests.size();
+        warm_up_requests.erase(
+            std::remove_if(warm_up_requests.begin(), warm_up_requests.end(),
+                           [table_id](const WarmUpRequest& request) {
+                               return request.table_id == table_id;
+                           }),
+            warm_up_requests.end());
+        warm_up_stats.pending_tables -= request_count - warm_up_requests.size();
+        bool is_warming = warming_table_id == table_id;
+        pthread_mutex_unlock(&warmer_mutex);
+
+        if (!is_reading && !is_warming) break;
+        usleep(RESIZE_RETRY_INTERVAL_MS * 1000);
+    }
+}
+
+void* cleaner_main([[maybe_unused]] void* arg) {
+    pthread_mutex_lock(&cleaner_mutex);
+    while (cleaner_running) {
+        double clean_share = cleaner_share;
+        pthread_mutex_unlock(&cleaner_mutex);
+
+        clean_cold_frames(clean_share);
+
+        pthread_mutex_lock(&cleaner_mutex);
+        if (!cleaner_running) break;
+
+        timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += cleaner_interval_ms / 1000;
+        deadline.tv_nsec += (cleaner_interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&cleaner_cond, &cleaner_mutex, &deadline);
+    }
+    pthread_mutex_unlock(&cleaner_mutex);
+    return nullptr;
+}
+
+void write_space_header(tableid_t table_id, pagenum_t free_page_idx,
+                        pagenum_t unformatted_page_idx, pagenum_t page_num,
+                        const std::vector<PageRun>& holes) {
+    PageGuard<headerpage_t> header_page(table_id, 0, EXCLUSIVE_LATCH);
+    space_helper::set_header_fields(header_page.get(), free_page_idx,
+                                    unformatted_page_idx, page_num, holes);
+    header_page.mark_dirty();
 }
 }  // namespace buffer_helper
 
-int init_buffer(int _buffer_size) {
+PageGuardBase::PageGuardBase()
+    : table_id(0),
+      pagenum(0),
+      mode(SHARED_LATCH),
+      frame(nullptr),
+      page(nullptr),
+      is_dirty(false) {}
+
+PageGuardBase::PageGuardBase(tableid_t table_id, pagenum_t pagenum,
+                             LatchMode mode, AccessHint hint)
+    : table_id(table_id),
+      pagenum(pagenum),
+      mode(mode),
+      frame(buffer_helper::pin_frame(table_id, pagenum, hint, mode)),
+      is_dirty(false) {
+    buffer_helper::hold_frame();
+    if (frame != nullptr) {
+        buffer_helper::latch_frame(frame, mode);
+        page = frame->page;
+    } else {
+        // direct I/O fallback
+        buffer_stats_helper::count(BUFFER_FALLBACK);
+        page = new fullpage_t;
+        file_read_page(table_id, pagenum, page);
+    }
+}
+
+PageGuardBase::PageGuardBase(PageGuardBase&& other) noexcept
+    : table_id(other.table_id),
+      pagenum(other.pagenum),
+      mode(other.mode),
+      frame(other.frame),
+      page(other.page),
+      is_dirty(other.is_dirty) {
+    other.frame = nullptr;
+    other.page = nullptr;
+    other.is_dirty = false;
+}
+
+PageGuardBase& PageGuardBase::operator=(PageGuardBase&& other) noexcept {
+    if (this != &other) {
+        release();
+
+        table_id = other.table_id;
+        pagenum = other.pagenum;
+        mode = other.mode;
+        frame = other.frame;
+        page = other.page;
+        is_dirty = other.is_dirty;
+
+        other.frame = nullptr;
+        other.page = nullptr;
+        other.is_dirty = false;
+    }
+    return *this;
+}
+
+PageGuardBase::~PageGuardBase() { release(); }
+
+void PageGuardBase::mark_dirty() {
+    assert(mode == EXCLUSIVE_LATCH);
+    is_dirty = true;
+}
+
+void PageGuardBase::release() {
+    if (page == nullptr) {
+        return;
+    }
+
+    if (frame != nullptr) {
+        buffer_helper::unlatch_frame(frame);
+        buffer_helper::unpin_frame(frame, is_dirty);
+    } else {
+        if (is_dirty) {
+            victim_cache_helper::drop_page(std::make_pair(table_id, pagenum));
+            file_write_page(table_id, pagenum, page);
+        }
+        delete page;
+        buffer_helper::end_fallback(table_id, pagenum);
+    }
+    buffer_helper::drop_frame();
+
+    frame = nullptr;
+    page = nullptr;
+    is_dirty = false;
+}
+
+int init_buffer(int _buffer_size, int _shard_count,
+                ReplacementPolicyType policy, bool huge_pages) {
+    if (buffer_shards != nullptr) {
+        if (_buffer_size == buffer_size && _shard_count == buffer_shard_count) {
+            return 0;
+        } else {
+            return -1;
+        }
+    }
+
+    if (_buffer_size <= 0 || _shard_count <= 0) {
+        return -1;
+    }
+    if (policy < LRU_POLICY || policy > TWO_Q_POLICY) {
+        return -1;
+    }
+    // Every shard should own at least one frame.
+    if (_shard_count > _buffer_size) {
+        _shard_count = _buffer_size;
+    }
+    if (_buffer_size / _shard_count + (_buffer_size % _shard_count != 0) >
+        FRAME_CHUNK_SIZE * MAX_FRAME_CHUNKS) {
+        return -1;
+    }
+
     try {
-        buffer_manager_mutex = new pthread_mutex_t;
-        if (pthread_mutex_init(buffer_manager_mutex, nullptr)) {
+        buffer_huge_pages = huge_pages;
+        buffer_shards = new BufferShard[_shard_count];
+        buffer_shard_count = _shard_count;
+        buffer_size = _buffer_size;
+
+        for (int shard_idx = 0; shard_idx < buffer_shard_count; shard_idx++) {
+            BufferShard& shard = buffer_shards[shard_idx];
+
+            // Spread the remainder frames into the leading shards.
+            int shard_size = buffer_size / buffer_shard_count +
+                             (shard_idx < buffer_size % buffer_shard_count);
+            shard.frame_count = 0;
+            shard.size = 0;
+            shard.index.init(shard_size);
+            shard.policy = make_replacement_policy(
+                policy,
+                [&shard](int frame_idx) -> const PageLocation& {
+                    return buffer_helper::get_frame(shard, frame_idx)
+                        ->page_location;
+                },
+                0);
+            shard.dirty_count = 0;
+            shard.cleaner_writes = 0;
+            shard.eviction_writes = 0;
+            shard.flush_writes = 0;
+            shard.prefetched_pages = 0;
+            shard.prefetch_used = 0;
+            shard.prefetch_wasted = 0;
+            shard.table_shares.clear();
+            shard.has_quotas = false;
+            shard.frame_waiters = 0;
+            pthread_mutex_init(&shard.mutex, nullptr);
+            pthread_cond_init(&shard.frame_cond, nullptr);
+
+            buffer_helper::grow_shard(shard, shard_size);
+        }
+    } catch (const std::bad_alloc& err) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&warmer_mutex);
+    warm_up_stats = {0, 0, 0};
+    pthread_mutex_unlock(&warmer_mutex);
+    reset_buffer_stats();
+
+    if (set_read_ahead(DEFAULT_READ_AHEAD_WINDOW) != 0 ||
+        set_buffer_warm_up(true) != 0) {
+        return -1;
+    }
+    return set_buffer_cleaner(CLEAN_VICTIM_WINDOW);
+}
+
+int resize_buffer(int _buffer_size) {
+    if (buffer_shards == nullptr || _buffer_size < buffer_shard_count) {
+        return -1;
+    }
+    if (_buffer_size / buffer_shard_count +
+            (_buffer_size % buffer_shard_count != 0) >
+        FRAME_CHUNK_SIZE * MAX_FRAME_CHUNKS) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&resize_mutex);
+    // Every shard should keep an unreserved frame.
+    for (int shard_idx = 0; shard_idx < buffer_shard_count; shard_idx++) {
+        BufferShard& shard = buffer_shards[shard_idx];
+        int reserved_frames = 0;
+        pthread_mutex_lock(&shard.mutex);
+        for (const auto& share : shard.table_shares) {
+            reserved_frames += share.second.min_frames;
+        }
+        pthread_mutex_unlock(&shard.mutex);
+
+        if (reserved_frames >=
+            buffer_helper::get_shard_share(_buffer_size, shard_idx)) {
+            pthread_mutex_unlock(&resize_mutex);
             return -1;
         }
+    }
 
-        if (buffer_slot != nullptr) {
-            if (_buffer_size == buffer_size) {
-                return 0;
-            } else {
-                return -1;
+    int result = 0;
+    int resized_size = 0;
+    for (int shard_idx = 0; shard_idx < buffer_shard_count; shard_idx++) {
+        BufferShard& shard = buffer_shards[shard_idx];
+        int shard_size =
+            buffer_helper::get_shard_share(_buffer_size, shard_idx);
+
+        try {
+            if (shard_size > shard.size) {
+                buffer_helper::grow_shard(shard, shard_size);
+            } else if (shard_size < shard.size) {
+                buffer_helper::shrink_shard(shard, shard_size);
             }
+        } catch (const std::bad_alloc& err) {
+            // The shard keeps the frames added so far.
+            result = -1;
         }
-        buffer_size = _buffer_size;
-        buffer_slot = new BufferBlock[buffer_size];
-        for (int i = 0; i < buffer_size; i++) {
-            buffer_slot[i].page_location =
-                std::make_pair(MAX_TABLE_INSTANCE + 1, 0);
+        resized_size += shard.size;
+    }
+    buffer_size = resized_size;
+    pthread_mutex_unlock(&resize_mutex);
+    return result;
+}
 
-            pthread_cond_init(&buffer_slot[i].latch, nullptr);
-            buffer_slot[i].is_dirty = false;
-            buffer_slot[i].pin_count = 0;
-            buffer_slot[i].pin_owner = -1;
+int flush_buffer() {
+    if (buffer_shards == nullptr) {
+        return -1;
+    }
 
-            if (i < buffer_size - 1) buffer_slot[i].next_block_idx = i + 1;
-            if (i > 0) buffer_slot[i].prev_block_idx = i - 1;
+    for (tableid_t table_id = 0; table_id < file_helper::get_table_id_limit();
+         table_id++) {
+        TableInstance* instance = file_helper::enter_table(table_id, false);
+        if (instance == nullptr) continue;
+        space_helper::drain_caches(table_id);
+        persist_table_space(table_id, buffered_write_page,
+                            buffer_helper::write_space_header);
+        file_helper::leave_table(instance);
+    }
+
+    // Frames claimed for eviction are written by the eviction itself.
+    std::vector<std::pair<PageLocation, BufferBlock*>> batch;
+    for (int shard_idx = 0; shard_idx < buffer_shard_count; shard_idx++) {
+        BufferShard& shard = buffer_shards[shard_idx];
+
+        pthread_mutex_lock(&shard.mutex);
+        for (int i = 0; i < shard.size && shard.dirty_count > 0; i++) {
+            BufferBlock* frame = buffer_helper::get_frame(shard, i);
+            if (frame->is_dirty && frame->guard_count >= 0) {
+                frame->guard_count++;
+                buffer_helper::set_dirty(shard, frame, false);
+                batch.emplace_back(frame->page_location, frame);
+            }
+        }
+        pthread_mutex_unlock(&shard.mutex);
+    }
+    std::sort(batch.begin(), batch.end());
+
+    std::vector<std::vector<std::pair<PageLocation, BufferBlock*>>>
+        table_batches;
+    for (const auto& dirty_page : batch) {
+        if (table_batches.empty() ||
+            table_batches.back().back().first.first != dirty_page.first.first) {
+            table_batches.emplace_back();
+        }
+        table_batches.back().push_back(dirty_page);
+    }
+
+    // The first table is flushed by the caller.
+    std::vector<pthread_t> flushers;
+    for (size_t i = 1; i < table_batches.size(); i++) {
+        pthread_t flusher;
+        if (pthread_create(&flusher, nullptr, buffer_helper::flusher_main,
+                           &table_batches[i]) == 0) {
+            flushers.push_back(flusher);
+        } else {
+            buffer_helper::flush_frames(table_batches[i]);
         }
+    }
+    if (!table_batches.empty()) {
+        buffer_helper::flush_frames(table_batches[0]);
+    }
+    for (pthread_t flusher : flushers) {
+        pthread_join(flusher, nullptr);
+    }
+    return 0;
+}
+
+int set_buffer_cleaner(double clean_share, int interval_ms) {
+    if (buffer_shards == nullptr || clean_share < 0 || clean_share > 1 ||
+        interval_ms <= 0) {
+        return -1;
+    }
 
-        buffer_slot[0].prev_block_idx = -1;
-        buffer_slot[buffer_size - 1].next_block_idx = -1;
+    pthread_mutex_lock(&cleaner_mutex);
+    cleaner_share = clean_share;
+    cleaner_interval_ms = interval_ms;
 
-        buffer_head_idx = 0;
-        buffer_tail_idx = buffer_size - 1;
+    if (clean_share > 0 && !cleaner_running) {
+        cleaner_running = true;
+        if (pthread_create(&cleaner_thread, nullptr,
+                           buffer_helper::cleaner_main, nullptr) != 0) {
+            cleaner_running = false;
+            pthread_mutex_unlock(&cleaner_mutex);
+            return -1;
+        }
+    } else if (clean_share == 0 && cleaner_running) {
+        cleaner_running = false;
+        pthread_cond_signal(&cleaner_cond);
+        pthread_mutex_unlock(&cleaner_mutex);
 
+        pthread_join(cleaner_thread, nullptr);
         return 0;
-    } catch (const std::bad_alloc& err) {
+    }
+    pthread_mutex_unlock(&cleaner_mutex);
+    return 0;
+}
+
+int set_read_ahead(int window) {
+    if (buffer_shards == nullptr || window < 0) {
         return -1;
     }
+
+    pthread_mutex_lock(&prefetcher_mutex);
+    read_ahead_window = window;
+
+    if (window > 0 && !prefetcher_running) {
+        prefetcher_running = true;
+        if (pthread_create(&prefetcher_thread, nullptr,
+                           buffer_helper::prefetcher_main, nullptr) != 0) {
+            prefetcher_running = false;
+            pthread_mutex_unlock(&prefetcher_mutex);
+            return -1;
+        }
+    } else if (window == 0 && prefetcher_running) {
+        prefetcher_running = false;
+        read_ahead_requests.clear();
+        sequential_states.clear();
+        pthread_cond_signal(&prefetcher_cond);
+        pthread_mutex_unlock(&prefetcher_mutex);
+
+        pthread_join(prefetcher_thread, nullptr);
+        return 0;
+    }
+    pthread_mutex_unlock(&prefetcher_mutex);
+    return 0;
 }
 
-tableid_t buffered_open_table_file(const char* path) {
-    return file_open_table_file(path);
+int set_buffer_warm_up(bool enabled) {
+    if (buffer_shards == nullptr) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&warmer_mutex);
+    warm_up_enabled = enabled;
+    if (!enabled) {
+        warm_up_stats.pending_tables -= warm_up_requests.size();
+        warm_up_requests.clear();
+    }
+    bool joinable = !enabled && (warmer_running || warmer_joinable);
+    warmer_running = warmer_running && enabled;
+    warmer_joinable = warmer_joinable && enabled;
+    pthread_mutex_unlock(&warmer_mutex);
+
+    // The warmer stops after its current run of pages.
+    if (joinable) {
+        pthread_join(warmer_thread, nullptr);
+
+        pthread_mutex_lock(&warmer_mutex);
+        warmer_joinable = false;
+        pthread_mutex_unlock(&warmer_mutex);
+    }
+    return 0;
+}
+
+WarmUpStats get_warm_up_stats() {
+    pthread_mutex_lock(&warmer_mutex);
+    WarmUpStats stats = warm_up_stats;
+    pthread_mutex_unlock(&warmer_mutex);
+    return stats;
+}
+
+ReadAheadStats get_read_ahead_stats() {
+    ReadAheadStats stats = {0, 0, 0};
+    for (int shard_idx = 0; shard_idx < buffer_shard_count; shard_idx++) {
+        BufferShard& shard = buffer_shards[shard_idx];
+
+        pthread_mutex_lock(&shard.mutex);
+        stats.prefetched_pages += shard.prefetched_pages;
+        stats.used_pages += shard.prefetch_used;
+        stats.wasted_pages += shard.prefetch_wasted;
+        pthread_mutex_unlock(&shard.mutex);
+    }
+    return stats;
+}
+
+DirtyPageStats get_dirty_page_stats() {
+    DirtyPageStats stats = {0, 0, 0, 0};
+    for (int shard_idx = 0; shard_idx < buffer_shard_count; shard_idx++) {
+        BufferShard& shard = buffer_shards[shard_idx];
+
+        pthread_mutex_lock(&shard.mutex);
+        stats.dirty_pages += shard.dirty_count;
+        stats.cleaner_writes += shard.cleaner_writes;
+        stats.eviction_writes += shard.eviction_writes;
+        stats.flush_writes += shard.flush_writes;
+        pthread_mutex_unlock(&shard.mutex);
+    }
+    return stats;
+}
+
+int set_table_buffer_quota(tableid_t table_id, const BufferQuota& quota) {
+    if (buffer_shards == nullptr ||
+        file_helper::find_table_instance(table_id) == nullptr) {
+        return -1;
+    }
+    if (!buffer_helper::is_valid_quota(quota)) {
+        return -1;
+    }
+
+    // Serialized with resizes, so that the reservations are checked against
+    // the shard sizes they are applied to.
+    pthread_mutex_lock(&resize_mutex);
+    for (int shard_idx = 0; shard_idx < buffer_shard_count; shard_idx++) {
+        BufferShard& shard = buffer_shards[shard_idx];
+        int reserved_frames =
+            buffer_helper::get_shard_share(quota.min_frames, shard_idx);
+        pthread_mutex_lock(&shard.mutex);
+        for (const auto& other : shard.table_shares) {
+            if (other.first != table_id) {
+                reserved_frames += other.second.min_frames;
+            }
+        }
+        int shard_size = shard.size;
+        pthread_mutex_unlock(&shard.mutex);
+
+        if (reserved_frames >= shard_size) {
+            pthread_mutex_unlock(&resize_mutex);
+            return -1;
+        }
+    }
+
+    for (int shard_idx = 0; shard_idx < buffer_shard_count; shard_idx++) {
+        BufferShard& shard = buffer_shards[shard_idx];
+        pthread_mutex_lock(&shard.mutex);
+        TableShare& share = buffer_helper::get_table_share(shard, table_id);
+        share.min_frames =
+            buffer_helper::get_shard_share(quota.min_frames, shard_idx);
+        // Every shard allows at least one frame of a capped table.
+        share.max_frames =
+            quota.max_frames > 0
+                ? std::max(1, buffer_helper::get_shard_share(
+                                  quota.max_frames, shard_idx))
+                : 0;
+        share.priority = quota.priority;
+
+        shard.has_quotas = false;
+        for (const auto& other : shard.table_shares) {
+            if (other.second.min_frames > 0 || other.second.max_frames > 0 ||
+                other.second.priority != NORMAL_PRIORITY) {
+                shard.has_quotas = true;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&shard.mutex);
+    }
+    pthread_mutex_unlock(&resize_mutex);
+    return 0;
 }
 
-pagenum_t buffered_alloc_page(tableid_t table_id, trxid_t trx_id) {
-    file_helper::extend_capacity(table_id);
+tableid_t buffered_open_table_file(const char* path, IOBackend backend,
+                                   bool direct_io, const BufferQuota& quota) {
+    bool has_quota = quota.min_frames != 0 || quota.max_frames != 0 ||
+                     quota.priority != NORMAL_PRIORITY;
+    if (has_quota && !buffer_helper::is_valid_quota(quota)) {
+        return -1;
+    }
 
-    headerpage_t header_page;
+    bool is_opened = false;
+    tableid_t table_id =
+        file_open_table_file(path, backend, direct_io, &is_opened);
+    if (table_id >= 0 && buffer_shards != nullptr) {
+        if (has_quota && set_table_buffer_quota(table_id, quota) != 0) {
+            // The reservation is rejected, so a table opened here is closed.
+            if (is_opened) {
+                buffered_close_table_file(table_id);
+            }
+            return -1;
+        }
+        buffer_helper::queue_warm_up(table_id);
+    }
+    return table_id;
+}
 
-    buffer_helper::load_buffer(table_id, 0, &header_page, trx_id);
+int buffered_close_table_file(tableid_t table_id) {
+    // Running operations hold guards on the frames, so they are waited for
+    // before the frames are dropped.
+    TableInstance* instance = file_helper::begin_close(table_id);
+    if (instance == nullptr) {
+        return -1;
+    }
 
-    // Pop the first page from free page stack.
-    pagenum_t free_page_idx = header_page.free_page_idx;
+    if (buffer_shards != nullptr) {
+        buffer_helper::cancel_background_requests(table_id);
 
-    freepage_t allocated_page;
-    buffer_helper::load_buffer(table_id, free_page_idx, &allocated_page,
-                               trx_id);
+        space_helper::drain_caches(table_id, true);
+        persist_table_space(table_id, buffered_write_page,
+                            buffer_helper::write_space_header);
 
-    // Move the first free page index to the next page.
-    header_page.free_page_idx = allocated_page.next_free_idx;
+        // Serialized with resizes, so that no frame is being retired.
+        pthread_mutex_lock(&resize_mutex);
+        for (int shard_idx = 0; shard_idx < buffer_shard_count; shard_idx++) {
+            buffer_helper::drop_table_frames(buffer_shards[shard_idx],
+                                             table_id);
+        }
+        pthread_mutex_unlock(&resize_mutex);
+        victim_cache_helper::drop_table(table_id);
+    }
+    file_helper::end_close(table_id, instance);
+    return 0;
+}
 
-    buffer_helper::apply_buffer(table_id, 0, &header_page);
-    buffer_helper::apply_buffer(table_id, free_page_idx, &allocated_page);
+int buffered_shrink_table_file(tableid_t table_id, CompactionStats* stats) {
+    if (buffer_shards == nullptr ||
+        file_helper::find_table_instance(table_id) == nullptr) {
+        return -1;
+    }
 
-    return free_page_idx;
+    // Requests queued before pages were moved may point to released pages.
+    buffer_helper::cancel_background_requests(table_id);
+    space_helper::drain_caches(table_id, true);
+
+    TableSpace& space = space_helper::get_space(table_id);
+    pthread_mutex_lock(&space.mutex);
+    pagenum_t page_num = space.page_num;
+    pagenum_t newsize = space_helper::get_used_page_end(space);
+    space_helper::shrink_space(space, newsize);
+    std::vector<PageRun> holes = space_helper::punch_free_pages(space);
+    pthread_mutex_unlock(&space.mutex);
+
+    auto is_released = [newsize, &holes](pagenum_t pagenum) {
+        if (pagenum >= newsize) return true;
+        for (const PageRun& run : holes) {
+            if (pagenum >= run.first && pagenum < run.end) return true;
+        }
+        return false;
+    };
+    pthread_mutex_lock(&resize_mutex);
+    for (int shard_idx = 0; shard_idx < buffer_shard_count; shard_idx++) {
+        buffer_helper::discard_page_frames(buffer_shards[shard_idx], table_id,
+                                           is_released);
+    }
+    pthread_mutex_unlock(&resize_mutex);
+    victim_cache_helper::drop_table(table_id);
+
+    // The header page which records the released pages reaches the disk
+    // before they are released.
+    persist_table_space(table_id, buffered_write_page,
+                        buffer_helper::write_space_header);
+    buffer_helper::flush_table_frames(table_id);
+    space_helper::release_file_pages(table_id, newsize, holes);
+
+    stats->truncated_pages += page_num - newsize;
+    for (const PageRun& run : holes) {
+        stats->punched_pages += run.end - run.first;
+    }
+    return 0;
 }
 
-void buffered_free_page(tableid_t table_id, pagenum_t pagenum, trxid_t trx_id) {
-    headerpage_t header_page;
-    buffer_helper::load_buffer(table_id, 0, &header_page, trx_id);
+pagenum_t buffered_alloc_page(tableid_t table_id,
+                              [[maybe_unused]] trxid_t trx_id) {
+    return space_alloc_page(table_id);
+}
 
-    // Current first free page index
-    pagenum_t old_free_page_idx = header_page.free_page_idx;
-    // Newly freed page
-    freepage_t new_free_page;
-    buffer_helper::load_buffer(table_id, pagenum, &new_free_page, trx_id);
+pagenum_t buffered_alloc_page_near(tableid_t table_id, PageLevel level,
+                                   pagenum_t near_page_idx) {
+    return space_alloc_page_near(table_id, level, near_page_idx);
+}
 
-    // Next free page index of newly freed page is current first free page
-    // index. Its just pushing the pagenum into free page stack.
-    new_free_page.next_free_idx = old_free_page_idx;
-    buffer_helper::apply_buffer(table_id, pagenum, &new_free_page);
+pagenum_t buffered_alloc_page_below(tableid_t table_id, pagenum_t end) {
+    return space_alloc_page_below(table_id, end);
+}
 
-    // Set the first free page to freed page number.
-    header_page.free_page_idx = pagenum;
-    buffer_helper::apply_buffer(table_id, 0, &header_page);
+void buffered_free_page(tableid_t table_id, pagenum_t pagenum,
+                        [[maybe_unused]] trxid_t trx_id) {
+    space_free_page(table_id, pagenum);
 }
 
 void buffered_read_page(tableid_t table_id, pagenum_t pagenum, page_t* dest,
@@ -296,26 +2201,57 @@ void buffered_release_page(tableid_t table_id, pagenum_t pagenum) {
 }
 
 int shutdown_buffer() {
-    if (buffer_slot != nullptr) {
-        for (int i = 0; i < buffer_size; i++) {
-            tableid_t table_id;
-            pagenum_t page_num;
+    if (buffer_shards != nullptr) {
+        pthread_mutex_lock(&warmer_mutex);
+        bool write_manifests = warm_up_enabled;
+        pthread_mutex_unlock(&warmer_mutex);
+
+        set_buffer_warm_up(false);
+        set_buffer_stats_dump(0);
+        set_read_ahead(0);
+        set_buffer_cleaner(0);
+        set_victim_cache(0);
+
+        // Extents are given back before the last flush, so that the table
+        // files are not written after the manifests.
+        for (tableid_t table_id = 0;
+             table_id < file_helper::get_table_id_limit(); table_id++) {
+            if (file_helper::find_table_instance(table_id) != nullptr) {
+                space_helper::drain_caches(table_id, true);
+            }
+        }
+        flush_buffer();
+        if (write_manifests) {
+            buffer_helper::write_warm_up_manifests();
+        }
 
-            BufferBlock* buffer = buffer_slot + i;
-            std::tie(table_id, page_num) = buffer->page_location;
+        for (int shard_idx = 0; shard_idx < buffer_shard_count; shard_idx++) {
+            BufferShard& shard = buffer_shards[shard_idx];
 
-            if (buffer->is_dirty) {
-                file_write_page(table_id, page_num, &buffer->page);
+            for (int i = 0; i < shard.frame_count; i++) {
+                BufferBlock* frame = buffer_helper::get_frame(shard, i);
+                pthread_rwlock_destroy(&frame->latch);
+            }
+            for (int i = 0; i < shard.frame_count / FRAME_CHUNK_SIZE; i++) {
+                delete[] shard.chunks[i];
+                munmap(shard.page_chunks[i], HUGE_PAGE_SIZE);
             }
-            pthread_cond_destroy(&buffer_slot[i].latch);
+            delete shard.policy;
+            pthread_mutex_destroy(&shard.mutex);
+            pthread_cond_destroy(&shard.frame_cond);
         }
-        delete[] buffer_slot;
-        buffer_slot = nullptr;
+        delete[] buffer_shards;
+        buffer_shards = nullptr;
+        buffer_shard_count = 0;
         buffer_size = 0;
-        buffer_index.clear();
+
+        // Pins which are not released are gone with the frames, and the
+        // other threads should not hold any at shutdown.
+        held_frames = 0;
+        frame_holders = 0;
+        blocked_holders = 0;
+        frame_waiting_holders = 0;
     }
-    pthread_mutex_destroy(buffer_manager_mutex);
-    delete buffer_manager_mutex;
 
     file_close_table_files();
     return 0;
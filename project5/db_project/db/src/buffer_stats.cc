@@ -0,0 +1,229 @@
+/**
+ * @addtogroup BufferManager
+ * @{
+ */
+#include <buffer_stats.h>
+#include <pthread.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <ctime>
+#include <vector>
+
+/// @brief counters of the running threads.
+std::vector<ThreadBufferStats*> thread_stats;
+/// @brief sum of the counters of exited threads.
+BufferStats exited_stats = {};
+/// @brief statistics when they are reset, subtracted from the sum.
+BufferStats baseline_stats = {};
+/// @brief mutex which protects the thread counters registry and the sums.
+pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/// @brief statistics dump thread.
+pthread_t dumper_thread;
+/// @brief <code>true</code> if the dump thread is running.
+bool dumper_running = false;
+/// @brief interval(in milliseconds) between dumps.
+int dump_interval_ms = 0;
+/// @brief mutex which protects the dump configuration.
+pthread_mutex_t dumper_mutex = PTHREAD_MUTEX_INITIALIZER;
+/// @brief wakes the dump thread up before its interval.
+pthread_cond_t dumper_cond = PTHREAD_COND_INITIALIZER;
+
+/**
+ * @brief Add the counters of a thread into statistics.
+ *
+ * @param      counters thread counters.
+ * @param[out] stats    statistics to add into.
+ */
+static void add_thread_stats(const ThreadBufferStats& counters,
+                             BufferStats* stats) {
+    uint64_t events[BUFFER_EVENT_COUNT];
+    for (int event = 0; event < BUFFER_EVENT_COUNT; event++) {
+        events[event] = counters.events[event].load(std::memory_order_relaxed);
+    }
+    stats->hits += events[BUFFER_HIT];
+    stats->misses += events[BUFFER_MISS];
+    stats->evictions += events[BUFFER_EVICTION];
+    stats->dirty_evictions += events[BUFFER_DIRTY_EVICTION];
+    stats->fallbacks += events[BUFFER_FALLBACK];
+    stats->pin_waits += events[BUFFER_PIN_WAIT];
+    stats->latch_waits += events[BUFFER_LATCH_WAIT];
+    stats->latch_wait_ns += events[BUFFER_LATCH_WAIT_NS];
+    stats->io_waits += events[BUFFER_IO_WAIT];
+    stats->frame_waits += events[BUFFER_FRAME_WAIT];
+
+    size_t table_count = counters.table_hits.size();
+    if (stats->table_hits.size() < table_count) {
+        stats->table_hits.resize(table_count, 0);
+        stats->table_misses.resize(table_count, 0);
+    }
+    for (size_t table_id = 0; table_id < table_count; table_id++) {
+        stats->table_hits[table_id] +=
+            counters.table_hits[table_id].load(std::memory_order_relaxed);
+        stats->table_misses[table_id] +=
+            counters.table_misses[table_id].load(std::memory_order_relaxed);
+    }
+}
+
+ThreadBufferStats::ThreadBufferStats() {
+    for (auto& counter : events) counter.store(0, std::memory_order_relaxed);
+
+    pthread_mutex_lock(&stats_mutex);
+    thread_stats.push_back(this);
+    pthread_mutex_unlock(&stats_mutex);
+}
+
+ThreadBufferStats::~ThreadBufferStats() {
+    pthread_mutex_lock(&stats_mutex);
+    add_thread_stats(*this, &exited_stats);
+    for (size_t i = 0; i < thread_stats.size(); i++) {
+        if (thread_stats[i] == this) {
+            thread_stats[i] = thread_stats.back();
+            thread_stats.pop_back();
+            break;
+        }
+    }
+    pthread_mutex_unlock(&stats_mutex);
+}
+
+namespace buffer_stats_helper {
+ThreadBufferStats& get_thread_stats() {
+    static thread_local ThreadBufferStats local_stats;
+    return local_stats;
+}
+
+void count_access(tableid_t table_id, bool is_hit) {
+    ThreadBufferStats& local_stats = get_thread_stats();
+    if (local_stats.table_hits.size() <= static_cast<size_t>(table_id)) {
+        pthread_mutex_lock(&stats_mutex);
+        while (local_stats.table_hits.size() <= static_cast<size_t>(table_id)) {
+            local_stats.table_hits.emplace_back(0);
+            local_stats.table_misses.emplace_back(0);
+        }
+        pthread_mutex_unlock(&stats_mutex);
+    }
+    std::atomic<uint64_t>& counter = is_hit ? local_stats.table_hits[table_id]
+                                            : local_stats.table_misses[table_id];
+    counter.store(counter.load(std::memory_order_relaxed) + 1,
+                  std::memory_order_relaxed);
+    count(is_hit ? BUFFER_HIT : BUFFER_MISS);
+}
+
+void collect(BufferStats* stats) {
+    pthread_mutex_lock(&stats_mutex);
+    *stats = exited_stats;
+    for (const ThreadBufferStats* counters : thread_stats) {
+        add_thread_stats(*counters, stats);
+    }
+    pthread_mutex_unlock(&stats_mutex);
+}
+
+void print_stats(const BufferStats& stats) {
+    uint64_t accesses = stats.hits + stats.misses;
+    fprintf(stderr,
+            "buffer: hits=%" PRIu64 " misses=%" PRIu64 " hit_ratio=%.2f%%"
+            " evictions=%" PRIu64 " dirty_evictions=%" PRIu64
+            " fallbacks=%" PRIu64 " pin_waits=%" PRIu64 " latch_waits=%" PRIu64
+            " latch_wait_us=%" PRIu64 " io_waits=%" PRIu64
+            " frame_waits=%" PRIu64 "\n",
+            stats.hits, stats.misses,
+            accesses > 0 ? 100.0 * stats.hits / accesses : 0.0,
+            stats.evictions, stats.dirty_evictions, stats.fallbacks,
+            stats.pin_waits, stats.latch_waits, stats.latch_wait_ns / 1000,
+            stats.io_waits, stats.frame_waits);
+    for (size_t table_id = 0; table_id < stats.table_hits.size();
+         table_id++) {
+        if (stats.table_hits[table_id] + stats.table_misses[table_id] > 0) {
+            fprintf(stderr,
+                    "buffer: table=%zu hits=%" PRIu64 " misses=%" PRIu64 "\n",
+                    table_id, stats.table_hits[table_id],
+                    stats.table_misses[table_id]);
+        }
+    }
+}
+
+void* dumper_main([[maybe_unused]] void* arg) {
+    pthread_mutex_lock(&dumper_mutex);
+    while (dumper_running) {
+        timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += dump_interval_ms / 1000;
+        deadline.tv_nsec += (dump_interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&dumper_cond, &dumper_mutex, &deadline);
+        if (!dumper_running) break;
+
+        pthread_mutex_unlock(&dumper_mutex);
+        print_stats(get_buffer_stats());
+        pthread_mutex_lock(&dumper_mutex);
+    }
+    pthread_mutex_unlock(&dumper_mutex);
+    return nullptr;
+}
+}  // namespace buffer_stats_helper
+
+BufferStats get_buffer_stats() {
+    BufferStats stats;
+    buffer_stats_helper::collect(&stats);
+
+    pthread_mutex_lock(&stats_mutex);
+    stats.hits -= baseline_stats.hits;
+    stats.misses -= baseline_stats.misses;
+    stats.evictions -= baseline_stats.evictions;
+    stats.dirty_evictions -= baseline_stats.dirty_evictions;
+    stats.fallbacks -= baseline_stats.fallbacks;
+    stats.pin_waits -= baseline_stats.pin_waits;
+    stats.latch_waits -= baseline_stats.latch_waits;
+    stats.latch_wait_ns -= baseline_stats.latch_wait_ns;
+    stats.io_waits -= baseline_stats.io_waits;
+    stats.frame_waits -= baseline_stats.frame_waits;
+    for (size_t table_id = 0; table_id < baseline_stats.table_hits.size();
+         table_id++) {
+        stats.table_hits[table_id] -= baseline_stats.table_hits[table_id];
+        stats.table_misses[table_id] -= baseline_stats.table_misses[table_id];
+    }
+    pthread_mutex_unlock(&stats_mutex);
+    return stats;
+}
+
+void reset_buffer_stats() {
+    BufferStats stats;
+    buffer_stats_helper::collect(&stats);
+
+    pthread_mutex_lock(&stats_mutex);
+    baseline_stats = stats;
+    pthread_mutex_unlock(&stats_mutex);
+}
+
+int set_buffer_stats_dump(int interval_ms) {
+    if (interval_ms < 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&dumper_mutex);
+    dump_interval_ms = interval_ms;
+
+    if (interval_ms > 0 && !dumper_running) {
+        dumper_running = true;
+        if (pthread_create(&dumper_thread, nullptr,
+                           buffer_stats_helper::dumper_main, nullptr) != 0) {
+            dumper_running = false;
+            pthread_mutex_unlock(&dumper_mutex);
+            return -1;
+        }
+    } else if (interval_ms == 0 && dumper_running) {
+        dumper_running = false;
+        pthread_cond_signal(&dumper_cond);
+        pthread_mutex_unlock(&dumper_mutex);
+
+        pthread_join(dumper_thread, nullptr);
+        return 0;
+    }
+    pthread_mutex_unlock(&dumper_mutex);
+    return 0;
+}
+/** @}*/
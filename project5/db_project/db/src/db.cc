@@ -4,30 +4,83 @@
  */
 #include <buffer.h>
 #include <db.h>
+#include <file.h>
 #include <tree.h>
 #include <lock.h>
 #include <transaction.h>
 
 #include <cstring>
 
-int init_db(int num_buf) {
+/**
+ * @class   TableGate
+ * @brief   Gate of a table held for an operation.
+ * @details Operations hold it shared, and compaction holds it exclusive. The
+ * gate is not held if the table is not open.
+ */
+class TableGate {
+   public:
+    TableGate(tableid_t table_id, bool is_exclusive)
+        : instance(file_helper::enter_table(table_id, is_exclusive)) {}
+    ~TableGate() {
+        if (instance != nullptr) file_helper::leave_table(instance);
+    }
+    TableGate(const TableGate&) = delete;
+    TableGate& operator=(const TableGate&) = delete;
+
+    /// @brief <code>true</code> if the table is open and the gate is held.
+    bool is_held() const { return instance != nullptr; }
+
+   private:
+    /// @brief entered table, <code>nullptr</code> if none.
+    TableInstance* instance;
+};
+
+int init_db(int num_buf, int num_shards, ReplacementPolicyType policy,
+            bool huge_pages) {
     if(init_lock_table() != 0) return -1;
     if(init_trx() != 0) return -1;
-    if(init_buffer(num_buf) != 0) return -1;
+    if(init_buffer(num_buf, num_shards, policy, huge_pages) != 0) return -1;
     return 0;
 }
 
-tableid_t open_table(char* pathname) {
-    return buffered_open_table_file(pathname);
+int db_resize_buffer(int num_buf) { return resize_buffer(num_buf); }
+
+int db_flush() { return flush_buffer(); }
+
+BufferStats db_get_buffer_stats() { return get_buffer_stats(); }
+
+int db_set_buffer_stats_dump(int interval_ms) {
+    return set_buffer_stats_dump(interval_ms);
+}
+
+int db_set_victim_cache(size_t budget_bytes) {
+    return set_victim_cache(budget_bytes);
+}
+
+VictimCacheStats db_get_victim_cache_stats() {
+    return get_victim_cache_stats();
+}
+
+tableid_t open_table(char* pathname, IOBackend backend, bool direct_io,
+                     const BufferQuota& quota) {
+    return buffered_open_table_file(pathname, backend, direct_io, quota);
+}
+
+int close_table(tableid_t table_id) {
+    return buffered_close_table_file(table_id);
 }
 
 int db_insert(tableid_t table_id, recordkey_t key, char* value,
               valsize_t value_size) {
+    TableGate gate(table_id, false);
+    if (!gate.is_held()) return -1;
     return insert_node(table_id, key, value, value_size) != 0 ? 0 : -1;
 }
 
 int db_find(tableid_t table_id, recordkey_t key, char* ret_val,
             valsize_t* value_size) {
+    TableGate gate(table_id, false);
+    if (!gate.is_held()) return -1;
     if (!find_by_key(table_id, key, ret_val, value_size, 0)) {
         return -1;
     }
@@ -36,14 +89,69 @@ int db_find(tableid_t table_id, recordkey_t key, char* ret_val,
 
 int db_find(tableid_t table_id, recordkey_t key, char* ret_val,
             valsize_t* value_size, trxid_t trx_id) {
+    TableGate gate(table_id, false);
+    if (!gate.is_held()) return -1;
     if (!find_by_key(table_id, key, ret_val, value_size, trx_id)) {
         return -1;
     }
     return 0;
 }
 
+int db_scan(
+    tableid_t table_id, recordkey_t begin_key, recordkey_t end_key,
+    const std::function<bool(recordkey_t, const char*, valsize_t)>& visitor,
+    AccessHint hint) {
+    if (begin_key > end_key) {
+        return -1;
+    }
+    TableGate gate(table_id, false);
+    if (!gate.is_held()) return -1;
+    return find_range(table_id, begin_key, end_key, visitor, hint);
+}
+
+int db_get_leaf_fragmentation(tableid_t table_id,
+                              LeafFragmentation* fragmentation) {
+    if (fragmentation == nullptr) {
+        return -1;
+    }
+    TableGate gate(table_id, false);
+    if (!gate.is_held()) return -1;
+    *fragmentation = get_leaf_fragmentation(table_id);
+    return 0;
+}
+
+int db_compact_table(tableid_t table_id, int max_moves,
+                     CompactionStats* stats) {
+    if (stats == nullptr) {
+        return -1;
+    }
+    *stats = {};
+    while (true) {
+        TableGate gate(table_id, true);
+        if (!gate.is_held()) return -1;
+        // Record locks refer to the pages which would be moved.
+        if (lock_is_table_locked(table_id)) return -1;
+
+        int batch_moves = COMPACTION_BATCH_MOVES;
+        if (max_moves >= 0 && max_moves < batch_moves) {
+            batch_moves = max_moves;
+        }
+        uint64_t moved_pages = stats->moved_pages;
+        if (move_tree_pages(table_id, batch_moves, stats) != 0) return -1;
+        moved_pages = stats->moved_pages - moved_pages;
+        if (max_moves >= 0) max_moves -= moved_pages;
+
+        if (moved_pages < static_cast<uint64_t>(batch_moves) ||
+            max_moves == 0) {
+            return buffered_shrink_table_file(table_id, stats);
+        }
+    }
+}
+
 int db_update(tableid_t table_id, recordkey_t key, char* value,
               valsize_t new_val_size, valsize_t* old_val_size, trxid_t trx_id) {
+    TableGate gate(table_id, false);
+    if (!gate.is_held()) return -1;
     if (!update_node(table_id, key, value, new_val_size, old_val_size,
                      trx_id)) {
         return -1;
@@ -52,6 +160,8 @@ int db_update(tableid_t table_id, recordkey_t key, char* value,
 }
 
 int db_delete(tableid_t table_id, recordkey_t key) {
+    TableGate gate(table_id, false);
+    if (!gate.is_held()) return -1;
     if (!delete_node(table_id, key)) {
         return -1;
     }
@@ -6,65 +6,167 @@
 #include <errors.h>
 #include <fcntl.h>
 #include <file.h>
+#include <limits.h>
+#include <sched.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
-/// @brief current table instance number
-int table_instance_count = 0;
-/// @brief all table instances
-TableInstance table_instances[MAX_TABLE_INSTANCE];
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class   TableSlot
+ * @brief   Slot of a table id.
+ */
+struct TableSlot {
+    /// @brief table instance, <code>nullptr</code> if the table is closed.
+    std::atomic<TableInstance*> instance;
+    /// @brief number of threads between finding the instance and counting
+    /// themselves as its users.
+    std::atomic<int> entering_count;
+};
+
+/// @brief chunks of <code>TABLE_CHUNK_SIZE</code> table slots, indexed by
+/// table id.
+TableSlot* table_chunks[MAX_TABLE_CHUNKS];
+/// @brief next table id, published after its slot is set.
+std::atomic<tableid_t> next_table_id(0);
+/// @brief real path to table id map of the open tables.
+std::unordered_map<std::string, tableid_t> table_paths;
+/// @brief mutex which serializes opens and closes.
+pthread_mutex_t table_registry_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 namespace file_helper {
 TableInstance& get_table_instance(tableid_t table_id) {
-    error::ok(table_id < table_instance_count);
-    return table_instances[table_id];
+    TableInstance* instance = find_table_instance(table_id);
+    error::ok(instance != nullptr);
+    return *instance;
 }
 
-void extend_capacity(tableid_t table_id, pagenum_t newsize) {
-    auto& instance = get_table_instance(table_id);
+TableInstance* find_table_instance(tableid_t table_id) {
+    if (table_id < 0 ||
+        table_id >= next_table_id.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    return table_chunks[table_id / TABLE_CHUNK_SIZE][table_id %
+                                                     TABLE_CHUNK_SIZE]
+        .instance.load(std::memory_order_acquire);
+}
 
-    int table_fd = instance.file_descriptor;
-    headerpage_t header_page;
-    error::ok(pread64(table_fd, &header_page, PAGE_SIZE, 0));
+tableid_t get_table_id_limit() {
+    return next_table_id.load(std::memory_order_acquire);
+}
 
-    if (newsize > header_page.page_num || header_page.free_page_idx == 0) {
-        if (newsize == 0) {
-            newsize = header_page.page_num * 2;
-        }
+TableInstance* enter_table(tableid_t table_id, bool is_exclusive) {
+    if (table_id < 0 ||
+        table_id >= next_table_id.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    TableSlot& slot =
+        table_chunks[table_id / TABLE_CHUNK_SIZE][table_id % TABLE_CHUNK_SIZE];
+
+    // A close waits for the entering threads after unpublishing, so the
+    // instance is counted before it can be freed.
+    slot.entering_count.fetch_add(1);
+    TableInstance* instance = slot.instance.load();
+    if (instance != nullptr) {
+        instance->user_count.fetch_add(1);
+    }
+    slot.entering_count.fetch_sub(1);
+    if (instance == nullptr) {
+        return nullptr;
+    }
+    if (instance->is_closing.load()) {
+        instance->user_count.fetch_sub(1);
+        return nullptr;
+    }
 
-        // Write last page first to use fdatasync().
-        freepage_t last_page;
-        last_page.next_free_idx = 0;
-        error::ok(pwrite64(table_fd, &last_page, PAGE_SIZE,
-                           (newsize - 1) * PAGE_SIZE) == PAGE_SIZE);
-        // error::ok(fsync(table_fd) == 0);
-
-        // from page number to new size, create a new free page and write it.
-        for (pagenum_t free_page_idx = header_page.page_num;
-             free_page_idx < newsize - 1; free_page_idx++) {
-            freepage_t free_page;
-
-            /// next free page index is next page index, unless it is the last
-            /// page.
-            if (free_page_idx < newsize - 1)
-                free_page.next_free_idx = free_page_idx + 1;
-            else
-                free_page.next_free_idx = 0;
-
-            error::ok(pwrite64(table_fd, &free_page, PAGE_SIZE,
-                               free_page_idx * PAGE_SIZE) == PAGE_SIZE);
-            // error::ok(fdatasync(table_fd) == 0);
-        }
+    if (is_exclusive) {
+        pthread_rwlock_wrlock(&instance->table_gate);
+    } else {
+        pthread_rwlock_rdlock(&instance->table_gate);
+    }
+    if (instance->is_closing) {
+        leave_table(instance);
+        return nullptr;
+    }
+    return instance;
+}
 
-        header_page.free_page_idx = header_page.page_num;
-        header_page.page_num = newsize;
+void leave_table(TableInstance* instance) {
+    pthread_rwlock_unlock(&instance->table_gate);
+    instance->user_count.fetch_sub(1);
+}
 
-        error::ok(pwrite64(table_fd, &header_page, PAGE_SIZE, 0) == PAGE_SIZE);
-        // error::ok(fdatasync(table_fd) == 0);
+TableInstance* begin_close(tableid_t table_id) {
+    if (table_id < 0 ||
+        table_id >= next_table_id.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    // Opens and closes are serialized, so the instance is not freed here.
+    pthread_mutex_lock(&table_registry_mutex);
+    TableInstance* instance = find_table_instance(table_id);
+    if (instance == nullptr || instance->is_closing.exchange(true)) {
+        pthread_mutex_unlock(&table_registry_mutex);
+        return nullptr;
     }
+    instance->user_count.fetch_add(1);
+    pthread_mutex_unlock(&table_registry_mutex);
+
+    // New threads leave from now on, so the running ones are waited for.
+    pthread_rwlock_wrlock(&instance->table_gate);
+    return instance;
+}
+
+void end_close(tableid_t table_id, TableInstance* instance) {
+    pthread_mutex_lock(&table_registry_mutex);
+    space_helper::drain_caches(table_id, true);
+    persist_table_space(table_id, file_write_page,
+                        space_helper::write_file_header);
+
+    // Unpublish the table, so that thread caches exiting from now on skip
+    // it.
+    TableSlot& slot =
+        table_chunks[table_id / TABLE_CHUNK_SIZE][table_id % TABLE_CHUNK_SIZE];
+    slot.instance.store(nullptr);
+    table_paths.erase(instance->file_path);
+    pthread_mutex_unlock(&table_registry_mutex);
+
+    // Threads waiting for the gate see the close and leave.
+    leave_table(instance);
+    while (slot.entering_count.load() != 0 ||
+           instance->user_count.load() != 0) {
+        sched_yield();
+    }
+
+    // Close file descriptor and free file path
+    space_helper::destroy_space(instance->space);
+    delete instance->ring;
+    close(instance->file_descriptor);
+    free(instance->file_path);
+    pthread_rwlock_destroy(&instance->table_gate);
+    delete instance;
+}
+
+void extend_capacity(tableid_t table_id, pagenum_t newsize) {
+    TableSpace& space = space_helper::get_space(table_id);
+
+    pthread_mutex_lock(&space.mutex);
+    if (newsize == 0 && space.free_pages.empty() &&
+        space.unformatted_page_idx == space.page_num) {
+        newsize = space.page_num * 2;
+    }
+    if (newsize > space.page_num) {
+        space_helper::grow_space(table_id, space, newsize);
+    }
+    pthread_mutex_unlock(&space.mutex);
 }
 
 void flush_header(tableid_t table_id, headerpage_t* header_page) {
@@ -75,143 +177,275 @@ void flush_header(tableid_t table_id, headerpage_t* header_page) {
     error::ok(pwrite64(table_fd, header_page, PAGE_SIZE, 0) == PAGE_SIZE);
     // error::ok(fdatasync(table_fd) == 0);
 }
-};  // namespace file_helper
 
-tableid_t file_open_table_file(const char* pathname) {
-    char* real_path = NULL;
+void transfer_pages(tableid_t table_id, const PageBuffer* pages, int count,
+                    bool is_write) {
+    auto& instance = get_table_instance(table_id);
 
-    // If table instance is already full, then return error.
-    if (table_instance_count >= MAX_TABLE_INSTANCE) {
-        return -1;
-    }
+    int table_fd = instance.file_descriptor;
+    std::vector<PageBuffer> sorted(pages, pages + count);
+    std::sort(sorted.begin(), sorted.end(),
+              [](const PageBuffer& lhs, const PageBuffer& rhs) {
+                  return lhs.pagenum < rhs.pagenum;
+              });
+
+    std::vector<iovec> io_vectors;
+    for (int begin = 0; begin < count;) {
+        io_vectors.clear();
+        int end = begin;
+        for (; end < count && end - begin < IOV_MAX &&
+               sorted[end].pagenum == sorted[begin].pagenum + (end - begin);
+             end++) {
+            assert(reinterpret_cast<uintptr_t>(sorted[end].page) % PAGE_SIZE ==
+                   0);
+            io_vectors.push_back({sorted[end].page, PAGE_SIZE});
+        }
 
-    // Check if table file is already in table instance array.
-    if ((real_path = realpath(pathname, NULL)) > 0) {
-        for (int instance_idx = 0; instance_idx < table_instance_count;
-             instance_idx++) {
-            if (strcmp(table_instances[instance_idx].file_path, real_path) ==
-                0) {
-                // If exists, then return it.
-                free(real_path);
-                return instance_idx;
-            }
+        off_t offset = sorted[begin].pagenum * PAGE_SIZE;
+        ssize_t length = static_cast<ssize_t>(end - begin) * PAGE_SIZE;
+        if (is_write) {
+            error::ok(pwritev(table_fd, io_vectors.data(), end - begin,
+                              offset) == length);
+        } else {
+            error::ok(preadv(table_fd, io_vectors.data(), end - begin,
+                             offset) == length);
         }
+        begin = end;
+    }
+}
+};  // namespace file_helper
 
+tableid_t file_open_table_file(const char* pathname, IOBackend backend,
+                               bool direct_io, bool* is_opened) {
+    char* real_path = NULL;
+
+    if (is_opened != nullptr) {
+        *is_opened = false;
+    }
+    pthread_mutex_lock(&table_registry_mutex);
+    // Check if table file is already open.
+    if ((real_path = realpath(pathname, NULL)) != NULL) {
+        auto table = table_paths.find(real_path);
         free(real_path);
+        if (table != table_paths.end()) {
+            // If exists, then return it.
+            pthread_mutex_unlock(&table_registry_mutex);
+            return table->second;
+        }
     }
 
-    // Reserve a new area in table instance array.
-    auto& new_instance =
-        file_helper::get_table_instance(table_instance_count++);
+    // Reserve a new slot, whose chunk is allocated on its first id.
+    tableid_t table_id = next_table_id.load(std::memory_order_relaxed);
+    if (table_id >= static_cast<tableid_t>(TABLE_CHUNK_SIZE) *
+                        MAX_TABLE_CHUNKS) {
+        pthread_mutex_unlock(&table_registry_mutex);
+        return -1;
+    }
+    auto& chunk = table_chunks[table_id / TABLE_CHUNK_SIZE];
+    if (chunk == nullptr) {
+        chunk = new TableSlot[TABLE_CHUNK_SIZE]();
+    }
+    TableInstance* instance = new TableInstance();
+    auto& new_instance = *instance;
+    pthread_rwlock_init(&new_instance.table_gate, nullptr);
+    new_instance.user_count.store(0);
+    new_instance.is_closing.store(false);
 
     int& table_fd = new_instance.file_descriptor;
     headerpage_t header_page;
+    bool is_created = false;
+
+    int open_flags = direct_io ? O_RDWR | O_DIRECT : O_RDWR;
 
     // Check if file exists.
-    if ((table_fd = open(pathname, O_RDWR)) < 1) {
+    if ((table_fd = open(pathname, open_flags)) < 1 && errno == EINVAL) {
+        // The file system does not support O_DIRECT.
+        open_flags = O_RDWR;
+        table_fd = open(pathname, open_flags);
+    }
+    if (table_fd < 1) {
         if (errno == ENOENT) {
-            // Create if not exists.
-            error::ok((table_fd = open(pathname, O_RDWR | O_CREAT | O_EXCL,
-                                       0644)) > 0);
+            // Create if not exists. The file is created even if O_DIRECT is
+            // rejected, so it is opened again without O_EXCL.
+            if ((table_fd = open(pathname, open_flags | O_CREAT | O_EXCL,
+                                 0644)) < 1 &&
+                errno == EINVAL) {
+                open_flags = O_RDWR;
+                table_fd = open(pathname, open_flags | O_CREAT, 0644);
+            }
+            error::ok(table_fd > 0);
 
             // Initialize header page.
             header_page.root_page_idx = 0;
+            header_page.magic = HEADER_MAGIC;
+            header_page.version = HEADER_VERSION;
             header_page.free_page_idx = 0;
+            header_page.unformatted_page_idx = 0;
+            header_page.hole_count = 0;
             header_page.page_num = 1;
             error::ok(pwrite64(table_fd, &header_page, PAGE_SIZE, 0) ==
                       PAGE_SIZE);
 
-            // Initialize free pages.
-            file_helper::extend_capacity(table_instance_count - 1, 2560);
+            new_instance.space = space_helper::load_space(table_fd, header_page);
+            is_created = true;
         } else {
+            pthread_rwlock_destroy(&instance->table_gate);
+            delete instance;
+            pthread_mutex_unlock(&table_registry_mutex);
             return error::print();
         }
+    } else {
+        error::ok(pread64(table_fd, &header_page, PAGE_SIZE, 0) == PAGE_SIZE);
+        new_instance.space = space_helper::load_space(table_fd, header_page);
     }
 
     new_instance.file_path = realpath(pathname, NULL);
+    new_instance.direct_io = (open_flags & O_DIRECT) != 0;
+
+    // Fall back to pread if the kernel does not support io_uring.
+    new_instance.backend = PREAD_BACKEND;
+    new_instance.ring = NULL;
+    if (backend == IO_URING_BACKEND) {
+        IoUring* ring = new IoUring();
+        if (ring->init(IO_URING_ENTRIES) == 0) {
+            new_instance.backend = IO_URING_BACKEND;
+            new_instance.ring = ring;
+        } else {
+            delete ring;
+        }
+    }
 
-    return table_instance_count - 1;
+    // Published last, so that lookups never find a half-open table.
+    table_paths[new_instance.file_path] = table_id;
+    chunk[table_id % TABLE_CHUNK_SIZE].instance.store(
+        instance, std::memory_order_release);
+    next_table_id.store(table_id + 1, std::memory_order_release);
+
+    if (is_created) {
+        // Reserve free pages, and write the header right away.
+        file_helper::extend_capacity(table_id, INITIAL_TABLE_CAPS);
+        persist_table_space(table_id, file_write_page,
+                            space_helper::write_file_header);
+    }
+    pthread_mutex_unlock(&table_registry_mutex);
+    if (is_opened != nullptr) {
+        *is_opened = true;
+    }
+    return table_id;
 }
 
-pagenum_t file_alloc_page(tableid_t table_id) {
-    auto& instance = file_helper::get_table_instance(table_id);
+IOBackend file_get_backend(tableid_t table_id) {
+    return file_helper::get_table_instance(table_id).backend;
+}
 
-    int table_fd = instance.file_descriptor;
-    headerpage_t header_page;
+bool file_is_direct_io(tableid_t table_id) {
+    return file_helper::get_table_instance(table_id).direct_io;
+}
 
-    file_helper::extend_capacity(table_id);
-    error::ok(pread64(table_fd, &header_page, PAGE_SIZE, 0));
+pagenum_t file_alloc_page(tableid_t table_id) {
+    TableSpace& space = space_helper::get_space(table_id);
 
     // Pop the first page from free page stack.
-    pagenum_t free_page_idx = header_page.free_page_idx;
-    freepage_t free_page;
-
-    error::ok(pread64(table_fd, &free_page, PAGE_SIZE,
-                      free_page_idx * PAGE_SIZE) == PAGE_SIZE);
-    // Move the first free page index to the next page.
-    header_page.free_page_idx = free_page.next_free_idx;
-
-    file_helper::flush_header(table_id, &header_page);
+    pthread_mutex_lock(&space.mutex);
+    pagenum_t free_page_idx = space_helper::pop_free_page(table_id, space);
+    pthread_mutex_unlock(&space.mutex);
 
+    persist_table_space(table_id, file_write_page,
+                        space_helper::write_file_header);
     return free_page_idx;
 }
 
 void file_free_page(tableid_t table_id, pagenum_t pagenum) {
-    auto& instance = file_helper::get_table_instance(table_id);
+    TableSpace& space = space_helper::get_space(table_id);
 
-    int table_fd = instance.file_descriptor;
-    headerpage_t header_page;
-    error::ok(pread64(table_fd, &header_page, PAGE_SIZE, 0));
-
-    // Current first free page index
-    pagenum_t old_free_page_idx = header_page.free_page_idx;
-    // Newly freed page
-    freepage_t new_free_page;
-
-    // Next free page index of newly freed page is current first free page
-    // index. Its just pushing the pagenum into free page stack.
-    new_free_page.next_free_idx = old_free_page_idx;
-    error::ok(pwrite64(table_fd, &new_free_page, PAGE_SIZE,
-                       pagenum * PAGE_SIZE) == PAGE_SIZE);
-    // error::ok(fdatasync(table_fd) == 0);
+    // Push the pagenum into free page stack. Its link to the current first
+    // free page is written by the persist.
+    pthread_mutex_lock(&space.mutex);
+    space_helper::push_free_page(space, pagenum);
+    pthread_mutex_unlock(&space.mutex);
 
-    // Set the first free page to freed page number.
-    header_page.free_page_idx = pagenum;
-    file_helper::flush_header(table_id, &header_page);
-
-    return;
+    persist_table_space(table_id, file_write_page,
+                        space_helper::write_file_header);
 }
 
 void file_read_page(tableid_t table_id, pagenum_t pagenum, page_t* dest) {
+    PageIO request = {pagenum, dest, false};
+    file_submit_pages(table_id, &request, 1);
+}
+
+void file_write_page(tableid_t table_id, pagenum_t pagenum, const page_t* src) {
+    PageIO request = {pagenum, const_cast<page_t*>(src), true};
+    file_submit_pages(table_id, &request, 1);
+}
+
+void file_read_pages(tableid_t table_id, const PageBuffer* pages, int count) {
+    file_helper::transfer_pages(table_id, pages, count, false);
+}
+
+void file_write_pages(tableid_t table_id, const PageBuffer* pages, int count) {
+    file_helper::transfer_pages(table_id, pages, count, true);
+}
+
+void file_submit_pages(tableid_t table_id, PageIO* requests, int count) {
     auto& instance = file_helper::get_table_instance(table_id);
 
     int table_fd = instance.file_descriptor;
-    error::ok(pread64(table_fd, dest, PAGE_SIZE, pagenum * PAGE_SIZE) ==
-              PAGE_SIZE);
+    for (int i = 0; i < count; i++) {
+        assert(reinterpret_cast<uintptr_t>(requests[i].page) % PAGE_SIZE == 0);
+    }
+
+    if (instance.backend == IO_URING_BACKEND) {
+        std::vector<IoUringRequest> ring_requests(count);
+        for (int i = 0; i < count; i++) {
+            ring_requests[i].offset = requests[i].pagenum * PAGE_SIZE;
+            ring_requests[i].buffer = requests[i].page;
+            ring_requests[i].length = PAGE_SIZE;
+            ring_requests[i].is_write = requests[i].is_write;
+        }
+        error::ok(instance.ring->submit_and_wait(
+                      table_fd, ring_requests.data(), count) == 0);
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        off_t offset = requests[i].pagenum * PAGE_SIZE;
+        if (requests[i].is_write) {
+            error::ok(pwrite64(table_fd, requests[i].page, PAGE_SIZE,
+                               offset) == PAGE_SIZE);
+            // error::ok(fdatasync(table_fd) == 0);
+        } else {
+            error::ok(pread64(table_fd, requests[i].page, PAGE_SIZE,
+                              offset) == PAGE_SIZE);
+        }
+    }
 }
 
-void file_write_page(tableid_t table_id, pagenum_t pagenum, const page_t* src) {
+void file_advise_pages(tableid_t table_id, pagenum_t pagenum, int count) {
     auto& instance = file_helper::get_table_instance(table_id);
 
     int table_fd = instance.file_descriptor;
-    error::ok(pwrite64(table_fd, src, PAGE_SIZE, pagenum * PAGE_SIZE) ==
-              PAGE_SIZE);
-    // error::ok(fdatasync(table_fd) == 0);
+    if (instance.direct_io) {
+        return;
+    }
+    // It is only a hint, so the result is ignored.
+    posix_fadvise(table_fd, pagenum * PAGE_SIZE,
+                  static_cast<off_t>(count) * PAGE_SIZE, POSIX_FADV_WILLNEED);
 }
 
-void file_close_table_files() {
-    for (int instance_idx = 0; instance_idx < table_instance_count;
-         instance_idx++) {
-        // Close file descriptor and free file path
-        close(table_instances[instance_idx].file_descriptor);
-        free(table_instances[instance_idx].file_path);
-
-        // Reset for accidently re-opening table file.
-        table_instances[instance_idx].file_descriptor = 0;
-        table_instances[instance_idx].file_path = NULL;
+int file_close_table_file(tableid_t table_id) {
+    TableInstance* instance = file_helper::begin_close(table_id);
+    if (instance == nullptr) {
+        return -1;
     }
+    file_helper::end_close(table_id, instance);
+    return 0;
+}
 
-    // Clear table instance count.
-    table_instance_count = 0;
+void file_close_table_files() {
+    // Ids are not reset, so that a stale id never finds another table.
+    for (tableid_t table_id = 0; table_id < file_helper::get_table_id_limit();
+         table_id++) {
+        file_close_table_file(table_id);
+    }
 }
 /** @}*/
\ No newline at end of file
@@ -0,0 +1,192 @@
+/**
+ * @addtogroup DiskSpaceManager
+ * @{
+ */
+#include <key_search.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KEY_SEARCH_X86
+#endif
+
+static_assert(sizeof(PageBranch) == 16,
+              "the SIMD kernels load two branches into 32 bytes");
+
+/**
+ * @brief Internal page search kernel.
+ */
+typedef int (*BranchSearch)(const PageBranch* branches, int count,
+                            recordkey_t key);
+
+/**
+ * @brief Narrow the range of the upper bound with a branchless binary search.
+ * @details The upper bound is the returned branch plus the number of the
+ * branches of which key is not greater than <code>key</code> among the first
+ * <code>*count</code> branches from it.
+ *
+ * @param branches      sorted branches.
+ * @param[in,out] count number of branches, and the number of the remaining
+ * branches. It ends up not greater than <code>limit</code> or the given count.
+ * @param key           search key.
+ * @param limit         number of the branches to stop at.
+ * @return the first remaining branch.
+ */
+__attribute__((no_sanitize("thread"))) static inline const PageBranch*
+narrow_branches(const PageBranch* branches, int* count, recordkey_t key,
+                int limit) {
+    const PageBranch* base = branches;
+    int n = *count;
+    while (n > limit) {
+        int half = n / 2;
+        base = base[half].key <= key ? base + half : base;
+        n -= half;
+    }
+    *count = n;
+    return base;
+}
+
+/**
+ * @brief Branchless binary search kernel.
+ */
+__attribute__((no_sanitize("thread"))) static int upper_bound_scalar(
+    const PageBranch* branches, int count, recordkey_t key) {
+    if (count == 0) return 0;
+
+    int n = count;
+    const PageBranch* base = narrow_branches(branches, &n, key, 1);
+    return static_cast<int>(base - branches) + (base->key <= key);
+}
+
+#ifdef KEY_SEARCH_X86
+/**
+ * @brief SSE4.2 kernel.
+ * @details Two branches are loaded into two registers, and their keys are
+ * unpacked into one register to be compared at once.
+ */
+__attribute__((target("sse4.2"), no_sanitize("thread"))) static int
+upper_bound_sse42(const PageBranch* branches, int count, recordkey_t key) {
+    int n = count;
+    const PageBranch* base =
+        narrow_branches(branches, &n, key, KEY_SEARCH_BLOCK);
+
+    const __m128i needle = _mm_set1_epi64x(key);
+    int greater = 0;
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i first =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(base + i));
+        __m128i second =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(base + i + 1));
+        __m128i keys = _mm_unpacklo_epi64(first, second);
+        __m128i mask = _mm_cmpgt_epi64(keys, needle);
+        greater += __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(mask)));
+    }
+
+    int not_greater = i - greater;
+    for (; i < n; i++) {
+        not_greater += base[i].key <= key;
+    }
+    return static_cast<int>(base - branches) + not_greater;
+}
+
+/**
+ * @brief AVX2 kernel.
+ * @details Four branches are loaded into two registers, and their keys are
+ * unpacked into one register to be compared at once. The order of the keys
+ * changes by the unpacking, which does not matter for counting.
+ */
+__attribute__((target("avx2"), no_sanitize("thread"))) static int
+upper_bound_avx2(const PageBranch* branches, int count, recordkey_t key) {
+    int n = count;
+    const PageBranch* base =
+        narrow_branches(branches, &n, key, KEY_SEARCH_BLOCK);
+
+    const __m256i needle = _mm256_set1_epi64x(key);
+    int greater = 0;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i first =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(base + i));
+        __m256i second =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(base + i + 2));
+        __m256i keys = _mm256_unpacklo_epi64(first, second);
+        __m256i mask = _mm256_cmpgt_epi64(keys, needle);
+        greater +=
+            __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(mask)));
+    }
+
+    int not_greater = i - greater;
+    for (; i < n; i++) {
+        not_greater += base[i].key <= key;
+    }
+    return static_cast<int>(base - branches) + not_greater;
+}
+#endif
+
+/**
+ * @brief Get the function of the kernel.
+ *
+ * @param kernel    search kernel.
+ * @return kernel function.
+ */
+static BranchSearch get_kernel_function(KeySearchKernel kernel) {
+#ifdef KEY_SEARCH_X86
+    switch (kernel) {
+        case AVX2_SEARCH:
+            return upper_bound_avx2;
+        case SSE42_SEARCH:
+            return upper_bound_sse42;
+        default:
+            break;
+    }
+#endif
+    return upper_bound_scalar;
+}
+
+/**
+ * @brief Check the kernels the CPU supports.
+ *
+ * @return the fastest supported kernel.
+ */
+static KeySearchKernel detect_kernel() {
+#ifdef KEY_SEARCH_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return AVX2_SEARCH;
+    if (__builtin_cpu_supports("sse4.2")) return SSE42_SEARCH;
+#endif
+    return SCALAR_SEARCH;
+}
+
+namespace key_search_helper {
+int upper_bound_branches(const PageBranch* branches, int count,
+                         recordkey_t key) {
+    static const BranchSearch search =
+        get_kernel_function(get_supported_kernel());
+    return search(branches, count, key);
+}
+
+int upper_bound_branches(KeySearchKernel kernel, const PageBranch* branches,
+                         int count, recordkey_t key) {
+    return get_kernel_function(kernel)(branches, count, key);
+}
+
+KeySearchKernel get_supported_kernel() {
+    static const KeySearchKernel kernel = detect_kernel();
+    return kernel;
+}
+
+int lower_bound_slots(const PageSlot* slots, int count, recordkey_t key) {
+    if (count == 0) return 0;
+
+    const PageSlot* base = slots;
+    int n = count;
+    while (n > 1) {
+        int half = n / 2;
+        base = base[half].key < key ? base + half : base;
+        n -= half;
+    }
+    return static_cast<int>(base - slots) + (base->key < key);
+}
+}  // namespace key_search_helper
+
+/** @}*/
@@ -2,6 +2,7 @@
  * @addtogroup LockManager
  * @{
  */
+#include <buffer.h>
 #include <const.h>
 #include <lock.h>
 #include <transaction.h>
@@ -186,7 +187,12 @@ Lock* lock_acquire(int table_id, pagenum_t page_id, int key_idx,
     lock_instance->list->tail = lock_instance;
 
     if (should_wait) {
+        // Frames held meanwhile are not released until the lock is granted.
+        bool is_blocked = buffer_helper::begin_holder_wait(nullptr);
         pthread_cond_wait(lock_instance->cond, lock_manager_mutex);
+        if (is_blocked) {
+            buffer_helper::end_holder_wait();
+        }
     }
     trx_wait.erase(trx_id);
 
@@ -251,4 +257,17 @@ int lock_release(Lock* lock_obj) {
     pthread_mutex_unlock(lock_manager_mutex);
     return 0;
 }
+
+bool lock_is_table_locked(int table_id) {
+    pthread_mutex_lock(lock_manager_mutex);
+    bool is_locked = false;
+    for (const auto& lock_instance : lock_instances) {
+        if (lock_instance.first.first == table_id) {
+            is_locked = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(lock_manager_mutex);
+    return is_locked;
+}
 /** @}*/
@@ -1,3 +1,4 @@
+#include <key_search.h>
 #include <page.h>
 #include <types.h>
 
@@ -12,10 +13,10 @@ PageSlot* get_page_slot(LeafPage* page) {
 
 int get_record_idx(LeafPage* page, recordkey_t key) {
     PageSlot* leaf_slot = get_page_slot(page);
-    for(int i = 0; i < page->page_header.key_num; i++) {
-        if(leaf_slot[i].key == key) {
-            return i;
-        }
+    int key_num = page->page_header.key_num;
+    int i = key_search_helper::lower_bound_slots(leaf_slot, key_num, key);
+    if (i < key_num && leaf_slot[i].key == key) {
+        return i;
     }
 
     return -1;
@@ -127,9 +128,27 @@ bool set_leaf_value(LeafPage* page, recordkey_t key, char* old_value, valsize_t*
                            leaf_slot[i].value_offset,
                        leaf_slot[i].value_size);
 
+            int size_diff =
+                static_cast<int>(new_val_size) - leaf_slot[i].value_size;
+            if (size_diff > 0 &&
+                *get_free_space(page) < static_cast<uint64_t>(size_diff)) {
+                return false;
+            }
+
+            // Values are packed from the end of the page in slot order, so
+            // the values of the following slots move by the size difference.
+            uint8_t* base = reinterpret_cast<uint8_t*>(page);
+            uint16_t last_offset =
+                leaf_slot[page->page_header.key_num - 1].value_offset;
+            memmove(base + last_offset - size_diff, base + last_offset,
+                    leaf_slot[i].value_offset - last_offset);
+            for (int j = i; j < page->page_header.key_num; j++) {
+                leaf_slot[j].value_offset -= size_diff;
+            }
+
             leaf_slot[i].value_size = new_val_size;
-            memcpy(reinterpret_cast<uint8_t*>(page) + leaf_slot[i].value_offset,
-                   new_value, new_val_size);
+            memcpy(base + leaf_slot[i].value_offset, new_value, new_val_size);
+            *get_free_space(page) -= size_diff;
             return true;
         }
     }
@@ -172,4 +191,10 @@ uint64_t* get_leftmost_child_idx(InternalPage* page) {
     return &(page->page_header.reserved_footer.footer_2);
 }
 
+int get_branch_idx(InternalPage* page, recordkey_t key) {
+    return key_search_helper::upper_bound_branches(
+               page->page_branches, page->page_header.key_num, key) -
+           1;
+}
+
 }  // namespace page_helper
\ No newline at end of file
@@ -0,0 +1,170 @@
+/**
+ * @addtogroup BufferManager
+ * @{
+ */
+#include <page_table.h>
+
+#include <cassert>
+
+PageTable::PageTable() : table(nullptr), stored_count(0) {}
+
+PageTable::~PageTable() { free_slots(); }
+
+uint64_t PageTable::pack(const PageLocation& page_location) {
+    assert(page_location.second >> PAGENUM_BITS == 0);
+    return static_cast<uint64_t>(page_location.first) << PAGENUM_BITS |
+           page_location.second;
+}
+
+size_t PageTable::home(uint64_t key, size_t mask) {
+    // Finalizer of MurmurHash3, so that consecutive pages are spread out.
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key & mask;
+}
+
+PageTable::Slots* PageTable::make_slots(int capacity) {
+    // Keep the load factor under a half to bound probe sequences.
+    size_t slot_count = 16;
+    while (slot_count < static_cast<size_t>(capacity) * 2) {
+        slot_count *= 2;
+    }
+
+    Slots* slots = new Slots;
+    slots->slots = new Slot[slot_count];
+    slots->mask = slot_count - 1;
+
+    for (size_t i = 0; i < slot_count; i++) {
+        slots->slots[i].key.store(EMPTY_KEY, std::memory_order_relaxed);
+        slots->slots[i].value.store(-1, std::memory_order_relaxed);
+    }
+    return slots;
+}
+
+void PageTable::free_slots() {
+    retired.push_back(table.load(std::memory_order_relaxed));
+    for (Slots* slots : retired) {
+        if (slots != nullptr) {
+            delete[] slots->slots;
+            delete slots;
+        }
+    }
+    retired.clear();
+    table.store(nullptr, std::memory_order_relaxed);
+}
+
+void PageTable::init(int capacity) {
+    free_slots();
+    table.store(make_slots(capacity), std::memory_order_release);
+    stored_count = 0;
+}
+
+void PageTable::reserve(int capacity) {
+    Slots* current = table.load(std::memory_order_relaxed);
+    Slots* grown = make_slots(capacity);
+    if (grown->mask <= current->mask) {
+        delete[] grown->slots;
+        delete grown;
+        return;
+    }
+
+    for (size_t i = 0; i <= current->mask; i++) {
+        uint64_t key = current->slots[i].key.load(std::memory_order_relaxed);
+        if (key == EMPTY_KEY) continue;
+
+        size_t slot_idx = home(key, grown->mask);
+        while (grown->slots[slot_idx].key.load(std::memory_order_relaxed) !=
+               EMPTY_KEY) {
+            slot_idx = (slot_idx + 1) & grown->mask;
+        }
+        grown->slots[slot_idx].value.store(
+            current->slots[i].value.load(std::memory_order_relaxed),
+            std::memory_order_relaxed);
+        grown->slots[slot_idx].key.store(key, std::memory_order_relaxed);
+    }
+
+    // Lookups which have loaded the old slots keep probing them.
+    table.store(grown, std::memory_order_release);
+    retired.push_back(current);
+}
+
+int PageTable::find(const PageLocation& page_location) const {
+    const Slots* current = table.load(std::memory_order_acquire);
+    uint64_t key = pack(page_location);
+    size_t slot_idx = home(key, current->mask);
+
+    for (size_t probed = 0; probed <= current->mask; probed++) {
+        uint64_t slot_key =
+            current->slots[slot_idx].key.load(std::memory_order_acquire);
+        if (slot_key == key) {
+            return current->slots[slot_idx].value.load(
+                std::memory_order_relaxed);
+        }
+        if (slot_key == EMPTY_KEY) {
+            return -1;
+        }
+        slot_idx = (slot_idx + 1) & current->mask;
+    }
+    return -1;
+}
+
+void PageTable::insert(const PageLocation& page_location, int frame_idx) {
+    Slots* current = table.load(std::memory_order_relaxed);
+    Slot* slots = current->slots;
+    size_t mask = current->mask;
+    uint64_t key = pack(page_location);
+    size_t slot_idx = home(key, mask);
+
+    while (slots[slot_idx].key.load(std::memory_order_relaxed) != EMPTY_KEY) {
+        slot_idx = (slot_idx + 1) & mask;
+    }
+
+    // Publish the value before the key, so readers never see the key with a
+    // value of an empty slot.
+    slots[slot_idx].value.store(frame_idx, std::memory_order_relaxed);
+    slots[slot_idx].key.store(key, std::memory_order_release);
+    stored_count++;
+}
+
+void PageTable::erase(const PageLocation& page_location) {
+    Slots* current = table.load(std::memory_order_relaxed);
+    Slot* slots = current->slots;
+    size_t mask = current->mask;
+    uint64_t key = pack(page_location);
+    size_t hole = home(key, mask);
+
+    for (;; hole = (hole + 1) & mask) {
+        uint64_t slot_key = slots[hole].key.load(std::memory_order_relaxed);
+        if (slot_key == key) break;
+        if (slot_key == EMPTY_KEY) return;
+    }
+
+    // Shift back the following entries which can not be found across the
+    // hole, until an empty slot is reached.
+    size_t slot_idx = hole;
+    for (;;) {
+        slot_idx = (slot_idx + 1) & mask;
+        uint64_t slot_key = slots[slot_idx].key.load(std::memory_order_relaxed);
+        if (slot_key == EMPTY_KEY) break;
+
+        // Distance from the home slot, which is kept when it is not longer
+        // than the distance to the hole.
+        size_t slot_home = home(slot_key, mask);
+        if (((slot_idx - slot_home) & mask) < ((slot_idx - hole) & mask)) {
+            continue;
+        }
+
+        slots[hole].value.store(
+            slots[slot_idx].value.load(std::memory_order_relaxed),
+            std::memory_order_relaxed);
+        slots[hole].key.store(slot_key, std::memory_order_release);
+        hole = slot_idx;
+    }
+
+    slots[hole].key.store(EMPTY_KEY, std::memory_order_release);
+    stored_count--;
+}
+/** @}*/
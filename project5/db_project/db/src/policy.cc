@@ -0,0 +1,454 @@
+/**
+ * @addtogroup BufferManager
+ * @{
+ */
+#include <const.h>
+#include <policy.h>
+
+#include <algorithm>
+#include <new>
+#include <utility>
+
+namespace policy_helper {
+void push_head(FrameList& list, std::vector<int>& prev, std::vector<int>& next,
+               int frame_idx) {
+    prev[frame_idx] = -1;
+    next[frame_idx] = list.head;
+    if (list.head != -1) {
+        prev[list.head] = frame_idx;
+    } else {
+        list.tail = frame_idx;
+    }
+    list.head = frame_idx;
+    list.size++;
+}
+
+void push_tail(FrameList& list, std::vector<int>& prev, std::vector<int>& next,
+               int frame_idx) {
+    next[frame_idx] = -1;
+    prev[frame_idx] = list.tail;
+    if (list.tail != -1) {
+        next[list.tail] = frame_idx;
+    } else {
+        list.head = frame_idx;
+    }
+    list.tail = frame_idx;
+    list.size++;
+}
+
+void unlink(FrameList& list, std::vector<int>& prev, std::vector<int>& next,
+            int frame_idx) {
+    if (prev[frame_idx] != -1) {
+        next[prev[frame_idx]] = next[frame_idx];
+    } else {
+        list.head = next[frame_idx];
+    }
+
+    if (next[frame_idx] != -1) {
+        prev[next[frame_idx]] = prev[frame_idx];
+    } else {
+        list.tail = prev[frame_idx];
+    }
+
+    prev[frame_idx] = next[frame_idx] = -1;
+    list.size--;
+}
+
+int find_from_tail(const FrameList& list, const std::vector<int>& prev,
+                   const std::function<bool(int)>& evictable, int scan_limit) {
+    int frame_idx = list.tail;
+    for (int visited = 0; frame_idx != -1 && visited < scan_limit; visited++) {
+        if (evictable(frame_idx)) {
+            return frame_idx;
+        }
+        frame_idx = prev[frame_idx];
+    }
+    return -1;
+}
+
+int visit_from_tail(const FrameList& list, const std::vector<int>& prev,
+                    const std::function<void(int)>& visitor, int visit_limit) {
+    int frame_idx = list.tail;
+    int visited = 0;
+    for (; frame_idx != -1 && visited < visit_limit; visited++) {
+        visitor(frame_idx);
+        frame_idx = prev[frame_idx];
+    }
+    return visited;
+}
+}  // namespace policy_helper
+
+LRUPolicy::LRUPolicy(const PageLocator& page_location_of, int size)
+    : ReplacementPolicy(page_location_of, size),
+      prev(size, -1),
+      next(size, -1),
+      is_protected(size, false),
+      protected_limit(std::max(1, static_cast<int>(size * LRU_PROTECTED_SHARE))) {
+}
+
+void LRUPolicy::resize(int new_size) {
+    ReplacementPolicy::resize(new_size);
+    prev.resize(new_size, -1);
+    next.resize(new_size, -1);
+    is_protected.resize(new_size, false);
+    protected_limit =
+        std::max(1, static_cast<int>(new_size * LRU_PROTECTED_SHARE));
+}
+
+void LRUPolicy::on_load(int frame_idx, AccessHint hint) {
+    is_protected[frame_idx] = false;
+    if (hint == SCAN_ACCESS) {
+        policy_helper::push_tail(probation, prev, next, frame_idx);
+    } else {
+        policy_helper::push_head(probation, prev, next, frame_idx);
+    }
+}
+
+void LRUPolicy::on_hit(int frame_idx, AccessHint hint) {
+    if (hint == SCAN_ACCESS) return;
+
+    if (is_protected[frame_idx]) {
+        if (protected_list.head == frame_idx) return;
+        policy_helper::unlink(protected_list, prev, next, frame_idx);
+        policy_helper::push_head(protected_list, prev, next, frame_idx);
+        return;
+    }
+
+    // Promote the frame, and demote the least recently used protected frame
+    // to the midpoint if the protected list is full.
+    policy_helper::unlink(probation, prev, next, frame_idx);
+    policy_helper::push_head(protected_list, prev, next, frame_idx);
+    is_protected[frame_idx] = true;
+
+    if (protected_list.size > protected_limit) {
+        int demoted_idx = protected_list.tail;
+        policy_helper::unlink(protected_list, prev, next, demoted_idx);
+        policy_helper::push_head(probation, prev, next, demoted_idx);
+        is_protected[demoted_idx] = false;
+    }
+}
+
+void LRUPolicy::on_evict(int frame_idx) {
+    policy_helper::unlink(is_protected[frame_idx] ? protected_list : probation,
+                          prev, next, frame_idx);
+    is_protected[frame_idx] = false;
+}
+
+int LRUPolicy::victim(const std::function<bool(int)>& evictable,
+                      int scan_limit) {
+    // The scan limit counts frames from the coldest end of both lists.
+    int victim_idx =
+        policy_helper::find_from_tail(probation, prev, evictable, scan_limit);
+    if (victim_idx == -1 && probation.size < scan_limit) {
+        victim_idx = policy_helper::find_from_tail(
+            protected_list, prev, evictable, scan_limit - probation.size);
+    }
+    return victim_idx;
+}
+
+void LRUPolicy::visit_coldest(const std::function<void(int)>& visitor,
+                              int visit_limit) {
+    int visited =
+        policy_helper::visit_from_tail(probation, prev, visitor, visit_limit);
+    policy_helper::visit_from_tail(protected_list, prev, visitor,
+                                   visit_limit - visited);
+}
+
+ClockPolicy::ClockPolicy(const PageLocator& page_location_of, int size)
+    : ReplacementPolicy(page_location_of, size),
+      referenced(size, false),
+      tracked(size, false),
+      hand(0),
+      prev(size, -1),
+      next(size, -1),
+      on_probation(size, false) {}
+
+void ClockPolicy::resize(int new_size) {
+    ReplacementPolicy::resize(new_size);
+    referenced.resize(new_size, false);
+    tracked.resize(new_size, false);
+    prev.resize(new_size, -1);
+    next.resize(new_size, -1);
+    on_probation.resize(new_size, false);
+    if (hand >= new_size) {
+        hand = 0;
+    }
+}
+
+void ClockPolicy::on_load(int frame_idx, AccessHint hint) {
+    tracked[frame_idx] = true;
+    referenced[frame_idx] = false;
+    if (hint == SCAN_ACCESS) {
+        on_probation[frame_idx] = true;
+        policy_helper::push_head(probation, prev, next, frame_idx);
+    }
+}
+
+void ClockPolicy::on_hit(int frame_idx, AccessHint hint) {
+    if (hint == SCAN_ACCESS) return;
+    if (on_probation[frame_idx]) {
+        on_probation[frame_idx] = false;
+        policy_helper::unlink(probation, prev, next, frame_idx);
+    }
+    referenced[frame_idx] = true;
+}
+
+void ClockPolicy::on_evict(int frame_idx) {
+    if (on_probation[frame_idx]) {
+        on_probation[frame_idx] = false;
+        policy_helper::unlink(probation, prev, next, frame_idx);
+    }
+    tracked[frame_idx] = false;
+    referenced[frame_idx] = false;
+}
+
+int ClockPolicy::victim(const std::function<bool(int)>& evictable,
+                        int scan_limit) {
+    int victim_idx =
+        policy_helper::find_from_tail(probation, prev, evictable, scan_limit);
+    if (victim_idx != -1) {
+        return victim_idx;
+    }
+
+    int visited = std::min(probation.size, scan_limit);
+    // Two rounds are enough to clear every reference bit once.
+    for (int step = 0; step < 2 * size && visited < scan_limit; step++) {
+        int frame_idx = hand;
+        hand = (hand + 1) % size;
+
+        if (!tracked[frame_idx] || on_probation[frame_idx]) continue;
+        if (referenced[frame_idx]) {
+            referenced[frame_idx] = false;
+            continue;
+        }
+
+        visited++;
+        if (evictable(frame_idx)) {
+            return frame_idx;
+        }
+    }
+    return -1;
+}
+
+void ClockPolicy::visit_coldest(const std::function<void(int)>& visitor,
+                                int visit_limit) {
+    // Frames which would get a second chance come after the others.
+    int visited =
+        policy_helper::visit_from_tail(probation, prev, visitor, visit_limit);
+    for (int round = 0; round < 2; round++) {
+        bool second_chance = round == 1;
+        for (int step = 0; step < size && visited < visit_limit; step++) {
+            int frame_idx = (hand + step) % size;
+            if (tracked[frame_idx] && !on_probation[frame_idx] &&
+                referenced[frame_idx] == second_chance) {
+                visitor(frame_idx);
+                visited++;
+            }
+        }
+    }
+}
+
+LRUKPolicy::LRUKPolicy(const PageLocator& page_location_of, int size, int k)
+    : ReplacementPolicy(page_location_of, size),
+      k(k),
+      now(0),
+      history(size),
+      tracked(size, false) {}
+
+void LRUKPolicy::resize(int new_size) {
+    ReplacementPolicy::resize(new_size);
+    history.resize(new_size);
+    tracked.resize(new_size, false);
+}
+
+void LRUKPolicy::on_load(int frame_idx, AccessHint hint) {
+    tracked[frame_idx] = true;
+    // Access time 0 makes the frame older than any other.
+    history[frame_idx].assign(1, hint == SCAN_ACCESS ? 0 : ++now);
+}
+
+void LRUKPolicy::on_hit(int frame_idx, AccessHint hint) {
+    if (hint == SCAN_ACCESS) return;
+    auto& access = history[frame_idx];
+    access.insert(access.begin(), ++now);
+    if (static_cast<int>(access.size()) > k) {
+        access.pop_back();
+    }
+}
+
+void LRUKPolicy::on_evict(int frame_idx) {
+    tracked[frame_idx] = false;
+    history[frame_idx].clear();
+}
+
+int LRUKPolicy::sort_candidates(int count) {
+    // ((K-th access time or 0 if less than K accesses, last access time),
+    // frame index). Access times start from 1, so frames with less than K
+    // accesses come first.
+    candidates.clear();
+    for (int frame_idx = 0; frame_idx < size; frame_idx++) {
+        if (!tracked[frame_idx]) continue;
+        const auto& access = history[frame_idx];
+        bool has_k = static_cast<int>(access.size()) >= k;
+        candidates.emplace_back(
+            std::make_pair(has_k ? access.back() : 0, access.front()),
+            frame_idx);
+    }
+
+    int sorted_count = std::min<int>(count, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + sorted_count,
+                      candidates.end());
+    return sorted_count;
+}
+
+int LRUKPolicy::victim(const std::function<bool(int)>& evictable,
+                       int scan_limit) {
+    int visit_count = sort_candidates(scan_limit);
+    for (int i = 0; i < visit_count; i++) {
+        if (evictable(candidates[i].second)) {
+            return candidates[i].second;
+        }
+    }
+    return -1;
+}
+
+void LRUKPolicy::visit_coldest(const std::function<void(int)>& visitor,
+                               int visit_limit) {
+    int visit_count = sort_candidates(visit_limit);
+    for (int i = 0; i < visit_count; i++) {
+        visitor(candidates[i].second);
+    }
+}
+
+TwoQueuePolicy::TwoQueuePolicy(const PageLocator& page_location_of, int size)
+    : ReplacementPolicy(page_location_of, size),
+      prev(size, -1),
+      next(size, -1),
+      in_am(size, false),
+      scanned(size, false),
+      kin(std::max(1, size / 4)),
+      kout(std::max(1, size / 2)) {}
+
+void TwoQueuePolicy::resize(int new_size) {
+    ReplacementPolicy::resize(new_size);
+    prev.resize(new_size, -1);
+    next.resize(new_size, -1);
+    in_am.resize(new_size, false);
+    scanned.resize(new_size, false);
+    kin = std::max(1, new_size / 4);
+    kout = std::max(1, new_size / 2);
+
+    while (static_cast<int>(a1out.size()) > kout) {
+        a1out_index.erase(a1out.back());
+        a1out.pop_back();
+    }
+}
+
+void TwoQueuePolicy::on_load(int frame_idx, AccessHint hint) {
+    if (hint == SCAN_ACCESS) {
+        // Scanned pages are evicted first, and do not touch A1out.
+        in_am[frame_idx] = false;
+        scanned[frame_idx] = true;
+        policy_helper::push_tail(a1in, prev, next, frame_idx);
+        return;
+    }
+
+    scanned[frame_idx] = false;
+    const PageLocation& page_location = page_location_of(frame_idx);
+    const auto& ghost = a1out_index.find(page_location);
+
+    if (ghost != a1out_index.end()) {
+        // Loaded again while remembered: it is a hot page.
+        a1out.erase(ghost->second);
+        a1out_index.erase(ghost);
+
+        in_am[frame_idx] = true;
+        policy_helper::push_head(am, prev, next, frame_idx);
+    } else {
+        in_am[frame_idx] = false;
+        policy_helper::push_head(a1in, prev, next, frame_idx);
+    }
+}
+
+void TwoQueuePolicy::on_hit(int frame_idx, AccessHint hint) {
+    if (hint == SCAN_ACCESS) return;
+    scanned[frame_idx] = false;
+    // Hits in A1in are regarded as correlated references.
+    if (!in_am[frame_idx] || am.head == frame_idx) return;
+    policy_helper::unlink(am, prev, next, frame_idx);
+    policy_helper::push_head(am, prev, next, frame_idx);
+}
+
+void TwoQueuePolicy::on_evict(int frame_idx) {
+    if (in_am[frame_idx]) {
+        policy_helper::unlink(am, prev, next, frame_idx);
+        return;
+    }
+
+    policy_helper::unlink(a1in, prev, next, frame_idx);
+    if (scanned[frame_idx]) {
+        scanned[frame_idx] = false;
+        return;
+    }
+
+    // Remember the page evicted from A1in.
+    const PageLocation& page_location = page_location_of(frame_idx);
+    if (a1out_index.find(page_location) == a1out_index.end()) {
+        a1out.push_front(page_location);
+        a1out_index[page_location] = a1out.begin();
+    }
+    if (static_cast<int>(a1out.size()) > kout) {
+        a1out_index.erase(a1out.back());
+        a1out.pop_back();
+    }
+}
+
+int TwoQueuePolicy::victim(const std::function<bool(int)>& evictable,
+                           int scan_limit) {
+    int victim_idx = -1;
+    if (a1in.size > kin || am.size == 0) {
+        victim_idx =
+            policy_helper::find_from_tail(a1in, prev, evictable, scan_limit);
+        if (victim_idx == -1) {
+            victim_idx =
+                policy_helper::find_from_tail(am, prev, evictable, scan_limit);
+        }
+    } else {
+        victim_idx =
+            policy_helper::find_from_tail(am, prev, evictable, scan_limit);
+        if (victim_idx == -1) {
+            victim_idx = policy_helper::find_from_tail(a1in, prev, evictable,
+                                                       scan_limit);
+        }
+    }
+    return victim_idx;
+}
+
+void TwoQueuePolicy::visit_coldest(const std::function<void(int)>& visitor,
+                                   int visit_limit) {
+    const FrameList& first = (a1in.size > kin || am.size == 0) ? a1in : am;
+    const FrameList& second = (&first == &a1in) ? am : a1in;
+
+    int visited =
+        policy_helper::visit_from_tail(first, prev, visitor, visit_limit);
+    policy_helper::visit_from_tail(second, prev, visitor,
+                                   visit_limit - visited);
+}
+
+ReplacementPolicy* make_replacement_policy(ReplacementPolicyType type,
+                                           const PageLocator& page_location_of,
+                                           int size) {
+    switch (type) {
+        case LRU_POLICY:
+            return new LRUPolicy(page_location_of, size);
+        case CLOCK_POLICY:
+            return new ClockPolicy(page_location_of, size);
+        case LRU_K_POLICY:
+            return new LRUKPolicy(page_location_of, size);
+        case TWO_Q_POLICY:
+            return new TwoQueuePolicy(page_location_of, size);
+        default:
+            return nullptr;
+    }
+}
+/** @}*/
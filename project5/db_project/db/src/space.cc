@@ -0,0 +1,738 @@
+/**
+ * @addtogroup DiskSpaceManager
+ * @{
+ */
+#include <assert.h>
+#include <errors.h>
+#include <fcntl.h>
+#include <file.h>
+#include <space.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+/// @brief caches of the running threads.
+std::vector<ThreadSpaceCache*> thread_space_caches;
+/// @brief mutex which protects the thread caches registry.
+pthread_mutex_t space_caches_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Check the bit of a page.
+ *
+ * @param bits      page bitmap.
+ * @param pagenum   page index.
+ * @return <code>true</code> if set.
+ */
+static inline bool test_bit(const std::vector<uint64_t>& bits,
+                            pagenum_t pagenum) {
+    return bits[pagenum / 64] & (1ULL << (pagenum % 64));
+}
+
+/**
+ * @brief Set the bit of a page.
+ *
+ * @param bits      page bitmap.
+ * @param pagenum   page index.
+ */
+static inline void set_bit(std::vector<uint64_t>& bits, pagenum_t pagenum) {
+    bits[pagenum / 64] |= 1ULL << (pagenum % 64);
+}
+
+/**
+ * @brief Clear the bit of a page.
+ *
+ * @param bits      page bitmap.
+ * @param pagenum   page index.
+ */
+static inline void clear_bit(std::vector<uint64_t>& bits, pagenum_t pagenum) {
+    bits[pagenum / 64] &= ~(1ULL << (pagenum % 64));
+}
+
+/**
+ * @brief Find the free space of an open table.
+ *
+ * @param table_id  table id.
+ * @return table space, or <code>nullptr</code> if the table is not open.
+ */
+static TableSpace* find_space(tableid_t table_id) {
+    TableInstance* instance = file_helper::find_table_instance(table_id);
+    return instance != nullptr ? instance->space : nullptr;
+}
+
+/**
+ * @brief   Give cached pages back to a table.
+ * @details Caller should hold the cache mutex.
+ *
+ * @param table_id  table id.
+ * @param pages     cached pages, the most recently freed last.
+ * @param count     number of the oldest pages to give back.
+ */
+static void give_back(tableid_t table_id, std::vector<pagenum_t>& pages,
+                      size_t count) {
+    TableSpace* space = find_space(table_id);
+    if (space != nullptr) {
+        pthread_mutex_lock(&space->mutex);
+        for (size_t i = 0; i < count; i++) {
+            space_helper::push_free_page(*space, pages[i]);
+        }
+        pthread_mutex_unlock(&space->mutex);
+    }
+    pages.erase(pages.begin(), pages.begin() + count);
+}
+
+/**
+ * @brief   Give the extents of a thread back to a table.
+ * @details Caller should hold the cache mutex.
+ *
+ * @param table_id  table id.
+ * @param extents   extents of each level.
+ */
+static void give_back_extents(
+    tableid_t table_id, std::array<SpaceExtent, PAGE_LEVEL_COUNT>& extents) {
+    TableSpace* space = find_space(table_id);
+    if (space != nullptr) {
+        pthread_mutex_lock(&space->mutex);
+        for (SpaceExtent& extent : extents) {
+            space_helper::release_extent(*space, &extent);
+        }
+        pthread_mutex_unlock(&space->mutex);
+    }
+    extents.fill({0, 0});
+}
+
+/**
+ * @brief   Make room for a table in the cache of a thread.
+ * @details Caller should hold the cache mutex.
+ *
+ * @param cache     thread cache.
+ * @param table_id  table id.
+ */
+static void reserve_table_cache(ThreadSpaceCache& cache, tableid_t table_id) {
+    if (cache.pages.size() <= static_cast<size_t>(table_id)) {
+        cache.pages.resize(table_id + 1);
+        cache.extents.resize(table_id + 1, {{{0, 0}, {0, 0}}});
+    }
+}
+
+ThreadSpaceCache::ThreadSpaceCache() {
+    pthread_mutex_init(&mutex, nullptr);
+
+    pthread_mutex_lock(&space_caches_mutex);
+    thread_space_caches.push_back(this);
+    pthread_mutex_unlock(&space_caches_mutex);
+}
+
+ThreadSpaceCache::~ThreadSpaceCache() {
+    pthread_mutex_lock(&space_caches_mutex);
+    pthread_mutex_lock(&mutex);
+    for (size_t table_id = 0; table_id < pages.size(); table_id++) {
+        give_back(table_id, pages[table_id], pages[table_id].size());
+        give_back_extents(table_id, extents[table_id]);
+    }
+    pthread_mutex_unlock(&mutex);
+
+    for (size_t i = 0; i < thread_space_caches.size(); i++) {
+        if (thread_space_caches[i] == this) {
+            thread_space_caches[i] = thread_space_caches.back();
+            thread_space_caches.pop_back();
+            break;
+        }
+    }
+    pthread_mutex_unlock(&space_caches_mutex);
+    pthread_mutex_destroy(&mutex);
+}
+
+namespace space_helper {
+TableSpace& get_space(tableid_t table_id) {
+    TableSpace* space = file_helper::get_table_instance(table_id).space;
+    error::ok(space != nullptr);
+    return *space;
+}
+
+TableSpace* load_space(int table_fd, const headerpage_t& header_page) {
+    TableSpace* space = new TableSpace();
+    space->page_num = header_page.page_num;
+    // The unformatted tail is trusted only if the header has the field, and
+    // it lies in the file. Otherwise every page is formatted.
+    bool is_versioned = header_page.magic == HEADER_MAGIC &&
+                        header_page.version == HEADER_VERSION;
+    space->unformatted_page_idx =
+        is_versioned && header_page.unformatted_page_idx != 0 &&
+                header_page.unformatted_page_idx <= header_page.page_num
+            ? header_page.unformatted_page_idx
+            : header_page.page_num;
+    space->free_bits.assign((space->page_num + 63) / 64, 0);
+    space->listed_bits.assign((space->page_num + 63) / 64, 0);
+    space->tombstone_count = 0;
+    space->extent_search_idx = 0;
+    pthread_mutex_init(&space->mutex, nullptr);
+    pthread_mutex_init(&space->persist_mutex, nullptr);
+
+    // Punched runs lie below the list, in the order they are recorded. They
+    // are read only from a versioned header, and a run out of the formatted
+    // pages, which are within page_num, is dropped.
+    uint64_t hole_count =
+        is_versioned && header_page.hole_count <= MAX_HEADER_HOLES
+            ? header_page.hole_count
+            : 0;
+    for (uint64_t i = 0; i < hole_count; i++) {
+        const PageRun& run = header_page.holes[i];
+        if (run.first == 0 || run.first >= run.end ||
+            run.end > space->unformatted_page_idx) {
+            continue;
+        }
+        for (pagenum_t pagenum = run.first; pagenum < run.end; pagenum++) {
+            if (test_bit(space->free_bits, pagenum)) continue;
+            set_bit(space->free_bits, pagenum);
+            set_bit(space->listed_bits, pagenum);
+            space->free_pages.push_back(pagenum);
+        }
+    }
+    space->hole_count = space->free_pages.size();
+
+    // The list is read from its head, which is popped first.
+    pagenum_t free_page_idx = header_page.free_page_idx;
+    while (free_page_idx != 0 && free_page_idx < space->unformatted_page_idx &&
+           !test_bit(space->free_bits, free_page_idx)) {
+        set_bit(space->free_bits, free_page_idx);
+        set_bit(space->listed_bits, free_page_idx);
+        space->free_pages.push_back(free_page_idx);
+
+        freepage_t free_page;
+        error::ok(pread64(table_fd, &free_page, PAGE_SIZE,
+                          free_page_idx * PAGE_SIZE) == PAGE_SIZE);
+        free_page_idx = free_page.next_free_idx;
+    }
+    std::reverse(space->free_pages.begin() + space->hole_count,
+                 space->free_pages.end());
+
+    space->persisted_count = space->free_pages.size();
+    space->is_dirty = false;
+    return space;
+}
+
+void destroy_space(TableSpace* space) {
+    pthread_mutex_destroy(&space->mutex);
+    pthread_mutex_destroy(&space->persist_mutex);
+    delete space;
+}
+
+ThreadSpaceCache& get_thread_cache() {
+    static thread_local ThreadSpaceCache local_cache;
+    return local_cache;
+}
+
+void grow_space(tableid_t table_id, TableSpace& space, pagenum_t newsize) {
+    auto& instance = file_helper::get_table_instance(table_id);
+
+    int table_fd = instance.file_descriptor;
+    off_t offset = space.page_num * PAGE_SIZE;
+    off_t length = (newsize - space.page_num) * PAGE_SIZE;
+    if (fallocate(table_fd, 0, offset, length) != 0) {
+        // Write last page to extend the file, leaving a hole before it.
+        freepage_t last_page = {};
+        error::ok(pwrite64(table_fd, &last_page, PAGE_SIZE,
+                           (newsize - 1) * PAGE_SIZE) == PAGE_SIZE);
+    }
+
+    // The unformatted tail runs to the end of the file, so it just grows.
+    space.page_num = newsize;
+    space.free_bits.resize((newsize + 63) / 64, 0);
+    space.listed_bits.resize((newsize + 63) / 64, 0);
+    space.is_dirty = true;
+}
+
+/**
+ * @brief   Get the punched runs at the bottom of the free page list.
+ * @details Caller should hold the space mutex.
+ *
+ * @param space table space.
+ * @return punched runs, adjacent pages merged.
+ */
+static std::vector<PageRun> get_holes(const TableSpace& space) {
+    std::vector<PageRun> holes;
+    for (size_t i = 0; i < space.hole_count; i++) {
+        pagenum_t pagenum = space.free_pages[i];
+        if (!holes.empty() && holes.back().end == pagenum) {
+            holes.back().end++;
+        } else {
+            holes.push_back({pagenum, pagenum + 1});
+        }
+    }
+    return holes;
+}
+
+/**
+ * @brief   Pop the tombstones on the top of the free page list.
+ * @details Caller should hold the space mutex.
+ *
+ * @param space table space.
+ */
+static void pop_tombstones(TableSpace& space) {
+    while (space.tombstone_count > 0 &&
+           !test_bit(space.free_bits, space.free_pages.back())) {
+        clear_bit(space.listed_bits, space.free_pages.back());
+        space.free_pages.pop_back();
+        space.tombstone_count--;
+    }
+    space.persisted_count =
+        std::min(space.persisted_count, space.free_pages.size());
+}
+
+pagenum_t pop_free_page(tableid_t table_id, TableSpace& space) {
+    space.is_dirty = true;
+    pop_tombstones(space);
+    if (space.free_pages.empty()) {
+        if (space.unformatted_page_idx == space.page_num) {
+            grow_space(table_id, space, space.page_num * 2);
+        }
+        return space.unformatted_page_idx++;
+    }
+
+    pagenum_t pagenum = space.free_pages.back();
+    space.free_pages.pop_back();
+    clear_bit(space.free_bits, pagenum);
+    clear_bit(space.listed_bits, pagenum);
+
+    space.persisted_count =
+        std::min(space.persisted_count, space.free_pages.size());
+    return pagenum;
+}
+
+bool is_listed_free(const TableSpace& space, pagenum_t pagenum) {
+    return pagenum < space.unformatted_page_idx &&
+           test_bit(space.free_bits, pagenum);
+}
+
+void take_listed_page(TableSpace& space, pagenum_t pagenum) {
+    assert(is_listed_free(space, pagenum));
+
+    clear_bit(space.free_bits, pagenum);
+    space.tombstone_count++;
+    space.is_dirty = true;
+}
+
+void compact_free_pages(TableSpace& space) {
+    if (space.tombstone_count == 0) {
+        return;
+    }
+
+    size_t live_count = 0;
+    for (size_t i = 0; i < space.free_pages.size(); i++) {
+        pagenum_t pagenum = space.free_pages[i];
+        if (!test_bit(space.free_bits, pagenum)) {
+            // The pages above the tombstone are linked again.
+            clear_bit(space.listed_bits, pagenum);
+            space.persisted_count = std::min(space.persisted_count, live_count);
+            continue;
+        }
+        space.free_pages[live_count++] = pagenum;
+    }
+    space.free_pages.resize(live_count);
+    space.tombstone_count = 0;
+}
+
+pagenum_t find_free_page_below(const TableSpace& space, pagenum_t end) {
+    end = std::min(end, space.unformatted_page_idx);
+    for (size_t word_idx = 0; word_idx < (end + 63) / 64; word_idx++) {
+        uint64_t word = space.free_bits[word_idx];
+        if (word == 0) continue;
+
+        pagenum_t pagenum = word_idx * 64 + __builtin_ctzll(word);
+        return pagenum < end ? pagenum : 0;
+    }
+    return 0;
+}
+
+pagenum_t get_used_page_end(const TableSpace& space) {
+    for (size_t word_idx = (space.unformatted_page_idx + 63) / 64;
+         word_idx > 0; word_idx--) {
+        uint64_t used = ~space.free_bits[word_idx - 1];
+        // Pages from the unformatted tail are free.
+        pagenum_t first = (word_idx - 1) * 64;
+        if (space.unformatted_page_idx - first < 64) {
+            used &= (1ULL << (space.unformatted_page_idx - first)) - 1;
+        }
+        if (used != 0) {
+            return first + 64 - __builtin_clzll(used);
+        }
+    }
+    return 1;
+}
+
+void shrink_space(TableSpace& space, pagenum_t newsize) {
+    assert(newsize >= get_used_page_end(space));
+
+    // The pages are dropped from the list as tombstones.
+    for (pagenum_t pagenum = newsize; pagenum < space.unformatted_page_idx;
+         pagenum++) {
+        take_listed_page(space, pagenum);
+    }
+    compact_free_pages(space);
+
+    space.page_num = newsize;
+    space.unformatted_page_idx = std::min(space.unformatted_page_idx, newsize);
+    space.free_bits.resize((newsize + 63) / 64);
+    space.listed_bits.resize((newsize + 63) / 64);
+    space.extent_search_idx = 0;
+    space.is_dirty = true;
+}
+
+std::vector<PageRun> punch_free_pages(TableSpace& space) {
+    compact_free_pages(space);
+    space.hole_count = std::min(space.hole_count, space.persisted_count);
+
+    std::vector<uint64_t> hole_bits(space.free_bits.size(), 0);
+    for (size_t i = 0; i < space.hole_count; i++) {
+        set_bit(hole_bits, space.free_pages[i]);
+    }
+
+    // Merged runs are not counted, so the limit is never exceeded.
+    std::vector<PageRun> punched;
+    size_t run_count = get_holes(space).size();
+    for (size_t word_idx = 0; word_idx < space.unformatted_page_idx / 64 &&
+                              run_count < MAX_HEADER_HOLES;
+         word_idx++) {
+        if (space.free_bits[word_idx] != ~0ULL || hole_bits[word_idx] != 0) {
+            continue;
+        }
+        hole_bits[word_idx] = ~0ULL;
+        run_count++;
+
+        pagenum_t first = word_idx * 64;
+        if (!punched.empty() && punched.back().end == first) {
+            punched.back().end += 64;
+        } else {
+            punched.push_back({first, first + 64});
+        }
+    }
+    if (punched.empty()) {
+        return punched;
+    }
+
+    // Holes go to the bottom in page order, and the rest keep their order.
+    std::vector<pagenum_t> free_pages;
+    free_pages.reserve(space.free_pages.size());
+    for (size_t word_idx = 0; word_idx < hole_bits.size(); word_idx++) {
+        for (uint64_t word = hole_bits[word_idx]; word != 0;
+             word &= word - 1) {
+            free_pages.push_back(word_idx * 64 + __builtin_ctzll(word));
+        }
+    }
+    space.hole_count = free_pages.size();
+    for (size_t i = 0; i < space.free_pages.size(); i++) {
+        if (!test_bit(hole_bits, space.free_pages[i])) {
+            free_pages.push_back(space.free_pages[i]);
+        }
+    }
+    space.free_pages.swap(free_pages);
+    space.persisted_count = space.hole_count;
+    space.is_dirty = true;
+    return punched;
+}
+
+void release_file_pages(tableid_t table_id, pagenum_t newsize,
+                        const std::vector<PageRun>& holes) {
+    auto& instance = file_helper::get_table_instance(table_id);
+
+    int table_fd = instance.file_descriptor;
+    error::ok(ftruncate(table_fd, newsize * PAGE_SIZE) == 0);
+    for (const PageRun& run : holes) {
+        // The pages are free anyway, so the result is ignored.
+        fallocate(table_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  run.first * PAGE_SIZE, (run.end - run.first) * PAGE_SIZE);
+    }
+}
+
+bool reserve_extent(tableid_t table_id, TableSpace& space,
+                    SpaceExtent* extent) {
+    static_assert(SPACE_EXTENT_SIZE == 64, "an extent is a bitmap word");
+
+    // Search an aligned run of free pages from where the last one was found.
+    size_t word_count = space.unformatted_page_idx / 64;
+    for (size_t i = 0; i < word_count; i++) {
+        size_t word_idx = (space.extent_search_idx + i) % word_count;
+        if (space.free_bits[word_idx] != ~0ULL) continue;
+
+        pagenum_t first = word_idx * 64;
+        for (pagenum_t pagenum = first; pagenum < first + 64; pagenum++) {
+            take_listed_page(space, pagenum);
+        }
+        space.extent_search_idx = word_idx + 1;
+        *extent = {first, first + 64};
+        return true;
+    }
+
+    if (space.unformatted_page_idx == space.page_num) {
+        if (space.free_pages.size() > space.tombstone_count) {
+            return false;
+        }
+        grow_space(table_id, space, space.page_num * 2);
+    }
+
+    pagenum_t first = space.unformatted_page_idx;
+    pagenum_t count =
+        std::min<pagenum_t>(SPACE_EXTENT_SIZE, space.page_num - first);
+    space.unformatted_page_idx += count;
+    space.is_dirty = true;
+    *extent = {first, first + count};
+    return true;
+}
+
+void release_extent(TableSpace& space, SpaceExtent* extent) {
+    if (extent->next < extent->end) {
+        if (extent->end == space.unformatted_page_idx) {
+            space.unformatted_page_idx = extent->next;
+            space.is_dirty = true;
+        } else {
+            // The lowest page is pushed last, to be popped first.
+            for (pagenum_t pagenum = extent->end; pagenum > extent->next;
+                 pagenum--) {
+                push_free_page(space, pagenum - 1);
+            }
+        }
+    }
+    *extent = {0, 0};
+}
+
+void refill_cache(tableid_t table_id, TableSpace& space,
+                  std::vector<pagenum_t>& pages) {
+    space.is_dirty = true;
+    pop_tombstones(space);
+    if (space.free_pages.empty()) {
+        if (space.unformatted_page_idx == space.page_num) {
+            grow_space(table_id, space, space.page_num * 2);
+        }
+
+        // The lowest page is pushed last, to be popped first.
+        pagenum_t count = std::min<pagenum_t>(
+            SPACE_CACHE_BATCH, space.page_num - space.unformatted_page_idx);
+        for (pagenum_t pagenum = space.unformatted_page_idx + count;
+             pagenum > space.unformatted_page_idx; pagenum--) {
+            pages.push_back(pagenum - 1);
+        }
+        space.unformatted_page_idx += count;
+        return;
+    }
+
+    // Take the first free pages as they are, so that the order of
+    // allocations is still LIFO. Tombstones among them are dropped.
+    size_t begin = space.free_pages.size();
+    size_t count = 0;
+    while (begin > 0 && count < static_cast<size_t>(SPACE_CACHE_BATCH)) {
+        count += test_bit(space.free_bits, space.free_pages[--begin]);
+    }
+    for (size_t i = begin; i < space.free_pages.size(); i++) {
+        pagenum_t pagenum = space.free_pages[i];
+        if (test_bit(space.free_bits, pagenum)) {
+            clear_bit(space.free_bits, pagenum);
+            pages.push_back(pagenum);
+        } else {
+            space.tombstone_count--;
+        }
+        clear_bit(space.listed_bits, pagenum);
+    }
+    space.free_pages.resize(begin);
+    space.persisted_count = std::min(space.persisted_count, begin);
+}
+
+void push_free_page(TableSpace& space, pagenum_t pagenum) {
+    assert(pagenum != 0 && pagenum < space.unformatted_page_idx);
+    assert(!test_bit(space.free_bits, pagenum));
+
+    if (test_bit(space.listed_bits, pagenum)) {
+        // The page of a tombstone may be overwritten, so it is linked again
+        // on the top rather than revived in place.
+        compact_free_pages(space);
+    }
+    set_bit(space.free_bits, pagenum);
+    set_bit(space.listed_bits, pagenum);
+    space.free_pages.push_back(pagenum);
+    space.is_dirty = true;
+}
+
+void drain_caches(tableid_t table_id, bool with_extents) {
+    pthread_mutex_lock(&space_caches_mutex);
+    for (ThreadSpaceCache* cache : thread_space_caches) {
+        pthread_mutex_lock(&cache->mutex);
+        if (static_cast<size_t>(table_id) < cache->pages.size()) {
+            std::vector<pagenum_t>& pages = cache->pages[table_id];
+            give_back(table_id, pages, pages.size());
+            if (with_extents) {
+                give_back_extents(table_id, cache->extents[table_id]);
+            }
+        }
+        pthread_mutex_unlock(&cache->mutex);
+    }
+    pthread_mutex_unlock(&space_caches_mutex);
+}
+
+void write_file_header(tableid_t table_id, pagenum_t free_page_idx,
+                       pagenum_t unformatted_page_idx, pagenum_t page_num,
+                       const std::vector<PageRun>& holes) {
+    auto& instance = file_helper::get_table_instance(table_id);
+
+    headerpage_t header_page;
+    error::ok(pread64(instance.file_descriptor, &header_page, PAGE_SIZE, 0) ==
+              PAGE_SIZE);
+    set_header_fields(&header_page, free_page_idx, unformatted_page_idx,
+                      page_num, holes);
+    file_helper::flush_header(table_id, &header_page);
+}
+
+void set_header_fields(headerpage_t* header_page, pagenum_t free_page_idx,
+                       pagenum_t unformatted_page_idx, pagenum_t page_num,
+                       const std::vector<PageRun>& holes) {
+    assert(holes.size() <= static_cast<size_t>(MAX_HEADER_HOLES));
+
+    header_page->magic = HEADER_MAGIC;
+    header_page->version = HEADER_VERSION;
+    header_page->free_page_idx = free_page_idx;
+    header_page->unformatted_page_idx = unformatted_page_idx;
+    header_page->page_num = page_num;
+    header_page->hole_count = holes.size();
+    std::copy(holes.begin(), holes.end(), header_page->holes);
+}
+}  // namespace space_helper
+
+pagenum_t space_alloc_page(tableid_t table_id) {
+    ThreadSpaceCache& cache = space_helper::get_thread_cache();
+
+    pthread_mutex_lock(&cache.mutex);
+    reserve_table_cache(cache, table_id);
+    std::vector<pagenum_t>& pages = cache.pages[table_id];
+    if (pages.empty()) {
+        TableSpace& space = space_helper::get_space(table_id);
+        pthread_mutex_lock(&space.mutex);
+        space_helper::refill_cache(table_id, space, pages);
+        pthread_mutex_unlock(&space.mutex);
+    }
+
+    pagenum_t pagenum = pages.back();
+    pages.pop_back();
+    pthread_mutex_unlock(&cache.mutex);
+    return pagenum;
+}
+
+pagenum_t space_alloc_page_near(tableid_t table_id, PageLevel level,
+                                pagenum_t near_page_idx) {
+    ThreadSpaceCache& cache = space_helper::get_thread_cache();
+
+    pthread_mutex_lock(&cache.mutex);
+    reserve_table_cache(cache, table_id);
+    SpaceExtent& extent = cache.extents[table_id][level];
+    TableSpace& space = space_helper::get_space(table_id);
+
+    pagenum_t pagenum = 0;
+    pagenum_t next_page_idx = near_page_idx + 1;
+    if (near_page_idx != 0 &&
+        !(next_page_idx == extent.next && extent.next < extent.end)) {
+        // Follow the neighbour if the page after it is free.
+        pthread_mutex_lock(&space.mutex);
+        if (space_helper::is_listed_free(space, next_page_idx)) {
+            space_helper::take_listed_page(space, next_page_idx);
+            pagenum = next_page_idx;
+        } else if (next_page_idx == space.unformatted_page_idx &&
+                   next_page_idx < space.page_num) {
+            space.unformatted_page_idx++;
+            space.is_dirty = true;
+            pagenum = next_page_idx;
+        }
+        pthread_mutex_unlock(&space.mutex);
+    }
+
+    if (pagenum == 0 && extent.next == extent.end) {
+        pthread_mutex_lock(&space.mutex);
+        if (!space_helper::reserve_extent(table_id, space, &extent)) {
+            // Scattered free pages are used up before the file grows.
+            pagenum = space_helper::pop_free_page(table_id, space);
+        }
+        pthread_mutex_unlock(&space.mutex);
+    }
+    if (pagenum == 0) {
+        pagenum = extent.next++;
+    }
+    pthread_mutex_unlock(&cache.mutex);
+    return pagenum;
+}
+
+pagenum_t space_alloc_page_below(tableid_t table_id, pagenum_t end) {
+    TableSpace& space = space_helper::get_space(table_id);
+
+    pthread_mutex_lock(&space.mutex);
+    pagenum_t pagenum = space_helper::find_free_page_below(space, end);
+    if (pagenum != 0) {
+        space_helper::take_listed_page(space, pagenum);
+    }
+    pthread_mutex_unlock(&space.mutex);
+    return pagenum;
+}
+
+void space_free_page(tableid_t table_id, pagenum_t pagenum) {
+    ThreadSpaceCache& cache = space_helper::get_thread_cache();
+
+    pthread_mutex_lock(&cache.mutex);
+    reserve_table_cache(cache, table_id);
+    std::vector<pagenum_t>& pages = cache.pages[table_id];
+    pages.push_back(pagenum);
+    if (pages.size() > static_cast<size_t>(SPACE_CACHE_CAPACITY)) {
+        give_back(table_id, pages, pages.size() / 2);
+    }
+    pthread_mutex_unlock(&cache.mutex);
+}
+
+pagenum_t space_get_page_count(tableid_t table_id) {
+    TableSpace& space = space_helper::get_space(table_id);
+
+    pthread_mutex_lock(&space.mutex);
+    pagenum_t page_num = space.page_num;
+    pthread_mutex_unlock(&space.mutex);
+    return page_num;
+}
+
+void persist_table_space(tableid_t table_id, SpacePageWriter write_page,
+                         SpaceHeaderWriter write_header) {
+    TableSpace& space = space_helper::get_space(table_id);
+
+    pthread_mutex_lock(&space.persist_mutex);
+    pthread_mutex_lock(&space.mutex);
+    if (!space.is_dirty) {
+        pthread_mutex_unlock(&space.mutex);
+        pthread_mutex_unlock(&space.persist_mutex);
+        return;
+    }
+    space_helper::compact_free_pages(space);
+    // Holes which were popped or taken are gone, and the ones above them are
+    // linked again.
+    space.hole_count = std::min(space.hole_count, space.persisted_count);
+
+    // Pages are linked under the space mutex, so that none of them is
+    // allocated and initialized before its link is written. The lowest
+    // linked page ends the list, since holes are not linked.
+    for (size_t i = space.persisted_count; i < space.free_pages.size(); i++) {
+        freepage_t free_page = {};
+        free_page.next_free_idx =
+            i > space.hole_count ? space.free_pages[i - 1] : 0;
+        write_page(table_id, space.free_pages[i], &free_page);
+    }
+    space.persisted_count = space.free_pages.size();
+    space.is_dirty = false;
+
+    pagenum_t free_page_idx = space.free_pages.size() > space.hole_count
+                                  ? space.free_pages.back()
+                                  : 0;
+    pagenum_t unformatted_page_idx =
+        space.unformatted_page_idx < space.page_num
+            ? space.unformatted_page_idx
+            : 0;
+    pagenum_t page_num = space.page_num;
+    std::vector<PageRun> holes = space_helper::get_holes(space);
+    pthread_mutex_unlock(&space.mutex);
+
+    // The header page is written without the space mutex, since a tree
+    // modification may allocate pages while it latches the header page.
+    write_header(table_id, free_page_idx, unformatted_page_idx, page_num,
+                 holes);
+    pthread_mutex_unlock(&space.persist_mutex);
+}
+/** @}*/
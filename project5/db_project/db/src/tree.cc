@@ -4,93 +4,165 @@
  */
 #include <buffer.h>
 #include <errors.h>
+#include <key_search.h>
 #include <page.h>
 #include <transaction.h>
 #include <tree.h>
 
 #include <algorithm>
+#include <cstring>
+#include <functional>
 #include <utility>
 #include <vector>
 
-pagenum_t make_node(tableid_t table_id, pagenum_t parent_page_idx) {
-    allocatedpage_t page = {};
-    pagenum_t page_idx = buffered_alloc_page(table_id);
+pagenum_t make_node(tableid_t table_id, pagenum_t parent_page_idx,
+                    pagenum_t near_page_idx) {
+    pagenum_t page_idx =
+        buffered_alloc_page_near(table_id, INTERNAL_LEVEL, near_page_idx);
 
-    buffered_read_page(table_id, page_idx, &page);
-    page.page_header.is_leaf_page = 0;
-    page.page_header.parent_page_idx = parent_page_idx;
-    page.page_header.key_num = 0;
+    PageGuard<allocatedpage_t> page(table_id, page_idx, EXCLUSIVE_LATCH);
+    page->page_header.is_leaf_page = 0;
+    page->page_header.parent_page_idx = parent_page_idx;
+    page->page_header.key_num = 0;
 
-    buffered_write_page(table_id, page_idx, &page);
+    page.mark_dirty();
 
     return page_idx;
 }
 
-pagenum_t make_leaf(tableid_t table_id, pagenum_t parent_page_idx) {
-    leafpage_t leaf_page;
-    pagenum_t leaf_page_idx = buffered_alloc_page(table_id);
+pagenum_t make_leaf(tableid_t table_id, pagenum_t parent_page_idx,
+                    pagenum_t near_page_idx) {
+    pagenum_t leaf_page_idx =
+        buffered_alloc_page_near(table_id, LEAF_LEVEL, near_page_idx);
 
-    buffered_read_page(table_id, leaf_page_idx, &leaf_page);
+    PageGuard<leafpage_t> leaf_page(table_id, leaf_page_idx, EXCLUSIVE_LATCH);
 
-    leaf_page.page_header.is_leaf_page = 1;
-    leaf_page.page_header.parent_page_idx = parent_page_idx;
-    leaf_page.page_header.key_num = 0;
+    leaf_page->page_header.is_leaf_page = 1;
+    leaf_page->page_header.parent_page_idx = parent_page_idx;
+    leaf_page->page_header.key_num = 0;
 
-    leaf_page.page_header.reserved_footer.footer_1 = 3968;
-    leaf_page.page_header.reserved_footer.footer_2 = 0;
+    leaf_page->page_header.reserved_footer.footer_1 = 3968;
+    leaf_page->page_header.reserved_footer.footer_2 = 0;
 
-    buffered_write_page(table_id, leaf_page_idx, &leaf_page);
+    leaf_page.mark_dirty();
 
     return leaf_page_idx;
 }
 
 pagenum_t create_tree(tableid_t table_id, recordkey_t key, const char* value,
                       valsize_t value_size) {
-    headerpage_t header_page;
-
-    leafpage_t leaf_page;
     pagenum_t leaf_page_idx = make_leaf(table_id);
 
-    buffered_read_page(table_id, 0, &header_page);
-    buffered_read_page(table_id, leaf_page_idx, &leaf_page);
+    PageGuard<headerpage_t> header_page(table_id, 0, EXCLUSIVE_LATCH);
+    PageGuard<leafpage_t> leaf_page(table_id, leaf_page_idx, EXCLUSIVE_LATCH);
 
-    page_helper::add_leaf_value(&leaf_page, key, value, value_size);
+    page_helper::add_leaf_value(leaf_page.get(), key, value, value_size);
 
-    header_page.root_page_idx = leaf_page_idx;
+    header_page->root_page_idx = leaf_page_idx;
 
-    buffered_write_page(table_id, leaf_page_idx, &leaf_page);
-    buffered_write_page(table_id, 0, &header_page);
+    leaf_page.mark_dirty();
+    header_page.mark_dirty();
 
     return leaf_page_idx;
 }
 
-pagenum_t find_leaf(tableid_t table_id, recordkey_t key, trxid_t trx_id) {
-    headerpage_t header_page;
-    buffered_read_page(table_id, 0, &header_page, 0, false);
+__attribute__((no_sanitize("thread")))
+bool find_leaf_optimistic(tableid_t table_id, recordkey_t key,
+                          pagenum_t* page_idx) {
+    for (int restart = 0; restart < MAX_OPTIMISTIC_RESTARTS; restart++) {
+        *page_idx = 0;
+
+        BufferBlock* frame;
+        uint64_t version;
+        auto header_page = reinterpret_cast<const headerpage_t*>(
+            buffer_helper::begin_optimistic_read(table_id, 0, &frame,
+                                                 &version));
+        if (header_page == nullptr) {
+            return false;
+        }
+        pagenum_t current_page_idx = header_page->root_page_idx;
+        if (!buffer_helper::validate_optimistic_read(frame, version)) {
+            continue;
+        }
+        if (!current_page_idx) {
+            return true;
+        }
+
+        for (;;) {
+            BufferBlock* child_frame;
+            uint64_t child_version;
+            auto current_page = reinterpret_cast<const internalpage_t*>(
+                buffer_helper::begin_optimistic_read(
+                    table_id, current_page_idx, &child_frame,
+                    &child_version));
+            // The parent still points to the child when its version is read.
+            if (!buffer_helper::validate_optimistic_read(frame, version)) {
+                break;
+            }
+            if (current_page == nullptr) {
+                *page_idx = current_page_idx;
+                return false;
+            }
+            frame = child_frame;
+            version = child_version;
+
+            if (current_page->page_header.is_leaf_page) {
+                if (!buffer_helper::validate_optimistic_read(frame, version)) {
+                    break;
+                }
+                *page_idx = current_page_idx;
+                return true;
+            }
 
-    internalpage_t current_page;
-    pagenum_t current_page_idx = header_page.root_page_idx;
+            // A torn key count should not read beyond the page.
+            int key_num = std::min<int>(current_page->page_header.key_num,
+                                        MAX_PAGE_BRANCHES);
+            int i = key_search_helper::upper_bound_branches(
+                        current_page->page_branches, key_num, key) -
+                    1;
+
+            if (i >= 0) {
+                current_page_idx = current_page->page_branches[i].page_idx;
+            } else {
+                current_page_idx = *page_helper::get_leftmost_child_idx(
+                    const_cast<internalpage_t*>(current_page));
+            }
+            if (!buffer_helper::validate_optimistic_read(frame, version)) {
+                break;
+            }
+        }
+    }
+    return false;
+}
+
+pagenum_t find_leaf(tableid_t table_id, recordkey_t key,
+                    [[maybe_unused]] trxid_t trx_id) {
+    pagenum_t current_page_idx;
+    if (find_leaf_optimistic(table_id, key, &current_page_idx)) {
+        return current_page_idx;
+    }
+
+    if (!current_page_idx) {
+        PageGuard<headerpage_t> header_page(table_id, 0);
+        current_page_idx = header_page->root_page_idx;
+        header_page.release();
+    }
 
     if (!current_page_idx) {
         return 0;
     }
 
-    buffered_read_page(table_id, header_page.root_page_idx, &current_page,
-                       trx_id, false);
-    while (!current_page.page_header.is_leaf_page) {
-        int i = 0;
-        for (i = 0; i < current_page.page_header.key_num; i++) {
-            if (key < current_page.page_branches[i].key) break;
-        }
-        i--;
+    PageGuard<internalpage_t> current_page(table_id, current_page_idx);
+    while (!current_page->page_header.is_leaf_page) {
+        int i = page_helper::get_branch_idx(current_page.get(), key);
 
         if (i >= 0) {
-            current_page_idx = current_page.page_branches[i].page_idx;
+            current_page_idx = current_page->page_branches[i].page_idx;
         } else {
-            current_page_idx = *page_helper::get_leftmost_child_idx(
-                reinterpret_cast<internalpage_t*>(&current_page));
+            current_page_idx =
+                *page_helper::get_leftmost_child_idx(current_page.get());
         }
-        buffered_read_page(table_id, current_page_idx, &current_page, trx_id, false);
+        current_page = PageGuard<internalpage_t>(table_id, current_page_idx);
     }
 
     return current_page_idx;
@@ -98,58 +170,302 @@ pagenum_t find_leaf(tableid_t table_id, recordkey_t key, trxid_t trx_id) {
 
 bool find_by_key(tableid_t table_id, recordkey_t key, char* value,
                  valsize_t* value_size, trxid_t trx_id) {
-    int i = 0;
-    leafpage_t leaf_page;
     pagenum_t leaf_page_idx = find_leaf(table_id, key);
 
     if (!leaf_page_idx) return false;
-    buffered_read_page(table_id, leaf_page_idx, &leaf_page, trx_id, false);
-    int key_idx = page_helper::get_record_idx(&leaf_page, key);
-    
-    if (trx_id &&
-        !trx_helper::lock_acquire(table_id, leaf_page_idx, key_idx, trx_id, SHARED))
-        return false;
-
-    PageSlot* leaf_slot = page_helper::get_page_slot(&leaf_page);
-
-    for (i = 0; i < leaf_page.page_header.key_num; i++) {
-        if (leaf_slot[i].key == key) break;
+    PageGuard<leafpage_t> leaf_page(table_id, leaf_page_idx);
+    int key_idx = page_helper::get_record_idx(leaf_page.get(), key);
+
+    if (trx_id) {
+        // The record lock may wait for a writer, which latches the leaf.
+        leaf_page.release();
+        if (!trx_helper::lock_acquire(table_id, leaf_page_idx, key_idx, trx_id,
+                                      SHARED))
+            return false;
+        leaf_page = PageGuard<leafpage_t>(table_id, leaf_page_idx);
+        key_idx = page_helper::get_record_idx(leaf_page.get(), key);
     }
 
-    if (i == leaf_page.page_header.key_num)
+    if (key_idx < 0)
         return false;
     else {
-        page_helper::get_leaf_value(&leaf_page, i, value, value_size);
+        page_helper::get_leaf_value(leaf_page.get(), key_idx, value,
+                                    value_size);
         return true;
     }
 }
 
+int find_range(
+    tableid_t table_id, recordkey_t begin_key, recordkey_t end_key,
+    const std::function<bool(recordkey_t, const char*, valsize_t)>& visitor,
+    AccessHint hint) {
+    int visited = 0;
+    pagenum_t leaf_page_idx = find_leaf(table_id, begin_key);
+
+    while (leaf_page_idx) {
+        PageGuard<leafpage_t> leaf_page(table_id, leaf_page_idx, SHARED_LATCH,
+                                        hint);
+        pagenum_t next_leaf_page_idx =
+            *page_helper::get_sibling_idx(leaf_page.get());
+        buffer_helper::record_leaf_access(table_id, leaf_page_idx,
+                                          next_leaf_page_idx);
+
+        PageSlot* leaf_slot = page_helper::get_page_slot(leaf_page.get());
+        for (int i = 0; i < leaf_page->page_header.key_num; i++) {
+            if (leaf_slot[i].key < begin_key) continue;
+            if (leaf_slot[i].key > end_key) return visited;
+
+            visited++;
+            if (!visitor(leaf_slot[i].key,
+                         reinterpret_cast<const char*>(leaf_page.get()) +
+                             leaf_slot[i].value_offset,
+                         leaf_slot[i].value_size)) {
+                return visited;
+            }
+        }
+
+        leaf_page_idx = next_leaf_page_idx;
+    }
+
+    return visited;
+}
+
+LeafFragmentation get_leaf_fragmentation(tableid_t table_id) {
+    LeafFragmentation fragmentation = {};
+    pagenum_t leaf_page_idx = find_leaf(table_id, INT64_MIN);
+
+    while (leaf_page_idx) {
+        PageGuard<leafpage_t> leaf_page(table_id, leaf_page_idx, SHARED_LATCH,
+                                        SCAN_ACCESS);
+        pagenum_t next_leaf_page_idx =
+            *page_helper::get_sibling_idx(leaf_page.get());
+
+        fragmentation.leaf_count++;
+        if (next_leaf_page_idx) {
+            fragmentation.sequential_links +=
+                next_leaf_page_idx == leaf_page_idx + 1;
+            fragmentation.forward_links += next_leaf_page_idx > leaf_page_idx;
+            fragmentation.total_distance +=
+                next_leaf_page_idx > leaf_page_idx
+                    ? next_leaf_page_idx - leaf_page_idx
+                    : leaf_page_idx - next_leaf_page_idx;
+        }
+
+        leaf_page_idx = next_leaf_page_idx;
+    }
+
+    return fragmentation;
+}
+
+std::unordered_map<pagenum_t, TreePageLinks> map_tree_links(
+    tableid_t table_id) {
+    std::unordered_map<pagenum_t, TreePageLinks> links;
+
+    PageGuard<headerpage_t> header_page(table_id, 0);
+    pagenum_t root_page_idx = header_page->root_page_idx;
+    header_page.release();
+    if (!root_page_idx) {
+        return links;
+    }
+
+    links[root_page_idx] = {0, 0};
+    std::vector<pagenum_t> level = {root_page_idx};
+    while (!level.empty()) {
+        std::vector<pagenum_t> next_level;
+        pagenum_t left_page_idx = 0;
+        for (pagenum_t page_idx : level) {
+            PageGuard<internalpage_t> page(table_id, page_idx, SHARED_LATCH,
+                                           SCAN_ACCESS);
+            if (page->page_header.is_leaf_page) {
+                links[page_idx].left_page_idx = left_page_idx;
+                left_page_idx = page_idx;
+                continue;
+            }
+
+            pagenum_t child_page_idx =
+                *page_helper::get_leftmost_child_idx(page.get());
+            links[child_page_idx] = {page_idx, 0};
+            next_level.push_back(child_page_idx);
+            for (int i = 0; i < page->page_header.key_num; i++) {
+                child_page_idx = page->page_branches[i].page_idx;
+                links[child_page_idx] = {page_idx, 0};
+                next_level.push_back(child_page_idx);
+            }
+        }
+        level.swap(next_level);
+    }
+
+    return links;
+}
+
+int relocate_page(tableid_t table_id, pagenum_t page_idx,
+                  pagenum_t new_page_idx,
+                  std::unordered_map<pagenum_t, TreePageLinks>& links) {
+    TreePageLinks page_links = links[page_idx];
+
+    PageGuard<headerpage_t> header_page;
+    PageGuard<internalpage_t> parent_page;
+    if (page_links.parent_page_idx == 0) {
+        header_page = PageGuard<headerpage_t>(table_id, 0, EXCLUSIVE_LATCH);
+    } else {
+        parent_page = PageGuard<internalpage_t>(
+            table_id, page_links.parent_page_idx, EXCLUSIVE_LATCH);
+    }
+    PageGuard<internalpage_t> page(table_id, page_idx, EXCLUSIVE_LATCH);
+
+    // Find the pointer to the page before anything is modified. The
+    // leftmost child has no branch.
+    bool is_linked = false;
+    int branch_idx = -1;
+    if (header_page.is_valid()) {
+        is_linked = header_page->root_page_idx == page_idx;
+    } else if (*page_helper::get_leftmost_child_idx(parent_page.get()) ==
+               page_idx) {
+        is_linked = true;
+    } else {
+        for (int i = 0; i < parent_page->page_header.key_num; i++) {
+            if (parent_page->page_branches[i].page_idx == page_idx) {
+                is_linked = true;
+                branch_idx = i;
+                break;
+            }
+        }
+    }
+    PageGuard<leafpage_t> left_page;
+    if (page->page_header.is_leaf_page && page_links.left_page_idx) {
+        left_page = PageGuard<leafpage_t>(table_id, page_links.left_page_idx,
+                                          EXCLUSIVE_LATCH);
+        is_linked = is_linked &&
+                    *page_helper::get_sibling_idx(left_page.get()) == page_idx;
+    }
+    if (!is_linked) {
+        return -1;
+    }
+
+    PageGuard<internalpage_t> new_page(table_id, new_page_idx,
+                                       EXCLUSIVE_LATCH);
+    memcpy(new_page.get(), page.get(), PAGE_SIZE);
+    new_page.mark_dirty();
+
+    if (header_page.is_valid()) {
+        header_page->root_page_idx = new_page_idx;
+        header_page.mark_dirty();
+    } else {
+        if (branch_idx < 0) {
+            *page_helper::get_leftmost_child_idx(parent_page.get()) =
+                new_page_idx;
+        } else {
+            parent_page->page_branches[branch_idx].page_idx = new_page_idx;
+        }
+        parent_page.mark_dirty();
+    }
+    links.erase(page_idx);
+    links[new_page_idx] = page_links;
+
+    if (!new_page->page_header.is_leaf_page) {
+        std::vector<pagenum_t> child_page_idxs = {
+            *page_helper::get_leftmost_child_idx(new_page.get())};
+        for (int i = 0; i < new_page->page_header.key_num; i++) {
+            child_page_idxs.push_back(new_page->page_branches[i].page_idx);
+        }
+        for (pagenum_t child_page_idx : child_page_idxs) {
+            PageGuard<allocatedpage_t> child_page(table_id, child_page_idx,
+                                                  EXCLUSIVE_LATCH);
+            child_page->page_header.parent_page_idx = new_page_idx;
+            child_page.mark_dirty();
+            links[child_page_idx].parent_page_idx = new_page_idx;
+        }
+    } else {
+        if (left_page.is_valid()) {
+            *page_helper::get_sibling_idx(left_page.get()) = new_page_idx;
+            left_page.mark_dirty();
+        }
+        pagenum_t right_page_idx = *page_helper::get_sibling_idx(
+            reinterpret_cast<leafpage_t*>(new_page.get()));
+        if (right_page_idx) {
+            links[right_page_idx].left_page_idx = new_page_idx;
+        }
+    }
+
+    left_page.release();
+    new_page.release();
+    page.release();
+    parent_page.release();
+    header_page.release();
+    buffered_free_page(table_id, page_idx);
+    return 0;
+}
+
+int move_tree_pages(tableid_t table_id, int max_moves,
+                    CompactionStats* stats) {
+    if (file_helper::find_table_instance(table_id) == nullptr) {
+        return -1;
+    }
+
+    // Every free page is a candidate to move to.
+    space_helper::drain_caches(table_id, true);
+
+    std::unordered_map<pagenum_t, TreePageLinks> links =
+        map_tree_links(table_id);
+    std::vector<pagenum_t> page_idxs;
+    for (const auto& page_links : links) {
+        page_idxs.push_back(page_links.first);
+    }
+    std::sort(page_idxs.begin(), page_idxs.end(), std::greater<pagenum_t>());
+
+    // The tree pages would fill the file right after the header page.
+    pagenum_t end = page_idxs.size() + 1;
+    std::vector<pagenum_t> moved_page_idxs;
+    for (pagenum_t page_idx : page_idxs) {
+        if (page_idx < end ||
+            static_cast<int>(moved_page_idxs.size()) == max_moves) {
+            break;
+        }
+        moved_page_idxs.push_back(page_idx);
+    }
+
+    // The lowest page goes to the lowest free page, so that the moved pages
+    // keep their order on disk.
+    std::reverse(moved_page_idxs.begin(), moved_page_idxs.end());
+    for (pagenum_t page_idx : moved_page_idxs) {
+        pagenum_t new_page_idx = buffered_alloc_page_below(table_id, end);
+        if (new_page_idx == 0) {
+            break;
+        }
+        if (relocate_page(table_id, page_idx, new_page_idx, links) != 0) {
+            buffered_free_page(table_id, new_page_idx);
+            return -1;
+        }
+        stats->moved_pages++;
+    }
+
+    return 0;
+}
+
 pagenum_t insert_into_new_root(tableid_t table_id, pagenum_t left_page_idx,
                                recordkey_t key, pagenum_t right_page_idx) {
-    headerpage_t header_page;
-    allocatedpage_t left_page, right_page;
+    pagenum_t new_root_page_idx = make_node(table_id);
 
-    internalpage_t new_root_page;
-    pagenum_t new_root_page_idx;
+    PageGuard<headerpage_t> header_page(table_id, 0, EXCLUSIVE_LATCH);
+    PageGuard<internalpage_t> new_root_page(table_id, new_root_page_idx,
+                                            EXCLUSIVE_LATCH);
+    PageGuard<allocatedpage_t> left_page(table_id, left_page_idx,
+                                         EXCLUSIVE_LATCH);
+    PageGuard<allocatedpage_t> right_page(table_id, right_page_idx,
+                                          EXCLUSIVE_LATCH);
 
-    new_root_page_idx = make_node(table_id);
-    buffered_read_page(table_id, 0, &header_page);
-    buffered_read_page(table_id, new_root_page_idx, &new_root_page);
-    buffered_read_page(table_id, left_page_idx, &left_page);
-    buffered_read_page(table_id, right_page_idx, &right_page);
+    *page_helper::get_leftmost_child_idx(new_root_page.get()) = left_page_idx;
+    page_helper::add_internal_key(new_root_page.get(), key, right_page_idx);
 
-    *page_helper::get_leftmost_child_idx(&new_root_page) = left_page_idx;
-    page_helper::add_internal_key(&new_root_page, key, right_page_idx);
+    left_page->page_header.parent_page_idx = new_root_page_idx;
+    right_page->page_header.parent_page_idx = new_root_page_idx;
 
-    left_page.page_header.parent_page_idx = new_root_page_idx;
-    right_page.page_header.parent_page_idx = new_root_page_idx;
+    new_root_page.mark_dirty();
+    left_page.mark_dirty();
+    right_page.mark_dirty();
 
-    buffered_write_page(table_id, new_root_page_idx, &new_root_page);
-    buffered_write_page(table_id, left_page_idx, &left_page);
-    buffered_write_page(table_id, right_page_idx, &right_page);
-
-    header_page.root_page_idx = new_root_page_idx;
-    buffered_write_page(table_id, 0, &header_page);
+    header_page->root_page_idx = new_root_page_idx;
+    header_page.mark_dirty();
 
     return new_root_page_idx;
 }
@@ -157,18 +473,16 @@ pagenum_t insert_into_new_root(tableid_t table_id, pagenum_t left_page_idx,
 pagenum_t insert_into_node(tableid_t table_id, pagenum_t parent_page_idx,
                            pagenum_t left_page_idx, recordkey_t key,
                            pagenum_t right_page_idx) {
-    int insert_position;
-    internalpage_t parent_page;
-
-    buffered_read_page(table_id, parent_page_idx, &parent_page);
+    PageGuard<internalpage_t> parent_page(table_id, parent_page_idx,
+                                          EXCLUSIVE_LATCH);
 
-    page_helper::add_internal_key(&parent_page, key, right_page_idx);
+    page_helper::add_internal_key(parent_page.get(), key, right_page_idx);
     std::sort(
-        parent_page.page_branches,
-        parent_page.page_branches + parent_page.page_header.key_num,
+        parent_page->page_branches,
+        parent_page->page_branches + parent_page->page_header.key_num,
         [](const PageBranch& a, const PageBranch& b) { return a.key < b.key; });
 
-    buffered_write_page(table_id, parent_page_idx, &parent_page);
+    parent_page.mark_dirty();
 
     return parent_page_idx;
 }
@@ -177,23 +491,24 @@ pagenum_t insert_into_node_after_splitting(tableid_t table_id,
                                            pagenum_t page_idx, recordkey_t key,
                                            pagenum_t right_page_idx) {
     pagenum_t new_page_idx;
-    internalpage_t page, new_page;
 
     recordkey_t seperate_key;
 
     std::vector<PageBranch> temp_branches;
 
-    buffered_read_page(table_id, page_idx, &page);
+    PageGuard<internalpage_t> page(table_id, page_idx, EXCLUSIVE_LATCH);
 
     /* Create the new node and copy
      * half the keys and pointers to the
      * old and half to the new.
      */
-    new_page_idx = make_node(table_id, page.page_header.parent_page_idx);
-    buffered_read_page(table_id, new_page_idx, &new_page);
+    new_page_idx =
+        make_node(table_id, page->page_header.parent_page_idx, page_idx);
+    PageGuard<internalpage_t> new_page(table_id, new_page_idx,
+                                       EXCLUSIVE_LATCH);
 
     for (int i = 0; i < 248; i++) {
-        temp_branches.push_back(page.page_branches[i]);
+        temp_branches.push_back(page->page_branches[i]);
     }
     PageBranch new_branch;
 
@@ -204,34 +519,32 @@ pagenum_t insert_into_node_after_splitting(tableid_t table_id,
         temp_branches.begin(), temp_branches.end(),
         [](const PageBranch& a, const PageBranch& b) { return a.key < b.key; });
 
-    page.page_header.key_num = 0;
+    page->page_header.key_num = 0;
     for (int i = 0; i < 124; i++) {
-        page_helper::add_internal_key(&page, temp_branches[i].key,
+        page_helper::add_internal_key(page.get(), temp_branches[i].key,
                                       temp_branches[i].page_idx);
     }
 
     seperate_key = temp_branches[124].key;
-    *page_helper::get_leftmost_child_idx(&new_page) =
+    *page_helper::get_leftmost_child_idx(new_page.get()) =
         temp_branches[124].page_idx;
 
-    allocatedpage_t leftmost_child_page;
-
-    buffered_read_page(table_id, temp_branches[124].page_idx,
-                       &leftmost_child_page);
-    leftmost_child_page.page_header.parent_page_idx = new_page_idx;
-    buffered_write_page(table_id, temp_branches[124].page_idx,
-                        &leftmost_child_page);
+    PageGuard<allocatedpage_t> leftmost_child_page(
+        table_id, temp_branches[124].page_idx, EXCLUSIVE_LATCH);
+    leftmost_child_page->page_header.parent_page_idx = new_page_idx;
+    leftmost_child_page.mark_dirty();
+    leftmost_child_page.release();
 
     for (int i = 125; i < 249; i++) {
-        allocatedpage_t child_page;
-        page_helper::add_internal_key(&new_page, temp_branches[i].key,
+        page_helper::add_internal_key(new_page.get(), temp_branches[i].key,
                                       temp_branches[i].page_idx);
 
-        buffered_read_page(table_id, temp_branches[i].page_idx, &child_page);
+        PageGuard<allocatedpage_t> child_page(
+            table_id, temp_branches[i].page_idx, EXCLUSIVE_LATCH);
 
-        child_page.page_header.parent_page_idx = new_page_idx;
+        child_page->page_header.parent_page_idx = new_page_idx;
 
-        buffered_write_page(table_id, temp_branches[i].page_idx, &child_page);
+        child_page.mark_dirty();
     }
 
     /* Insert a new key into the parent of the two
@@ -239,30 +552,33 @@ pagenum_t insert_into_node_after_splitting(tableid_t table_id,
      * the old node to the left and the new to the right.
      */
 
-    buffered_write_page(table_id, page_idx, &page);
-    buffered_write_page(table_id, new_page_idx, &new_page);
+    page.mark_dirty();
+    new_page.mark_dirty();
+    page.release();
+    new_page.release();
 
     return insert_into_parent(table_id, page_idx, seperate_key, new_page_idx);
 }
 
 pagenum_t insert_into_parent(tableid_t table_id, pagenum_t left_page_idx,
                              recordkey_t key, pagenum_t right_page_idx) {
-    allocatedpage_t left_page;
-
-    internalpage_t parent_page;
     pagenum_t parent_page_idx;
+    uint32_t parent_key_num;
 
-    buffered_read_page(table_id, left_page_idx, &left_page, 0, false);
+    PageGuard<allocatedpage_t> left_page(table_id, left_page_idx);
+    parent_page_idx = left_page->page_header.parent_page_idx;
+    left_page.release();
 
-    if (left_page.page_header.parent_page_idx == 0) {
+    if (parent_page_idx == 0) {
         return insert_into_new_root(table_id, left_page_idx, key,
                                     right_page_idx);
     }
 
-    parent_page_idx = left_page.page_header.parent_page_idx;
-    buffered_read_page(table_id, parent_page_idx, &parent_page, 0, false);
+    PageGuard<internalpage_t> parent_page(table_id, parent_page_idx);
+    parent_key_num = parent_page->page_header.key_num;
+    parent_page.release();
 
-    if (parent_page.page_header.key_num < 248)
+    if (parent_key_num < 248)
         return insert_into_node(table_id, parent_page_idx, left_page_idx, key,
                                 right_page_idx);
 
@@ -275,22 +591,23 @@ pagenum_t insert_into_leaf_after_splitting(tableid_t table_id,
                                            recordkey_t key, const char* value,
                                            valsize_t value_size) {
     recordkey_t new_key;
-    leafpage_t leaf_page, new_leaf_page;
     pagenum_t new_leaf_page_idx;
-    PageSlot* leaf_slot = page_helper::get_page_slot(&leaf_page);
 
-    buffered_read_page(table_id, leaf_page_idx, &leaf_page);
+    PageGuard<leafpage_t> leaf_page(table_id, leaf_page_idx, EXCLUSIVE_LATCH);
+    PageSlot* leaf_slot = page_helper::get_page_slot(leaf_page.get());
 
-    int total_values_num = leaf_page.page_header.key_num + 1;
+    int total_values_num = leaf_page->page_header.key_num + 1;
     std::vector<std::pair<PageSlot, const char*>> temp;
 
     new_leaf_page_idx =
-        make_leaf(table_id, leaf_page.page_header.parent_page_idx);
-    buffered_read_page(table_id, new_leaf_page_idx, &new_leaf_page);
+        make_leaf(table_id, leaf_page->page_header.parent_page_idx,
+                  leaf_page_idx);
+    PageGuard<leafpage_t> new_leaf_page(table_id, new_leaf_page_idx,
+                                        EXCLUSIVE_LATCH);
 
-    for (int i = 0; i < leaf_page.page_header.key_num; i++) {
+    for (int i = 0; i < leaf_page->page_header.key_num; i++) {
         char* temp_value = new char[MAX_VALUE_SIZE];
-        page_helper::get_leaf_value(&leaf_page, i, temp_value);
+        page_helper::get_leaf_value(leaf_page.get(), i, temp_value);
 
         temp.emplace_back(leaf_slot[i], temp_value);
     }
@@ -311,36 +628,39 @@ pagenum_t insert_into_leaf_after_splitting(tableid_t table_id,
 
     int split_start = 0;
     int acc_len = 0;
-    for (; split_start < leaf_page.page_header.key_num + 1; split_start++) {
+    for (; split_start < leaf_page->page_header.key_num + 1; split_start++) {
         acc_len += temp[split_start].first.value_size + sizeof(PageSlot);
         if (acc_len >= (PAGE_SIZE - PAGE_HEADER_SIZE) / 2) {
             break;
         }
     }
 
-    leaf_page.page_header.key_num = 0;
-    *page_helper::get_free_space(&leaf_page) = PAGE_SIZE - PAGE_HEADER_SIZE;
+    leaf_page->page_header.key_num = 0;
+    *page_helper::get_free_space(leaf_page.get()) =
+        PAGE_SIZE - PAGE_HEADER_SIZE;
 
     for (int i = 0; i < split_start; i++) {
-        page_helper::add_leaf_value(&leaf_page, temp[i].first.key,
+        page_helper::add_leaf_value(leaf_page.get(), temp[i].first.key,
                                     temp[i].second, temp[i].first.value_size);
     }
 
     new_key = temp[split_start].first.key;
     for (int i = split_start; i < total_values_num; i++) {
-        page_helper::add_leaf_value(&new_leaf_page, temp[i].first.key,
+        page_helper::add_leaf_value(new_leaf_page.get(), temp[i].first.key,
                                     temp[i].second, temp[i].first.value_size);
     }
 
-    uint64_t* leaf_sibling_idx = page_helper::get_sibling_idx(&leaf_page);
+    uint64_t* leaf_sibling_idx = page_helper::get_sibling_idx(leaf_page.get());
     uint64_t* new_leaf_sibling_idx =
-        page_helper::get_sibling_idx(&new_leaf_page);
+        page_helper::get_sibling_idx(new_leaf_page.get());
 
     *new_leaf_sibling_idx = *leaf_sibling_idx;
     *leaf_sibling_idx = new_leaf_page_idx;
 
-    buffered_write_page(table_id, leaf_page_idx, &leaf_page);
-    buffered_write_page(table_id, new_leaf_page_idx, &new_leaf_page);
+    leaf_page.mark_dirty();
+    new_leaf_page.mark_dirty();
+    leaf_page.release();
+    new_leaf_page.release();
 
     for (auto& temp_pair : temp) {
         delete[] temp_pair.second;
@@ -352,9 +672,7 @@ pagenum_t insert_into_leaf_after_splitting(tableid_t table_id,
 
 pagenum_t insert_node(tableid_t table_id, recordkey_t key, const char* value,
                       valsize_t value_size) {
-    headerpage_t header_page;
-
-    leafpage_t leaf_page;
+    pagenum_t root_page_idx;
     pagenum_t leaf_page_idx;
 
     /* The current implementation ignores
@@ -369,8 +687,11 @@ pagenum_t insert_node(tableid_t table_id, recordkey_t key, const char* value,
      * Start a new tree.
      */
 
-    buffered_read_page(table_id, 0, &header_page, 0, false);
-    if (header_page.root_page_idx == 0)
+    PageGuard<headerpage_t> header_page(table_id, 0);
+    root_page_idx = header_page->root_page_idx;
+    header_page.release();
+
+    if (root_page_idx == 0)
         return create_tree(table_id, key, value, value_size);
 
     /* Case: the tree already exists.
@@ -378,18 +699,18 @@ pagenum_t insert_node(tableid_t table_id, recordkey_t key, const char* value,
      */
 
     leaf_page_idx = find_leaf(table_id, key);
-    buffered_read_page(table_id, leaf_page_idx, &leaf_page);
+    PageGuard<leafpage_t> leaf_page(table_id, leaf_page_idx, EXCLUSIVE_LATCH);
 
     /* Case: leaf has room for key and pointer.
      */
 
-    if (page_helper::has_enough_space(&leaf_page, value_size)) {
+    if (page_helper::has_enough_space(leaf_page.get(), value_size)) {
         std::vector<std::pair<PageSlot, const char*>> temp;
-        PageSlot* leaf_slot = page_helper::get_page_slot(&leaf_page);
+        PageSlot* leaf_slot = page_helper::get_page_slot(leaf_page.get());
 
-        for (int i = 0; i < leaf_page.page_header.key_num; i++) {
+        for (int i = 0; i < leaf_page->page_header.key_num; i++) {
             char* temp_value = new char[MAX_VALUE_SIZE];
-            page_helper::get_leaf_value(&leaf_page, i, temp_value);
+            page_helper::get_leaf_value(leaf_page.get(), i, temp_value);
 
             temp.emplace_back(leaf_slot[i], temp_value);
         }
@@ -409,20 +730,21 @@ pagenum_t insert_node(tableid_t table_id, recordkey_t key, const char* value,
                       return a.first.key < b.first.key;
                   });
 
-        leaf_page.page_header.key_num = 0;
-        *page_helper::get_free_space(&leaf_page) = PAGE_SIZE - PAGE_HEADER_SIZE;
+        leaf_page->page_header.key_num = 0;
+        *page_helper::get_free_space(leaf_page.get()) =
+            PAGE_SIZE - PAGE_HEADER_SIZE;
 
         for (auto& temp_pair : temp) {
-            page_helper::add_leaf_value(&leaf_page, temp_pair.first.key,
+            page_helper::add_leaf_value(leaf_page.get(), temp_pair.first.key,
                                         temp_pair.second,
                                         temp_pair.first.value_size);
             delete[] temp_pair.second;
         }
 
-        buffered_write_page(table_id, leaf_page_idx, &leaf_page);
+        leaf_page.mark_dirty();
         return leaf_page_idx;
     } else {
-        buffered_release_page(table_id, leaf_page_idx);
+        leaf_page.release();
     }
 
     /* Case:  leaf must be split.
@@ -433,19 +755,22 @@ pagenum_t insert_node(tableid_t table_id, recordkey_t key, const char* value,
 }
 
 pagenum_t adjust_root(tableid_t table_id) {
-    headerpage_t header_page;
-    allocatedpage_t root_page, new_root_page;
+    pagenum_t root_page_idx;
+    bool is_leaf_root;
+    pagenum_t child_page_idx = 0;
+
+    PageGuard<headerpage_t> header_page(table_id, 0);
+    root_page_idx = header_page->root_page_idx;
+    header_page.release();
 
-    buffered_read_page(table_id, 0, &header_page, 0, false);
-    buffered_read_page(table_id, header_page.root_page_idx, &root_page, 0,
-                       false);
+    PageGuard<internalpage_t> root_page(table_id, root_page_idx);
 
     /* Case: nonempty root.
      * Key and pointer have already been deleted,
      * so nothing to be done.
      */
 
-    if (root_page.page_header.key_num > 0) return header_page.root_page_idx;
+    if (root_page->page_header.key_num > 0) return root_page_idx;
 
     /* Case: empty root.
      */
@@ -454,99 +779,103 @@ pagenum_t adjust_root(tableid_t table_id) {
     // the first (only) child
     // as the new root.
 
-    buffered_free_page(table_id, header_page.root_page_idx);
-    buffered_read_page(table_id, 0, &header_page);
+    // Freeing overwrites the root page, so read it in advance.
+    is_leaf_root = root_page->page_header.is_leaf_page;
+    if (!is_leaf_root) {
+        child_page_idx = *page_helper::get_leftmost_child_idx(root_page.get());
+    }
+    root_page.release();
+
+    buffered_free_page(table_id, root_page_idx);
+    header_page = PageGuard<headerpage_t>(table_id, 0, EXCLUSIVE_LATCH);
 
-    if (!root_page.page_header.is_leaf_page) {
-        header_page.root_page_idx = *page_helper::get_leftmost_child_idx(
-            reinterpret_cast<internalpage_t*>(&root_page));
-        buffered_read_page(table_id, header_page.root_page_idx, &new_root_page);
-        new_root_page.page_header.parent_page_idx = 0;
-        buffered_write_page(table_id, header_page.root_page_idx,
-                            &new_root_page);
+    if (!is_leaf_root) {
+        header_page->root_page_idx = child_page_idx;
+        PageGuard<allocatedpage_t> new_root_page(table_id, child_page_idx,
+                                                 EXCLUSIVE_LATCH);
+        new_root_page->page_header.parent_page_idx = 0;
+        new_root_page.mark_dirty();
     } else {
-        header_page.root_page_idx = 0;
-        buffered_write_page(table_id, 0, &header_page);
+        header_page->root_page_idx = 0;
+        header_page.mark_dirty();
         return 1;
     }
 
-    buffered_write_page(table_id, 0, &header_page);
+    header_page.mark_dirty();
 
-    return header_page.root_page_idx;
+    return header_page->root_page_idx;
 }
 
 pagenum_t coalesce_internal_nodes(tableid_t table_id, pagenum_t left_page_idx,
                                   recordkey_t seperate_key,
                                   int seperate_key_idx,
                                   pagenum_t right_page_idx) {
-    headerpage_t header_page;
-
-    recordkey_t old_key;
-    internalpage_t parent_page;
-    internalpage_t left_page, right_page;
-    allocatedpage_t child_page;
-    PageSlot* right_slot;
+    pagenum_t root_page_idx;
+    pagenum_t parent_page_idx;
+    pagenum_t right_leftmost_child_idx;
+
+    PageGuard<headerpage_t> header_page(table_id, 0);
+    root_page_idx = header_page->root_page_idx;
+    header_page.release();
+
+    PageGuard<internalpage_t> left_page(table_id, left_page_idx,
+                                        EXCLUSIVE_LATCH);
+    PageGuard<internalpage_t> right_page(table_id, right_page_idx);
+    parent_page_idx = left_page->page_header.parent_page_idx;
+
+    right_leftmost_child_idx =
+        *page_helper::get_leftmost_child_idx(right_page.get());
+    page_helper::add_internal_key(left_page.get(), seperate_key,
+                                  right_leftmost_child_idx);
+
+    PageGuard<allocatedpage_t> leftmost_child_page(
+        table_id, right_leftmost_child_idx, EXCLUSIVE_LATCH);
+    leftmost_child_page->page_header.parent_page_idx = left_page_idx;
+    leftmost_child_page.mark_dirty();
+    leftmost_child_page.release();
+
+    for (int i = 0; i < right_page->page_header.key_num; i++) {
+        page_helper::add_internal_key(left_page.get(),
+                                      right_page->page_branches[i].key,
+                                      right_page->page_branches[i].page_idx);
+
+        PageGuard<allocatedpage_t> child_page(
+            table_id, right_page->page_branches[i].page_idx, EXCLUSIVE_LATCH);
+        child_page->page_header.parent_page_idx = left_page_idx;
+        child_page.mark_dirty();
+    }
 
-    buffered_read_page(table_id, 0, &header_page, 0, false);
-    buffered_read_page(table_id, left_page_idx, &left_page);
-    buffered_read_page(table_id, right_page_idx, &right_page, 0, false);
-    buffered_read_page(table_id, left_page.page_header.parent_page_idx,
-                       &parent_page);
-
-    page_helper::add_internal_key(
-        &left_page, seperate_key,
-        *page_helper::get_leftmost_child_idx(&right_page));
-
-    buffered_read_page(table_id,
-                       *page_helper::get_leftmost_child_idx(&right_page),
-                       &child_page);
-    child_page.page_header.parent_page_idx = left_page_idx;
-    buffered_write_page(table_id,
-                        *page_helper::get_leftmost_child_idx(&right_page),
-                        &child_page);
-
-    for (int i = 0; i < right_page.page_header.key_num; i++) {
-        allocatedpage_t child_page;
-        page_helper::add_internal_key(&left_page,
-                                      right_page.page_branches[i].key,
-                                      right_page.page_branches[i].page_idx);
-
-        buffered_read_page(table_id, right_page.page_branches[i].page_idx,
-                           &child_page);
-        child_page.page_header.parent_page_idx = left_page_idx;
-        buffered_write_page(table_id, right_page.page_branches[i].page_idx,
-                            &child_page);
-    }
-
-    buffered_write_page(table_id, left_page_idx, &left_page);
+    left_page.mark_dirty();
+    left_page.release();
+    right_page.release();
     buffered_free_page(table_id, right_page_idx);
-    buffered_release_page(table_id, left_page.page_header.parent_page_idx);
 
-    for (int i = 0; i < parent_page.page_header.key_num; i++) {
-        if (parent_page.page_branches[i].page_idx == right_page_idx) {
-            delete_internal_key(table_id, left_page.page_header.parent_page_idx,
-                                parent_page.page_branches[i].key);
+    PageGuard<internalpage_t> parent_page(table_id, parent_page_idx);
+    for (int i = 0; i < parent_page->page_header.key_num; i++) {
+        if (parent_page->page_branches[i].page_idx == right_page_idx) {
+            recordkey_t parent_key = parent_page->page_branches[i].key;
+            parent_page.release();
+            delete_internal_key(table_id, parent_page_idx, parent_key);
             break;
         }
     }
 
-    return header_page.root_page_idx;
+    return root_page_idx;
 }
 
 pagenum_t coalesce_leaf_nodes(tableid_t table_id, pagenum_t left_page_idx,
                               pagenum_t right_page_idx) {
-    headerpage_t header_page;
-
-    recordkey_t old_key;
-    internalpage_t parent_page;
-    leafpage_t left_page, right_page;
+    pagenum_t root_page_idx;
+    pagenum_t parent_page_idx;
     PageSlot* right_slot;
 
-    buffered_read_page(table_id, 0, &header_page, 0, false);
-    buffered_read_page(table_id, left_page_idx, &left_page);
-    buffered_read_page(table_id, right_page_idx, &right_page, 0, false);
-    buffered_read_page(table_id, left_page.page_header.parent_page_idx,
-                       &parent_page, 0, false);
+    PageGuard<headerpage_t> header_page(table_id, 0);
+    root_page_idx = header_page->root_page_idx;
+    header_page.release();
+
+    PageGuard<leafpage_t> left_page(table_id, left_page_idx, EXCLUSIVE_LATCH);
+    PageGuard<leafpage_t> right_page(table_id, right_page_idx);
+    parent_page_idx = left_page->page_header.parent_page_idx;
 
     /* In a leaf, append the keys and pointers of
      * n to the neighbor.
@@ -554,99 +883,109 @@ pagenum_t coalesce_leaf_nodes(tableid_t table_id, pagenum_t left_page_idx,
      * what had been n's right neighbor.
      */
 
-    right_slot = page_helper::get_page_slot(&right_page);
+    right_slot = page_helper::get_page_slot(right_page.get());
 
-    for (int i = 0; i < right_page.page_header.key_num; i++) {
+    for (int i = 0; i < right_page->page_header.key_num; i++) {
         char right_slot_value[MAX_VALUE_SIZE];
-        page_helper::get_leaf_value(&right_page, i, right_slot_value);
-        page_helper::add_leaf_value(&left_page, right_slot[i].key,
+        page_helper::get_leaf_value(right_page.get(), i, right_slot_value);
+        page_helper::add_leaf_value(left_page.get(), right_slot[i].key,
                                     right_slot_value, right_slot[i].value_size);
     }
-    *page_helper::get_sibling_idx(&left_page) =
-        *page_helper::get_sibling_idx(&right_page);
+    *page_helper::get_sibling_idx(left_page.get()) =
+        *page_helper::get_sibling_idx(right_page.get());
 
-    buffered_write_page(table_id, left_page_idx, &left_page);
+    left_page.mark_dirty();
+    left_page.release();
+    right_page.release();
     buffered_free_page(table_id, right_page_idx);
 
-    for (int i = 0; i < parent_page.page_header.key_num; i++) {
-        if (parent_page.page_branches[i].page_idx == right_page_idx) {
-            delete_internal_key(table_id, left_page.page_header.parent_page_idx,
-                                parent_page.page_branches[i].key);
+    PageGuard<internalpage_t> parent_page(table_id, parent_page_idx);
+    for (int i = 0; i < parent_page->page_header.key_num; i++) {
+        if (parent_page->page_branches[i].page_idx == right_page_idx) {
+            recordkey_t parent_key = parent_page->page_branches[i].key;
+            parent_page.release();
+            delete_internal_key(table_id, parent_page_idx, parent_key);
             break;
         }
     }
 
-    return header_page.root_page_idx;
+    return root_page_idx;
 }
 
 pagenum_t delete_internal_key(tableid_t table_id, pagenum_t internal_page_idx,
                               recordkey_t key) {
-    headerpage_t header_page;
+    pagenum_t root_page_idx;
 
     int seperate_key_idx;
     recordkey_t seperate_key;
     bool left_sibling = false;
 
     pagenum_t sibling_page_idx = 0;
-    internalpage_t internal_page, sibling_page;
-
     pagenum_t parent_page_idx;
-    internalpage_t parent_page;
 
-    buffered_read_page(table_id, 0, &header_page, 0, false);
-    buffered_read_page(table_id, internal_page_idx, &internal_page);
-    page_helper::remove_internal_key(&internal_page, key);
-    buffered_write_page(table_id, internal_page_idx, &internal_page);
+    PageGuard<headerpage_t> header_page(table_id, 0);
+    root_page_idx = header_page->root_page_idx;
+    header_page.release();
+
+    PageGuard<internalpage_t> internal_page(table_id, internal_page_idx,
+                                            EXCLUSIVE_LATCH);
+    page_helper::remove_internal_key(internal_page.get(), key);
+    internal_page.mark_dirty();
 
-    parent_page_idx = internal_page.page_header.parent_page_idx;
+    parent_page_idx = internal_page->page_header.parent_page_idx;
 
-    if (internal_page_idx == header_page.root_page_idx)
+    if (internal_page_idx == root_page_idx) {
+        internal_page.release();
         return adjust_root(table_id);
+    }
 
-    if (internal_page.page_header.key_num >= 124)
-        return header_page.root_page_idx;
+    if (internal_page->page_header.key_num >= 124) return root_page_idx;
 
-    buffered_read_page(table_id, parent_page_idx, &parent_page);
-    if (*page_helper::get_leftmost_child_idx(&parent_page) ==
+    PageGuard<internalpage_t> parent_page(table_id, parent_page_idx,
+                                          EXCLUSIVE_LATCH);
+    if (*page_helper::get_leftmost_child_idx(parent_page.get()) ==
         internal_page_idx) {
         seperate_key_idx = 0;
-        seperate_key = parent_page.page_branches[0].key;
-        sibling_page_idx = parent_page.page_branches[0].page_idx;
+        seperate_key = parent_page->page_branches[0].key;
+        sibling_page_idx = parent_page->page_branches[0].page_idx;
     }
-    for (int i = 0; i < parent_page.page_header.key_num - 1; i++) {
-        if (parent_page.page_branches[i].page_idx == internal_page_idx) {
+    for (int i = 0; i < parent_page->page_header.key_num - 1; i++) {
+        if (parent_page->page_branches[i].page_idx == internal_page_idx) {
             seperate_key_idx = i + 1;
-            seperate_key = parent_page.page_branches[i + 1].key;
-            sibling_page_idx = parent_page.page_branches[i + 1].page_idx;
+            seperate_key = parent_page->page_branches[i + 1].key;
+            sibling_page_idx = parent_page->page_branches[i + 1].page_idx;
         }
     }
 
     if (sibling_page_idx == 0) {
-        if (parent_page.page_header.key_num < 2) {
+        if (parent_page->page_header.key_num < 2) {
             seperate_key_idx = 0;
-            seperate_key = parent_page.page_branches[0].key;
+            seperate_key = parent_page->page_branches[0].key;
             sibling_page_idx =
-                *page_helper::get_leftmost_child_idx(&parent_page);
+                *page_helper::get_leftmost_child_idx(parent_page.get());
         } else {
-            seperate_key_idx = parent_page.page_header.key_num - 1;
+            seperate_key_idx = parent_page->page_header.key_num - 1;
             seperate_key =
-                parent_page.page_branches[parent_page.page_header.key_num - 1]
+                parent_page->page_branches[parent_page->page_header.key_num - 1]
                     .key;
             sibling_page_idx =
-                parent_page.page_branches[parent_page.page_header.key_num - 2]
+                parent_page->page_branches[parent_page->page_header.key_num - 2]
                     .page_idx;
         }
         left_sibling = true;
     }
 
-    buffered_read_page(table_id, sibling_page_idx, &sibling_page);
+    PageGuard<internalpage_t> sibling_page(table_id, sibling_page_idx,
+                                           EXCLUSIVE_LATCH);
 
     /* Coalescence. */
 
-    if (internal_page.page_header.key_num + sibling_page.page_header.key_num <
+    if (internal_page->page_header.key_num +
+            sibling_page->page_header.key_num <
         248) {
-        buffered_release_page(table_id, parent_page_idx);
-        buffered_release_page(table_id, sibling_page_idx);
+        internal_page.release();
+        parent_page.release();
+        sibling_page.release();
         if (!left_sibling)
             return coalesce_internal_nodes(table_id, internal_page_idx,
                                            seperate_key, seperate_key_idx,
@@ -656,144 +995,151 @@ pagenum_t delete_internal_key(tableid_t table_id, pagenum_t internal_page_idx,
                                            seperate_key, seperate_key_idx,
                                            internal_page_idx);
     } else {
-        buffered_read_page(table_id, internal_page_idx, &internal_page);
-
-        allocatedpage_t leftmost_child_page;
         if (!left_sibling) {
-            parent_page.page_branches[seperate_key_idx].key =
-                sibling_page.page_branches[0].key;
+            parent_page->page_branches[seperate_key_idx].key =
+                sibling_page->page_branches[0].key;
             page_helper::add_internal_key(
-                &internal_page, seperate_key,
-                *page_helper::get_leftmost_child_idx(&sibling_page));
-
-            buffered_read_page(
-                table_id, *page_helper::get_leftmost_child_idx(&sibling_page),
-                &leftmost_child_page);
-            leftmost_child_page.page_header.parent_page_idx = internal_page_idx;
-            buffered_write_page(
-                table_id, *page_helper::get_leftmost_child_idx(&sibling_page),
-                &leftmost_child_page);
-
-            *page_helper::get_leftmost_child_idx(&sibling_page) =
-                sibling_page.page_branches[0].page_idx;
-
-            page_helper::remove_internal_key(&sibling_page,
-                                             sibling_page.page_branches[0].key);
+                internal_page.get(), seperate_key,
+                *page_helper::get_leftmost_child_idx(sibling_page.get()));
+
+            PageGuard<allocatedpage_t> leftmost_child_page(
+                table_id,
+                *page_helper::get_leftmost_child_idx(sibling_page.get()),
+                EXCLUSIVE_LATCH);
+            leftmost_child_page->page_header.parent_page_idx =
+                internal_page_idx;
+            leftmost_child_page.mark_dirty();
+            leftmost_child_page.release();
+
+            *page_helper::get_leftmost_child_idx(sibling_page.get()) =
+                sibling_page->page_branches[0].page_idx;
+
+            page_helper::remove_internal_key(
+                sibling_page.get(), sibling_page->page_branches[0].key);
         } else {
-            for (int i = internal_page.page_header.key_num; i > 0; i--) {
-                internal_page.page_branches[i] =
-                    internal_page.page_branches[i - 1];
+            for (int i = internal_page->page_header.key_num; i > 0; i--) {
+                internal_page->page_branches[i] =
+                    internal_page->page_branches[i - 1];
             }
-            internal_page.page_branches[0].key = seperate_key;
-            internal_page.page_branches[0].page_idx =
-                *page_helper::get_leftmost_child_idx(&internal_page);
+            internal_page->page_branches[0].key = seperate_key;
+            internal_page->page_branches[0].page_idx =
+                *page_helper::get_leftmost_child_idx(internal_page.get());
 
-            internal_page.page_header.key_num++;
+            internal_page->page_header.key_num++;
 
-            parent_page.page_branches[seperate_key_idx].key =
-                sibling_page.page_branches[sibling_page.page_header.key_num - 1]
+            parent_page->page_branches[seperate_key_idx].key =
+                sibling_page
+                    ->page_branches[sibling_page->page_header.key_num - 1]
                     .key;
 
-            *page_helper::get_leftmost_child_idx(&internal_page) =
-                sibling_page.page_branches[sibling_page.page_header.key_num - 1]
+            *page_helper::get_leftmost_child_idx(internal_page.get()) =
+                sibling_page
+                    ->page_branches[sibling_page->page_header.key_num - 1]
                     .page_idx;
 
-            buffered_read_page(
-                table_id, *page_helper::get_leftmost_child_idx(&internal_page),
-                &leftmost_child_page);
-            leftmost_child_page.page_header.parent_page_idx = internal_page_idx;
-            buffered_write_page(
-                table_id, *page_helper::get_leftmost_child_idx(&internal_page),
-                &leftmost_child_page);
+            PageGuard<allocatedpage_t> leftmost_child_page(
+                table_id,
+                *page_helper::get_leftmost_child_idx(internal_page.get()),
+                EXCLUSIVE_LATCH);
+            leftmost_child_page->page_header.parent_page_idx =
+                internal_page_idx;
+            leftmost_child_page.mark_dirty();
+            leftmost_child_page.release();
 
             page_helper::remove_internal_key(
-                &sibling_page,
-                sibling_page.page_branches[sibling_page.page_header.key_num - 1]
+                sibling_page.get(),
+                sibling_page
+                    ->page_branches[sibling_page->page_header.key_num - 1]
                     .key);
         }
 
-        buffered_write_page(table_id, internal_page_idx, &internal_page);
-        buffered_write_page(table_id, sibling_page_idx, &sibling_page);
-        buffered_write_page(table_id, parent_page_idx, &parent_page);
+        sibling_page.mark_dirty();
+        parent_page.mark_dirty();
     }
 
-    return header_page.root_page_idx;
+    return root_page_idx;
 }
 
 pagenum_t delete_leaf_key(tableid_t table_id, pagenum_t leaf_page_idx,
                           recordkey_t key) {
-    headerpage_t header_page;
+    pagenum_t root_page_idx;
 
     int seperate_key_idx = 99999;
     bool left_sibling = false;
 
     pagenum_t sibling_page_idx;
-    leafpage_t leaf_page, sibling_page;
-
     pagenum_t parent_page_idx;
-    internalpage_t parent_page;
 
-    buffered_read_page(table_id, 0, &header_page, 0, false);
-    buffered_read_page(table_id, leaf_page_idx, &leaf_page);
-    page_helper::remove_leaf_value(&leaf_page, key);
-    buffered_write_page(table_id, leaf_page_idx, &leaf_page);
+    PageGuard<headerpage_t> header_page(table_id, 0);
+    root_page_idx = header_page->root_page_idx;
+    header_page.release();
 
-    parent_page_idx = leaf_page.page_header.parent_page_idx;
+    PageGuard<leafpage_t> leaf_page(table_id, leaf_page_idx, EXCLUSIVE_LATCH);
+    page_helper::remove_leaf_value(leaf_page.get(), key);
+    leaf_page.mark_dirty();
 
-    if (leaf_page_idx == header_page.root_page_idx)
+    parent_page_idx = leaf_page->page_header.parent_page_idx;
+
+    if (leaf_page_idx == root_page_idx) {
+        leaf_page.release();
         return adjust_root(table_id);
+    }
 
-    buffered_read_page(table_id, parent_page_idx, &parent_page);
+    PageGuard<internalpage_t> parent_page(table_id, parent_page_idx,
+                                          EXCLUSIVE_LATCH);
 
-    if (*page_helper::get_free_space(&leaf_page) < REDISTRIBUTE_THRESHOLD) {
-        buffered_release_page(table_id, parent_page_idx);
+    if (*page_helper::get_free_space(leaf_page.get()) <
+        REDISTRIBUTE_THRESHOLD) {
         return leaf_page_idx;
     }
 
-    sibling_page_idx = *page_helper::get_sibling_idx(&leaf_page);
-    for (int i = 0; i < parent_page.page_header.key_num; i++) {
-        if (parent_page.page_branches[i].page_idx == sibling_page_idx) {
+    sibling_page_idx = *page_helper::get_sibling_idx(leaf_page.get());
+    for (int i = 0; i < parent_page->page_header.key_num; i++) {
+        if (parent_page->page_branches[i].page_idx == sibling_page_idx) {
             seperate_key_idx = i;
         }
     }
 
     if (sibling_page_idx == 0) {
-        if (parent_page.page_header.key_num < 2) {
+        if (parent_page->page_header.key_num < 2) {
             seperate_key_idx = 0;
             sibling_page_idx =
-                *page_helper::get_leftmost_child_idx(&parent_page);
+                *page_helper::get_leftmost_child_idx(parent_page.get());
         } else {
-            seperate_key_idx = parent_page.page_header.key_num - 1;
+            seperate_key_idx = parent_page->page_header.key_num - 1;
             sibling_page_idx =
-                parent_page.page_branches[parent_page.page_header.key_num - 2]
+                parent_page->page_branches[parent_page->page_header.key_num - 2]
                     .page_idx;
         }
         left_sibling = true;
     }
-    buffered_read_page(table_id, sibling_page_idx, &sibling_page);
+    PageGuard<leafpage_t> sibling_page(table_id, sibling_page_idx,
+                                       EXCLUSIVE_LATCH);
 
-    if (sibling_page.page_header.parent_page_idx !=
-        leaf_page.page_header.parent_page_idx) {
-        buffered_release_page(table_id, sibling_page_idx);
-        if (parent_page.page_header.key_num < 2) {
+    if (sibling_page->page_header.parent_page_idx !=
+        leaf_page->page_header.parent_page_idx) {
+        sibling_page.release();
+        if (parent_page->page_header.key_num < 2) {
             seperate_key_idx = 0;
             sibling_page_idx =
-                *page_helper::get_leftmost_child_idx(&parent_page);
+                *page_helper::get_leftmost_child_idx(parent_page.get());
         } else {
-            seperate_key_idx = parent_page.page_header.key_num - 1;
+            seperate_key_idx = parent_page->page_header.key_num - 1;
             sibling_page_idx =
-                parent_page.page_branches[parent_page.page_header.key_num - 2]
+                parent_page->page_branches[parent_page->page_header.key_num - 2]
                     .page_idx;
         }
         left_sibling = true;
-        buffered_read_page(table_id, sibling_page_idx, &sibling_page);
+        sibling_page =
+            PageGuard<leafpage_t>(table_id, sibling_page_idx, EXCLUSIVE_LATCH);
     }
 
-    if (*page_helper::get_free_space(&leaf_page) +
-            *page_helper::get_free_space(&sibling_page) >=
+    if (*page_helper::get_free_space(leaf_page.get()) +
+            *page_helper::get_free_space(sibling_page.get()) >=
         PAGE_SIZE - PAGE_HEADER_SIZE) {
-        buffered_release_page(table_id, parent_page_idx);
-        buffered_release_page(table_id, sibling_page_idx);
+        leaf_page.release();
+        parent_page.release();
+        sibling_page.release();
         if (!left_sibling)
             return coalesce_leaf_nodes(table_id, leaf_page_idx,
                                        sibling_page_idx);
@@ -801,83 +1147,84 @@ pagenum_t delete_leaf_key(tableid_t table_id, pagenum_t leaf_page_idx,
             return coalesce_leaf_nodes(table_id, sibling_page_idx,
                                        leaf_page_idx);
     } else {
-        buffered_read_page(table_id, leaf_page_idx, &leaf_page);
         if (!left_sibling) {
-            PageSlot temp_slot;
-            PageSlot* sibling_slot = page_helper::get_page_slot(&sibling_page);
+            PageSlot* sibling_slot =
+                page_helper::get_page_slot(sibling_page.get());
 
-            while (sibling_page.page_header.key_num > 0 &&
-                   *page_helper::get_free_space(&leaf_page) >=
+            while (sibling_page->page_header.key_num > 0 &&
+                   *page_helper::get_free_space(leaf_page.get()) >=
                        REDISTRIBUTE_THRESHOLD) {
                 char* temp_value = new char[MAX_VALUE_SIZE];
-                page_helper::get_leaf_value(&sibling_page, 0, temp_value);
-                page_helper::add_leaf_value(&leaf_page, sibling_slot[0].key,
-                                            temp_value,
+                page_helper::get_leaf_value(sibling_page.get(), 0, temp_value);
+                page_helper::add_leaf_value(leaf_page.get(),
+                                            sibling_slot[0].key, temp_value,
                                             sibling_slot[0].value_size);
 
-                page_helper::remove_leaf_value(&sibling_page,
+                page_helper::remove_leaf_value(sibling_page.get(),
                                                sibling_slot[0].key);
                 delete[] temp_value;
             }
 
-            parent_page.page_branches[seperate_key_idx].key =
+            parent_page->page_branches[seperate_key_idx].key =
                 sibling_slot[0].key;
         } else {
             std::vector<std::pair<PageSlot, const char*>> temp;
 
-            PageSlot* leaf_slot = page_helper::get_page_slot(&leaf_page);
-            PageSlot* sibling_slot = page_helper::get_page_slot(&sibling_page);
-            uint16_t temp_free_space = *page_helper::get_free_space(&leaf_page);
+            PageSlot* leaf_slot = page_helper::get_page_slot(leaf_page.get());
+            PageSlot* sibling_slot =
+                page_helper::get_page_slot(sibling_page.get());
+            uint16_t temp_free_space =
+                *page_helper::get_free_space(leaf_page.get());
 
-            while (sibling_page.page_header.key_num > 0 &&
+            while (sibling_page->page_header.key_num > 0 &&
                    temp_free_space >= REDISTRIBUTE_THRESHOLD) {
                 char* temp_value = new char[MAX_VALUE_SIZE];
                 page_helper::get_leaf_value(
-                    &sibling_page, sibling_page.page_header.key_num - 1,
+                    sibling_page.get(), sibling_page->page_header.key_num - 1,
                     temp_value);
 
                 temp.emplace_back(
-                    sibling_slot[sibling_page.page_header.key_num - 1],
+                    sibling_slot[sibling_page->page_header.key_num - 1],
                     temp_value);
                 temp_free_space -=
-                    sibling_slot[sibling_page.page_header.key_num - 1]
+                    sibling_slot[sibling_page->page_header.key_num - 1]
                         .value_size +
                     sizeof(PageSlot);
 
                 page_helper::remove_leaf_value(
-                    &sibling_page,
-                    sibling_slot[sibling_page.page_header.key_num - 1].key);
+                    sibling_page.get(),
+                    sibling_slot[sibling_page->page_header.key_num - 1].key);
             }
 
             std::reverse(temp.begin(), temp.end());
 
-            for (int i = 0; i < leaf_page.page_header.key_num; i++) {
+            for (int i = 0; i < leaf_page->page_header.key_num; i++) {
                 char* temp_value = new char[MAX_VALUE_SIZE];
-                page_helper::get_leaf_value(&leaf_page, i, temp_value);
+                page_helper::get_leaf_value(leaf_page.get(), i, temp_value);
 
                 temp.emplace_back(leaf_slot[i], temp_value);
             }
 
-            leaf_page.page_header.key_num = 0;
-            *page_helper::get_free_space(&leaf_page) =
+            leaf_page->page_header.key_num = 0;
+            *page_helper::get_free_space(leaf_page.get()) =
                 PAGE_SIZE - PAGE_HEADER_SIZE;
 
             for (auto& temp_pair : temp) {
-                page_helper::add_leaf_value(&leaf_page, temp_pair.first.key,
+                page_helper::add_leaf_value(leaf_page.get(),
+                                            temp_pair.first.key,
                                             temp_pair.second,
                                             temp_pair.first.value_size);
                 delete[] temp_pair.second;
             }
 
-            parent_page.page_branches[seperate_key_idx].key = leaf_slot[0].key;
+            parent_page->page_branches[seperate_key_idx].key = leaf_slot[0].key;
         }
 
-        buffered_write_page(table_id, leaf_page_idx, &leaf_page);
-        buffered_write_page(table_id, sibling_page_idx, &sibling_page);
-        buffered_write_page(table_id, parent_page_idx, &parent_page);
+        sibling_page.mark_dirty();
+        parent_page.mark_dirty();
     }
 
-    return header_page.root_page_idx;
+    return root_page_idx;
 }
 
 pagenum_t delete_node(tableid_t table_id, recordkey_t key) {
@@ -901,29 +1248,30 @@ pagenum_t update_node(tableid_t table_id, recordkey_t key, const char* value,
 
     if (leaf_page_idx == 0) return 0;
 
-    leafpage_t leaf_page;
-    buffered_read_page(table_id, leaf_page_idx, &leaf_page, trx_id, false);
+    PageGuard<leafpage_t> leaf_page(table_id, leaf_page_idx);
 
-    int key_idx = page_helper::get_record_idx(&leaf_page, key);
+    int key_idx = page_helper::get_record_idx(leaf_page.get(), key);
+    leaf_page.release();
 
     if (!trx_helper::lock_acquire(table_id, leaf_page_idx, key_idx, trx_id,
                                   EXCLUSIVE)) {
         return 0;
     }
-    buffered_read_page(table_id, leaf_page_idx, &leaf_page, trx_id, true);
+    leaf_page =
+        PageGuard<leafpage_t>(table_id, leaf_page_idx, EXCLUSIVE_LATCH);
 
     char* old_value = new char[MAX_VALUE_SIZE];
 
-    if (page_helper::set_leaf_value(&leaf_page, key, old_value, old_val_size, value,
-                                    new_val_size)) {
+    if (page_helper::set_leaf_value(leaf_page.get(), key, old_value,
+                                    old_val_size, value, new_val_size)) {
         //trx_helper::log_update(table_id, key, old_value, *old_val_size, trx_id);
-        buffered_write_page(table_id, leaf_page_idx, &leaf_page);
-        
+        leaf_page.mark_dirty();
+
         delete[] old_value;
         return leaf_page_idx;
     }
 
-    buffered_release_page(table_id, leaf_page_idx);
+    leaf_page.release();
 
     delete[] old_value;
     return 0;
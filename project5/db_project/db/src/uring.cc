@@ -0,0 +1,258 @@
+/**
+ * @addtogroup DiskSpaceManager
+ * @{
+ */
+#include <errno.h>
+#include <errors.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <uring.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+int io_uring_setup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int io_uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete,
+                   unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, to_submit,
+                                    min_complete, flags, nullptr, 0));
+}
+
+unsigned* ring_field(void* ring, unsigned offset) {
+    return reinterpret_cast<unsigned*>(static_cast<char*>(ring) + offset);
+}
+}  // namespace
+
+IoUring::IoUring()
+    : ring_fd(-1),
+      sq_ring(MAP_FAILED),
+      sq_ring_size(0),
+      cq_ring(MAP_FAILED),
+      cq_ring_size(0),
+      sqes(static_cast<io_uring_sqe*>(MAP_FAILED)),
+      sqes_size(0),
+      inflight(0),
+      queued(0) {
+    pthread_mutex_init(&submit_mutex, NULL);
+    pthread_cond_init(&inflight_cond, NULL);
+}
+
+IoUring::~IoUring() {
+    if (ring_fd >= 0) {
+        // A no-op with empty user data stops the reaper thread.
+        pthread_mutex_lock(&submit_mutex);
+        io_uring_sqe* sqe = get_sqe();
+        memset(sqe, 0, sizeof(io_uring_sqe));
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = 0;
+        flush_sqes();
+        pthread_mutex_unlock(&submit_mutex);
+
+        pthread_join(reaper_thread, NULL);
+    }
+
+    if (sqes != MAP_FAILED) {
+        munmap(sqes, sqes_size);
+    }
+    if (cq_ring != MAP_FAILED && cq_ring != sq_ring) {
+        munmap(cq_ring, cq_ring_size);
+    }
+    if (sq_ring != MAP_FAILED) {
+        munmap(sq_ring, sq_ring_size);
+    }
+    if (ring_fd >= 0) {
+        close(ring_fd);
+    }
+
+    pthread_cond_destroy(&inflight_cond);
+    pthread_mutex_destroy(&submit_mutex);
+}
+
+int IoUring::init(unsigned entries) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    if ((ring_fd = io_uring_setup(entries, &params)) < 0) {
+        ring_fd = -1;
+        return -1;
+    }
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    // Newer kernels map both rings with a single mmap.
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+
+    sq_ring = mmap(NULL, sq_ring_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED) {
+        return -1;
+    }
+
+    if (single_mmap) {
+        cq_ring = sq_ring;
+    } else {
+        cq_ring = mmap(NULL, cq_ring_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ring == MAP_FAILED) {
+            return -1;
+        }
+    }
+
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe*>(
+        mmap(NULL, sqes_size, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES));
+    if (sqes == MAP_FAILED) {
+        return -1;
+    }
+
+    sq_head = ring_field(sq_ring, params.sq_off.head);
+    sq_tail = ring_field(sq_ring, params.sq_off.tail);
+    sq_mask = *ring_field(sq_ring, params.sq_off.ring_mask);
+    sq_array = ring_field(sq_ring, params.sq_off.array);
+    sq_entries = params.sq_entries;
+
+    cq_head = ring_field(cq_ring, params.cq_off.head);
+    cq_tail = ring_field(cq_ring, params.cq_off.tail);
+    cq_mask = *ring_field(cq_ring, params.cq_off.ring_mask);
+    cq_entries = params.cq_entries;
+    cqes = reinterpret_cast<io_uring_cqe*>(static_cast<char*>(cq_ring) +
+                                           params.cq_off.cqes);
+
+    if (pthread_create(&reaper_thread, NULL, reaper_main, this) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+io_uring_sqe* IoUring::get_sqe() {
+    // Keep room in the completion queue for every submitted request.
+    while (inflight + queued >= cq_entries) {
+        flush_sqes();
+        pthread_cond_wait(&inflight_cond, &submit_mutex);
+    }
+
+    unsigned tail = *sq_tail;
+    if (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries) {
+        flush_sqes();
+        tail = *sq_tail;
+    }
+
+    unsigned index = tail & sq_mask;
+    sq_array[index] = index;
+    queued++;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    return &sqes[index];
+}
+
+void IoUring::flush_sqes() {
+    while (queued > 0) {
+        int submitted = io_uring_enter(ring_fd, queued, 0, 0);
+        if (submitted < 0) {
+            // Queued entries are already visible to the kernel, so they can
+            // not be taken back.
+            error::ok(errno == EINTR || errno == EAGAIN || errno == EBUSY);
+            continue;
+        }
+        queued -= submitted;
+        inflight += submitted;
+    }
+}
+
+void* IoUring::reaper_main(void* arg) {
+    IoUring* ring = static_cast<IoUring*>(arg);
+    bool running = true;
+
+    while (running) {
+        if (io_uring_enter(ring->ring_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+            errno != EINTR) {
+            break;
+        }
+
+        unsigned head = *ring->cq_head;
+        unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        unsigned reaped = tail - head;
+
+        for (; head != tail; head++) {
+            const io_uring_cqe& cqe = ring->cqes[head & ring->cq_mask];
+            if (cqe.user_data == 0) {
+                running = false;
+                continue;
+            }
+
+            IoUringRequest* request =
+                reinterpret_cast<IoUringRequest*>(cqe.user_data);
+            IoUringBatch* batch = request->batch;
+            bool failed = cqe.res < 0 ||
+                          static_cast<size_t>(cqe.res) != request->length;
+
+            // Wake up the submitter when the whole batch is completed.
+            pthread_mutex_lock(&batch->mutex);
+            batch->failed += failed;
+            if (--batch->pending == 0) {
+                pthread_cond_signal(&batch->cond);
+            }
+            pthread_mutex_unlock(&batch->mutex);
+        }
+        __atomic_store_n(ring->cq_head, tail, __ATOMIC_RELEASE);
+
+        if (reaped > 0) {
+            pthread_mutex_lock(&ring->submit_mutex);
+            ring->inflight -= reaped;
+            pthread_cond_broadcast(&ring->inflight_cond);
+            pthread_mutex_unlock(&ring->submit_mutex);
+        }
+    }
+    return NULL;
+}
+
+int IoUring::submit_and_wait(int fd, IoUringRequest* requests, int count) {
+    if (count <= 0) return 0;
+
+    IoUringBatch batch;
+    batch.pending = count;
+    batch.failed = 0;
+    pthread_mutex_init(&batch.mutex, NULL);
+    pthread_cond_init(&batch.cond, NULL);
+
+    pthread_mutex_lock(&submit_mutex);
+    for (int i = 0; i < count; i++) {
+        IoUringRequest& request = requests[i];
+        request.io_vector.iov_base = request.buffer;
+        request.io_vector.iov_len = request.length;
+        request.batch = &batch;
+
+        io_uring_sqe* sqe = get_sqe();
+        memset(sqe, 0, sizeof(io_uring_sqe));
+        sqe->opcode = request.is_write ? IORING_OP_WRITEV : IORING_OP_READV;
+        sqe->fd = fd;
+        sqe->off = request.offset;
+        sqe->addr = reinterpret_cast<uint64_t>(&request.io_vector);
+        sqe->len = 1;
+        sqe->user_data = reinterpret_cast<uint64_t>(&request);
+    }
+    flush_sqes();
+    pthread_mutex_unlock(&submit_mutex);
+
+    pthread_mutex_lock(&batch.mutex);
+    while (batch.pending > 0) {
+        pthread_cond_wait(&batch.cond, &batch.mutex);
+    }
+    pthread_mutex_unlock(&batch.mutex);
+
+    pthread_cond_destroy(&batch.cond);
+    pthread_mutex_destroy(&batch.mutex);
+
+    return batch.failed == 0 ? 0 : -1;
+}
+/** @}*/
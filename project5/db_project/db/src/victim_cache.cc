@@ -0,0 +1,386 @@
+/**
+ * @addtogroup BufferManager
+ * @{
+ */
+#include <victim_cache.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+/// @brief victim cache stripes.
+VictimCacheStripe victim_cache_stripes[VICTIM_CACHE_STRIPES];
+/// @brief <code>true</code> if the stripe mutexes are initialized.
+bool victim_cache_initialized = false;
+/// @brief <code>true</code> if the victim cache is enabled. Checked without
+/// a mutex, so that a disabled cache costs nothing.
+std::atomic<bool> victim_cache_enabled(false);
+/// @brief serializes configurations of the victim cache.
+pthread_mutex_t victim_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/// @brief minimum length of a match.
+static constexpr int MIN_MATCH = 4;
+/// @brief number of bits of a hash table index.
+static constexpr int HASH_BITS = 12;
+/// @brief maximum distance of a match, which fits in the 2-byte offset.
+static constexpr int MAX_OFFSET = 65535;
+/// @brief length which is continued into extra length bytes.
+static constexpr int LENGTH_MASK = 15;
+
+/**
+ * @brief Read 4 bytes without alignment.
+ *
+ * @param src   source.
+ * @return 4 bytes.
+ */
+static inline uint32_t read32(const uint8_t* src) {
+    uint32_t value;
+    memcpy(&value, src, sizeof(value));
+    return value;
+}
+
+/**
+ * @brief Write the extra bytes of a length.
+ *
+ * @param[in,out] op    output position.
+ * @param         end   end of the output.
+ * @param         length    length minus <code>LENGTH_MASK</code>.
+ * @return <code>false</code> if the output is full.
+ */
+static inline bool write_length(uint8_t*& op, const uint8_t* end,
+                                int length) {
+    while (length >= 255) {
+        if (op >= end) return false;
+        *op++ = 255;
+        length -= 255;
+    }
+    if (op >= end) return false;
+    *op++ = static_cast<uint8_t>(length);
+    return true;
+}
+
+/**
+ * @brief Read the extra bytes of a length.
+ *
+ * @param[in,out] ip        input position.
+ * @param         end       end of the input.
+ * @param[in,out] length    length to extend.
+ * @return <code>false</code> if the input is truncated.
+ */
+static inline bool read_length(const uint8_t*& ip, const uint8_t* end,
+                               int& length) {
+    uint8_t extra;
+    do {
+        if (ip >= end) return false;
+        extra = *ip++;
+        length += extra;
+    } while (extra == 255);
+    return true;
+}
+
+/**
+ * @brief Write a sequence.
+ *
+ * @param[in,out] op            output position.
+ * @param         end           end of the output.
+ * @param         literals      literals.
+ * @param         literal_len   number of literals.
+ * @param         offset        match offset. Ignored if there is no match.
+ * @param         match_len     match length. <code>0</code> for the last
+ * sequence.
+ * @return <code>false</code> if the output is full.
+ */
+static bool write_sequence(uint8_t*& op, const uint8_t* end,
+                           const uint8_t* literals, int literal_len,
+                           int offset, int match_len) {
+    int literal_code = std::min(literal_len, LENGTH_MASK);
+    int match_code =
+        match_len > 0 ? std::min(match_len - MIN_MATCH, LENGTH_MASK) : 0;
+
+    if (op >= end) return false;
+    *op++ = static_cast<uint8_t>(literal_code << 4 | match_code);
+    if (literal_code == LENGTH_MASK &&
+        !write_length(op, end, literal_len - LENGTH_MASK)) {
+        return false;
+    }
+    if (end - op < literal_len) return false;
+    memcpy(op, literals, literal_len);
+    op += literal_len;
+
+    if (match_len == 0) return true;
+    if (end - op < 2) return false;
+    *op++ = static_cast<uint8_t>(offset);
+    *op++ = static_cast<uint8_t>(offset >> 8);
+    if (match_code == LENGTH_MASK &&
+        !write_length(op, end, match_len - MIN_MATCH - LENGTH_MASK)) {
+        return false;
+    }
+    return true;
+}
+
+namespace victim_cache_helper {
+int compress(const uint8_t* src, int size, uint8_t* dst, int capacity) {
+    int positions[1 << HASH_BITS];
+    std::fill(positions, positions + (1 << HASH_BITS), -1);
+
+    uint8_t* op = dst;
+    const uint8_t* end = dst + capacity;
+    int anchor = 0;
+    int pos = 0;
+    while (pos + MIN_MATCH <= size) {
+        uint32_t sequence = read32(src + pos);
+        uint32_t hash = (sequence * 2654435761U) >> (32 - HASH_BITS);
+        int candidate = positions[hash];
+        positions[hash] = pos;
+
+        if (candidate < 0 || pos - candidate > MAX_OFFSET ||
+            read32(src + candidate) != sequence) {
+            pos++;
+            continue;
+        }
+
+        int match_len = MIN_MATCH;
+        while (pos + match_len < size &&
+               src[candidate + match_len] == src[pos + match_len]) {
+            match_len++;
+        }
+        if (!write_sequence(op, end, src + anchor, pos - anchor,
+                            pos - candidate, match_len)) {
+            return -1;
+        }
+        pos += match_len;
+        anchor = pos;
+    }
+
+    if (!write_sequence(op, end, src + anchor, size - anchor, 0, 0)) {
+        return -1;
+    }
+    return static_cast<int>(op - dst);
+}
+
+int decompress(const uint8_t* src, int size, uint8_t* dst, int capacity) {
+    const uint8_t* ip = src;
+    const uint8_t* end = src + size;
+    uint8_t* op = dst;
+    uint8_t* out_end = dst + capacity;
+
+    while (ip < end) {
+        uint8_t token = *ip++;
+        int literal_len = token >> 4;
+        if (literal_len == LENGTH_MASK && !read_length(ip, end, literal_len)) {
+            return -1;
+        }
+        if (end - ip < literal_len || out_end - op < literal_len) {
+            return -1;
+        }
+        memcpy(op, ip, literal_len);
+        ip += literal_len;
+        op += literal_len;
+
+        // The last sequence has no match.
+        if (ip == end) break;
+
+        if (end - ip < 2) return -1;
+        int offset = ip[0] | ip[1] << 8;
+        ip += 2;
+        int match_len = (token & LENGTH_MASK) + MIN_MATCH;
+        if ((token & LENGTH_MASK) == LENGTH_MASK &&
+            !read_length(ip, end, match_len)) {
+            return -1;
+        }
+        if (offset == 0 || offset > op - dst || out_end - op < match_len) {
+            return -1;
+        }
+
+        // Byte by byte, since a match may overlap its own output.
+        const uint8_t* match = op - offset;
+        for (int i = 0; i < match_len; i++) {
+            op[i] = match[i];
+        }
+        op += match_len;
+    }
+    return static_cast<int>(op - dst);
+}
+
+bool is_enabled() {
+    return victim_cache_enabled.load(std::memory_order_acquire);
+}
+
+VictimCacheStripe& get_stripe(const PageLocation& page_location) {
+    return victim_cache_stripes[std::hash<PageLocation>()(page_location) %
+                                VICTIM_CACHE_STRIPES];
+}
+
+void store_page(const PageLocation& page_location, const page_t* page) {
+    if (!victim_cache_enabled.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    // Compress outside of the stripe mutex.
+    uint8_t compressed[MAX_COMPRESSED_PAGE_SIZE];
+    int compressed_size =
+        compress(reinterpret_cast<const uint8_t*>(page), PAGE_SIZE,
+                 compressed, MAX_COMPRESSED_PAGE_SIZE);
+
+    VictimCacheStripe& stripe = get_stripe(page_location);
+    pthread_mutex_lock(&stripe.mutex);
+    if (stripe.budget_bytes == 0) {
+        pthread_mutex_unlock(&stripe.mutex);
+        return;
+    }
+    if (compressed_size < 0) {
+        stripe.rejected_pages++;
+        pthread_mutex_unlock(&stripe.mutex);
+        return;
+    }
+
+    auto entry_it = stripe.index.find(page_location);
+    if (entry_it != stripe.index.end()) {
+        stripe.used_bytes -=
+            sizeof(VictimCacheEntry) + entry_it->second->data.size();
+        stripe.entries.erase(entry_it->second);
+        stripe.index.erase(entry_it);
+    }
+
+    stripe.entries.push_front(VictimCacheEntry{
+        page_location,
+        std::vector<uint8_t>(compressed, compressed + compressed_size)});
+    stripe.index[page_location] = stripe.entries.begin();
+    stripe.used_bytes += sizeof(VictimCacheEntry) + compressed_size;
+    stripe.stored_pages++;
+    trim_stripe(stripe);
+    pthread_mutex_unlock(&stripe.mutex);
+}
+
+bool take_page(const PageLocation& page_location, page_t* dest) {
+    if (!victim_cache_enabled.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    VictimCacheStripe& stripe = get_stripe(page_location);
+    std::vector<uint8_t> data;
+    pthread_mutex_lock(&stripe.mutex);
+    auto entry_it = stripe.index.find(page_location);
+    if (entry_it == stripe.index.end()) {
+        if (stripe.budget_bytes > 0) stripe.misses++;
+        pthread_mutex_unlock(&stripe.mutex);
+        return false;
+    }
+    data.swap(entry_it->second->data);
+    stripe.used_bytes -= sizeof(VictimCacheEntry) + data.size();
+    stripe.entries.erase(entry_it->second);
+    stripe.index.erase(entry_it);
+    stripe.hits++;
+    pthread_mutex_unlock(&stripe.mutex);
+
+    // A corrupted entry is read from the table file instead.
+    return decompress(data.data(), static_cast<int>(data.size()),
+                      reinterpret_cast<uint8_t*>(dest),
+                      PAGE_SIZE) == PAGE_SIZE;
+}
+
+void drop_page(const PageLocation& page_location) {
+    if (!victim_cache_enabled.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    VictimCacheStripe& stripe = get_stripe(page_location);
+    pthread_mutex_lock(&stripe.mutex);
+    auto entry_it = stripe.index.find(page_location);
+    if (entry_it != stripe.index.end()) {
+        stripe.used_bytes -=
+            sizeof(VictimCacheEntry) + entry_it->second->data.size();
+        stripe.entries.erase(entry_it->second);
+        stripe.index.erase(entry_it);
+    }
+    pthread_mutex_unlock(&stripe.mutex);
+}
+
+void drop_table(tableid_t table_id) {
+    if (!victim_cache_enabled.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    for (VictimCacheStripe& stripe : victim_cache_stripes) {
+        pthread_mutex_lock(&stripe.mutex);
+        for (auto entry_it = stripe.entries.begin();
+             entry_it != stripe.entries.end();) {
+            if (entry_it->page_location.first != table_id) {
+                ++entry_it;
+                continue;
+            }
+            stripe.used_bytes -= sizeof(VictimCacheEntry) + entry_it->data.size();
+            stripe.index.erase(entry_it->page_location);
+            entry_it = stripe.entries.erase(entry_it);
+        }
+        pthread_mutex_unlock(&stripe.mutex);
+    }
+}
+
+void trim_stripe(VictimCacheStripe& stripe) {
+    while (stripe.used_bytes > stripe.budget_bytes && !stripe.entries.empty()) {
+        VictimCacheEntry& entry = stripe.entries.back();
+        stripe.used_bytes -= sizeof(VictimCacheEntry) + entry.data.size();
+        stripe.index.erase(entry.page_location);
+        stripe.entries.pop_back();
+        stripe.evicted_pages++;
+    }
+}
+}  // namespace victim_cache_helper
+
+int set_victim_cache(size_t budget_bytes) {
+    pthread_mutex_lock(&victim_cache_mutex);
+    if (!victim_cache_initialized) {
+        for (VictimCacheStripe& stripe : victim_cache_stripes) {
+            stripe.used_bytes = 0;
+            stripe.budget_bytes = 0;
+            pthread_mutex_init(&stripe.mutex, nullptr);
+        }
+        victim_cache_initialized = true;
+    }
+
+    bool was_enabled = victim_cache_enabled.load(std::memory_order_relaxed);
+    if (budget_bytes == 0) {
+        victim_cache_enabled.store(false, std::memory_order_release);
+    }
+    for (VictimCacheStripe& stripe : victim_cache_stripes) {
+        pthread_mutex_lock(&stripe.mutex);
+        if (!was_enabled) {
+            stripe.hits = 0;
+            stripe.misses = 0;
+            stripe.stored_pages = 0;
+            stripe.rejected_pages = 0;
+            stripe.evicted_pages = 0;
+        }
+        stripe.budget_bytes = budget_bytes / VICTIM_CACHE_STRIPES;
+        victim_cache_helper::trim_stripe(stripe);
+        pthread_mutex_unlock(&stripe.mutex);
+    }
+    if (budget_bytes > 0) {
+        victim_cache_enabled.store(true, std::memory_order_release);
+    }
+    pthread_mutex_unlock(&victim_cache_mutex);
+    return 0;
+}
+
+VictimCacheStats get_victim_cache_stats() {
+    VictimCacheStats stats = {0, 0, 0, 0, 0, 0, 0};
+
+    pthread_mutex_lock(&victim_cache_mutex);
+    if (victim_cache_initialized) {
+        for (VictimCacheStripe& stripe : victim_cache_stripes) {
+            pthread_mutex_lock(&stripe.mutex);
+            stats.hits += stripe.hits;
+            stats.misses += stripe.misses;
+            stats.stored_pages += stripe.stored_pages;
+            stats.rejected_pages += stripe.rejected_pages;
+            stats.evicted_pages += stripe.evicted_pages;
+            stats.cached_pages += stripe.entries.size();
+            stats.used_bytes += stripe.used_bytes;
+            pthread_mutex_unlock(&stripe.mutex);
+        }
+    }
+    pthread_mutex_unlock(&victim_cache_mutex);
+    return stats;
+}
+/** @}*/
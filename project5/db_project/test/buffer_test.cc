@@ -4,13 +4,21 @@
  */
 #include <buffer.h>
 #include <db.h>
+#include <fcntl.h>
+#include <file.h>
 #include <gtest/gtest.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <transaction.h>
+#include <tree.h>
 #include <unistd.h>
 
+#include <atomic>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <vector>
 
 constexpr int test_count = 100;
 
@@ -63,6 +71,9 @@ TEST_F(BasicBufferManagerTest, HandlesPageAllocation) {
     // Free one page
     buffered_free_page(table_id, freed_page);
 
+    // The free page list is written at a checkpoint.
+    ASSERT_EQ(flush_buffer(), 0);
+
     // Traverse the free page list and check the existence of the
     // freed/allocated pages. You might need to open a few APIs soley for
     // testing.
@@ -243,4 +254,1687 @@ TEST_F(CrossTableTest, RandomAllocateTest) {
         buffered_free_page(table_id[1], test_order[i]);
     }
 }
+
+/// @brief Number of pages written by sharded buffer tests.
+constexpr int shard_page_count = 256;
+/// @brief Number of threads used by sharded buffer tests.
+constexpr int shard_thread_count = 4;
+
+class ShardedBufferTest : public ::testing::Test {
+   protected:
+    /// @brief Test table id
+    tableid_t table_id = 0;
+    /// @brief Allocated page numbers
+    pagenum_t pages[shard_page_count];
+
+    ShardedBufferTest() {
+        // Smaller than shard_page_count to force eviction in every shard.
+        init_db(64, 7);
+        table_id = buffered_open_table_file(TABLE_PATH);
+
+        for (int i = 0; i < shard_page_count; i++) {
+            pages[i] = buffered_alloc_page(table_id);
+        }
+    }
+    ~ShardedBufferTest() {
+        for (int i = 0; i < shard_page_count; i++) {
+            buffered_free_page(table_id, pages[i]);
+        }
+        shutdown_db();
+    }
+
+    /**
+     * @brief Read every page and check the page stamp.
+     *
+     * @param arg   <code>ShardedBufferTest*</code>.
+     * @return <code>nullptr</code> if success, non-null otherwise.
+     */
+    static void* verify_pages(void* arg) {
+        ShardedBufferTest* test = reinterpret_cast<ShardedBufferTest*>(arg);
+        for (int i = 0; i < shard_page_count; i++) {
+            freepage_t page;
+            buffered_read_page(test->table_id, test->pages[i], &page, 0, false);
+            if (page.next_free_idx != test->pages[i] * 3) {
+                return arg;
+            }
+        }
+        return nullptr;
+    }
+};
+
+/**
+ * @brief   Tests buffer shard initialization.
+ * @details Re-initializing with another configuration should fail, and shard
+ * count which is larger than buffer size should be clamped.
+ */
+TEST_F(ShardedBufferTest, Initialization) {
+    EXPECT_EQ(init_buffer(64, 7), 0);
+    EXPECT_NE(init_buffer(64, 8), 0);
+    EXPECT_NE(init_buffer(128, 7), 0);
+
+    shutdown_buffer();
+    EXPECT_NE(init_buffer(4, 0), 0);
+    EXPECT_EQ(init_buffer(4, 16), 0);
+    shutdown_buffer();
+
+    EXPECT_EQ(init_buffer(64, 7), 0);
+    table_id = buffered_open_table_file(TABLE_PATH);
+}
+
+/**
+ * @brief   Tests concurrent access over the sharded buffer.
+ * @details Stamp pages which do not fit in the buffer, then read them back
+ * from several threads at once.
+ */
+TEST_F(ShardedBufferTest, ConcurrentRead) {
+    for (int i = 0; i < shard_page_count; i++) {
+        freepage_t page;
+        buffered_read_page(table_id, pages[i], &page);
+        page.next_free_idx = pages[i] * 3;
+        buffered_write_page(table_id, pages[i], &page);
+    }
+
+    pthread_t threads[shard_thread_count];
+    for (int i = 0; i < shard_thread_count; i++) {
+        pthread_create(&threads[i], nullptr, verify_pages, this);
+    }
+    for (int i = 0; i < shard_thread_count; i++) {
+        void* result;
+        pthread_join(threads[i], &result);
+        EXPECT_EQ(result, nullptr);
+    }
+}
+
+/**
+ * @brief   Make empty frames for replacement policy tests.
+ *
+ * @param frames    frames.
+ * @param size      number of frames.
+ */
+void reset_frames(BufferBlock* frames, int size) {
+    for (int i = 0; i < size; i++) {
+        frames[i].page_location = std::make_pair(0, i + 1);
+        frames[i].pin_count = 0;
+        frames[i].is_dirty = false;
+    }
+}
+
+/**
+ * @brief   Tests victim order of each replacement policy.
+ * @details Load four frames, touch some of them and check which frame is
+ * chosen as a victim.
+ */
+TEST(ReplacementPolicyTest, VictimOrder) {
+    BufferBlock* frames = new BufferBlock[4];
+    auto unpinned = [frames](int idx) { return frames[idx].pin_count == 0; };
+    auto locate = [frames](int idx) -> const PageLocation& {
+        return frames[idx].page_location;
+    };
+
+    // LRU: the least recently touched frame.
+    reset_frames(frames, 4);
+    ReplacementPolicy* policy = make_replacement_policy(LRU_POLICY, locate, 4);
+    for (int i = 0; i < 4; i++) policy->on_load(i);
+    policy->on_hit(0);
+    EXPECT_EQ(policy->victim(unpinned, 4), 1);
+    frames[1].pin_count = 1;
+    EXPECT_EQ(policy->victim(unpinned, 4), 2);
+    delete policy;
+
+    // CLOCK: a referenced frame gets a second chance.
+    reset_frames(frames, 4);
+    policy = make_replacement_policy(CLOCK_POLICY, locate, 4);
+    for (int i = 0; i < 4; i++) policy->on_load(i);
+    EXPECT_EQ(policy->victim(unpinned, 4), 0);
+    policy->on_evict(0);
+    policy->on_load(0);
+    policy->on_hit(1);
+    EXPECT_EQ(policy->victim(unpinned, 4), 2);
+    delete policy;
+
+    // LRU-2: frames touched only once are evicted before the others.
+    reset_frames(frames, 4);
+    policy = make_replacement_policy(LRU_K_POLICY, locate, 4);
+    for (int i = 0; i < 4; i++) policy->on_load(i);
+    policy->on_hit(0);
+    policy->on_hit(1);
+    policy->on_hit(0);
+    EXPECT_EQ(policy->victim(unpinned, 4), 2);
+    delete policy;
+
+    // 2Q: a page which comes back after eviction is protected in Am.
+    reset_frames(frames, 4);
+    policy = make_replacement_policy(TWO_Q_POLICY, locate, 4);
+    for (int i = 0; i < 4; i++) policy->on_load(i);
+    EXPECT_EQ(policy->victim(unpinned, 4), 0);
+    policy->on_evict(0);
+    policy->on_load(0);
+    EXPECT_EQ(policy->victim(unpinned, 4), 1);
+    policy->on_evict(1);
+    frames[1].page_location = std::make_pair(0, 100);
+    policy->on_load(1);
+    EXPECT_EQ(policy->victim(unpinned, 4), 2);
+    delete policy;
+
+    delete[] frames;
+}
+
+class ReplacementPolicyBufferTest
+    : public ::testing::TestWithParam<ReplacementPolicyType> {};
+
+/**
+ * @brief   Tests buffer read/write with every replacement policy.
+ * @details Stamp pages which do not fit in the buffer, then read them back.
+ */
+TEST_P(ReplacementPolicyBufferTest, ReadWriteOverEviction) {
+    ASSERT_EQ(init_db(16, 2, GetParam()), 0);
+    tableid_t table_id = buffered_open_table_file(TABLE_PATH);
+
+    pagenum_t pages[test_count];
+    for (int i = 0; i < test_count; i++) {
+        freepage_t page;
+        pages[i] = buffered_alloc_page(table_id);
+        buffered_read_page(table_id, pages[i], &page);
+        page.next_free_idx = pages[i] * 7;
+        buffered_write_page(table_id, pages[i], &page);
+    }
+
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < test_count; i++) {
+            freepage_t page;
+            buffered_read_page(table_id, pages[i], &page, 0, false);
+            EXPECT_EQ(page.next_free_idx, pages[i] * 7);
+        }
+    }
+
+    for (int i = 0; i < test_count; i++) {
+        buffered_free_page(table_id, pages[i]);
+    }
+    shutdown_db();
+}
+
+INSTANTIATE_TEST_SUITE_P(AllPolicies, ReplacementPolicyBufferTest,
+                         ::testing::Values(LRU_POLICY, CLOCK_POLICY,
+                                           LRU_K_POLICY, TWO_Q_POLICY));
+
+#define HOT_TABLE_PATH "test_hot.db"
+
+class ScanResistanceTest
+    : public ::testing::TestWithParam<ReplacementPolicyType> {
+   protected:
+    /// @brief Test table id
+    tableid_t table_id = 0;
+
+    void SetUp() override {
+        unlink(HOT_TABLE_PATH);
+        ASSERT_EQ(init_db(16, 1, GetParam()), 0);
+        ASSERT_EQ(set_buffer_cleaner(0), 0);
+        ASSERT_EQ(set_read_ahead(0), 0);
+        table_id = buffered_open_table_file(HOT_TABLE_PATH);
+        file_helper::extend_capacity(table_id, 256);
+    }
+
+    void TearDown() override {
+        shutdown_db();
+        unlink(HOT_TABLE_PATH);
+    }
+
+    /**
+     * @brief Access the hot pages 1 to 4 a few times.
+     */
+    void touch_hot_pages() {
+        for (int round = 0; round < 3; round++) {
+            for (pagenum_t pagenum = 1; pagenum <= 4; pagenum++) {
+                PageGuard<freepage_t> page(table_id, pagenum);
+            }
+        }
+    }
+
+    /**
+     * @brief Count the buffered hot pages.
+     *
+     * @return number of buffered hot pages.
+     */
+    int count_hot_pages() {
+        int buffered = 0;
+        for (pagenum_t pagenum = 1; pagenum <= 4; pagenum++) {
+            PageLocation page_location = std::make_pair(table_id, pagenum);
+            buffered += buffer_helper::get_shard(page_location)
+                            .index.count(page_location);
+        }
+        return buffered;
+    }
+};
+
+/**
+ * @brief   Tests flagged scans with every replacement policy.
+ * @details Walk pages which are much more than the buffer with
+ * <code>SCAN_ACCESS</code>. The hot pages should stay buffered.
+ */
+TEST_P(ScanResistanceTest, FlaggedScanKeepsHotPages) {
+    touch_hot_pages();
+    for (pagenum_t pagenum = 10; pagenum <= 200; pagenum++) {
+        PageGuard<freepage_t> page(table_id, pagenum, SHARED_LATCH,
+                                   SCAN_ACCESS);
+    }
+    EXPECT_EQ(count_hot_pages(), 4);
+}
+
+INSTANTIATE_TEST_SUITE_P(AllPolicies, ScanResistanceTest,
+                         ::testing::Values(LRU_POLICY, CLOCK_POLICY,
+                                           LRU_K_POLICY, TWO_Q_POLICY));
+
+/**
+ * @brief   Tests midpoint insertion of the LRU policy.
+ * @details A walk which is not flagged touches every page once, so the
+ * promoted hot pages should stay buffered.
+ */
+TEST(ScanResistanceLRUTest, UnflaggedWalkKeepsHotPages) {
+    unlink(HOT_TABLE_PATH);
+    ASSERT_EQ(init_db(16, 1, LRU_POLICY), 0);
+    ASSERT_EQ(set_buffer_cleaner(0), 0);
+    ASSERT_EQ(set_read_ahead(0), 0);
+    tableid_t table_id = buffered_open_table_file(HOT_TABLE_PATH);
+    file_helper::extend_capacity(table_id, 256);
+
+    for (int round = 0; round < 2; round++) {
+        for (pagenum_t pagenum = 1; pagenum <= 4; pagenum++) {
+            PageGuard<freepage_t> page(table_id, pagenum);
+        }
+    }
+    for (pagenum_t pagenum = 10; pagenum <= 200; pagenum++) {
+        PageGuard<freepage_t> page(table_id, pagenum);
+    }
+
+    for (pagenum_t pagenum = 1; pagenum <= 4; pagenum++) {
+        PageLocation page_location = std::make_pair(table_id, pagenum);
+        EXPECT_EQ(buffer_helper::get_shard(page_location)
+                      .index.count(page_location),
+                  1);
+    }
+
+    shutdown_db();
+    unlink(HOT_TABLE_PATH);
+}
+
+/**
+ * @brief   Tests clean victim preference.
+ * @details Fill a single-shard buffer and dirty its coldest page. Loading
+ * another page should evict a clean page instead of writing back.
+ */
+TEST(CleanVictimTest, PreferCleanVictim) {
+    ASSERT_EQ(init_db(8, 1, LRU_POLICY), 0);
+    ASSERT_EQ(set_buffer_cleaner(0), 0);
+    tableid_t table_id = buffered_open_table_file(TABLE_PATH);
+
+    freepage_t page;
+    for (pagenum_t pagenum = 1; pagenum <= 8; pagenum++) {
+        buffered_read_page(table_id, pagenum, &page, 0, false);
+    }
+    buffered_read_page(table_id, 1, &page);
+    buffered_write_page(table_id, 1, &page);
+    for (pagenum_t pagenum = 2; pagenum <= 8; pagenum++) {
+        buffered_read_page(table_id, pagenum, &page, 0, false);
+    }
+
+    // Page 1 is the coldest, but it is dirty.
+    buffered_read_page(table_id, 9, &page, 0, false);
+
+    BufferShard& shard =
+        buffer_helper::get_shard(std::make_pair(table_id, pagenum_t(1)));
+    EXPECT_EQ(shard.index.count(std::make_pair(table_id, pagenum_t(1))), 1);
+    EXPECT_EQ(shard.index.count(std::make_pair(table_id, pagenum_t(2))), 0);
+
+    shutdown_db();
+}
+
+/**
+ * @brief   Tests zero-copy page access.
+ * @details Modify a page through an exclusive guard, and check that the
+ * buffered page itself is modified and marked dirty.
+ */
+TEST(PageGuardTest, ModifyInPlace) {
+    ASSERT_EQ(init_db(8, 1), 0);
+    ASSERT_EQ(set_buffer_cleaner(0), 0);
+    tableid_t table_id = buffered_open_table_file(TABLE_PATH);
+    pagenum_t pagenum = buffered_alloc_page(table_id);
+
+    BufferShard& shard =
+        buffer_helper::get_shard(std::make_pair(table_id, pagenum));
+    {
+        PageGuard<freepage_t> page(table_id, pagenum, EXCLUSIVE_LATCH);
+        BufferBlock* frame = buffer_helper::get_frame(
+            shard, shard.index.find(std::make_pair(table_id, pagenum)));
+        EXPECT_EQ(reinterpret_cast<fullpage_t*>(page.get()), frame->page);
+        EXPECT_EQ(frame->guard_count.load(), 1);
+
+        page->next_free_idx = 1234;
+        page.mark_dirty();
+        page.release();
+
+        EXPECT_FALSE(page.is_valid());
+        EXPECT_EQ(frame->guard_count.load(), 0);
+        EXPECT_TRUE(frame->is_dirty);
+    }
+
+    freepage_t page;
+    buffered_read_page(table_id, pagenum, &page, 0, false);
+    EXPECT_EQ(page.next_free_idx, 1234);
+
+    buffered_free_page(table_id, pagenum);
+    shutdown_db();
+}
+
+/**
+ * @brief   Tests guarded frames are not evicted.
+ * @details Hold every frame of the buffer with guards. Another guard should
+ * fall back to a private copy, which is written back on release.
+ */
+TEST(PageGuardTest, FallbackWhenEveryFrameIsGuarded) {
+    ASSERT_EQ(init_db(2, 1), 0);
+    tableid_t table_id = buffered_open_table_file(TABLE_PATH);
+
+    PageGuard<freepage_t> first(table_id, 1);
+    PageGuard<freepage_t> second(table_id, 2);
+
+    BufferShard& shard = buffer_helper::get_shard(std::make_pair(table_id, 1));
+    pagenum_t next_free_idx;
+    {
+        PageGuard<freepage_t> third(table_id, 3, EXCLUSIVE_LATCH);
+        next_free_idx = third->next_free_idx;
+        EXPECT_EQ(shard.index.count(std::make_pair(table_id, pagenum_t(3))),
+                  0);
+
+        third->next_free_idx = 4321;
+        third.mark_dirty();
+    }
+    EXPECT_EQ(shard.index.count(std::make_pair(table_id, pagenum_t(1))), 1);
+    EXPECT_EQ(shard.index.count(std::make_pair(table_id, pagenum_t(2))), 1);
+
+    first.release();
+    second.release();
+
+    freepage_t page;
+    buffered_read_page(table_id, 3, &page);
+    EXPECT_EQ(page.next_free_idx, 4321);
+
+    // Restore the free page list.
+    page.next_free_idx = next_free_idx;
+    buffered_write_page(table_id, 3, &page);
+
+    shutdown_db();
+}
+
+/**
+ * @brief   Latch test thread argument.
+ */
+struct LatchTestArgs {
+    /// @brief table id.
+    tableid_t table_id;
+    /// @brief page number.
+    pagenum_t pagenum;
+    /// @brief latch mode.
+    LatchMode mode;
+    /// @brief set after the guard is acquired.
+    volatile bool acquired;
+};
+
+/**
+ * @brief   Acquire and release a guard.
+ *
+ * @param arg   <code>LatchTestArgs*</code>.
+ * @return <code>nullptr</code>.
+ */
+void* acquire_guard(void* arg) {
+    LatchTestArgs* args = reinterpret_cast<LatchTestArgs*>(arg);
+    PageGuard<freepage_t> page(args->table_id, args->pagenum, args->mode);
+    __atomic_store_n(&args->acquired, true, __ATOMIC_RELEASE);
+    return nullptr;
+}
+
+/**
+ * @brief   Wait until a guard is acquired by another thread.
+ *
+ * @param args      thread argument.
+ * @param wait_ms   maximum wait time in milliseconds.
+ * @return <code>true</code> if acquired.
+ */
+bool wait_acquired(LatchTestArgs& args, int wait_ms) {
+    for (int i = 0; i < wait_ms; i++) {
+        if (__atomic_load_n(&args.acquired, __ATOMIC_ACQUIRE)) return true;
+        usleep(1000);
+    }
+    return __atomic_load_n(&args.acquired, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief   Tests shared and exclusive page latches.
+ * @details Another shared guard of a page should be acquired while a shared
+ * guard is held, but an exclusive guard should wait until it is released.
+ */
+TEST(PageLatchTest, SharedAndExclusive) {
+    ASSERT_EQ(init_db(8, 1), 0);
+    tableid_t table_id = buffered_open_table_file(TABLE_PATH);
+
+    PageGuard<freepage_t> reader(table_id, 1);
+
+    pthread_t thread;
+    LatchTestArgs shared_args = {table_id, 1, SHARED_LATCH, false};
+    pthread_create(&thread, nullptr, acquire_guard, &shared_args);
+    EXPECT_TRUE(wait_acquired(shared_args, 1000));
+    pthread_join(thread, nullptr);
+
+    LatchTestArgs exclusive_args = {table_id, 1, EXCLUSIVE_LATCH, false};
+    pthread_create(&thread, nullptr, acquire_guard, &exclusive_args);
+    EXPECT_FALSE(wait_acquired(exclusive_args, 50));
+
+    reader.release();
+    EXPECT_TRUE(wait_acquired(exclusive_args, 1000));
+    pthread_join(thread, nullptr);
+
+    shutdown_db();
+}
+
+/**
+ * @brief   Tests cleaning the coldest frames.
+ * @details Dirty some pages with the cleaner stopped, then clean the whole
+ * buffer in one pass and check the pages on disk.
+ */
+TEST(BufferCleanerTest, CleanColdFrames) {
+    ASSERT_EQ(init_db(16, 2, LRU_POLICY), 0);
+    ASSERT_EQ(set_buffer_cleaner(0), 0);
+    tableid_t table_id = buffered_open_table_file(TABLE_PATH);
+
+    pagenum_t pages[8];
+    for (int i = 0; i < 8; i++) {
+        freepage_t page;
+        pages[i] = buffered_alloc_page(table_id);
+        buffered_read_page(table_id, pages[i], &page);
+        page.next_free_idx = pages[i] * 3;
+        buffered_write_page(table_id, pages[i], &page);
+    }
+    EXPECT_GT(get_dirty_page_stats().dirty_pages, 0);
+
+    EXPECT_GT(buffer_helper::clean_cold_frames(1), 0);
+    DirtyPageStats stats = get_dirty_page_stats();
+    EXPECT_EQ(stats.dirty_pages, 0);
+    EXPECT_EQ(stats.eviction_writes, 0);
+
+    for (int i = 0; i < 8; i++) {
+        freepage_t page;
+        file_read_page(table_id, pages[i], &page);
+        EXPECT_EQ(page.next_free_idx, pages[i] * 3);
+    }
+
+    for (int i = 0; i < 8; i++) {
+        buffered_free_page(table_id, pages[i]);
+    }
+    shutdown_db();
+}
+
+/**
+ * @brief   Tests the background cleaner thread.
+ * @details Dirty some pages and wait until the cleaner writes all of them.
+ */
+TEST(BufferCleanerTest, BackgroundCleaner) {
+    ASSERT_EQ(init_db(16, 2), 0);
+    ASSERT_EQ(set_buffer_cleaner(1, 1), 0);
+    tableid_t table_id = buffered_open_table_file(TABLE_PATH);
+
+    pagenum_t pages[8];
+    for (int i = 0; i < 8; i++) {
+        pages[i] = buffered_alloc_page(table_id);
+        PageGuard<freepage_t> page(table_id, pages[i], EXCLUSIVE_LATCH);
+        page.mark_dirty();
+    }
+
+    for (int retry = 0; retry < 1000; retry++) {
+        if (get_dirty_page_stats().dirty_pages == 0) break;
+        usleep(1000);
+    }
+    EXPECT_EQ(get_dirty_page_stats().dirty_pages, 0);
+    EXPECT_GT(get_dirty_page_stats().cleaner_writes, 0);
+
+    for (int i = 0; i < 8; i++) {
+        buffered_free_page(table_id, pages[i]);
+    }
+    shutdown_db();
+}
+
+class ReadAheadTest : public ::testing::Test {
+   protected:
+    /// @brief Read-ahead test table path
+    static constexpr const char* SCAN_TABLE_PATH = "test_scan.db";
+    /// @brief Number of records
+    static constexpr int record_count = 3000;
+
+    /// @brief Test table id
+    tableid_t table_id = 0;
+
+    void SetUp() override {
+        unlink(SCAN_TABLE_PATH);
+        ASSERT_EQ(init_db(), 0);
+        table_id = open_table(const_cast<char*>(SCAN_TABLE_PATH));
+
+        char value[MAX_VALUE_SIZE] = {};
+        for (int key = 0; key < record_count; key++) {
+            ASSERT_EQ(db_insert(table_id, key, value, 100), 0);
+        }
+
+        // Restart with a cold buffer.
+        ASSERT_EQ(set_buffer_warm_up(false), 0);
+        shutdown_db();
+        ASSERT_EQ(init_db(256, 4), 0);
+        table_id = open_table(const_cast<char*>(SCAN_TABLE_PATH));
+    }
+    void TearDown() override {
+        shutdown_db();
+        unlink(SCAN_TABLE_PATH);
+    }
+};
+
+/**
+ * @brief   Tests reading a leaf sibling chain ahead.
+ * @details Read the first leaves ahead, then scan the table. Every prefetched
+ * page should be counted as used.
+ */
+TEST_F(ReadAheadTest, ReadSiblingChain) {
+    ASSERT_EQ(set_read_ahead(0), 0);
+
+    pagenum_t first_leaf_idx = find_leaf(table_id, 0);
+    ASSERT_NE(first_leaf_idx, 0);
+    int loaded_count = buffer_helper::read_ahead(table_id, first_leaf_idx, 16);
+    EXPECT_GT(loaded_count, 0);
+    EXPECT_EQ(get_read_ahead_stats().prefetched_pages, loaded_count);
+
+    int next_key = 0;
+    EXPECT_EQ(db_scan(table_id, 0, record_count,
+                      [&next_key](recordkey_t key, const char*,
+                                  valsize_t value_size) {
+                          EXPECT_EQ(key, next_key++);
+                          EXPECT_EQ(value_size, 100);
+                          return true;
+                      }),
+              record_count);
+
+    ReadAheadStats stats = get_read_ahead_stats();
+    EXPECT_EQ(stats.used_pages, loaded_count);
+    EXPECT_EQ(stats.wasted_pages, 0);
+}
+
+/**
+ * @brief   Tests sequential walk detection.
+ * @details Scan the table slowly enough for the prefetcher to get ahead of the
+ * scan, then wait for it to read leaves ahead.
+ */
+TEST_F(ReadAheadTest, DetectSequentialWalk) {
+    ASSERT_EQ(set_read_ahead(8), 0);
+
+    EXPECT_EQ(db_scan(table_id, 0, record_count,
+                      [](recordkey_t key, const char*, valsize_t) {
+                          if (key % 100 == 0) usleep(1000);
+                          return true;
+                      }),
+              record_count);
+
+    for (int retry = 0; retry < 1000; retry++) {
+        if (get_read_ahead_stats().prefetched_pages > 0) break;
+        usleep(1000);
+    }
+    EXPECT_GT(get_read_ahead_stats().prefetched_pages, 0);
+}
+
+/// @brief io_uring test table path
+const char* URING_TABLE_PATH = "test_uring.db";
+
+/**
+ * @brief   Tests batched page I/O of io_uring backend.
+ * @details Write and read a batch larger than the submission queue, and
+ * compare the pages. The table may fall back to pread on old kernels, which
+ * should give the same result.
+ */
+TEST(IoUringBackendTest, BatchedPageIO) {
+    constexpr int batch_size = 4 * IO_URING_ENTRIES;
+
+    unlink(URING_TABLE_PATH);
+    ASSERT_EQ(init_db(), 0);
+    tableid_t table_id =
+        open_table(const_cast<char*>(URING_TABLE_PATH), IO_URING_BACKEND);
+    ASSERT_GE(table_id, 0);
+
+    std::vector<fullpage_t> pages(batch_size);
+    std::vector<PageIO> requests(batch_size);
+    for (int i = 0; i < batch_size; i++) {
+        memset(&pages[i], i % 256, PAGE_SIZE);
+        requests[i] = {static_cast<pagenum_t>(i + 1), &pages[i], true};
+    }
+    file_submit_pages(table_id, requests.data(), batch_size);
+
+    std::vector<fullpage_t> read_pages(batch_size);
+    for (int i = 0; i < batch_size; i++) {
+        requests[i] = {static_cast<pagenum_t>(i + 1), &read_pages[i], false};
+    }
+    file_submit_pages(table_id, requests.data(), batch_size);
+
+    for (int i = 0; i < batch_size; i++) {
+        EXPECT_EQ(memcmp(&pages[i], &read_pages[i], PAGE_SIZE), 0);
+    }
+
+    shutdown_db();
+    unlink(URING_TABLE_PATH);
+}
+
+/**
+ * @brief   Tests tree operations on a table with io_uring backend.
+ * @details Insert records with a small buffer, so that evictions and the
+ * cleaner go through io_uring, then find them after restarting.
+ */
+TEST(IoUringBackendTest, TreeOperations) {
+    constexpr int record_count = 2000;
+
+    unlink(URING_TABLE_PATH);
+    ASSERT_EQ(init_db(64, 4), 0);
+    tableid_t table_id =
+        open_table(const_cast<char*>(URING_TABLE_PATH), IO_URING_BACKEND);
+    ASSERT_GE(table_id, 0);
+    IOBackend backend = file_get_backend(table_id);
+
+    char value[MAX_VALUE_SIZE] = {};
+    for (int key = 0; key < record_count; key++) {
+        snprintf(value, sizeof(value), "%d", key);
+        ASSERT_EQ(db_insert(table_id, key, value, 100), 0);
+    }
+
+    shutdown_db();
+    ASSERT_EQ(init_db(64, 4), 0);
+    table_id =
+        open_table(const_cast<char*>(URING_TABLE_PATH), IO_URING_BACKEND);
+    EXPECT_EQ(file_get_backend(table_id), backend);
+
+    char expected[MAX_VALUE_SIZE] = {};
+    char found[MAX_VALUE_SIZE];
+    valsize_t value_size;
+    for (int key = 0; key < record_count; key++) {
+        snprintf(expected, sizeof(expected), "%d", key);
+        ASSERT_EQ(db_find(table_id, key, found, &value_size), 0);
+        EXPECT_EQ(value_size, 100);
+        EXPECT_STREQ(found, expected);
+    }
+
+    shutdown_db();
+    unlink(URING_TABLE_PATH);
+}
+const char* RESIZE_TABLE_PATH = "test_resize.db";
+
+extern BufferShard* buffer_shards;
+extern int buffer_shard_count;
+
+/**
+ * @brief   Count the frames of the buffer pool.
+ *
+ * @return number of frames in every shard which hold a page buffer.
+ */
+int count_pool_frames() {
+    int frame_count = 0;
+    for (int shard_idx = 0; shard_idx < buffer_shard_count; shard_idx++) {
+        BufferShard& shard = buffer_shards[shard_idx];
+        for (int i = 0; i < shard.frame_count; i++) {
+            frame_count += buffer_helper::get_frame(shard, i)->page != nullptr;
+        }
+    }
+    return frame_count;
+}
+
+/**
+ * @brief Resize test reader argument.
+ */
+struct ResizeReaderArgs {
+    /// @brief table id.
+    tableid_t table_id;
+    /// @brief number of records.
+    int record_count;
+    /// @brief <code>true</code> while the reader should keep reading.
+    std::atomic<bool> running;
+    /// @brief number of records which were not found as inserted.
+    std::atomic<int> mismatch_count;
+};
+
+/**
+ * @brief   Find every record repeatedly until stopped.
+ *
+ * @param arg   <code>ResizeReaderArgs*</code>.
+ * @return <code>nullptr</code>.
+ */
+void* find_records(void* arg) {
+    ResizeReaderArgs* args = reinterpret_cast<ResizeReaderArgs*>(arg);
+    char expected[MAX_VALUE_SIZE] = {};
+    char found[MAX_VALUE_SIZE];
+    valsize_t value_size;
+
+    while (args->running) {
+        for (int key = 0; key < args->record_count; key++) {
+            snprintf(expected, sizeof(expected), "%d", key);
+            if (db_find(args->table_id, key, found, &value_size) != 0 ||
+                strcmp(found, expected) != 0) {
+                args->mismatch_count++;
+            }
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief   Tests growing and shrinking the buffer pool.
+ * @details Resize a pool holding dirty pages in both directions, and check
+ * the number of frames and the records. Shrinking below the shard count
+ * should fail.
+ */
+TEST(BufferResizeTest, GrowAndShrink) {
+    constexpr int record_count = 1000;
+
+    unlink(RESIZE_TABLE_PATH);
+    ASSERT_EQ(init_db(64), 0);
+    ASSERT_EQ(set_buffer_cleaner(0), 0);
+    tableid_t table_id = open_table(const_cast<char*>(RESIZE_TABLE_PATH));
+
+    char value[MAX_VALUE_SIZE] = {};
+    for (int key = 0; key < record_count; key++) {
+        snprintf(value, sizeof(value), "%d", key);
+        ASSERT_EQ(db_insert(table_id, key, value, 100), 0);
+    }
+
+    ASSERT_EQ(db_resize_buffer(1000), 0);
+    EXPECT_EQ(count_pool_frames(), 1000);
+    ASSERT_EQ(db_resize_buffer(16), 0);
+    EXPECT_EQ(count_pool_frames(), 16);
+    EXPECT_LE(get_dirty_page_stats().dirty_pages, 16);
+    EXPECT_NE(db_resize_buffer(DEFAULT_BUFFER_SHARDS - 1), 0);
+    ASSERT_EQ(db_resize_buffer(100), 0);
+    EXPECT_EQ(count_pool_frames(), 100);
+
+    // Re-initializing with the resized size is a no-op.
+    EXPECT_EQ(init_buffer(100), 0);
+
+    char found[MAX_VALUE_SIZE];
+    valsize_t value_size;
+    for (int key = 0; key < record_count; key++) {
+        snprintf(value, sizeof(value), "%d", key);
+        ASSERT_EQ(db_find(table_id, key, found, &value_size), 0);
+        EXPECT_STREQ(found, value);
+    }
+
+    shutdown_db();
+    unlink(RESIZE_TABLE_PATH);
+}
+
+/**
+ * @brief   Tests resizing the buffer pool while records are read.
+ * @details Readers keep finding records while the pool is grown and shrunk
+ * several times, and every record should be found.
+ */
+TEST(BufferResizeTest, ResizeWhileReading) {
+    constexpr int record_count = 1000;
+    constexpr int reader_count = 4;
+
+    unlink(RESIZE_TABLE_PATH);
+    ASSERT_EQ(init_db(32), 0);
+    tableid_t table_id = open_table(const_cast<char*>(RESIZE_TABLE_PATH));
+
+    char value[MAX_VALUE_SIZE] = {};
+    for (int key = 0; key < record_count; key++) {
+        snprintf(value, sizeof(value), "%d", key);
+        ASSERT_EQ(db_insert(table_id, key, value, 100), 0);
+    }
+
+    ResizeReaderArgs args;
+    args.table_id = table_id;
+    args.record_count = record_count;
+    args.running = true;
+    args.mismatch_count = 0;
+
+    pthread_t threads[reader_count];
+    for (int i = 0; i < reader_count; i++) {
+        pthread_create(&threads[i], nullptr, find_records, &args);
+    }
+    for (int round = 0; round < 10; round++) {
+        EXPECT_EQ(db_resize_buffer(round % 2 == 0 ? 512 : 16), 0);
+        usleep(1000);
+    }
+    args.running = false;
+    for (int i = 0; i < reader_count; i++) {
+        pthread_join(threads[i], nullptr);
+    }
+
+    EXPECT_EQ(args.mismatch_count, 0);
+    EXPECT_EQ(count_pool_frames(), 16);
+
+    shutdown_db();
+    unlink(RESIZE_TABLE_PATH);
+}
+const char* DIRECT_TABLE_PATH = "test_direct.db";
+
+/**
+ * @brief   Tests tree operations on tables opened with O_DIRECT.
+ * @details Insert records into a table with each backend, with frames backed
+ * by huge pages if available, then find them after restarting. Frames should
+ * be aligned for O_DIRECT. The file system may not support O_DIRECT, which
+ * should give the same result through the page cache.
+ */
+TEST(DirectIOTest, TreeOperations) {
+    constexpr int record_count = 2000;
+
+    for (IOBackend backend : {PREAD_BACKEND, IO_URING_BACKEND}) {
+        unlink(DIRECT_TABLE_PATH);
+        ASSERT_EQ(init_db(64, 4, DEFAULT_REPLACEMENT_POLICY, true), 0);
+        tableid_t table_id =
+            open_table(const_cast<char*>(DIRECT_TABLE_PATH), backend, true);
+        ASSERT_GE(table_id, 0);
+        bool direct_io = file_is_direct_io(table_id);
+
+        char value[MAX_VALUE_SIZE] = {};
+        for (int key = 0; key < record_count; key++) {
+            snprintf(value, sizeof(value), "%d", key);
+            ASSERT_EQ(db_insert(table_id, key, value, 100), 0);
+        }
+
+        for (int shard_idx = 0; shard_idx < buffer_shard_count; shard_idx++) {
+            BufferShard& shard = buffer_shards[shard_idx];
+            for (int i = 0; i < shard.size; i++) {
+                EXPECT_EQ(reinterpret_cast<uintptr_t>(
+                              buffer_helper::get_frame(shard, i)->page) %
+                              PAGE_SIZE,
+                          0);
+            }
+        }
+
+        shutdown_db();
+        ASSERT_EQ(init_db(64, 4), 0);
+        table_id =
+            open_table(const_cast<char*>(DIRECT_TABLE_PATH), backend, true);
+        EXPECT_EQ(file_is_direct_io(table_id), direct_io);
+
+        char found[MAX_VALUE_SIZE];
+        valsize_t value_size;
+        for (int key = 0; key < record_count; key++) {
+            snprintf(value, sizeof(value), "%d", key);
+            ASSERT_EQ(db_find(table_id, key, found, &value_size), 0);
+            EXPECT_STREQ(found, value);
+        }
+
+        shutdown_db();
+    }
+    unlink(DIRECT_TABLE_PATH);
+}
+
+/// @brief Warm-up test table path
+#define WARM_TABLE_PATH "test_warm.db"
+
+/**
+ * @brief Wait until every queued warm-up is done.
+ */
+static void wait_warm_up() {
+    for (int retry = 0; retry < 1000; retry++) {
+        if (get_warm_up_stats().pending_tables == 0) break;
+        usleep(1000);
+    }
+}
+
+/**
+ * @brief   Tests the buffer warm-up over a restart.
+ * @details Buffered pages are written into the manifest on shutdown, and
+ * loaded back in the background after the table is opened again.
+ */
+TEST(BufferWarmUpTest, PreloadAfterRestart) {
+    unlink(WARM_TABLE_PATH);
+    unlink(WARM_TABLE_PATH ".warm");
+    ASSERT_EQ(init_db(64, 4), 0);
+    tableid_t table_id = open_table(const_cast<char*>(WARM_TABLE_PATH));
+    ASSERT_GE(table_id, 0);
+
+    char value[MAX_VALUE_SIZE] = {};
+    for (int key = 0; key < 2000; key++) {
+        ASSERT_EQ(db_insert(table_id, key, value, 100), 0);
+    }
+    std::vector<PageLocation> buffered_pages;
+    for (int shard_idx = 0; shard_idx < buffer_shard_count; shard_idx++) {
+        BufferShard& shard = buffer_shards[shard_idx];
+        for (int i = 0; i < shard.size; i++) {
+            BufferBlock* frame = buffer_helper::get_frame(shard, i);
+            if (shard.index.find(frame->page_location) == i) {
+                buffered_pages.push_back(frame->page_location);
+            }
+        }
+    }
+    ASSERT_GT(buffered_pages.size(), 0);
+    shutdown_db();
+
+    struct stat manifest_stat;
+    ASSERT_EQ(stat(WARM_TABLE_PATH ".warm", &manifest_stat), 0);
+
+    ASSERT_EQ(init_db(64, 4), 0);
+    ASSERT_EQ(set_read_ahead(0), 0);
+    table_id = open_table(const_cast<char*>(WARM_TABLE_PATH));
+    wait_warm_up();
+
+    WarmUpStats stats = get_warm_up_stats();
+    EXPECT_EQ(stats.pending_tables, 0);
+    EXPECT_EQ(stats.warmed_pages, buffered_pages.size());
+    for (PageLocation page_location : buffered_pages) {
+        page_location.first = table_id;
+        EXPECT_GE(buffer_helper::get_shard(page_location).index.find(
+                      page_location),
+                  0);
+    }
+    EXPECT_NE(stat(WARM_TABLE_PATH ".warm", &manifest_stat), 0);
+
+    valsize_t value_size;
+    for (int key = 0; key < 2000; key++) {
+        ASSERT_EQ(db_find(table_id, key, value, &value_size), 0);
+    }
+
+    shutdown_db();
+    unlink(WARM_TABLE_PATH);
+    unlink(WARM_TABLE_PATH ".warm");
+}
+
+/**
+ * @brief   Tests that a stale manifest is ignored.
+ * @details Touch the table file after shutdown. The manifest does not match
+ * the file anymore, so nothing should be loaded.
+ */
+TEST(BufferWarmUpTest, IgnoreStaleManifest) {
+    unlink(WARM_TABLE_PATH);
+    ASSERT_EQ(init_db(64, 4), 0);
+    tableid_t table_id = buffered_open_table_file(WARM_TABLE_PATH);
+    for (pagenum_t pagenum = 1; pagenum <= 16; pagenum++) {
+        PageGuard<freepage_t> page(table_id, pagenum);
+    }
+    shutdown_db();
+
+    struct stat manifest_stat;
+    ASSERT_EQ(stat(WARM_TABLE_PATH ".warm", &manifest_stat), 0);
+    // Set the modification time to now.
+    ASSERT_EQ(utimensat(AT_FDCWD, WARM_TABLE_PATH, nullptr, 0), 0);
+
+    ASSERT_EQ(init_db(64, 4), 0);
+    buffered_open_table_file(WARM_TABLE_PATH);
+    wait_warm_up();
+    EXPECT_EQ(get_warm_up_stats().warmed_pages, 0);
+    EXPECT_NE(stat(WARM_TABLE_PATH ".warm", &manifest_stat), 0);
+
+    // Disabled warm-up does not write a manifest.
+    ASSERT_EQ(set_buffer_warm_up(false), 0);
+    shutdown_db();
+    EXPECT_NE(stat(WARM_TABLE_PATH ".warm", &manifest_stat), 0);
+    unlink(WARM_TABLE_PATH);
+}
+/// @brief Flush test table paths
+const char* FLUSH_TABLE_PATHS[] = {"test_flush.db", "test_flush_another.db"};
+
+/**
+ * @brief   Tests flushing the buffer.
+ * @details Modify runs of consecutive pages and scattered pages of two
+ * tables, then flush. Every page should be clean, and the table files should
+ * hold the modified pages.
+ */
+TEST(BufferFlushTest, FlushTables) {
+    ASSERT_EQ(init_db(256, 4), 0);
+    ASSERT_EQ(set_buffer_cleaner(0), 0);
+
+    std::vector<pagenum_t> pagenums;
+    for (pagenum_t pagenum = 1; pagenum <= 60; pagenum++) {
+        pagenums.push_back(pagenum);
+    }
+    for (pagenum_t pagenum = 100; pagenum < 300; pagenum += 10) {
+        pagenums.push_back(pagenum);
+    }
+
+    tableid_t table_ids[2];
+    for (int table = 0; table < 2; table++) {
+        unlink(FLUSH_TABLE_PATHS[table]);
+        table_ids[table] =
+            open_table(const_cast<char*>(FLUSH_TABLE_PATHS[table]));
+        ASSERT_GE(table_ids[table], 0);
+
+        for (pagenum_t pagenum : pagenums) {
+            PageGuard<freepage_t> page(table_ids[table], pagenum,
+                                       EXCLUSIVE_LATCH);
+            page->next_free_idx = pagenum * 7 + table;
+            page.mark_dirty();
+        }
+    }
+    EXPECT_EQ(get_dirty_page_stats().dirty_pages, 2 * pagenums.size());
+
+    ASSERT_EQ(db_flush(), 0);
+    DirtyPageStats stats = get_dirty_page_stats();
+    EXPECT_EQ(stats.dirty_pages, 0);
+    EXPECT_EQ(stats.flush_writes, 2 * pagenums.size());
+
+    for (int table = 0; table < 2; table++) {
+        int fd = open(FLUSH_TABLE_PATHS[table], O_RDONLY);
+        ASSERT_GE(fd, 0);
+        for (pagenum_t pagenum : pagenums) {
+            freepage_t page;
+            ASSERT_EQ(pread(fd, &page, PAGE_SIZE, pagenum * PAGE_SIZE),
+                      PAGE_SIZE);
+            EXPECT_EQ(page.next_free_idx, pagenum * 7 + table);
+        }
+        close(fd);
+    }
+
+    // Nothing is left to write on shutdown.
+    shutdown_db();
+    for (int table = 0; table < 2; table++) {
+        unlink(FLUSH_TABLE_PATHS[table]);
+    }
+}
+
+/// @brief Statistics test table path
+#define STATS_TABLE_PATH "test_stats.db"
+
+/**
+ * @brief Pin page 1 with a shared latch.
+ *
+ * @param arg   <code>tableid_t*</code> of the table.
+ * @return <code>nullptr</code>.
+ */
+static void* latch_page_shared(void* arg) {
+    PageGuard<freepage_t> page(*reinterpret_cast<tableid_t*>(arg), 1);
+    return nullptr;
+}
+
+/**
+ * @brief   Tests the buffer manager statistics.
+ * @details Count hits, misses and evictions of a single-shard buffer, a latch
+ * wait of another thread, and fallbacks when every frame is guarded.
+ */
+TEST(BufferStatsTest, CountEvents) {
+    unlink(STATS_TABLE_PATH);
+    ASSERT_EQ(init_db(16, 1, LRU_POLICY), 0);
+    ASSERT_EQ(set_buffer_cleaner(0), 0);
+    ASSERT_EQ(set_read_ahead(0), 0);
+    tableid_t table_id = buffered_open_table_file(STATS_TABLE_PATH);
+
+    for (int round = 0; round < 2; round++) {
+        for (pagenum_t pagenum = 1; pagenum <= 8; pagenum++) {
+            PageGuard<freepage_t> page(table_id, pagenum);
+        }
+    }
+    for (pagenum_t pagenum = 9; pagenum <= 24; pagenum++) {
+        PageGuard<freepage_t> page(table_id, pagenum, EXCLUSIVE_LATCH);
+        page.mark_dirty();
+    }
+
+    BufferStats stats = db_get_buffer_stats();
+    EXPECT_EQ(stats.hits, 8);
+    EXPECT_EQ(stats.misses, 24);
+    EXPECT_EQ(stats.table_hits[table_id], 8);
+    EXPECT_EQ(stats.table_misses[table_id], 24);
+    EXPECT_EQ(stats.evictions, 8);
+    EXPECT_EQ(stats.dirty_evictions, 8);
+    EXPECT_EQ(stats.fallbacks, 0);
+
+    // Counters of an exited thread are kept.
+    pthread_t reader;
+    {
+        PageGuard<freepage_t> page(table_id, 1, EXCLUSIVE_LATCH);
+        ASSERT_EQ(pthread_create(&reader, nullptr, latch_page_shared,
+                                 &table_id),
+                  0);
+        usleep(20000);
+    }
+    pthread_join(reader, nullptr);
+    stats = db_get_buffer_stats();
+    EXPECT_EQ(stats.latch_waits, 1);
+    EXPECT_GE(stats.latch_wait_ns, 10000000);
+    EXPECT_EQ(stats.hits + stats.misses, 34);
+
+    std::vector<PageGuard<freepage_t>> guards;
+    for (pagenum_t pagenum = 1; pagenum <= 16; pagenum++) {
+        guards.emplace_back(table_id, pagenum);
+    }
+    { PageGuard<freepage_t> page(table_id, 17); }
+    EXPECT_EQ(db_get_buffer_stats().fallbacks, 1);
+    guards.clear();
+
+    shutdown_db();
+    ASSERT_EQ(init_db(16, 1, LRU_POLICY), 0);
+    EXPECT_EQ(db_get_buffer_stats().hits, 0);
+    shutdown_db();
+    unlink(STATS_TABLE_PATH);
+}
+
+/// @brief Quota test table paths
+#define QUOTA_TABLE_PATHS {"test_quota0.db", "test_quota1.db"}
+
+/**
+ * @brief Count the buffered pages of a table.
+ *
+ * @param table_id      table id.
+ * @param page_count    pages to check from page 1.
+ * @return number of buffered pages.
+ */
+static int count_buffered_pages(tableid_t table_id, pagenum_t page_count) {
+    int buffered_pages = 0;
+    for (pagenum_t pagenum = 1; pagenum <= page_count; pagenum++) {
+        PageLocation page_location = std::make_pair(table_id, pagenum);
+        buffered_pages += buffer_helper::get_shard(page_location)
+                              .index.find(page_location) >= 0;
+    }
+    return buffered_pages;
+}
+
+/**
+ * @brief   Tests per-table buffer quotas.
+ * @details A capped table replaces its own pages, and reserved or high
+ * priority pages outlive a walk of another table.
+ */
+TEST(BufferQuotaTest, HonorQuotas) {
+    const char* paths[] = QUOTA_TABLE_PATHS;
+    for (const char* path : paths) unlink(path);
+    ASSERT_EQ(init_db(32, 1, LRU_POLICY), 0);
+    ASSERT_EQ(set_buffer_cleaner(0), 0);
+    ASSERT_EQ(set_read_ahead(0), 0);
+
+    tableid_t capped_id = open_table(const_cast<char*>(paths[0]),
+                                     PREAD_BACKEND, false,
+                                     {0, 8, NORMAL_PRIORITY});
+    tableid_t hot_id = open_table(const_cast<char*>(paths[1]));
+    ASSERT_GE(capped_id, 0);
+    ASSERT_GE(hot_id, 0);
+
+    for (pagenum_t pagenum = 1; pagenum <= 16; pagenum++) {
+        PageGuard<freepage_t> page(hot_id, pagenum);
+    }
+    for (pagenum_t pagenum = 1; pagenum <= 64; pagenum++) {
+        PageGuard<freepage_t> page(capped_id, pagenum);
+    }
+    EXPECT_EQ(count_buffered_pages(capped_id, 64), 8);
+    EXPECT_EQ(count_buffered_pages(hot_id, 16), 16);
+
+    // Low priority pages are evicted first.
+    ASSERT_EQ(set_table_buffer_quota(capped_id, {0, 0, LOW_PRIORITY}), 0);
+    ASSERT_EQ(set_table_buffer_quota(hot_id, {0, 0, HIGH_PRIORITY}), 0);
+    for (pagenum_t pagenum = 1; pagenum <= 128; pagenum++) {
+        PageGuard<freepage_t> page(capped_id, pagenum);
+    }
+    EXPECT_EQ(count_buffered_pages(hot_id, 16), 16);
+
+    // Reserved pages are kept even if they are evicted first.
+    ASSERT_EQ(set_table_buffer_quota(capped_id, DEFAULT_BUFFER_QUOTA), 0);
+    ASSERT_EQ(set_table_buffer_quota(hot_id, {4, 0, LOW_PRIORITY}), 0);
+    for (pagenum_t pagenum = 1; pagenum <= 128; pagenum++) {
+        PageGuard<freepage_t> page(capped_id, pagenum);
+    }
+    EXPECT_EQ(count_buffered_pages(hot_id, 16), 4);
+
+    // Every shard keeps an unreserved frame.
+    EXPECT_NE(set_table_buffer_quota(capped_id, {28, 0, NORMAL_PRIORITY}), 0);
+    EXPECT_NE(set_table_buffer_quota(capped_id, {8, 4, NORMAL_PRIORITY}), 0);
+    EXPECT_NE(resize_buffer(4), 0);
+    EXPECT_EQ(resize_buffer(16), 0);
+
+    shutdown_db();
+    for (const char* path : paths) unlink(path);
+}
+
+/**
+ * @brief   Tests opening a table with a quota which can not be set.
+ * @details An invalid quota is rejected before the file is opened. A table
+ * opened with a rejected reservation is closed again, and a table which was
+ * already open stays open with its quota.
+ */
+TEST(BufferQuotaTest, RejectQuotaOnOpen) {
+    const char* paths[] = QUOTA_TABLE_PATHS;
+    for (const char* path : paths) unlink(path);
+    ASSERT_EQ(init_db(32, 1, LRU_POLICY), 0);
+
+    tableid_t id_limit = file_helper::get_table_id_limit();
+    EXPECT_EQ(open_table(const_cast<char*>(paths[0]), PREAD_BACKEND, false,
+                         {8, 4, NORMAL_PRIORITY}),
+              -1);
+    EXPECT_EQ(file_helper::get_table_id_limit(), id_limit);
+    struct stat table_stat;
+    EXPECT_NE(stat(paths[0], &table_stat), 0);
+
+    EXPECT_EQ(open_table(const_cast<char*>(paths[0]), PREAD_BACKEND, false,
+                         {32, 0, NORMAL_PRIORITY}),
+              -1);
+    EXPECT_EQ(file_helper::find_table_instance(id_limit), nullptr);
+
+    tableid_t table_id = open_table(const_cast<char*>(paths[1]),
+                                    PREAD_BACKEND, false,
+                                    {4, 0, NORMAL_PRIORITY});
+    ASSERT_GE(table_id, 0);
+    EXPECT_EQ(open_table(const_cast<char*>(paths[1]), PREAD_BACKEND, false,
+                         {32, 0, NORMAL_PRIORITY}),
+              -1);
+    EXPECT_NE(file_helper::find_table_instance(table_id), nullptr);
+    EXPECT_EQ(buffer_helper::get_table_share(buffer_shards[0], table_id)
+                  .min_frames,
+              4);
+
+    shutdown_db();
+    for (const char* path : paths) unlink(path);
+}
+
+/// @brief Victim cache test table path
+#define VICTIM_TABLE_PATH "test_victim.db"
+
+/**
+ * @brief Fill a page with repetitive records, like a leaf page.
+ *
+ * @param[out] page     page to fill.
+ * @param      pagenum  page number written into the records.
+ */
+static void fill_record_page(page_t* page, pagenum_t pagenum) {
+    char* data = reinterpret_cast<char*>(page);
+    memset(data, 0, PAGE_SIZE);
+    for (int offset = 0; offset + 64 <= PAGE_SIZE; offset += 64) {
+        snprintf(data + offset, 64, "page %llu record %d value",
+                 static_cast<unsigned long long>(pagenum), offset / 64);
+    }
+}
+
+/**
+ * @brief   Tests the victim cache codec.
+ * @details Compressible pages shrink and round trip, random pages are
+ * rejected by the cache size limit, and truncated blocks are detected.
+ */
+TEST(VictimCacheTest, CodecRoundTrip) {
+    fullpage_t page, restored;
+    uint8_t compressed[2 * PAGE_SIZE];
+    uint8_t* src = reinterpret_cast<uint8_t*>(&page);
+    uint8_t* dst = reinterpret_cast<uint8_t*>(&restored);
+
+    memset(&page, 0, PAGE_SIZE);
+    int size = victim_cache_helper::compress(src, PAGE_SIZE, compressed,
+                                             MAX_COMPRESSED_PAGE_SIZE);
+    ASSERT_GT(size, 0);
+    EXPECT_LT(size, 64);
+    EXPECT_EQ(victim_cache_helper::decompress(compressed, size, dst,
+                                              PAGE_SIZE),
+              PAGE_SIZE);
+    EXPECT_EQ(memcmp(&page, &restored, PAGE_SIZE), 0);
+
+    fill_record_page(&page, 42);
+    size = victim_cache_helper::compress(src, PAGE_SIZE, compressed,
+                                         MAX_COMPRESSED_PAGE_SIZE);
+    ASSERT_GT(size, 0);
+    EXPECT_LT(size, PAGE_SIZE / 2);
+    EXPECT_EQ(victim_cache_helper::decompress(compressed, size, dst,
+                                              PAGE_SIZE),
+              PAGE_SIZE);
+    EXPECT_EQ(memcmp(&page, &restored, PAGE_SIZE), 0);
+    EXPECT_NE(victim_cache_helper::decompress(compressed, size / 2, dst,
+                                              PAGE_SIZE),
+              PAGE_SIZE);
+
+    srand(0);
+    for (int i = 0; i < PAGE_SIZE; i++) src[i] = rand();
+    EXPECT_EQ(victim_cache_helper::compress(src, PAGE_SIZE, compressed,
+                                            MAX_COMPRESSED_PAGE_SIZE),
+              -1);
+    size = victim_cache_helper::compress(src, PAGE_SIZE, compressed,
+                                         sizeof(compressed));
+    ASSERT_GT(size, 0);
+    EXPECT_EQ(victim_cache_helper::decompress(compressed, size, dst,
+                                              PAGE_SIZE),
+              PAGE_SIZE);
+    EXPECT_EQ(memcmp(&page, &restored, PAGE_SIZE), 0);
+}
+
+/**
+ * @brief   Tests loading evicted pages from the victim cache.
+ * @details Pages evicted from a small buffer are loaded back from the cache
+ * with their last contents, and a write which bypasses the buffer drops the
+ * cached copy.
+ */
+TEST(VictimCacheTest, LoadEvictedPages) {
+    unlink(VICTIM_TABLE_PATH);
+    ASSERT_EQ(init_db(8, 1, LRU_POLICY), 0);
+    ASSERT_EQ(set_buffer_cleaner(0), 0);
+    ASSERT_EQ(set_read_ahead(0), 0);
+    ASSERT_EQ(db_set_victim_cache(1 << 20), 0);
+    tableid_t table_id = buffered_open_table_file(VICTIM_TABLE_PATH);
+
+    for (pagenum_t pagenum = 1; pagenum <= 32; pagenum++) {
+        PageGuard<freepage_t> page(table_id, pagenum, EXCLUSIVE_LATCH);
+        fill_record_page(reinterpret_cast<page_t*>(page.get()), pagenum);
+        page.mark_dirty();
+    }
+    VictimCacheStats stats = db_get_victim_cache_stats();
+    EXPECT_EQ(stats.misses, 32);
+    EXPECT_EQ(stats.stored_pages, 24);
+    EXPECT_EQ(stats.cached_pages, 24);
+    EXPECT_GT(stats.used_bytes, 0);
+    EXPECT_LT(stats.used_bytes, 24 * PAGE_SIZE / 2);
+
+    fullpage_t expected, page;
+    for (pagenum_t pagenum = 1; pagenum <= 32; pagenum++) {
+        fill_record_page(&expected, pagenum);
+        buffered_read_page(table_id, pagenum, &page, 0, false);
+        EXPECT_EQ(memcmp(&expected, &page, PAGE_SIZE), 0);
+    }
+    // Every page which is not buffered is loaded from the cache.
+    stats = db_get_victim_cache_stats();
+    EXPECT_GE(stats.hits, 24);
+    EXPECT_EQ(stats.misses, 32);
+    EXPECT_EQ(stats.cached_pages, 24);
+
+    // A page written while every frame is guarded bypasses the buffer.
+    {
+        std::vector<PageGuard<freepage_t>> guards;
+        for (pagenum_t pagenum = 25; pagenum <= 32; pagenum++) {
+            guards.emplace_back(table_id, pagenum);
+        }
+        PageGuard<freepage_t> page(table_id, 1, EXCLUSIVE_LATCH);
+        memset(page.get(), 0, PAGE_SIZE);
+        page.mark_dirty();
+    }
+    buffered_read_page(table_id, 1, &page, 0, false);
+    memset(&expected, 0, PAGE_SIZE);
+    EXPECT_EQ(memcmp(&expected, &page, PAGE_SIZE), 0);
+
+    ASSERT_EQ(db_set_victim_cache(0), 0);
+    EXPECT_EQ(db_get_victim_cache_stats().cached_pages, 0);
+
+    shutdown_db();
+    unlink(VICTIM_TABLE_PATH);
+}
+
+/// @brief Frame wait test table path
+#define FRAME_WAIT_TABLE_PATH "test_frame_wait.db"
+
+/**
+ * @brief Guard a page which is not buffered.
+ *
+ * @param arg   <code>tableid_t*</code> of the table.
+ * @return <code>nullptr</code>.
+ */
+static void* guard_unbuffered_page(void* arg) {
+    PageGuard<freepage_t> page(*reinterpret_cast<tableid_t*>(arg), 100);
+    return nullptr;
+}
+
+/**
+ * @brief   Tests waiting for a frame when every frame is in use.
+ * @details A thread which holds no frame waits until a frame is released,
+ * instead of reading the page without the buffer.
+ */
+TEST(BufferFrameWaitTest, WaitForReleasedFrame) {
+    unlink(FRAME_WAIT_TABLE_PATH);
+    ASSERT_EQ(init_db(8, 1, LRU_POLICY), 0);
+    ASSERT_EQ(set_buffer_cleaner(0), 0);
+    ASSERT_EQ(set_read_ahead(0), 0);
+    tableid_t table_id = buffered_open_table_file(FRAME_WAIT_TABLE_PATH);
+
+    pthread_t reader;
+    {
+        std::vector<PageGuard<freepage_t>> guards;
+        for (pagenum_t pagenum = 1; pagenum <= 8; pagenum++) {
+            guards.emplace_back(table_id, pagenum);
+        }
+        ASSERT_EQ(pthread_create(&reader, nullptr, guard_unbuffered_page,
+                                 &table_id),
+                  0);
+        usleep(20000);
+    }
+    pthread_join(reader, nullptr);
+
+    BufferStats stats = db_get_buffer_stats();
+    EXPECT_EQ(stats.frame_waits, 1);
+    EXPECT_EQ(stats.fallbacks, 0);
+    PageLocation page_location = std::make_pair(table_id, 100);
+    EXPECT_GE(buffer_helper::get_shard(page_location).index.find(page_location),
+              0);
+
+    shutdown_db();
+    unlink(FRAME_WAIT_TABLE_PATH);
+}
+
+/**
+ * @brief Guard a page which is not buffered, while holding another page.
+ *
+ * @param arg   <code>tableid_t*</code> of the table.
+ * @return <code>nullptr</code>.
+ */
+static void* guard_two_pages(void* arg) {
+    tableid_t table_id = *reinterpret_cast<tableid_t*>(arg);
+    PageGuard<freepage_t> held(table_id, 2);
+    PageGuard<freepage_t> page(table_id, 100, EXCLUSIVE_LATCH);
+    return nullptr;
+}
+
+/**
+ * @brief   Tests waiting for a frame while holding another one.
+ * @details The other holder is not blocked and releases its frame, so the
+ * thread waits instead of falling back, even for an exclusive guard.
+ */
+TEST(BufferFrameWaitTest, HolderWaitsForReleasedFrame) {
+    unlink(FRAME_WAIT_TABLE_PATH);
+    ASSERT_EQ(init_db(2, 1, LRU_POLICY), 0);
+    ASSERT_EQ(set_buffer_cleaner(0), 0);
+    ASSERT_EQ(set_read_ahead(0), 0);
+    tableid_t table_id = buffered_open_table_file(FRAME_WAIT_TABLE_PATH);
+
+    pthread_t writer;
+    {
+        PageGuard<freepage_t> page(table_id, 1);
+        ASSERT_EQ(pthread_create(&writer, nullptr, guard_two_pages,
+                                 &table_id),
+                  0);
+        usleep(20000);
+    }
+    pthread_join(writer, nullptr);
+
+    BufferStats stats = db_get_buffer_stats();
+    EXPECT_EQ(stats.frame_waits, 1);
+    EXPECT_EQ(stats.fallbacks, 0);
+
+    shutdown_db();
+    unlink(FRAME_WAIT_TABLE_PATH);
+}
+
+/**
+ * @brief Guard a page, and wait for a record lock meanwhile.
+ *
+ * @param arg   <code>tableid_t*</code> of the table.
+ * @return <code>nullptr</code>.
+ */
+static void* guard_page_for_lock(void* arg) {
+    tableid_t table_id = *reinterpret_cast<tableid_t*>(arg);
+    trxid_t trx_id = trx_begin();
+    {
+        PageGuard<freepage_t> page(table_id, 1);
+        trx_helper::lock_acquire(table_id, 50, 0, trx_id, SHARED);
+    }
+    trx_commit(trx_id);
+    return nullptr;
+}
+
+/**
+ * @brief   Tests waiting for a frame held by a thread waiting for a lock.
+ * @details The lock is granted after the waiter commits, so the holder of the
+ * other frame is blocked as well, and the waiter falls back.
+ */
+TEST(BufferFrameWaitTest, FallBackForLockWaiter) {
+    unlink(FRAME_WAIT_TABLE_PATH);
+    ASSERT_EQ(init_db(2, 1, LRU_POLICY), 0);
+    ASSERT_EQ(set_buffer_cleaner(0), 0);
+    ASSERT_EQ(set_read_ahead(0), 0);
+    tableid_t table_id = buffered_open_table_file(FRAME_WAIT_TABLE_PATH);
+
+    trxid_t trx_id = trx_begin();
+    ASSERT_NE(trx_helper::lock_acquire(table_id, 50, 0, trx_id, EXCLUSIVE),
+              nullptr);
+    pthread_t locker;
+    ASSERT_EQ(
+        pthread_create(&locker, nullptr, guard_page_for_lock, &table_id), 0);
+    usleep(20000);
+    {
+        PageGuard<freepage_t> held(table_id, 2);
+        PageGuard<freepage_t> page(table_id, 100);
+    }
+    trx_commit(trx_id);
+    pthread_join(locker, nullptr);
+
+    BufferStats stats = db_get_buffer_stats();
+    EXPECT_EQ(stats.frame_waits, 1);
+    EXPECT_EQ(stats.fallbacks, 1);
+
+    shutdown_db();
+    unlink(FRAME_WAIT_TABLE_PATH);
+}
+
+/// @brief Number of threads which modify the same page without frames.
+constexpr int FALLBACK_THREADS = 4;
+/// @brief Number of increments of the page by each thread.
+constexpr int FALLBACK_ROUNDS = 1000;
+
+/**
+ * @brief Arguments of <code>increment_fallback_page()</code>.
+ */
+struct FallbackTestArgs {
+    /// @brief table id.
+    tableid_t table_id;
+    /// @brief page which every thread increments.
+    pagenum_t shared_page;
+    /// @brief page which the thread holds while it increments.
+    pagenum_t held_page;
+    /// @brief synchronizes the rounds of the threads.
+    pthread_barrier_t* barrier;
+};
+
+/**
+ * @brief Increment a page while holding another one, so that every frame is
+ * held when the threads guard the page.
+ *
+ * @param arg   <code>FallbackTestArgs*</code>.
+ * @return <code>nullptr</code>.
+ */
+static void* increment_fallback_page(void* arg) {
+    FallbackTestArgs* args = reinterpret_cast<FallbackTestArgs*>(arg);
+    for (int round = 0; round < FALLBACK_ROUNDS; round++) {
+        PageGuard<freepage_t> held(args->table_id, args->held_page);
+        pthread_barrier_wait(args->barrier);
+        {
+            PageGuard<freepage_t> page(args->table_id, args->shared_page,
+                                       EXCLUSIVE_LATCH);
+            page->next_free_idx++;
+            page.mark_dirty();
+        }
+        held.release();
+        pthread_barrier_wait(args->barrier);
+    }
+    return nullptr;
+}
+
+/**
+ * @brief   Tests exclusive fallbacks of the same page.
+ * @details Every frame is held by the threads when they modify the page, so
+ * they fall back to private copies. The fallbacks are serialized, and no
+ * increment is lost.
+ */
+TEST(BufferFrameWaitTest, SerializeFallbacksOfPage) {
+    unlink(FRAME_WAIT_TABLE_PATH);
+    ASSERT_EQ(init_db(FALLBACK_THREADS, 1, LRU_POLICY), 0);
+    ASSERT_EQ(set_buffer_cleaner(0), 0);
+    ASSERT_EQ(set_read_ahead(0), 0);
+    tableid_t table_id = buffered_open_table_file(FRAME_WAIT_TABLE_PATH);
+    pagenum_t shared_page = buffered_alloc_page(table_id);
+    {
+        PageGuard<freepage_t> page(table_id, shared_page, EXCLUSIVE_LATCH);
+        page->next_free_idx = 0;
+        page.mark_dirty();
+    }
+
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, nullptr, FALLBACK_THREADS);
+    pthread_t threads[FALLBACK_THREADS];
+    FallbackTestArgs args[FALLBACK_THREADS];
+    for (int i = 0; i < FALLBACK_THREADS; i++) {
+        args[i] = {table_id, shared_page, buffered_alloc_page(table_id),
+                   &barrier};
+    }
+    for (int i = 0; i < FALLBACK_THREADS; i++) {
+        ASSERT_EQ(pthread_create(&threads[i], nullptr,
+                                 increment_fallback_page, &args[i]),
+                  0);
+    }
+    for (int i = 0; i < FALLBACK_THREADS; i++) {
+        pthread_join(threads[i], nullptr);
+    }
+    pthread_barrier_destroy(&barrier);
+
+    EXPECT_GE(db_get_buffer_stats().fallbacks, FALLBACK_ROUNDS);
+    freepage_t page;
+    buffered_read_page(table_id, shared_page, &page);
+    EXPECT_EQ(page.next_free_idx, FALLBACK_THREADS * FALLBACK_ROUNDS);
+
+    shutdown_db();
+    unlink(FRAME_WAIT_TABLE_PATH);
+}
+
+/// @brief Optimistic read test table path
+#define OPTIMISTIC_TABLE_PATH "test_optimistic.db"
+
+/**
+ * @brief   Tests validating optimistic reads with frame versions.
+ * @details A read is rejected while the page is exclusively latched, and
+ * invalidated by an exclusive latch or an eviction of the page. A descent
+ * finds the same leaf as the latched one, and stops at a page which is not
+ * buffered.
+ */
+TEST(OptimisticReadTest, ValidateVersions) {
+    unlink(OPTIMISTIC_TABLE_PATH);
+    ASSERT_EQ(init_db(64, 1, LRU_POLICY), 0);
+    ASSERT_EQ(set_read_ahead(0), 0);
+    tableid_t table_id = open_table(const_cast<char*>(OPTIMISTIC_TABLE_PATH));
+
+    pagenum_t leaf_idx;
+    EXPECT_EQ(find_leaf(table_id, 0), 0);
+    EXPECT_TRUE(find_leaf_optimistic(table_id, 0, &leaf_idx));
+    EXPECT_EQ(leaf_idx, 0);
+
+    char value[MAX_VALUE_SIZE] = {};
+    for (int key = 0; key < 200; key++) {
+        ASSERT_EQ(db_insert(table_id, key, value, 100), 0);
+    }
+    for (int key = 0; key < 200; key += 50) {
+        EXPECT_TRUE(find_leaf_optimistic(table_id, key, &leaf_idx));
+        EXPECT_EQ(leaf_idx, find_leaf(table_id, key));
+    }
+
+    BufferBlock* frame;
+    uint64_t version;
+    ASSERT_NE(buffer_helper::begin_optimistic_read(table_id, leaf_idx, &frame,
+                                                   &version),
+              nullptr);
+    EXPECT_TRUE(buffer_helper::validate_optimistic_read(frame, version));
+    {
+        PageGuard<leafpage_t> page(table_id, leaf_idx);
+        EXPECT_TRUE(buffer_helper::validate_optimistic_read(frame, version));
+    }
+    {
+        PageGuard<leafpage_t> page(table_id, leaf_idx, EXCLUSIVE_LATCH);
+        BufferBlock* latched_frame;
+        uint64_t latched_version;
+        EXPECT_EQ(buffer_helper::begin_optimistic_read(
+                      table_id, leaf_idx, &latched_frame, &latched_version),
+                  nullptr);
+    }
+    EXPECT_FALSE(buffer_helper::validate_optimistic_read(frame, version));
+
+    // Evict the pages of the tree but one.
+    ASSERT_NE(buffer_helper::begin_optimistic_read(table_id, leaf_idx, &frame,
+                                                   &version),
+              nullptr);
+    ASSERT_EQ(db_resize_buffer(1), 0);
+    EXPECT_FALSE(buffer_helper::validate_optimistic_read(frame, version));
+    EXPECT_FALSE(find_leaf_optimistic(table_id, 0, &leaf_idx));
+
+    shutdown_db();
+    unlink(OPTIMISTIC_TABLE_PATH);
+}
 /** @}*/
\ No newline at end of file
@@ -2,20 +2,32 @@
  * @addtogroup TestCode
  * @{
  */
+#include <buffer.h>
+#include <db.h>
+#include <fcntl.h>
 #include <file.h>
 #include <gtest/gtest.h>
+#include <limits.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <transaction.h>
+#include <tree.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
+#include <unordered_map>
+#include <vector>
 
 constexpr int test_count = 128;
 
-const char* TABLE_PATH = "test.db";
-const char* TABLE_PATH_ALIAS = "./test.db";
-const char* ANOTHER_TABLE_PATH = "test_another.db";
+static const char* TABLE_PATH = "test.db";
+static const char* TABLE_PATH_ALIAS = "./test.db";
+static const char* ANOTHER_TABLE_PATH = "test_another.db";
 
 class BasicFileManagerTest : public ::testing::Test {
    protected:
@@ -203,4 +215,693 @@ TEST_F(BasicFileManagerTest, RandomAllocateTest) {
         file_free_page(table_id, test_order[i]);
     }
 }
+
+/// @brief Lazy format test table path
+#define LAZY_TABLE_PATH "test_lazy.db"
+
+/**
+ * @brief   Tests growing a table without formatting free pages.
+ * @details The file is extended without linking the new pages, which are
+ * allocated from the lowest one, and the allocations continue after the
+ * table is reopened.
+ */
+TEST(TableSpaceTest, GrowWithoutFormatting) {
+    unlink(LAZY_TABLE_PATH);
+    tableid_t table_id = file_open_table_file(LAZY_TABLE_PATH);
+    file_helper::extend_capacity(table_id, 16384);
+
+    struct stat table_stat;
+    lstat(LAZY_TABLE_PATH, &table_stat);
+    EXPECT_EQ(table_stat.st_size, 16384LL * PAGE_SIZE);
+
+    EXPECT_EQ(file_alloc_page(table_id), 1);
+    headerpage_t header_page;
+    file_read_page(table_id, 0, &header_page);
+    EXPECT_EQ(header_page.free_page_idx, 0);
+    EXPECT_EQ(header_page.unformatted_page_idx, 2);
+    EXPECT_EQ(header_page.page_num, 16384);
+
+    for (pagenum_t pagenum = 2; pagenum < 3000; pagenum++) {
+        ASSERT_EQ(file_alloc_page(table_id), pagenum);
+    }
+    file_free_page(table_id, 1000);
+    file_close_table_files();
+
+    table_id = file_open_table_file(LAZY_TABLE_PATH);
+    EXPECT_EQ(file_alloc_page(table_id), 1000);
+    EXPECT_EQ(file_alloc_page(table_id), 3000);
+    file_close_table_files();
+    unlink(LAZY_TABLE_PATH);
+}
+
+/**
+ * @brief   Tests loading the free space fields of a header page.
+ * @details The tail and the punched runs of a header without the magic,
+ * which an older file may leave in its reserved area, and a tail or a run
+ * beyond the file are ignored. Every page is taken as formatted and used, so
+ * the file grows on the next allocation.
+ */
+TEST(TableSpaceTest, IgnoreUnknownHeaderFields) {
+    unlink(LAZY_TABLE_PATH);
+    file_open_table_file(LAZY_TABLE_PATH);
+    file_close_table_files();
+
+    headerpage_t header_page;
+    int table_fd = open(LAZY_TABLE_PATH, O_RDWR);
+    ASSERT_EQ(pread(table_fd, &header_page, PAGE_SIZE, 0), PAGE_SIZE);
+    EXPECT_EQ(header_page.magic, HEADER_MAGIC);
+    EXPECT_EQ(header_page.unformatted_page_idx, 1);
+    pagenum_t page_num = header_page.page_num;
+    header_page.magic = 0;
+    header_page.hole_count = 1;
+    header_page.holes[0] = {1, 2};
+    ASSERT_EQ(pwrite(table_fd, &header_page, PAGE_SIZE, 0), PAGE_SIZE);
+    close(table_fd);
+
+    tableid_t table_id = file_open_table_file(LAZY_TABLE_PATH);
+    EXPECT_EQ(file_alloc_page(table_id), page_num);
+    file_close_table_files();
+
+    table_fd = open(LAZY_TABLE_PATH, O_RDWR);
+    ASSERT_EQ(pread(table_fd, &header_page, PAGE_SIZE, 0), PAGE_SIZE);
+    EXPECT_EQ(header_page.magic, HEADER_MAGIC);
+    page_num = header_page.page_num;
+    header_page.unformatted_page_idx = page_num + 100;
+    header_page.hole_count = 1;
+    header_page.holes[0] = {page_num - 1, page_num + 100};
+    ASSERT_EQ(pwrite(table_fd, &header_page, PAGE_SIZE, 0), PAGE_SIZE);
+    close(table_fd);
+
+    table_id = file_open_table_file(LAZY_TABLE_PATH);
+    EXPECT_EQ(file_alloc_page(table_id), page_num);
+    file_close_table_files();
+    unlink(LAZY_TABLE_PATH);
+}
+
+/// @brief Table space test table path
+#define SPACE_TABLE_PATH "test_space.db"
+
+/**
+ * @brief Allocate a page in a thread, which exits with cached pages.
+ *
+ * @param arg   <code>tableid_t*</code> of the table.
+ * @return allocated page index.
+ */
+static void* alloc_page_in_thread(void* arg) {
+    tableid_t table_id = *reinterpret_cast<tableid_t*>(arg);
+    return reinterpret_cast<void*>(buffered_alloc_page(table_id));
+}
+
+/**
+ * @brief   Tests the in-memory free space.
+ * @details Allocations do not write the header page, and the free page list
+ * is written at a checkpoint. Pages cached by an exited thread are given back,
+ * and the LIFO order survives a restart.
+ */
+TEST(TableSpaceTest, PersistLazily) {
+    unlink(SPACE_TABLE_PATH);
+    ASSERT_EQ(init_db(), 0);
+    tableid_t table_id = buffered_open_table_file(SPACE_TABLE_PATH);
+    EXPECT_EQ(space_get_page_count(table_id), 2560);
+
+    pagenum_t pages[3];
+    for (int i = 0; i < 3; i++) {
+        pages[i] = buffered_alloc_page(table_id);
+    }
+    EXPECT_EQ(pages[0], 1);
+    EXPECT_EQ(pages[1], 2);
+    EXPECT_EQ(pages[2], 3);
+
+    headerpage_t header_page;
+    file_read_page(table_id, 0, &header_page);
+    EXPECT_EQ(header_page.free_page_idx, 0);
+    EXPECT_EQ(header_page.unformatted_page_idx, 1);
+
+    buffered_free_page(table_id, pages[1]);
+    ASSERT_EQ(flush_buffer(), 0);
+    file_read_page(table_id, 0, &header_page);
+    EXPECT_EQ(header_page.free_page_idx, pages[1]);
+    freepage_t free_page;
+    file_read_page(table_id, pages[1], &free_page);
+    EXPECT_EQ(free_page.next_free_idx, 4);
+
+    // The cache of the thread is given back when it exits.
+    pthread_t thread;
+    void* allocated;
+    ASSERT_EQ(pthread_create(&thread, nullptr, alloc_page_in_thread,
+                             &table_id),
+              0);
+    pthread_join(thread, &allocated);
+    EXPECT_EQ(reinterpret_cast<pagenum_t>(allocated), pages[1]);
+    buffered_free_page(table_id, pages[1]);
+    shutdown_db();
+
+    ASSERT_EQ(init_db(), 0);
+    table_id = buffered_open_table_file(SPACE_TABLE_PATH);
+    EXPECT_EQ(buffered_alloc_page(table_id), pages[1]);
+    EXPECT_EQ(buffered_alloc_page(table_id), 4);
+
+    shutdown_db();
+    unlink(SPACE_TABLE_PATH);
+}
+
+/// @brief Extent test table path
+#define EXTENT_TABLE_PATH "test_extent.db"
+
+/**
+ * @brief   Tests allocating pages of a tree level in extents.
+ * @details A page is placed after its neighbour, and the pages of each level
+ * are taken from separate extents. The unused pages of the extents are given
+ * back when the table is closed. Sequential inserts lay the leaves out in key
+ * order.
+ */
+TEST(TableSpaceTest, AllocateExtents) {
+    unlink(EXTENT_TABLE_PATH);
+    ASSERT_EQ(init_db(), 0);
+    tableid_t table_id = buffered_open_table_file(EXTENT_TABLE_PATH);
+
+    pagenum_t leaf_idx = buffered_alloc_page_near(table_id, LEAF_LEVEL);
+    EXPECT_EQ(leaf_idx, 1);
+    EXPECT_EQ(buffered_alloc_page_near(table_id, LEAF_LEVEL, leaf_idx), 2);
+    EXPECT_EQ(buffered_alloc_page_near(table_id, INTERNAL_LEVEL),
+              1 + SPACE_EXTENT_SIZE);
+    shutdown_db();
+
+    table_id = file_open_table_file(EXTENT_TABLE_PATH);
+    headerpage_t header_page;
+    file_read_page(table_id, 0, &header_page);
+    EXPECT_EQ(header_page.free_page_idx, 3);
+    EXPECT_EQ(header_page.unformatted_page_idx, 2 + SPACE_EXTENT_SIZE);
+    file_close_table_files();
+    unlink(EXTENT_TABLE_PATH);
+
+    ASSERT_EQ(init_db(), 0);
+    table_id = open_table(const_cast<char*>(EXTENT_TABLE_PATH));
+    char value[MAX_VALUE_SIZE] = {};
+    for (int key = 0; key < 10000; key++) {
+        ASSERT_EQ(db_insert(table_id, key, value, 100), 0);
+    }
+
+    LeafFragmentation fragmentation;
+    ASSERT_EQ(db_get_leaf_fragmentation(table_id, &fragmentation), 0);
+    EXPECT_GT(fragmentation.leaf_count, 100);
+    EXPECT_EQ(fragmentation.forward_links, fragmentation.leaf_count - 1);
+    EXPECT_GE(fragmentation.sequential_links * 10,
+              (fragmentation.leaf_count - 1) * 9);
+
+    shutdown_db();
+    unlink(EXTENT_TABLE_PATH);
+}
+
+extern BufferShard* buffer_shards;
+extern int buffer_shard_count;
+
+/// @brief Table registry test table path format
+#define REGISTRY_TABLE_PATH "test_registry_%d.db"
+/// @brief Number of tables opened by the registry test
+#define REGISTRY_TABLE_COUNT 40
+
+/**
+ * @brief   Tests opening and closing tables one by one.
+ * @details More tables than the old fixed registry are open at once, and a
+ * path keeps its id while it is open. A closed table gives its frames and
+ * victim cache entries up, and gets a new id when it is opened again, with
+ * its records and free space intact.
+ */
+TEST(TableRegistryTest, CloseAndReopen) {
+    char paths[REGISTRY_TABLE_COUNT][32];
+    for (int i = 0; i < REGISTRY_TABLE_COUNT; i++) {
+        snprintf(paths[i], sizeof(paths[i]), REGISTRY_TABLE_PATH, i);
+        unlink(paths[i]);
+    }
+    ASSERT_EQ(init_db(8, 1, LRU_POLICY), 0);
+    ASSERT_EQ(set_buffer_cleaner(0), 0);
+    ASSERT_EQ(set_read_ahead(0), 0);
+    ASSERT_EQ(db_set_victim_cache(1 << 20), 0);
+
+    tableid_t table_ids[REGISTRY_TABLE_COUNT];
+    for (int i = 0; i < REGISTRY_TABLE_COUNT; i++) {
+        table_ids[i] = open_table(paths[i]);
+        ASSERT_GE(table_ids[i], 0);
+        if (i > 0) {
+            EXPECT_GT(table_ids[i], table_ids[i - 1]);
+        }
+    }
+    EXPECT_EQ(open_table(paths[7]), table_ids[7]);
+
+    char value[MAX_VALUE_SIZE] = {};
+    for (int key = 0; key < 500; key++) {
+        ASSERT_EQ(db_insert(table_ids[0], key, value, 100), 0);
+    }
+    pagenum_t page_count = space_get_page_count(table_ids[0]);
+    EXPECT_GT(db_get_victim_cache_stats().cached_pages, 0);
+
+    ASSERT_EQ(close_table(table_ids[0]), 0);
+    EXPECT_EQ(close_table(table_ids[0]), -1);
+    EXPECT_EQ(db_get_victim_cache_stats().cached_pages, 0);
+    for (int shard_idx = 0; shard_idx < buffer_shard_count; shard_idx++) {
+        BufferShard& shard = buffer_shards[shard_idx];
+        for (int i = 0; i < shard.size; i++) {
+            EXPECT_NE(buffer_helper::get_frame(shard, i)->page_location.first,
+                      table_ids[0]);
+        }
+    }
+
+    tableid_t table_id = open_table(paths[0]);
+    EXPECT_GT(table_id, table_ids[REGISTRY_TABLE_COUNT - 1]);
+    EXPECT_EQ(space_get_page_count(table_id), page_count);
+    valsize_t value_size;
+    for (int key = 0; key < 500; key++) {
+        ASSERT_EQ(db_find(table_id, key, value, &value_size), 0);
+    }
+    EXPECT_GT(db_get_buffer_stats().table_misses[table_id], 0);
+
+    shutdown_db();
+    for (int i = 0; i < REGISTRY_TABLE_COUNT; i++) {
+        unlink(paths[i]);
+    }
+}
+
+/**
+ * @brief Registry test reader argument.
+ */
+struct RegistryReaderArgs {
+    /// @brief table id.
+    tableid_t table_id;
+    /// @brief number of records.
+    int record_count;
+    /// @brief number of records found before the table is closed.
+    std::atomic<int> found_count;
+};
+
+/**
+ * @brief   Find the records repeatedly until the table is closed.
+ *
+ * @param arg   <code>RegistryReaderArgs*</code>.
+ * @return <code>nullptr</code>.
+ */
+void* find_until_closed(void* arg) {
+    RegistryReaderArgs* args = reinterpret_cast<RegistryReaderArgs*>(arg);
+    char value[MAX_VALUE_SIZE];
+    valsize_t value_size;
+    for (int key = 0;; key = (key + 1) % args->record_count) {
+        if (db_find(args->table_id, key, value, &value_size) != 0) break;
+        args->found_count++;
+    }
+    return nullptr;
+}
+
+/**
+ * @brief   Tests closing a table while it is read.
+ * @details Readers find the records until the table is closed. The close
+ * waits for the running finds, and the later ones fail.
+ */
+TEST(TableRegistryTest, CloseWhileReading) {
+    constexpr int reader_count = 4;
+    constexpr int record_count = 1000;
+
+    char path[32];
+    snprintf(path, sizeof(path), REGISTRY_TABLE_PATH, 0);
+    unlink(path);
+    ASSERT_EQ(init_db(64), 0);
+    tableid_t table_id = open_table(path);
+    char value[MAX_VALUE_SIZE] = {};
+    for (int key = 0; key < record_count; key++) {
+        ASSERT_EQ(db_insert(table_id, key, value, 100), 0);
+    }
+
+    RegistryReaderArgs args;
+    args.table_id = table_id;
+    args.record_count = record_count;
+    args.found_count = 0;
+    pthread_t readers[reader_count];
+    for (int i = 0; i < reader_count; i++) {
+        ASSERT_EQ(
+            pthread_create(&readers[i], nullptr, find_until_closed, &args), 0);
+    }
+    while (args.found_count < record_count) {
+        usleep(1000);
+    }
+    EXPECT_EQ(close_table(table_id), 0);
+    for (int i = 0; i < reader_count; i++) {
+        pthread_join(readers[i], nullptr);
+    }
+
+    table_id = open_table(path);
+    valsize_t value_size;
+    for (int key = 0; key < record_count; key++) {
+        ASSERT_EQ(db_find(table_id, key, value, &value_size), 0);
+    }
+
+    shutdown_db();
+    unlink(path);
+}
+
+/// @brief Vectored I/O test table path
+#define VECTORED_TABLE_PATH "test_vectored.db"
+
+/**
+ * @brief   Tests vectored page I/O.
+ * @details Write runs of consecutive pages and scattered pages out of order,
+ * then read them in another order. Both should match page by page.
+ */
+TEST(VectoredPageIOTest, ReadAndWritePages) {
+    unlink(VECTORED_TABLE_PATH);
+    ASSERT_EQ(init_db(), 0);
+    tableid_t table_id = open_table(const_cast<char*>(VECTORED_TABLE_PATH));
+    ASSERT_GE(table_id, 0);
+
+    std::vector<pagenum_t> pagenums;
+    for (pagenum_t pagenum = 1; pagenum < 1 + 2 * IOV_MAX; pagenum++) {
+        pagenums.push_back(pagenum);
+    }
+    for (pagenum_t pagenum = 2000; pagenum < 2100; pagenum += 3) {
+        pagenums.push_back(pagenum);
+    }
+    srand(23);
+    for (size_t i = pagenums.size() - 1; i > 0; i--) {
+        std::swap(pagenums[i], pagenums[rand() % (i + 1)]);
+    }
+
+    std::vector<fullpage_t> pages(pagenums.size());
+    std::vector<PageBuffer> buffers(pagenums.size());
+    for (size_t i = 0; i < pagenums.size(); i++) {
+        memset(&pages[i], pagenums[i] % 251, PAGE_SIZE);
+        buffers[i] = {pagenums[i], &pages[i]};
+    }
+    file_write_pages(table_id, buffers.data(), buffers.size());
+
+    std::reverse(pagenums.begin(), pagenums.end());
+    std::vector<fullpage_t> read_pages(pagenums.size());
+    for (size_t i = 0; i < pagenums.size(); i++) {
+        buffers[i] = {pagenums[i], &read_pages[i]};
+    }
+    file_read_pages(table_id, buffers.data(), buffers.size());
+
+    fullpage_t expected;
+    for (size_t i = 0; i < pagenums.size(); i++) {
+        memset(&expected, pagenums[i] % 251, PAGE_SIZE);
+        EXPECT_EQ(memcmp(&expected, &read_pages[i], PAGE_SIZE), 0);
+    }
+
+    shutdown_db();
+    unlink(VECTORED_TABLE_PATH);
+}
+
+/// @brief Compaction test table path
+#define COMPACTION_TABLE_PATH "test_compaction.db"
+
+/**
+ * @brief   Tests moving tree pages and truncating the file.
+ * @details Most of the lower keys are deleted, so that the leaves of the
+ * upper keys are moved into the freed pages. The file should end right after
+ * the tree, and every record should be found and scanned in order, before and
+ * after a restart.
+ */
+TEST(TableCompactionTest, MoveAndTruncate) {
+    unlink(COMPACTION_TABLE_PATH);
+    ASSERT_EQ(init_db(), 0);
+    tableid_t table_id = open_table(const_cast<char*>(COMPACTION_TABLE_PATH));
+    char value[MAX_VALUE_SIZE] = {};
+    for (int key = 0; key < 20000; key++) {
+        ASSERT_EQ(db_insert(table_id, key, value, 100), 0);
+    }
+    for (int key = 0; key < 15000; key++) {
+        ASSERT_EQ(db_delete(table_id, key), 0);
+    }
+    pagenum_t page_count = space_get_page_count(table_id);
+
+    CompactionStats stats;
+    ASSERT_EQ(db_compact_table(table_id, -1, &stats), 0);
+    EXPECT_GT(stats.moved_pages, 0);
+    EXPECT_EQ(stats.punched_pages, 0);
+    EXPECT_EQ(space_get_page_count(table_id),
+              page_count - stats.truncated_pages);
+    EXPECT_EQ(space_get_page_count(table_id),
+              map_tree_links(table_id).size() + 1);
+
+    // Moved leaves keep their order.
+    LeafFragmentation fragmentation;
+    ASSERT_EQ(db_get_leaf_fragmentation(table_id, &fragmentation), 0);
+    EXPECT_GE(fragmentation.sequential_links * 10,
+              (fragmentation.leaf_count - 1) * 9);
+
+    struct stat table_stat;
+    ASSERT_EQ(stat(COMPACTION_TABLE_PATH, &table_stat), 0);
+    EXPECT_EQ(table_stat.st_size, space_get_page_count(table_id) * PAGE_SIZE);
+
+    valsize_t value_size;
+    for (int key = 15000; key < 20000; key++) {
+        ASSERT_EQ(db_find(table_id, key, value, &value_size), 0);
+    }
+    recordkey_t last_key = 14999;
+    EXPECT_EQ(db_scan(table_id, 0, 20000,
+                      [&last_key](recordkey_t key, const char*, valsize_t) {
+                          EXPECT_EQ(key, last_key + 1);
+                          last_key = key;
+                          return true;
+                      }),
+              5000);
+    page_count = space_get_page_count(table_id);
+    shutdown_db();
+
+    ASSERT_EQ(init_db(), 0);
+    table_id = open_table(const_cast<char*>(COMPACTION_TABLE_PATH));
+    EXPECT_EQ(space_get_page_count(table_id), page_count);
+    for (int key = 15000; key < 20000; key++) {
+        ASSERT_EQ(db_find(table_id, key, value, &value_size), 0);
+    }
+    EXPECT_NE(db_find(table_id, 0, value, &value_size), 0);
+
+    shutdown_db();
+    unlink(COMPACTION_TABLE_PATH);
+}
+
+/**
+ * @brief Compaction test writer argument.
+ */
+struct CompactionWriterArgs {
+    /// @brief table id.
+    tableid_t table_id;
+    /// @brief first key to insert.
+    int first_key;
+    /// @brief number of keys to insert.
+    int key_count;
+    /// @brief <code>true</code> once the writer is done.
+    std::atomic<bool> is_done;
+};
+
+/**
+ * @brief   Insert the keys, and delete the even ones.
+ *
+ * @param arg   <code>CompactionWriterArgs*</code>.
+ * @return <code>nullptr</code>.
+ */
+void* write_compacted_records(void* arg) {
+    CompactionWriterArgs* args = reinterpret_cast<CompactionWriterArgs*>(arg);
+    char value[MAX_VALUE_SIZE] = {};
+    for (int i = 0; i < args->key_count; i++) {
+        db_insert(args->table_id, args->first_key + i, value, 100);
+    }
+    for (int i = 0; i < args->key_count; i += 2) {
+        db_delete(args->table_id, args->first_key + i);
+    }
+    args->is_done = true;
+    return nullptr;
+}
+
+/**
+ * @brief   Tests compacting a table while it is modified.
+ * @details A writer inserts and deletes records while the table is compacted
+ * over and over. The writer waits for each compaction, so every record it
+ * left should be found.
+ */
+TEST(TableCompactionTest, CompactWhileWriting) {
+    constexpr int key_count = 10000;
+
+    unlink(COMPACTION_TABLE_PATH);
+    ASSERT_EQ(init_db(), 0);
+    tableid_t table_id = open_table(const_cast<char*>(COMPACTION_TABLE_PATH));
+    char value[MAX_VALUE_SIZE] = {};
+    for (int key = 0; key < key_count; key++) {
+        ASSERT_EQ(db_insert(table_id, key, value, 100), 0);
+    }
+    for (int key = 0; key < key_count; key++) {
+        ASSERT_EQ(db_delete(table_id, key), 0);
+    }
+
+    CompactionWriterArgs args;
+    args.table_id = table_id;
+    args.first_key = key_count;
+    args.key_count = key_count;
+    args.is_done = false;
+    pthread_t writer;
+    ASSERT_EQ(
+        pthread_create(&writer, nullptr, write_compacted_records, &args), 0);
+    int compactions = 0;
+    while (!args.is_done) {
+        CompactionStats stats;
+        EXPECT_EQ(db_compact_table(table_id, 16, &stats), 0);
+        compactions++;
+    }
+    pthread_join(writer, nullptr);
+    EXPECT_GT(compactions, 0);
+
+    valsize_t value_size;
+    for (int key = key_count; key < key_count * 2; key++) {
+        EXPECT_EQ(db_find(table_id, key, value, &value_size) == 0,
+                  key % 2 == 1)
+            << key;
+    }
+
+    shutdown_db();
+    unlink(COMPACTION_TABLE_PATH);
+}
+
+/**
+ * @brief   Tests moving a page with stale links.
+ * @details The links of a leaf claim it is the root, so the move fails
+ * without modifying the tree.
+ */
+TEST(TableCompactionTest, RejectStaleLinks) {
+    unlink(COMPACTION_TABLE_PATH);
+    ASSERT_EQ(init_db(), 0);
+    tableid_t table_id = open_table(const_cast<char*>(COMPACTION_TABLE_PATH));
+    char value[MAX_VALUE_SIZE] = {};
+    for (int key = 0; key < 2000; key++) {
+        ASSERT_EQ(db_insert(table_id, key, value, 100), 0);
+    }
+
+    std::unordered_map<pagenum_t, TreePageLinks> links =
+        map_tree_links(table_id);
+    pagenum_t page_idx = 0;
+    for (const auto& page_links : links) {
+        if (page_links.second.left_page_idx != 0) {
+            page_idx = page_links.first;
+            break;
+        }
+    }
+    ASSERT_NE(page_idx, 0);
+    links[page_idx].parent_page_idx = 0;
+
+    pagenum_t new_page_idx = buffered_alloc_page(table_id);
+    EXPECT_EQ(relocate_page(table_id, page_idx, new_page_idx, links), -1);
+    buffered_free_page(table_id, new_page_idx);
+    EXPECT_EQ(map_tree_links(table_id).count(page_idx), 1);
+
+    valsize_t value_size;
+    for (int key = 0; key < 2000; key++) {
+        ASSERT_EQ(db_find(table_id, key, value, &value_size), 0);
+    }
+
+    shutdown_db();
+    unlink(COMPACTION_TABLE_PATH);
+}
+
+/**
+ * @brief   Tests refusing to compact a table with record locks.
+ * @details A running transaction holds a record lock, so nothing should be
+ * moved until it commits. Then the limit of moves should hold across the
+ * batches.
+ */
+TEST(TableCompactionTest, RefuseWithRecordLocks) {
+    unlink(COMPACTION_TABLE_PATH);
+    ASSERT_EQ(init_db(), 0);
+    tableid_t table_id = open_table(const_cast<char*>(COMPACTION_TABLE_PATH));
+    char value[MAX_VALUE_SIZE] = {};
+    for (int key = 0; key < 20000; key++) {
+        ASSERT_EQ(db_insert(table_id, key, value, 100), 0);
+    }
+    for (int key = 0; key < 15000; key++) {
+        ASSERT_EQ(db_delete(table_id, key), 0);
+    }
+
+    trxid_t trx_id = trx_begin();
+    valsize_t value_size;
+    ASSERT_EQ(db_find(table_id, 19999, value, &value_size, trx_id), 0);
+    CompactionStats stats;
+    EXPECT_EQ(db_compact_table(table_id, -1, &stats), -1);
+    EXPECT_EQ(stats.moved_pages, 0);
+    ASSERT_EQ(trx_commit(trx_id), trx_id);
+
+    int max_moves = COMPACTION_BATCH_MOVES + COMPACTION_BATCH_MOVES / 2;
+    ASSERT_EQ(db_compact_table(table_id, max_moves, &stats), 0);
+    EXPECT_EQ(stats.moved_pages, max_moves);
+    for (int key = 15000; key < 20000; key++) {
+        ASSERT_EQ(db_find(table_id, key, value, &value_size), 0);
+    }
+
+    shutdown_db();
+    unlink(COMPACTION_TABLE_PATH);
+}
+
+/**
+ * @brief   Tests punching the free extents in the middle of the file.
+ * @details The middle keys are deleted and nothing is moved, so the freed
+ * extents are punched and recorded in the header page. They should be loaded
+ * again after a restart, and reused by new records. The dirty pages of
+ * another table are not written by the compaction.
+ */
+TEST(TableCompactionTest, PunchFreeExtents) {
+    unlink(COMPACTION_TABLE_PATH);
+    ASSERT_EQ(init_db(), 0);
+    tableid_t table_id = open_table(const_cast<char*>(COMPACTION_TABLE_PATH));
+    char value[MAX_VALUE_SIZE] = {};
+    for (int key = 0; key < 20000; key++) {
+        ASSERT_EQ(db_insert(table_id, key, value, 100), 0);
+    }
+    for (int key = 5000; key < 15000; key++) {
+        ASSERT_EQ(db_delete(table_id, key), 0);
+    }
+    ASSERT_EQ(set_buffer_cleaner(0), 0);
+    tableid_t other_id = buffered_open_table_file(ANOTHER_TABLE_PATH);
+    {
+        PageGuard<freepage_t> page(other_id, 1, EXCLUSIVE_LATCH);
+        page.mark_dirty();
+    }
+
+    CompactionStats stats;
+    ASSERT_EQ(db_compact_table(table_id, 0, &stats), 0);
+    EXPECT_EQ(stats.moved_pages, 0);
+    EXPECT_GT(stats.punched_pages, 0);
+    EXPECT_EQ(stats.punched_pages % SPACE_EXTENT_SIZE, 0);
+    pagenum_t page_count = space_get_page_count(table_id);
+
+    PageLocation other_location = std::make_pair(other_id, 1);
+    BufferShard& shard = buffer_helper::get_shard(other_location);
+    int frame_idx = shard.index.find(other_location);
+    ASSERT_GE(frame_idx, 0);
+    EXPECT_TRUE(buffer_helper::get_frame(shard, frame_idx)->is_dirty);
+    shutdown_db();
+
+    table_id = file_open_table_file(COMPACTION_TABLE_PATH);
+    headerpage_t header_page;
+    file_read_page(table_id, 0, &header_page);
+    EXPECT_GT(header_page.hole_count, 0);
+    pagenum_t hole_pages = 0;
+    for (uint64_t i = 0; i < header_page.hole_count; i++) {
+        hole_pages += header_page.holes[i].end - header_page.holes[i].first;
+    }
+    EXPECT_EQ(hole_pages, stats.punched_pages);
+    file_close_table_files();
+
+    ASSERT_EQ(init_db(), 0);
+    table_id = open_table(const_cast<char*>(COMPACTION_TABLE_PATH));
+    valsize_t value_size;
+    for (int key = 0; key < 20000; key++) {
+        EXPECT_EQ(db_find(table_id, key, value, &value_size) == 0,
+                  key < 5000 || key >= 15000);
+    }
+    for (int key = 5000; key < 15000; key++) {
+        ASSERT_EQ(db_insert(table_id, key, value, 100), 0);
+    }
+    EXPECT_EQ(space_get_page_count(table_id), page_count);
+    for (int key = 0; key < 20000; key++) {
+        ASSERT_EQ(db_find(table_id, key, value, &value_size), 0);
+    }
+
+    shutdown_db();
+    unlink(COMPACTION_TABLE_PATH);
+    unlink(ANOTHER_TABLE_PATH);
+}
 /** @}*/
\ No newline at end of file
@@ -0,0 +1,62 @@
+/**
+ * @addtogroup TestCode
+ * @{
+ */
+#include <gtest/gtest.h>
+#include <key_search.h>
+#include <page.h>
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+/**
+ * @brief   Tests the key search kernels against linear scans.
+ * @details Sorted random keys fill the pages from empty to full. Every kernel
+ * the CPU supports and the leaf page search should give the same results as
+ * the linear scans, for the stored keys, their neighbours and both ends.
+ */
+TEST(KeySearchTest, KernelsMatchLinearScan) {
+    std::mt19937 gen(5);
+    std::uniform_int_distribution<recordkey_t> gap_dis(1, 1000);
+    const int fill_counts[] = {0, 1, 2, 3, 4, 5, 15, 16, 17, 33, 124, 186, 248};
+    KeySearchKernel supported = key_search_helper::get_supported_kernel();
+
+    for (int count : fill_counts) {
+        internalpage_t internal_page;
+        leafpage_t leaf_page;
+        PageSlot* leaf_slot = page_helper::get_page_slot(&leaf_page);
+        internal_page.page_header.key_num = count;
+        leaf_page.page_header.key_num = count;
+
+        std::vector<recordkey_t> queries = {INT64_MIN, INT64_MAX};
+        recordkey_t key = -50000;
+        for (int i = 0; i < count; i++) {
+            key += gap_dis(gen);
+            internal_page.page_branches[i].key = key;
+            leaf_slot[i].key = key;
+            queries.insert(queries.end(), {key - 1, key, key + 1});
+        }
+
+        for (recordkey_t query : queries) {
+            int branch_idx = -1;
+            int record_idx = -1;
+            for (int i = 0; i < count; i++) {
+                if (internal_page.page_branches[i].key <= query) branch_idx = i;
+                if (leaf_slot[i].key == query) record_idx = i;
+            }
+
+            for (int kernel = SCALAR_SEARCH; kernel <= supported; kernel++) {
+                EXPECT_EQ(key_search_helper::upper_bound_branches(
+                              static_cast<KeySearchKernel>(kernel),
+                              internal_page.page_branches, count, query),
+                          branch_idx + 1);
+            }
+            EXPECT_EQ(page_helper::get_branch_idx(&internal_page, query),
+                      branch_idx);
+            EXPECT_EQ(page_helper::get_record_idx(&leaf_page, query),
+                      record_idx);
+        }
+    }
+}
+/** @}*/
\ No newline at end of file
@@ -0,0 +1,73 @@
+/**
+ * @addtogroup TestCode
+ * @{
+ */
+#include <gtest/gtest.h>
+#include <page_table.h>
+
+#include <cstdlib>
+#include <unordered_map>
+
+/**
+ * @brief   Tests page table updates.
+ * @details Insert and erase pages at random while mirroring them in a
+ * reference map, so that erasing shifts entries of long probe sequences.
+ */
+TEST(PageTableTest, InsertAndErase) {
+    constexpr int capacity = 64;
+    PageTable page_table;
+    page_table.init(capacity);
+
+    std::unordered_map<PageLocation, int> reference;
+    srand(1);
+    for (int step = 0; step < 100000; step++) {
+        PageLocation page_location =
+            std::make_pair(rand() % 4, static_cast<pagenum_t>(rand() % 256));
+        if (reference.count(page_location) != 0) {
+            page_table.erase(page_location);
+            reference.erase(page_location);
+        } else if (static_cast<int>(reference.size()) < capacity) {
+            page_table.insert(page_location, step);
+            reference[page_location] = step;
+        }
+
+        ASSERT_EQ(page_table.size(), reference.size());
+        if (step % 1000 == 0) {
+            for (int table_id = 0; table_id < 4; table_id++) {
+                for (pagenum_t pagenum = 0; pagenum < 256; pagenum++) {
+                    PageLocation location = std::make_pair(table_id, pagenum);
+                    const auto& expected = reference.find(location);
+                    ASSERT_EQ(page_table.find(location),
+                              expected != reference.end() ? expected->second
+                                                          : -1);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief   Tests growing the page table.
+ * @details Every stored page should be found after the slots are replaced,
+ * and more pages than the initial capacity should fit.
+ */
+TEST(PageTableTest, Reserve) {
+    PageTable page_table;
+    page_table.init(16);
+    for (int i = 0; i < 16; i++) {
+        page_table.insert(std::make_pair(1, static_cast<pagenum_t>(i)), i);
+    }
+
+    page_table.reserve(8);
+    page_table.reserve(256);
+    for (int i = 16; i < 256; i++) {
+        page_table.insert(std::make_pair(1, static_cast<pagenum_t>(i)), i);
+    }
+
+    EXPECT_EQ(page_table.size(), 256);
+    for (int i = 0; i < 256; i++) {
+        EXPECT_EQ(page_table.find(std::make_pair(1, static_cast<pagenum_t>(i))),
+                  i);
+    }
+}
+/** @}*/
\ No newline at end of file
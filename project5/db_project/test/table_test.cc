@@ -119,4 +119,45 @@ TEST_F(BasicTableTest, RandomDeletionTest) {
     }
 }
 
+/**
+ * @brief   Tests database range scan API.
+ * @details 1. Open a database and write records in random order.
+ *          2. Scan a key range and check the keys are visited in order.
+ *          3. Stop a scan in the middle.
+ */
+TEST_F(BasicTableTest, RangeScanTest) {
+    tableid_t table_id = open_table("test_scan_table.db");
+    ASSERT_TRUE(table_id >= 0);
+
+    for (int i = 0; i < test_count; i++) {
+        uint8_t temp_value[128] = {};
+        temp_value[0] = test_order[i] % 256;
+
+        ASSERT_EQ(db_insert(table_id, test_order[i],
+                            reinterpret_cast<char*>(temp_value), 64),
+                  0);
+    }
+
+    int next_key = 1000;
+    EXPECT_EQ(db_scan(table_id, 1000, 9999,
+                      [&next_key](recordkey_t key, const char* value,
+                                  valsize_t value_size) {
+                          EXPECT_EQ(key, next_key++);
+                          EXPECT_EQ(static_cast<uint8_t>(value[0]), key % 256);
+                          EXPECT_EQ(value_size, 64);
+                          return true;
+                      }),
+              9000);
+    EXPECT_EQ(next_key, 10000);
+
+    EXPECT_EQ(db_scan(table_id, 0, test_count,
+                      [](recordkey_t key, const char*, valsize_t) {
+                          return key < 99;
+                      }),
+              100);
+    EXPECT_LT(db_scan(table_id, 10, 0,
+                      [](recordkey_t, const char*, valsize_t) { return true; }),
+              0);
+}
+
 /** @}*/
\ No newline at end of file
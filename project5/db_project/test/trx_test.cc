@@ -8,6 +8,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <pthread.h>
+#include <unistd.h>
 
 #include <cstdlib>
 #include <cstring>
@@ -103,4 +104,114 @@ TEST_F(BasicTransactionTest, TransactionTest) {
     }
 }
 
+/**
+ * @brief   Tests updates which change the size of a value.
+ * @details The updated record lies between others in the leaf, so its value
+ * grows into and shrinks away from the values next to it, which should be
+ * kept intact.
+ */
+TEST_F(BasicTransactionTest, ResizeValueOnUpdate) {
+    unlink("test_trx_resize.db");
+    tableid_t resize_table_id = open_table("test_trx_resize.db");
+    ASSERT_TRUE(resize_table_id >= 0);
+    char values[3][128];
+    for (int key = 0; key < 3; key++) {
+        memset(values[key], 'a' + key, sizeof(values[key]));
+        ASSERT_EQ(db_insert(resize_table_id, key, values[key], 50), 0);
+    }
+
+    char found[128];
+    valsize_t value_size;
+    trxid_t trx_id = trx_begin();
+    for (valsize_t new_size : {120, 10}) {
+        char value[128];
+        memset(value, 'z', sizeof(value));
+        valsize_t old_size;
+        ASSERT_EQ(db_update(resize_table_id, 1, value, new_size, &old_size,
+                            trx_id),
+                  0);
+
+        ASSERT_EQ(db_find(resize_table_id, 1, found, &value_size, trx_id), 0);
+        EXPECT_EQ(value_size, new_size);
+        EXPECT_EQ(memcmp(found, value, new_size), 0);
+        for (int key : {0, 2}) {
+            ASSERT_EQ(
+                db_find(resize_table_id, key, found, &value_size, trx_id), 0);
+            EXPECT_EQ(value_size, 50);
+            EXPECT_EQ(memcmp(found, values[key], 50), 0);
+        }
+    }
+    trx_commit(trx_id);
+    unlink("test_trx_resize.db");
+}
+
+/**
+ * @brief Argument of the reading transaction.
+ */
+struct FindTrxArgs {
+    /// @brief table id.
+    tableid_t table_id;
+    /// @brief record key.
+    recordkey_t key;
+    /// @brief result of the find.
+    int result;
+};
+
+/**
+ * @brief   Find a record in a new transaction, and commit it.
+ *
+ * @param arg   <code>FindTrxArgs*</code>.
+ * @return <code>nullptr</code>.
+ */
+void* find_in_trx(void* arg) {
+    FindTrxArgs* args = reinterpret_cast<FindTrxArgs*>(arg);
+    char value[128];
+    valsize_t value_size;
+    trxid_t trx_id = trx_begin();
+    args->result = db_find(args->table_id, args->key, value, &value_size,
+                           trx_id);
+    trx_commit(trx_id);
+    return nullptr;
+}
+
+/**
+ * @brief   Tests a find waiting for the record lock of an update.
+ * @details The finding transaction waits for the lock of the updating one,
+ * which updates another record of the leaf meanwhile. The find should not
+ * hold the leaf while it waits, so the update latches it and both commit.
+ */
+TEST_F(BasicTransactionTest, FindWaitsForUpdate) {
+    unlink("test_trx_wait.db");
+    tableid_t wait_table_id = open_table("test_trx_wait.db");
+    ASSERT_TRUE(wait_table_id >= 0);
+    char value[128] = "initial";
+    ASSERT_EQ(db_insert(wait_table_id, 1, value, 100), 0);
+    ASSERT_EQ(db_insert(wait_table_id, 2, value, 100), 0);
+
+    valsize_t return_size;
+    trxid_t trx_id = trx_begin();
+    strcpy(value, "first");
+    ASSERT_EQ(
+        db_update(wait_table_id, 1, value, 100, &return_size, trx_id), 0);
+
+    FindTrxArgs args = {wait_table_id, 1, -2};
+    pthread_t reader;
+    ASSERT_EQ(pthread_create(&reader, nullptr, find_in_trx, &args), 0);
+    usleep(100000);
+
+    strcpy(value, "second");
+    EXPECT_EQ(
+        db_update(wait_table_id, 2, value, 100, &return_size, trx_id), 0);
+    trx_commit(trx_id);
+
+    pthread_join(reader, nullptr);
+    EXPECT_EQ(args.result, 0);
+    char found[128];
+    ASSERT_EQ(db_find(wait_table_id, 1, found, &return_size), 0);
+    EXPECT_STREQ(found, "first");
+    ASSERT_EQ(db_find(wait_table_id, 2, found, &return_size), 0);
+    EXPECT_STREQ(found, "second");
+    unlink("test_trx_wait.db");
+}
+
 /** @}*/
\ No newline at end of file